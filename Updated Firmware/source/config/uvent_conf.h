@@ -15,6 +15,19 @@
 #define SCREEN_WIDTH 800
 #define SCREEN_HEIGHT 480
 
+/* Display draw buffers, see display/flush_pipeline.h. LVGL renders a strip of
+ * the screen into one while the other is sent to the display.
+ * Lines per buffer, the tallest a strip can be. Each is SCREEN_WIDTH * lines * 2 bytes.
+ */
+#define DISPLAY_BUFFER_LINES 15
+// Shortest strip the tuning tries, and its step.
+#define DISPLAY_STRIP_MIN_LINES 5
+#define DISPLAY_STRIP_STEP_LINES 5
+// Frames that drew something, per strip height tried.
+#define DISPLAY_TUNE_FRAMES 32
+// Invalidated areas are merged if the box around them is less than this many pixels more, about what a flush costs by itself.
+#define DISPLAY_MERGE_SLACK_PX 2000
+
 // Debug LED
 #define DEBUG_LED 13
 
@@ -34,12 +47,34 @@
 // Pressure sensor testing
 #define ENABLE_TEST_PRESSURE_SENSORS 0
 
-// Settings address on external eeprom
+// External eeprom, a 24LC512
+#define EXT_EEPROM_SIZE_BYTES 65536
+#define EXT_EEPROM_PAGE_BYTES 128
+
+// Settings address on external eeprom, before the settings journal. Only read to move them into the journal.
 #define EXT_EEPROM_SETTINGS_LOC 100
 
-// CRC address on external eeprom
+// CRC address on external eeprom, for the settings at EXT_EEPROM_SETTINGS_LOC
 #define EXT_EEPROM_CRC_LOC 0
 
+// Settings journal on external eeprom, see eeprom/journal.h. Slots are page aligned.
+#define EXT_EEPROM_JOURNAL_LOC 1024
+#define EXT_EEPROM_JOURNAL_SLOT_BYTES 128
+#define EXT_EEPROM_JOURNAL_SLOTS 128
+
+// Black box recorder on external eeprom, see eeprom/black_box.h. Whole pages, from the journal up to the test area.
+#define EXT_EEPROM_BLACK_BOX_LOC 17408
+#define EXT_EEPROM_BLACK_BOX_BYTES 45568
+
+// Black box entries queued between the control handler and the EEPROM
+#define BLACK_BOX_QUEUE_ENTRIES 32
+
+// Longest a breath waits in the black box queue for a page to fill, in ms
+#define BLACK_BOX_FLUSH_MS 10000
+
+// Volume calibration address on external eeprom, it has its own CRC
+#define EXT_EEPROM_VOLUME_CAL_LOC 200
+
 // Test EEPROM
 #define ENABLE_TEST_EEPROM 0
 
@@ -54,8 +89,29 @@
 // Serial baud rate
 #define SERIAL_BAUD_RATE 115200
 
+// Port for the binary telemetry stream, see controls/telemetry.h. Shares the console by default.
+#define TELEMETRY_SERIAL Serial
+
+// Telemetry queue in bytes, power of 2. Covers loop() stalls of about a third of a second at 115200 baud.
+#define TELEMETRY_BUFFER_BYTES 4096
+
 #define SPI_CLK_SPEED 22000000L
 
+// I2C bus clock, the touch controller, angle sensor and EEPROM share it. See utilities/i2c_bus.h.
+#define I2C_BUS_CLOCK_HZ 100000
+
+// How often Timer3 steps the I2C queue while anything is queued, microsec. A byte takes 90 us at 100 kHz.
+#define I2C_BUS_POLL_US 30
+
+// Most bytes a touch or bulk read moves in one go, so the longest a control read waits behind one.
+#define I2C_BUS_CHUNK_BYTES 4
+
+// A chunk that takes longer than this has failed, microsec. The bus is reset and the chunk tried again.
+#define I2C_BUS_TIMEOUT_US 5000
+
+// Tries at a chunk before the transaction fails.
+#define I2C_BUS_RETRIES 2
+
 #ifndef ENABLE_CONTROL
 #define ENABLE_CONTROL 1
 #endif
@@ -66,10 +122,54 @@
 // Actuator handler period in microsec.
 #define ACTUATOR_HANDLER_PERIOD_US 50
 
+// State changes queued by the control handler for loop(), a power of 2. See control_next_state_transition().
+#define CONTROL_TRANSITION_QUEUE_ENTRIES 16
+
+// Perf probes: time allowed for a pass of the LVGL handler and the readouts, one display refresh.
+#define PERF_LVGL_BUDGET_US 30000
+
+// Perf probes: time allowed for the display DMA interrupt, it holds off the actuator handler.
+#define PERF_DMA_ISR_BUDGET_US ACTUATOR_HANDLER_PERIOD_US
+
+// Perf probes: time allowed for a pass of the alarm rules, from the control handler.
+#define PERF_ALARM_RULES_BUDGET_US 200
+
+// Most tasks loop() runs, see utilities/scheduler.h.
+#define SCHEDULER_MAX_TASKS 8
+
+/* loop() tasks: period, and time allowed for a run, in microsec.
+ * The GUI runs LVGL, which redraws every LV_DISP_DEF_REFR_PERIOD and reads touch every LV_INDEV_DEF_READ_PERIOD.
+ * The readouts run every SENSOR_POLL_INTERVAL with PERF_LVGL_BUDGET_US.
+ */
+#define TASK_GUI_PERIOD_US 10000
+#define TASK_PARSER_PERIOD_US 10000
+#define TASK_PARSER_BUDGET_US 5000
+#define TASK_TELEMETRY_PERIOD_US 10000
+#define TASK_TELEMETRY_BUDGET_US 1000
+#define TASK_STORAGE_PERIOD_US 20000
+#define TASK_STORAGE_BUDGET_US 15000
+#define TASK_WEB_PERIOD_US 100000
+#define TASK_WEB_BUDGET_US 10000
+
 // Pressure Sensor pins
 #define PRESSURE_GAUGE_PIN 1
 #define PRESSURE_DIFF_PIN 0
 
+/* Sample the pressure sensors continuously in hardware.
+ * 1 = The ADC samples both sensors at ADC_SAMPLER_RATE_HZ into ring buffers, see sensors/adc_sampler.h
+ * 0 = Each reading is an analogRead()
+ */
+#define USE_ADC_SAMPLER 1
+
+// Pressure sensor sample rate, Hz
+#define ADC_SAMPLER_RATE_HZ 1000
+
+// Samples kept per sensor, a power of two. 256 is the last 256 ms at 1 kHz.
+#define ADC_SAMPLER_BUFFER_SAMPLES 256
+
+// Samples per sensor moved by the PDC between interrupts.
+#define ADC_SAMPLER_BLOCK_SAMPLES 10
+
 // Pressure Sensor resistor resistance in ohms
 #define RESISTANCE_1 100000
 #define RESISTANCE_2 196000
@@ -91,6 +191,22 @@
 #define MAX_DIFF_PRESSURE_TYPE_1 0.09
 #define MIN_DIFF_PRESSURE_TYPE_1 -0.09
 
+// Rate the breath analyzer takes pressure and flow at, Hz. Must divide ADC_SAMPLER_RATE_HZ.
+#define BREATH_ANALYZER_RATE_HZ 250
+
+// Plateau and PEEP are the mean pressure over this long at the end of the hold and of expiration, ms.
+#define BREATH_ANALYZER_WINDOW_MS 40
+
+// Compliance isn't worked out from a plateau less than this above PEEP, cmH2O.
+#define BREATH_ANALYZER_MIN_DRIVING_CMH2O 1.0
+
+// Flow sensor offset is worked out from the volume left over after each breath.
+// A breath that leaves more than this, in L/min over the breath, has a leak and isn't used.
+#define FLOW_DRIFT_MAX_LPM 3.0
+
+// Share of each breath's offset estimate that is taken off the flow.
+#define FLOW_DRIFT_GAIN 0.25
+
 //Relay 1 control Pin (SET PIN AS OUTPUT WHEN IMPLEMENTING WIPER MOTOR)
 #define RELAY1_CONTROL_PIN 7
 
@@ -112,6 +228,29 @@
 // Stepper: Homing speed steps/sec
 #define STEPPER_HOMING_SPEED_IN_STEPS_SEC 100
 
+/* Stepper: Generate the step pulses in hardware.
+ * 1 = PWM channel of the step pin clocks out each move, a timer interrupts once per move.
+ * 0 = AccelStepper, polled from the actuator handler every ACTUATOR_HANDLER_PERIOD_US.
+ */
+#ifndef USE_HW_STEP_GENERATOR
+#define USE_HW_STEP_GENERATOR 1
+#endif
+
+// Stepper: Width of a step pulse in microsec, used by the hardware step generator.
+#define STEPPER_STEP_PULSE_US 5
+
+// Stepper: Acceleration limit for planned moves, steps/sec^2
+#define STEPPER_MAX_ACCEL_STEPS_PER_SEC2 6000
+
+// Stepper: Jerk limit for planned moves, steps/sec^3
+#define STEPPER_MAX_JERK_STEPS_PER_SEC3 120000
+
+/* Shape of the speed changes in planned moves
+ * 0 = Trapezoid, constant acceleration
+ * 1 = S-curve, jerk limited
+ */
+#define MOTION_PROFILE_TYPE 1
+
 // Stepper: Angle per step in degrees
 #define STEPPER_ANGLE_DEG_PER_STEP 1.8
 
@@ -205,6 +344,13 @@
 #define PRESSURE_MIN 0
 #define PRESSURE_MAX 41
 
+// Alarm thresholds, the rules are in alarm/alarm_rules.cpp.
+#define ALARM_HIGH_PRESSURE_CMH2O PRESSURE_MAX// Any sample above
+#define ALARM_LOW_PIP_CMH2O 10                // PIP below, disconnected
+#define ALARM_MAX_RESISTIVE_CMH2O 15          // PIP above the plateau by more
+#define ALARM_MIN_DRIVING_CMH2O 2             // Plateau above PEEP by less
+#define ALARM_UNMET_VOLUME_PERCENT 10         // VTi short of the set volume by more
+
 // The 'None' value for a readout.
 // Setting any adjustable value to this constant (or below) will force the label to show "--" as the value
 // Set below your lowest known value, within the range of `double`
@@ -233,6 +379,8 @@
 #define GAUGE_PRESSURE_CHART_LINE_MODE 1  /**< 0: No dots, only display line. 1: Use dots as data points */
 #define GAUGE_PRESSURE_CHART_DOT_SIZE 5   /**< Dot LxW in px. Only applies to LINE_MODE 1 (Default: 5)*/
 #define GAUGE_PRESSURE_CHART_LINE_WIDTH 2 /**< Changes the width of the line on the graph (Default: 2)*/
+#define GAUGE_PRESSURE_CHART_SWEEP 1      /**< 0: Scroll, the whole chart redraws. 1: Sweep, only the new points redraw */
+#define GAUGE_PRESSURE_CHART_TIME_BASE_MS 12000 /**< Time across the chart, see CHART_TIME_BASE_MS_VALID */
 
 #define FLOW_CHART_MIN_VALUE FLOW_MIN
 #define FLOW_CHART_MAX_VALUE FLOW_MAX
@@ -241,6 +389,21 @@
 #define FLOW_CHART_LINE_MODE 1  /**< 0: No dots, only display line. 1: Use dots as data points */
 #define FLOW_CHART_DOT_SIZE 5   /**< Dot LxW in px. Only applies to LINE_MODE 1 (Default: 5)*/
 #define FLOW_CHART_LINE_WIDTH 2 /**< Changes the width of the line on the graph (Default: 2)*/
+#define FLOW_CHART_SWEEP 1      /**< 0: Scroll, the whole chart redraws. 1: Sweep, only the new points redraw */
+#define FLOW_CHART_TIME_BASE_MS 12000 /**< Time across the chart, see CHART_TIME_BASE_MS_VALID */
+
+// Gap between the new trace and the old on a sweeping chart, px. Points ahead of the newest are blanked to cover it.
+#define CHART_SWEEP_GAP_PX 12
+
+/* A chart with a time base is fed from the sampled pressure and flow (controls/chart_feed.h),
+ * one column per pixel across, each drawn from the lowest to the highest sample
+ * behind it, and takes the time base to sweep across. Its MAX_POINTS and dots are
+ * not used. 0: one point per SENSOR_POLL_INTERVAL, MAX_POINTS across.
+ */
+#define CHART_TIME_BASE_MS_VALID(ms) ((ms) == 0 || (ms) == 6000 || (ms) == 12000 || (ms) == 24000)
+
+// Finished columns held for the readout task, per chart. Must be a power of 2.
+#define CHART_FEED_QUEUE_COLUMNS 64
 
 // Tidal Volume Chart Config
 // #define VOLUME_CHART_MIN_VALUE MIN_BAG_VOL_ML
@@ -254,7 +417,23 @@
 // Enable Wiper Motor (0 Defaults To Stepper Motor)
 #define ENABLE_WIPER_MOTOR 0
 
-// Temporary number, used to switch between VCV and PCV modes until button switching works
-#define pcv true
+/* Pressure controlled breaths, ControlModes::PCV. Through inspiration and its hold a PID
+ * holds the airway at the set PIP with the paddle speed, see controls/pressurePID.h.
+ * The paddle goes no further than the set volume would take it.
+ */
+// Gains: degrees/sec per cmH2O, per cmH2O*sec and per cmH2O/sec.
+#define PCV_PID_KP 30.0
+#define PCV_PID_KI 5.0
+#define PCV_PID_KD 0.3
+
+// Time constant of the low pass on the derivative, sec.
+#define PCV_PID_DERIVATIVE_TAU_S 0.03
+
+// Fastest the PID drives the paddle, degrees/sec, and most it changes the speed in a second.
+#define PCV_MAX_SPEED_DEG_P_SEC TIMING_PULLEY_STEPS_TO_DEGREES(STEPPER_MAX_STEPS_PER_SECOND)
+#define PCV_MAX_ACCEL_DEG_P_SEC2 TIMING_PULLEY_STEPS_TO_DEGREES(STEPPER_MAX_ACCEL_STEPS_PER_SEC2)
+
+// Gauge samples averaged for each pressure the PID takes, at ADC_SAMPLER_RATE_HZ.
+#define PCV_PRESSURE_SAMPLES 10
 
 #endif
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "AccelStepper.h"
+
+AccelStepper::AccelStepper(uint8_t interface, uint8_t pin1, uint8_t pin2, uint8_t pin3, uint8_t pin4, bool enable)
+{
+    (void) enable;
+    _interface = interface;
+    _currentPos = 0;
+    _targetPos = 0;
+    _speed = 0.0;
+    _maxSpeed = 1.0;
+    _acceleration = 0.0;
+    _stepInterval = 0;
+    _lastStepTime = 0;
+    _minPulseWidth = 1;
+    _pin[0] = pin1;
+    _pin[1] = pin2;
+    _pin[2] = pin3;
+    _pin[3] = pin4;
+
+    _n = 0;
+    _c0 = 0.0;
+    _cn = 0.0;
+    _cmin = 1.0;
+    _direction = DIRECTION_CCW;
+
+    // Some reasonable default
+    setAcceleration(1);
+}
+
+void AccelStepper::moveTo(long absolute)
+{
+    if (_targetPos != absolute) {
+        _targetPos = absolute;
+        computeNewSpeed();
+    }
+}
+
+void AccelStepper::move(long relative)
+{
+    moveTo(_currentPos + relative);
+}
+
+// Implements steps according to the current step interval
+// Returns true if a step occurred
+boolean AccelStepper::runSpeed()
+{
+    // Dont do anything unless we actually have a step interval
+    if (!_stepInterval) {
+        return false;
+    }
+
+    unsigned long time = micros();
+    if (time - _lastStepTime >= _stepInterval) {
+        if (_direction == DIRECTION_CW) {
+            // Clockwise
+            _currentPos += 1;
+        }
+        else {
+            // Anticlockwise
+            _currentPos -= 1;
+        }
+        step(_currentPos);
+
+        _lastStepTime = time;
+        return true;
+    }
+    return false;
+}
+
+boolean AccelStepper::run()
+{
+    if (runSpeed()) {
+        computeNewSpeed();
+    }
+    return _speed != 0.0 || distanceToGo() != 0;
+}
+
+unsigned long AccelStepper::computeNewSpeed()
+{
+    long distanceTo = distanceToGo();
+    long stepsToStop = (long) ((_speed * _speed) / (2.0 * _acceleration));
+
+    if (distanceTo == 0 && stepsToStop <= 1) {
+        // We are at the target and its time to stop
+        _stepInterval = 0;
+        _speed = 0.0;
+        _n = 0;
+        return _stepInterval;
+    }
+
+    if (distanceTo > 0) {
+        // We are anticlockwise from the target
+        // Need to go clockwise from here, maybe decelerate now
+        if (_n > 0) {
+            // Currently accelerating, need to decel now? Or maybe going the wrong way?
+            if ((stepsToStop >= distanceTo) || _direction == DIRECTION_CCW) {
+                _n = -stepsToStop;
+            }
+        }
+        else if (_n < 0) {
+            // Currently decelerating, need to accel again?
+            if ((stepsToStop < distanceTo) && _direction == DIRECTION_CW) {
+                _n = -_n;
+            }
+        }
+    }
+    else if (distanceTo < 0) {
+        // We are clockwise from the target
+        // Need to go anticlockwise from here, maybe decelerate
+        if (_n > 0) {
+            if ((stepsToStop >= -distanceTo) || _direction == DIRECTION_CW) {
+                _n = -stepsToStop;
+            }
+        }
+        else if (_n < 0) {
+            if ((stepsToStop < -distanceTo) && _direction == DIRECTION_CCW) {
+                _n = -_n;
+            }
+        }
+    }
+
+    // Need to accelerate or decelerate
+    if (_n == 0) {
+        // First step from stopped
+        _cn = _c0;
+        _direction = (distanceTo > 0) ? DIRECTION_CW : DIRECTION_CCW;
+    }
+    else {
+        // Subsequent step. Works for accel (n is +_ve) and decel (n is -ve).
+        _cn = _cn - ((2.0 * _cn) / ((4.0 * _n) + 1));
+        _cn = _cn > _cmin ? _cn : _cmin;
+    }
+    _n++;
+    _stepInterval = _cn;
+    _speed = 1000000.0 / _cn;
+    if (_direction == DIRECTION_CCW) {
+        _speed = -_speed;
+    }
+
+    return _stepInterval;
+}
+
+void AccelStepper::setMaxSpeed(float speed)
+{
+    if (speed < 0.0) {
+        speed = -speed;
+    }
+    if (_maxSpeed != speed) {
+        _maxSpeed = speed;
+        _cmin = 1000000.0 / speed;
+        // Recompute _n from current speed and adjust speed if accelerating or cruising
+        if (_n > 0) {
+            _n = (long) ((_speed * _speed) / (2.0 * _acceleration));
+            computeNewSpeed();
+        }
+    }
+}
+
+void AccelStepper::setAcceleration(float acceleration)
+{
+    if (acceleration == 0.0) {
+        return;
+    }
+    if (acceleration < 0.0) {
+        acceleration = -acceleration;
+    }
+    if (_acceleration != acceleration) {
+        // Recompute _n per Equation 17
+        _n = _n * (_acceleration / acceleration);
+        // New c0 per Equation 7, with correction per Equation 15
+        _c0 = 0.676 * sqrt(2.0 / acceleration) * 1000000.0;
+        _acceleration = acceleration;
+        computeNewSpeed();
+    }
+}
+
+void AccelStepper::setSpeed(float speed)
+{
+    if (speed == _speed) {
+        return;
+    }
+    speed = constrain(speed, -_maxSpeed, _maxSpeed);
+    if (speed == 0.0) {
+        _stepInterval = 0;
+    }
+    else {
+        _stepInterval = fabs(1000000.0 / speed);
+        _direction = (speed > 0.0) ? DIRECTION_CW : DIRECTION_CCW;
+    }
+    _speed = speed;
+}
+
+void AccelStepper::setCurrentPosition(long position)
+{
+    _targetPos = _currentPos = position;
+    _n = 0;
+    _stepInterval = 0;
+    _speed = 0.0;
+}
+
+void AccelStepper::runToPosition()
+{
+    while (run()) {
+    }
+}
+
+boolean AccelStepper::runSpeedToPosition()
+{
+    if (_targetPos == _currentPos) {
+        return false;
+    }
+    if (_targetPos > _currentPos) {
+        _direction = DIRECTION_CW;
+    }
+    else {
+        _direction = DIRECTION_CCW;
+    }
+    return runSpeed();
+}
+
+void AccelStepper::runToNewPosition(long position)
+{
+    moveTo(position);
+    runToPosition();
+}
+
+void AccelStepper::stop()
+{
+    if (_speed != 0.0) {
+        long stepsToStop = (long) ((_speed * _speed) / (2.0 * _acceleration)) + 1;
+        if (_speed > 0) {
+            move(stepsToStop);
+        }
+        else {
+            move(-stepsToStop);
+        }
+    }
+}
+
+boolean AccelStepper::isRunning() const
+{
+    return !(_speed == 0.0 && _targetPos == _currentPos);
+}
+
+void AccelStepper::step(long step)
+{
+    (void) step;
+    if (_interface != DRIVER) {
+        return;
+    }
+
+    digitalWrite(_pin[1], _direction ? HIGH : LOW);
+    digitalWrite(_pin[0], HIGH);
+    digitalWrite(_pin[0], LOW);
+}
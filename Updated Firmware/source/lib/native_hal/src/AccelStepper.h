@@ -0,0 +1,79 @@
+/* Host stand-in for AccelStepper 1.61.
+ *
+ * The speed and position bookkeeping follows the library, so the firmware
+ * sees the same step timing it gets on the Due. Only the DRIVER interface is
+ * emulated, step() writes the direction and step pins and nothing else.
+ */
+
+#ifndef NATIVE_HAL_ACCEL_STEPPER_H
+#define NATIVE_HAL_ACCEL_STEPPER_H
+
+#include "Arduino.h"
+
+class AccelStepper {
+public:
+    typedef enum {
+        FUNCTION = 0,
+        DRIVER = 1,
+        FULL2WIRE = 2,
+        FULL3WIRE = 3,
+        FULL4WIRE = 4,
+        HALF3WIRE = 6,
+        HALF4WIRE = 8
+    } MotorInterfaceType;
+
+    AccelStepper(uint8_t interface = AccelStepper::FULL4WIRE, uint8_t pin1 = 2, uint8_t pin2 = 3, uint8_t pin3 = 4, uint8_t pin4 = 5, bool enable = true);
+
+    void moveTo(long absolute);
+    void move(long relative);
+    boolean run();
+    boolean runSpeed();
+    void setMaxSpeed(float speed);
+    float maxSpeed() const { return _maxSpeed; }
+    void setAcceleration(float acceleration);
+    void setSpeed(float speed);
+    float speed() const { return _speed; }
+    long distanceToGo() const { return _targetPos - _currentPos; }
+    long targetPosition() const { return _targetPos; }
+    long currentPosition() const { return _currentPos; }
+    void setCurrentPosition(long position);
+    void runToPosition();
+    boolean runSpeedToPosition();
+    void runToNewPosition(long position);
+    void stop();
+    void disableOutputs() { }
+    void enableOutputs() { }
+    void setMinPulseWidth(unsigned int minWidth) { _minPulseWidth = minWidth; }
+    void setEnablePin(uint8_t enablePin = 0xff) { (void) enablePin; }
+    boolean isRunning() const;
+
+protected:
+    typedef enum {
+        DIRECTION_CCW = 0,
+        DIRECTION_CW = 1
+    } Direction;
+
+    unsigned long computeNewSpeed();
+    void step(long step);
+
+private:
+    uint8_t _interface;
+    uint8_t _pin[4];
+
+    long _currentPos;
+    long _targetPos;
+    float _speed;
+    float _maxSpeed;
+    float _acceleration;
+    unsigned long _stepInterval;
+    unsigned long _lastStepTime;
+    unsigned int _minPulseWidth;
+
+    long _n;
+    float _c0;
+    float _cn;
+    float _cmin;
+    boolean _direction;
+};
+
+#endif//NATIVE_HAL_ACCEL_STEPPER_H
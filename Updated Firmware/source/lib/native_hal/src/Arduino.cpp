@@ -0,0 +1,539 @@
+#include <chrono>
+#include <deque>
+#include <random>
+#include <thread>
+#include "Arduino.h"
+#include "native_hal.h"
+
+/* Time
+ * Both counters start at zero when the program starts, like they do at reset on the Due.
+ * With the virtual clock on, time only moves in native_hal_advance_us().
+ */
+
+static const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+static bool virtual_clock = false;
+static uint64_t virtual_time_us = 0;
+
+uint64_t native_hal_time_us()
+{
+    if (virtual_clock) {
+        return virtual_time_us;
+    }
+    return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void native_hal_set_virtual_clock(bool enable)
+{
+    if (enable && !virtual_clock) {
+        // Carry on from the wall clock, so time never goes backwards.
+        virtual_time_us = native_hal_time_us();
+    }
+    virtual_clock = enable;
+}
+
+bool native_hal_is_virtual_clock()
+{
+    return virtual_clock;
+}
+
+void native_hal_set_time_us(uint64_t time_us)
+{
+    if (time_us > virtual_time_us) {
+        virtual_time_us = time_us;
+    }
+}
+
+uint32_t millis()
+{
+    return (uint32_t) (native_hal_time_us() / 1000);
+}
+
+uint32_t micros()
+{
+    return (uint32_t) native_hal_time_us();
+}
+
+void delay(uint32_t ms)
+{
+    if (virtual_clock) {
+        native_hal_advance_us(ms * 1000);
+        return;
+    }
+
+    // Interrupts keep firing while the main loop waits.
+    uint32_t start = millis();
+    while (millis() - start < ms) {
+        native_hal_service_timers();
+        std::this_thread::yield();
+    }
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    if (virtual_clock) {
+        native_hal_set_time_us(virtual_time_us + us);
+        return;
+    }
+
+    uint32_t start = micros();
+    while (micros() - start < us) {
+    }
+}
+
+/* Pins
+ */
+
+static uint32_t pin_modes[NUM_DIGITAL_PINS];
+static uint32_t pin_values[NUM_DIGITAL_PINS];
+
+/* The tone driver toggles its pin through the PIO registers directly.
+ * All pins share one dummy port, so those writes go nowhere.
+ */
+static Pio pio_port;
+
+#define PIN_DESC_1 {&pio_port, 1u}
+#define PIN_DESC_2 PIN_DESC_1, PIN_DESC_1
+#define PIN_DESC_8 PIN_DESC_2, PIN_DESC_2, PIN_DESC_2, PIN_DESC_2
+#define PIN_DESC_32 PIN_DESC_8, PIN_DESC_8, PIN_DESC_8, PIN_DESC_8
+
+extern "C" const PinDescription g_APinDescription[NUM_DIGITAL_PINS] = {PIN_DESC_32, PIN_DESC_32, PIN_DESC_2};
+
+void pinMode(uint32_t pin, uint32_t mode)
+{
+    if (pin < NUM_DIGITAL_PINS) {
+        pin_modes[pin] = mode;
+    }
+}
+
+void digitalWrite(uint32_t pin, uint32_t val)
+{
+    if (pin < NUM_DIGITAL_PINS) {
+        pin_values[pin] = val ? HIGH : LOW;
+    }
+}
+
+int digitalRead(uint32_t pin)
+{
+    if (pin < NUM_DIGITAL_PINS) {
+        return (int) pin_values[pin];
+    }
+    return LOW;
+}
+
+int native_hal_get_digital(uint32_t pin)
+{
+    return digitalRead(pin);
+}
+
+uint32_t native_hal_get_pin_mode(uint32_t pin)
+{
+    return pin < NUM_DIGITAL_PINS ? pin_modes[pin] : INPUT;
+}
+
+void analogWrite(uint32_t pin, uint32_t val)
+{
+    digitalWrite(pin, val);
+}
+
+/* ADC
+ * The Due has 12 analog inputs, A0 to A11.
+ * Like the SAM core, pins below A0 are treated as channel numbers and
+ * results are scaled from 12 bits to the requested resolution.
+ */
+
+#define NATIVE_HAL_ANALOG_CHANNELS 12
+
+static uint32_t analog_values[NATIVE_HAL_ANALOG_CHANNELS];
+static native_hal_analog_source analog_source = nullptr;
+static void* analog_source_data = nullptr;
+static int analog_read_resolution = 10;
+
+static uint32_t analog_channel(uint32_t pin)
+{
+    if (pin >= A0) {
+        pin -= A0;
+    }
+    return pin;
+}
+
+void analogReadResolution(int res)
+{
+    analog_read_resolution = res;
+}
+
+uint32_t analogRead(uint32_t pin)
+{
+    uint32_t channel = analog_channel(pin);
+    if (channel >= NATIVE_HAL_ANALOG_CHANNELS) {
+        return 0;
+    }
+
+    uint32_t counts = analog_source ? analog_source(channel, analog_source_data) : analog_values[channel];
+    if (counts > 4095) {
+        counts = 4095;
+    }
+
+    if (analog_read_resolution > ADC_RESOLUTION) {
+        return counts << (analog_read_resolution - ADC_RESOLUTION);
+    }
+    return counts >> (ADC_RESOLUTION - analog_read_resolution);
+}
+
+void native_hal_set_analog(uint32_t pin, uint32_t counts)
+{
+    uint32_t channel = analog_channel(pin);
+    if (channel < NATIVE_HAL_ANALOG_CHANNELS) {
+        analog_values[channel] = counts;
+    }
+}
+
+void native_hal_set_analog_source(native_hal_analog_source source, void* user_data)
+{
+    analog_source = source;
+    analog_source_data = user_data;
+}
+
+/* Interrupts
+ * Only the timer dispatch needs to know, see DueTimer.cpp.
+ */
+
+bool native_hal_interrupts_enabled = true;
+
+void noInterrupts()
+{
+    native_hal_interrupts_enabled = false;
+}
+
+void interrupts()
+{
+    native_hal_interrupts_enabled = true;
+}
+
+/* Random
+ */
+
+static std::minstd_rand random_engine;
+
+void randomSeed(unsigned long seed)
+{
+    if (seed != 0) {
+        random_engine.seed(seed);
+    }
+}
+
+long random(long howbig)
+{
+    if (howbig == 0) {
+        return 0;
+    }
+    return (long) (random_engine() % (unsigned long) howbig);
+}
+
+long random(long howsmall, long howbig)
+{
+    if (howsmall >= howbig) {
+        return howsmall;
+    }
+    return random(howbig - howsmall) + howsmall;
+}
+
+/* String
+ */
+
+String::String(int value, unsigned char base)
+{
+    char buf[34];
+    if (base == DEC) {
+        snprintf(buf, sizeof(buf), "%d", value);
+    }
+    else if (base == HEX) {
+        snprintf(buf, sizeof(buf), "%x", value);
+    }
+    else if (base == OCT) {
+        snprintf(buf, sizeof(buf), "%o", value);
+    }
+    else {
+        unsigned int v = (unsigned int) value;
+        char* p = &buf[sizeof(buf) - 1];
+        *p = '\0';
+        do {
+            *--p = (char) ('0' + (v & 1));
+            v >>= 1;
+        } while (v);
+        str_ = p;
+        return;
+    }
+    str_ = buf;
+}
+
+String::String(double value, unsigned char decimal_places)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", decimal_places, value);
+    str_ = buf;
+}
+
+String& String::operator=(const char* cstr)
+{
+    str_ = cstr ? cstr : "";
+    return *this;
+}
+
+String& String::operator+=(const String& rhs)
+{
+    str_ += rhs.str_;
+    return *this;
+}
+
+String& String::operator+=(const char* cstr)
+{
+    if (cstr) {
+        str_ += cstr;
+    }
+    return *this;
+}
+
+String& String::operator+=(char c)
+{
+    str_ += c;
+    return *this;
+}
+
+String operator+(const String& lhs, const String& rhs)
+{
+    String result(lhs);
+    result += rhs;
+    return result;
+}
+
+String operator+(const String& lhs, const char* rhs)
+{
+    String result(lhs);
+    result += rhs;
+    return result;
+}
+
+long String::toInt() const
+{
+    return atol(str_.c_str());
+}
+
+float String::toFloat() const
+{
+    return (float) atof(str_.c_str());
+}
+
+double String::toDouble() const
+{
+    return atof(str_.c_str());
+}
+
+/* Serial
+ */
+
+HardwareSerial Serial;
+
+static std::deque<uint8_t> serial_rx;
+static bool serial_echo = true;
+static uint32_t serial_bytes_written = 0;
+static FILE* serial_capture = nullptr;
+
+void native_hal_serial_feed(const char* data)
+{
+    while (data && *data) {
+        serial_rx.push_back((uint8_t) *data++);
+    }
+}
+
+void native_hal_serial_set_echo(bool enable)
+{
+    serial_echo = enable;
+}
+
+void native_hal_serial_set_capture(FILE* file)
+{
+    serial_capture = file;
+}
+
+uint32_t native_hal_serial_bytes_written()
+{
+    return serial_bytes_written;
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+    (void) baud;
+}
+
+int HardwareSerial::available()
+{
+    return (int) serial_rx.size();
+}
+
+int HardwareSerial::availableForWrite()
+{
+    // Output is never held back on the host.
+    return 128;
+}
+
+int HardwareSerial::peek()
+{
+    return serial_rx.empty() ? -1 : serial_rx.front();
+}
+
+int HardwareSerial::read()
+{
+    if (serial_rx.empty()) {
+        return -1;
+    }
+    int c = serial_rx.front();
+    serial_rx.pop_front();
+    return c;
+}
+
+void HardwareSerial::flush()
+{
+    fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    serial_bytes_written += (uint32_t) size;
+    if (serial_echo) {
+        fwrite(buffer, 1, size, stdout);
+    }
+    if (serial_capture) {
+        fwrite(buffer, 1, size, serial_capture);
+    }
+    return size;
+}
+
+size_t HardwareSerial::write(const char* str)
+{
+    return str ? write((const uint8_t*) str, strlen(str)) : 0;
+}
+
+size_t HardwareSerial::print(const char* str)
+{
+    return write(str);
+}
+
+size_t HardwareSerial::print(const String& str)
+{
+    return write((const uint8_t*) str.c_str(), str.length());
+}
+
+size_t HardwareSerial::print(char c)
+{
+    return write((uint8_t) c);
+}
+
+size_t HardwareSerial::print(unsigned char value, int base)
+{
+    return print_number(value, base);
+}
+
+size_t HardwareSerial::print(int value, int base)
+{
+    return print((long) value, base);
+}
+
+size_t HardwareSerial::print(unsigned int value, int base)
+{
+    return print_number(value, base);
+}
+
+size_t HardwareSerial::print(long value, int base)
+{
+    if (base == DEC && value < 0) {
+        return print('-') + print_number((unsigned long) -value, base);
+    }
+    return print_number((unsigned long) value, base);
+}
+
+size_t HardwareSerial::print(unsigned long value, int base)
+{
+    return print_number(value, base);
+}
+
+size_t HardwareSerial::print(double value, int digits)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", digits, value);
+    return write(buf);
+}
+
+size_t HardwareSerial::println()
+{
+    return write("\r\n");
+}
+
+size_t HardwareSerial::println(const char* str)
+{
+    return print(str) + println();
+}
+
+size_t HardwareSerial::println(const String& str)
+{
+    return print(str) + println();
+}
+
+size_t HardwareSerial::println(char c)
+{
+    return print(c) + println();
+}
+
+size_t HardwareSerial::println(unsigned char value, int base)
+{
+    return print(value, base) + println();
+}
+
+size_t HardwareSerial::println(int value, int base)
+{
+    return print(value, base) + println();
+}
+
+size_t HardwareSerial::println(unsigned int value, int base)
+{
+    return print(value, base) + println();
+}
+
+size_t HardwareSerial::println(long value, int base)
+{
+    return print(value, base) + println();
+}
+
+size_t HardwareSerial::println(unsigned long value, int base)
+{
+    return print(value, base) + println();
+}
+
+size_t HardwareSerial::println(double value, int digits)
+{
+    return print(value, digits) + println();
+}
+
+size_t HardwareSerial::print_number(unsigned long value, int base)
+{
+    char buf[8 * sizeof(long) + 1];
+    char* str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+
+    if (base < 2) {
+        base = 10;
+    }
+
+    do {
+        char c = (char) (value % base);
+        value /= base;
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (value);
+
+    return write(str);
+}
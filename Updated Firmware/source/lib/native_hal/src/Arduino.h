@@ -0,0 +1,208 @@
+/* Host stand-in for the Arduino Due core.
+ *
+ * Only the subset of the SAM core used by the firmware is provided.
+ * The header must stay valid C, LVGL pulls it in through LV_TICK_CUSTOM_INCLUDE.
+ */
+
+#ifndef NATIVE_HAL_ARDUINO_H
+#define NATIVE_HAL_ARDUINO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#ifdef __cplusplus
+// Pull the C++ headers in before the Arduino macros below are defined,
+// so min/max/abs don't get expanded inside the standard library.
+#include <cstdlib>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <cmath>
+#include <string>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+
+#define PROGMEM
+#define F(str) (str)
+
+// Due analog inputs, as numbered in the SAM variant
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A5 59
+#define A6 60
+#define A7 61
+#define A8 62
+#define A9 63
+#define A10 64
+#define A11 65
+
+#define NUM_DIGITAL_PINS 66
+#define ADC_RESOLUTION 12
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t val);
+int digitalRead(uint32_t pin);
+uint32_t analogRead(uint32_t pin);
+void analogReadResolution(int res);
+void analogWrite(uint32_t pin, uint32_t val);
+
+void noInterrupts(void);
+void interrupts(void);
+
+/* Port registers used by the tone driver.
+ * Writes land in memory and are otherwise ignored.
+ */
+typedef struct {
+    volatile uint32_t PIO_SODR;
+    volatile uint32_t PIO_CODR;
+    volatile uint32_t PIO_ODSR;
+} Pio;
+
+typedef struct {
+    Pio* pPort;
+    uint32_t ulPin;
+} PinDescription;
+
+extern const PinDescription g_APinDescription[];
+
+#ifdef __cplusplus
+}// extern "C"
+#endif
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define abs(x) ((x) > 0 ? (x) : -(x))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#ifdef __cplusplus
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+inline bool isDigit(int c) { return isdigit(c) != 0; }
+
+/**
+ * Arduino String, backed by std::string.
+ * Only the members the firmware uses are implemented.
+ */
+class String {
+public:
+    String() = default;
+    String(const char* cstr) : str_(cstr ? cstr : "") { }
+    String(const String& other) = default;
+    explicit String(char c) : str_(1, c) { }
+    explicit String(int value, unsigned char base = DEC);
+    explicit String(double value, unsigned char decimal_places = 2);
+
+    String& operator=(const String& rhs) = default;
+    String& operator=(const char* cstr);
+
+    // The Arduino String converts to true whenever its buffer is valid
+    explicit operator bool() const { return true; }
+
+    unsigned int length() const { return (unsigned int) str_.length(); }
+    const char* c_str() const { return str_.c_str(); }
+    char charAt(unsigned int index) const { return index < str_.length() ? str_[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+
+    String& operator+=(const String& rhs);
+    String& operator+=(const char* cstr);
+    String& operator+=(char c);
+    friend String operator+(const String& lhs, const String& rhs);
+    friend String operator+(const String& lhs, const char* rhs);
+
+    bool operator==(const String& rhs) const { return str_ == rhs.str_; }
+    bool operator==(const char* cstr) const { return str_ == (cstr ? cstr : ""); }
+    bool operator!=(const String& rhs) const { return !(*this == rhs); }
+
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+
+private:
+    std::string str_;
+};
+
+/**
+ * Host serial port.
+ * Output goes to stdout (unless muted), input is fed by native_hal_serial_feed().
+ */
+class HardwareSerial {
+public:
+    void begin(unsigned long baud);
+    void end() { }
+    int available();
+    int availableForWrite();
+    int peek();
+    int read();
+    void flush();
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str);
+
+    size_t print(const char* str);
+    size_t print(const String& str);
+    size_t print(char c);
+    size_t print(unsigned char value, int base = DEC);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println();
+    size_t println(const char* str);
+    size_t println(const String& str);
+    size_t println(char c);
+    size_t println(unsigned char value, int base = DEC);
+    size_t println(int value, int base = DEC);
+    size_t println(unsigned int value, int base = DEC);
+    size_t println(long value, int base = DEC);
+    size_t println(unsigned long value, int base = DEC);
+    size_t println(double value, int digits = 2);
+
+    explicit operator bool() const { return true; }
+
+private:
+    size_t print_number(unsigned long value, int base);
+};
+
+extern HardwareSerial Serial;
+
+#endif// __cplusplus
+
+#endif//NATIVE_HAL_ARDUINO_H
@@ -0,0 +1,172 @@
+#include "DueTimer.h"
+#include "native_hal.h"
+
+extern bool native_hal_interrupts_enabled;
+
+struct native_timer {
+    void (* isr)();
+    double period_us;
+    bool running;
+    uint64_t next_due_us;
+};
+
+static native_timer timers[NUM_TIMERS] = {};
+
+// Periods are counted in whole microseconds, never zero.
+static uint64_t period_ticks(const native_timer& t)
+{
+    uint64_t ticks = (uint64_t) (t.period_us + 0.5);
+    return ticks ? ticks : 1;
+}
+
+// Set while a handler runs, so delay() inside a handler can't re-enter the dispatch.
+static bool in_handler = false;
+
+DueTimer Timer(0);
+DueTimer Timer0(0);
+DueTimer Timer1(1);
+DueTimer Timer2(2);
+DueTimer Timer3(3);
+DueTimer Timer4(4);
+DueTimer Timer5(5);
+DueTimer Timer6(6);
+DueTimer Timer7(7);
+DueTimer Timer8(8);
+
+DueTimer DueTimer::getAvailable()
+{
+    for (unsigned short i = 0; i < NUM_TIMERS; i++) {
+        if (!timers[i].isr) {
+            return DueTimer(i);
+        }
+    }
+    return DueTimer(0);
+}
+
+DueTimer& DueTimer::attachInterrupt(void (* isr)())
+{
+    timers[timer].isr = isr;
+    return *this;
+}
+
+DueTimer& DueTimer::detachInterrupt()
+{
+    stop();
+    timers[timer].isr = nullptr;
+    return *this;
+}
+
+DueTimer& DueTimer::start(double microseconds)
+{
+    if (microseconds > 0) {
+        setPeriod(microseconds);
+    }
+    if (timers[timer].period_us <= 0) {
+        setFrequency(1);
+    }
+
+    timers[timer].next_due_us = native_hal_time_us() + period_ticks(timers[timer]);
+    timers[timer].running = true;
+    return *this;
+}
+
+DueTimer& DueTimer::stop()
+{
+    timers[timer].running = false;
+    return *this;
+}
+
+DueTimer& DueTimer::setFrequency(double frequency)
+{
+    if (frequency > 0) {
+        timers[timer].period_us = 1000000.0 / frequency;
+    }
+    return *this;
+}
+
+DueTimer& DueTimer::setPeriod(double microseconds)
+{
+    timers[timer].period_us = microseconds;
+    return *this;
+}
+
+double DueTimer::getFrequency() const
+{
+    return timers[timer].period_us > 0 ? 1000000.0 / timers[timer].period_us : 0;
+}
+
+double DueTimer::getPeriod() const
+{
+    return timers[timer].period_us;
+}
+
+static void fire(native_timer& t)
+{
+    in_handler = true;
+    t.isr();
+    in_handler = false;
+}
+
+void native_hal_service_timers()
+{
+    if (in_handler || !native_hal_interrupts_enabled) {
+        return;
+    }
+
+    for (auto& t : timers) {
+        if (!t.running || !t.isr) {
+            continue;
+        }
+
+        uint64_t now = native_hal_time_us();
+        if (now < t.next_due_us) {
+            continue;
+        }
+
+        t.next_due_us += period_ticks(t);
+
+        // Fell more than a period behind, a pending flag only holds one interrupt.
+        if (now >= t.next_due_us) {
+            t.next_due_us = now + period_ticks(t);
+        }
+
+        fire(t);
+    }
+}
+
+void native_hal_advance_us(uint32_t us)
+{
+    uint64_t target = native_hal_time_us() + us;
+
+    if (!native_hal_is_virtual_clock()) {
+        while (native_hal_time_us() < target) {
+            native_hal_service_timers();
+        }
+        return;
+    }
+
+    // A handler that delays only moves time on, it can't fire other handlers.
+    if (in_handler || !native_hal_interrupts_enabled) {
+        native_hal_set_time_us(target);
+        return;
+    }
+
+    for (;;) {
+        // Earliest due timer, lowest number wins a tie.
+        native_timer* next = nullptr;
+        for (auto& t : timers) {
+            if (t.running && t.isr && t.next_due_us <= target && (!next || t.next_due_us < next->next_due_us)) {
+                next = &t;
+            }
+        }
+        if (!next) {
+            break;
+        }
+
+        native_hal_set_time_us(next->next_due_us);
+        next->next_due_us += period_ticks(*next);
+        fire(*next);
+    }
+
+    native_hal_set_time_us(target);
+}
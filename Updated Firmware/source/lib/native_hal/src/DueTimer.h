@@ -0,0 +1,50 @@
+/* Host stand-in for the DueTimer library.
+ *
+ * Keeps the DueTimer interface, but nothing fires on its own: the handlers
+ * are called from native_hal_service_timers(), which delay() also runs.
+ * Like the TC interrupts on the Due, a timer that falls behind fires once
+ * and picks up its next period from there, missed periods are not replayed.
+ */
+
+#ifndef NATIVE_HAL_DUE_TIMER_H
+#define NATIVE_HAL_DUE_TIMER_H
+
+#include "Arduino.h"
+
+#define NUM_TIMERS 9
+
+class DueTimer {
+public:
+    explicit DueTimer(unsigned short timer) : timer(timer) { }
+
+    static DueTimer getAvailable();
+
+    DueTimer& attachInterrupt(void (* isr)());
+    DueTimer& detachInterrupt();
+    DueTimer& start(double microseconds = -1);
+    DueTimer& stop();
+    DueTimer& setFrequency(double frequency);
+    DueTimer& setPeriod(double microseconds);
+
+    double getFrequency() const;
+    double getPeriod() const;
+
+    bool operator==(const DueTimer& rhs) const { return timer == rhs.timer; }
+    bool operator!=(const DueTimer& rhs) const { return timer != rhs.timer; }
+
+private:
+    unsigned short timer;
+};
+
+extern DueTimer Timer;
+extern DueTimer Timer0;
+extern DueTimer Timer1;
+extern DueTimer Timer2;
+extern DueTimer Timer3;
+extern DueTimer Timer4;
+extern DueTimer Timer5;
+extern DueTimer Timer6;
+extern DueTimer Timer7;
+extern DueTimer Timer8;
+
+#endif//NATIVE_HAL_DUE_TIMER_H
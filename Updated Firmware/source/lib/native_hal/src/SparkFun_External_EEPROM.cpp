@@ -0,0 +1,168 @@
+#include "SparkFun_External_EEPROM.h"
+#include "native_hal.h"
+
+// Bytes per bus transfer, the 32 byte Wire buffer less the 2 address bytes for a write.
+#define EEPROM_READ_TRANSFER_BYTES 32
+#define EEPROM_WRITE_TRANSFER_BYTES 30
+
+// Erased EEPROM cells read back as 0xFF.
+static uint8_t eeprom_memory[NATIVE_HAL_EEPROM_BYTES];
+static uint32_t eeprom_cell_writes[NATIVE_HAL_EEPROM_BYTES];
+static bool eeprom_erased = false;
+
+static bool eeprom_cut_armed = false;
+static bool eeprom_power_cut = false;
+static uint32_t eeprom_bytes_to_cut = 0;
+static uint32_t eeprom_junk = 0x2545F491;
+
+static uint32_t eeprom_bytes_written = 0;
+static uint32_t eeprom_page_writes = 0;
+static uint32_t eeprom_read_transfers = 0;
+
+void native_hal_eeprom_reset()
+{
+    memset(eeprom_memory, 0xFF, sizeof(eeprom_memory));
+    memset(eeprom_cell_writes, 0, sizeof(eeprom_cell_writes));
+    eeprom_erased = true;
+    eeprom_cut_armed = false;
+    eeprom_power_cut = false;
+    eeprom_bytes_written = 0;
+    eeprom_page_writes = 0;
+    eeprom_read_transfers = 0;
+}
+
+void native_hal_eeprom_cut_power_after(uint32_t bytes)
+{
+    eeprom_cut_armed = true;
+    eeprom_bytes_to_cut = bytes;
+}
+
+void native_hal_eeprom_restore_power()
+{
+    eeprom_cut_armed = false;
+    eeprom_power_cut = false;
+}
+
+bool native_hal_eeprom_power_is_cut()
+{
+    return eeprom_power_cut;
+}
+
+uint32_t native_hal_eeprom_bytes_written()
+{
+    return eeprom_bytes_written;
+}
+
+uint32_t native_hal_eeprom_page_writes()
+{
+    return eeprom_page_writes;
+}
+
+uint32_t native_hal_eeprom_read_transfers()
+{
+    return eeprom_read_transfers;
+}
+
+uint32_t native_hal_eeprom_max_cell_writes(uint32_t start, uint32_t length)
+{
+    uint32_t most = 0;
+    for (uint32_t addr = start; addr < start + length && addr < NATIVE_HAL_EEPROM_BYTES; addr++) {
+        if (eeprom_cell_writes[addr] > most) {
+            most = eeprom_cell_writes[addr];
+        }
+    }
+    return most;
+}
+
+static uint8_t eeprom_junk_byte()
+{
+    eeprom_junk ^= eeprom_junk << 13;
+    eeprom_junk ^= eeprom_junk >> 17;
+    eeprom_junk ^= eeprom_junk << 5;
+    return (uint8_t) eeprom_junk;
+}
+
+bool ExternalEEPROM::begin(uint8_t deviceAddress, TwoWire& wirePort)
+{
+    settings.deviceAddress = deviceAddress;
+    settings.i2cPort = &wirePort;
+
+    if (!eeprom_erased) {
+        memset(eeprom_memory, 0xFF, sizeof(eeprom_memory));
+        eeprom_erased = true;
+    }
+    return true;
+}
+
+void ExternalEEPROM::erase(uint8_t toWrite)
+{
+    for (uint32_t addr = 0; addr < length(); addr++) {
+        write(addr, toWrite);
+    }
+}
+
+uint8_t ExternalEEPROM::read(uint32_t eepromLocation)
+{
+    uint8_t temp_byte = 0xFF;
+    read(eepromLocation, &temp_byte, 1);
+    return temp_byte;
+}
+
+void ExternalEEPROM::read(uint32_t eepromLocation, uint8_t* buff, uint16_t bufferSize)
+{
+    uint32_t size = settings.memorySize_bytes < NATIVE_HAL_EEPROM_BYTES ? settings.memorySize_bytes : NATIVE_HAL_EEPROM_BYTES;
+    eeprom_read_transfers += (bufferSize + EEPROM_READ_TRANSFER_BYTES - 1) / EEPROM_READ_TRANSFER_BYTES;
+    for (uint16_t i = 0; i < bufferSize; i++) {
+        uint32_t addr = eepromLocation + i;
+        buff[i] = addr < size ? eeprom_memory[addr] : 0xFF;
+    }
+}
+
+void ExternalEEPROM::write(uint32_t eepromLocation, uint8_t dataToWrite)
+{
+    write(eepromLocation, &dataToWrite, 1);
+}
+
+void ExternalEEPROM::write(uint32_t eepromLocation, const uint8_t* dataToWrite, uint16_t blockSize)
+{
+    uint32_t size = settings.memorySize_bytes < NATIVE_HAL_EEPROM_BYTES ? settings.memorySize_bytes : NATIVE_HAL_EEPROM_BYTES;
+
+    // A page write at a time, as the library does: up to a transfer, not across a page.
+    uint16_t written = 0;
+    while (written < blockSize) {
+        uint32_t addr = eepromLocation + written;
+        uint16_t amount = blockSize - written;
+        if (amount > EEPROM_WRITE_TRANSFER_BYTES) {
+            amount = EEPROM_WRITE_TRANSFER_BYTES;
+        }
+        uint32_t page_end = (addr / settings.pageSize_bytes + 1) * settings.pageSize_bytes;
+        if (addr + amount > page_end) {
+            amount = page_end - addr;
+        }
+
+        if (eeprom_power_cut) {
+            return;
+        }
+        eeprom_page_writes++;
+
+        for (uint16_t i = 0; i < amount; i++) {
+            if (addr + i >= size) {
+                break;
+            }
+            if (eeprom_cut_armed && eeprom_bytes_to_cut == 0) {
+                // Power gone part way through the page write, the rest of it is junk.
+                eeprom_power_cut = true;
+                eeprom_cut_armed = false;
+            }
+            eeprom_memory[addr + i] = eeprom_power_cut ? eeprom_junk_byte() : dataToWrite[written + i];
+            eeprom_cell_writes[addr + i]++;
+            if (!eeprom_power_cut) {
+                eeprom_bytes_written++;
+                if (eeprom_cut_armed) {
+                    eeprom_bytes_to_cut--;
+                }
+            }
+        }
+        written += amount;
+    }
+}
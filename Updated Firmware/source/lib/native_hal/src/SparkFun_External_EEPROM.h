@@ -0,0 +1,74 @@
+/* Host stand-in for the SparkFun External EEPROM library (v1.0.5).
+ *
+ * All instances share one 64 KB array, which plays the part of the
+ * 24LC512 on the board. As with the library, accesses are clipped to the
+ * configured memory size (512 bytes until setMemorySize() is called).
+ */
+
+#ifndef NATIVE_HAL_SPARKFUN_EXTERNAL_EEPROM_H
+#define NATIVE_HAL_SPARKFUN_EXTERNAL_EEPROM_H
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#define NATIVE_HAL_EEPROM_BYTES 65536
+
+struct struct_memorySettings {
+    TwoWire* i2cPort;
+    uint8_t deviceAddress;
+    uint32_t memorySize_bytes;
+    uint16_t pageSize_bytes;
+    uint8_t pageWriteTime_ms;
+    bool pollForWriteComplete;
+};
+
+class ExternalEEPROM {
+public:
+    uint8_t read(uint32_t eepromLocation);
+    void read(uint32_t eepromLocation, uint8_t* buff, uint16_t bufferSize);
+    void write(uint32_t eepromLocation, uint8_t dataToWrite);
+    void write(uint32_t eepromLocation, const uint8_t* dataToWrite, uint16_t blockSize);
+
+    bool begin(uint8_t deviceAddress = 0b1010000, TwoWire& wirePort = Wire);
+    bool isConnected(uint8_t i2cAddress = 255) { (void) i2cAddress; return true; }
+    bool isBusy(uint8_t i2cAddress = 255) { (void) i2cAddress; return false; }
+    void erase(uint8_t toWrite = 0x00);
+
+    void setMemorySize(uint32_t memSize) { settings.memorySize_bytes = memSize; }
+    uint32_t getMemorySize() const { return settings.memorySize_bytes; }
+    uint32_t length() const { return settings.memorySize_bytes; }
+    void setPageSize(uint16_t pageSize) { settings.pageSize_bytes = pageSize; }
+    uint16_t getPageSize() const { return settings.pageSize_bytes; }
+    void setPageWriteTime(uint8_t writeTimeMS) { settings.pageWriteTime_ms = writeTimeMS; }
+    uint8_t getPageWriteTime() const { return settings.pageWriteTime_ms; }
+    void enablePollForWriteComplete() { settings.pollForWriteComplete = true; }
+    void disablePollForWriteComplete() { settings.pollForWriteComplete = false; }
+    uint16_t getI2CBufferSize() const { return 32; }
+
+    // Functionality to 'get' and 'put' objects to and from EEPROM.
+    template<typename T>
+    T& get(uint32_t idx, T& t)
+    {
+        read(idx, (uint8_t*) &t, sizeof(T));
+        return t;
+    }
+
+    template<typename T>
+    const T& put(uint32_t idx, const T& t)
+    {
+        write(idx, (const uint8_t*) &t, sizeof(T));
+        return t;
+    }
+
+private:
+    struct_memorySettings settings = {
+            .i2cPort = &Wire,
+            .deviceAddress = 0b1010000,
+            .memorySize_bytes = 512,
+            .pageSize_bytes = 64,
+            .pageWriteTime_ms = 5,
+            .pollForWriteComplete = true,
+    };
+};
+
+#endif//NATIVE_HAL_SPARKFUN_EXTERNAL_EEPROM_H
@@ -0,0 +1,4 @@
+#include "Wire.h"
+
+TwoWire Wire;
+TwoWire Wire1;
@@ -0,0 +1,62 @@
+/* Host stand-in for the Arduino Wire (TWI) library.
+ *
+ * The host has no I2C bus. Every transmission is NACKed and every read
+ * returns no data, the same as a bus with nothing attached.
+ * Devices the firmware depends on (EEPROM, angle sensor) are emulated
+ * at the library level instead.
+ */
+
+#ifndef NATIVE_HAL_WIRE_H
+#define NATIVE_HAL_WIRE_H
+
+#include "Arduino.h"
+
+class TwoWire {
+public:
+    void begin() { }
+    void end() { }
+    void setClock(uint32_t frequency) { (void) frequency; }
+
+    void beginTransmission(uint8_t address) { (void) address; }
+    void beginTransmission(int address) { (void) address; }
+
+    // Returns 2, received NACK on transmit of address
+    uint8_t endTransmission(uint8_t send_stop = true)
+    {
+        (void) send_stop;
+        return 2;
+    }
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t send_stop = true)
+    {
+        (void) address;
+        (void) quantity;
+        (void) send_stop;
+        return 0;
+    }
+    uint8_t requestFrom(int address, int quantity, int send_stop = true)
+    {
+        return requestFrom((uint8_t) address, (uint8_t) quantity, (uint8_t) send_stop);
+    }
+
+    size_t write(uint8_t data)
+    {
+        (void) data;
+        return 1;
+    }
+    size_t write(const uint8_t* data, size_t quantity)
+    {
+        (void) data;
+        return quantity;
+    }
+
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    void flush() { }
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif//NATIVE_HAL_WIRE_H
@@ -0,0 +1,55 @@
+#include "ams_as5048b.h"
+#include "native_hal.h"
+
+static uint16_t angle_raw = 0;
+
+void native_hal_set_angle_raw(uint16_t counts)
+{
+    angle_raw = counts & 0x3FFF;
+}
+
+uint16_t AMS_AS5048B::angleRegR()
+{
+    uint16_t angle = (uint16_t) ((angle_raw - zero_reg) & 0x3FFF);
+    if (clock_wise) {
+        angle = (uint16_t) (0x3FFF - angle);
+    }
+    return angle;
+}
+
+int8_t AMS_AS5048B::angleR(double& angle, int unit, boolean newVal)
+{
+    if (newVal) {
+        last_angle_raw = (double) angleRegR();
+    }
+    angle = convertAngle(unit, last_angle_raw);
+    return 0;
+}
+
+double AMS_AS5048B::convertAngle(int unit, double angle) const
+{
+    switch (unit) {
+        case U_RAW:
+            return angle;
+        case U_TRN:
+            return angle / AS5048B_RESOLUTION;
+        case U_DEG:
+            return (angle / AS5048B_RESOLUTION) * 360.0;
+        case U_RAD:
+            return (angle / AS5048B_RESOLUTION) * 2 * M_PI;
+        case U_GRAD:
+            return (angle / AS5048B_RESOLUTION) * 400.0;
+        case U_MOA:
+            return (angle / AS5048B_RESOLUTION) * 21600.0;
+        case U_SOA:
+            return (angle / AS5048B_RESOLUTION) * 1296000.0;
+        case U_MILNATO:
+            return (angle / AS5048B_RESOLUTION) * 6400.0;
+        case U_MILSE:
+            return (angle / AS5048B_RESOLUTION) * 6300.0;
+        case U_MILRU:
+            return (angle / AS5048B_RESOLUTION) * 6000.0;
+        default:
+            return angle;
+    }
+}
@@ -0,0 +1,62 @@
+/* Host stand-in for the AMS AS5048B angle sensor library
+ * (boston-engineering fork, angleR() reports I2C errors).
+ *
+ * The sensor is emulated at register level: the raw angle is set from the
+ * host with native_hal_set_angle_raw(), and the zero register is
+ * subtracted from it the same way the part does.
+ */
+
+#ifndef NATIVE_HAL_AMS_AS5048B_H
+#define NATIVE_HAL_AMS_AS5048B_H
+
+#include "Arduino.h"
+
+// Default addresses for AS5048B
+#define AS5048_ADDRESS 0x40// 0b10000 + ( A1 & A2 to GND)
+
+// Resolution, 14 bits
+#define AS5048B_RESOLUTION 16384.0
+
+// Unit consts - just to make the units more readable
+#define U_RAW 1
+#define U_TRN 2
+#define U_DEG 3
+#define U_RAD 4
+#define U_GRAD 5
+#define U_MOA 6
+#define U_SOA 7
+#define U_MILNATO 8
+#define U_MILSE 9
+#define U_MILRU 10
+
+class AMS_AS5048B {
+public:
+    AMS_AS5048B() : chip_address(AS5048_ADDRESS) { }
+    explicit AMS_AS5048B(uint8_t chip_address) : chip_address(chip_address) { }
+
+    void begin() { }
+    void toggleDebug() { }
+    void setClockWise(boolean cw = true) { clock_wise = cw; }
+
+    uint16_t zeroRegR() const { return zero_reg; }
+    void zeroRegW(uint16_t reg_val) { zero_reg = reg_val & 0x3FFF; }
+    void setZeroReg() { zeroRegW(0); zeroRegW(angleRegR()); }
+
+    uint16_t angleRegR();
+    uint8_t getAutoGain() { return 0x80; }
+    uint8_t getDiagReg() { return 0x01; }
+    uint16_t magnitudeR() { return 0x1000; }
+
+    // Returns 0 on success, -1 on an I2C error
+    int8_t angleR(double& angle, int unit = U_RAW, boolean newVal = true);
+
+private:
+    uint8_t chip_address;
+    uint16_t zero_reg = 0;
+    boolean clock_wise = false;
+    double last_angle_raw = 0;
+
+    double convertAngle(int unit, double angle) const;
+};
+
+#endif//NATIVE_HAL_AMS_AS5048B_H
@@ -0,0 +1,130 @@
+/* Host-only controls for the native HAL.
+ *
+ * These have no equivalent on the Due. They let a host program play the part
+ * of the hardware: set what the ADC reads, watch the pins and feed the serial port.
+ */
+
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+#include <Arduino.h>
+
+/**
+ * Source for the host ADC.
+ * Called on every analogRead() with the ADC channel (pin - A0) and returns raw counts.
+ */
+typedef uint32_t (* native_hal_analog_source)(uint32_t channel, void* user_data);
+
+/**
+ * Sets a fixed value returned by analogRead() for a channel.
+ * Accepts either an analog pin number (A0...) or a channel number, like analogRead().
+ */
+void native_hal_set_analog(uint32_t pin, uint32_t counts);
+
+/**
+ * Installs a source that is asked for the ADC counts on each analogRead().
+ * Pass nullptr to go back to the fixed values.
+ */
+void native_hal_set_analog_source(native_hal_analog_source source, void* user_data);
+
+/**
+ * @return The last value written to a digital pin.
+ */
+int native_hal_get_digital(uint32_t pin);
+
+/**
+ * @return The last mode set for a pin with pinMode().
+ */
+uint32_t native_hal_get_pin_mode(uint32_t pin);
+
+/**
+ * Sets the raw 14-bit reading of the emulated AS5048B, before its zero register is applied.
+ */
+void native_hal_set_angle_raw(uint16_t counts);
+
+/**
+ * Queue characters to be read back through Serial.read().
+ */
+void native_hal_serial_feed(const char* data);
+
+/**
+ * Enable/Disable printing Serial output to stdout.
+ */
+void native_hal_serial_set_echo(bool enable);
+
+/**
+ * Copies everything written to Serial to a file, printed or not. Pass nullptr to stop.
+ */
+void native_hal_serial_set_capture(FILE* file);
+
+/**
+ * @return The number of bytes written to Serial so far, printed or not.
+ */
+uint32_t native_hal_serial_bytes_written();
+
+/**
+ * Fires any DueTimer handler whose period has elapsed.
+ * Handlers run in timer order, Timer0 first, like nested ISRs of equal priority would.
+ */
+void native_hal_service_timers();
+
+/**
+ * Switches millis()/micros() between the wall clock (default) and a virtual clock.
+ * The virtual clock stands still until native_hal_advance_us() moves it,
+ * which lets a simulation run as fast as the host allows, with the same
+ * handler interleaving on every run.
+ */
+void native_hal_set_virtual_clock(bool enable);
+bool native_hal_is_virtual_clock();
+
+/**
+ * Moves the virtual clock forward by us microseconds.
+ * Each DueTimer handler fires at its exact due time on the way. Handlers due at the
+ * same microsecond run in timer order, Timer0 first. delay() calls this too.
+ * Without the virtual clock, this waits on the wall clock instead.
+ */
+void native_hal_advance_us(uint32_t us);
+
+/**
+ * @return Microseconds since start, without the 32-bit wrap of micros().
+ */
+uint64_t native_hal_time_us();
+
+/**
+ * Moves the virtual clock to time_us, if that is in the future. Fires no handlers.
+ */
+void native_hal_set_time_us(uint64_t time_us);
+
+/**
+ * Erases the emulated EEPROM to 0xFF, restores its power and clears its counters.
+ */
+void native_hal_eeprom_reset();
+
+/**
+ * Cuts the EEPROM's power once another bytes bytes are written. Writes are
+ * made a page write at a time, split like the SparkFun library splits them.
+ * The page write the power goes in keeps the bytes before the cut, the rest
+ * of it is left with junk. Every write after that is lost, until the power is restored.
+ */
+void native_hal_eeprom_cut_power_after(uint32_t bytes);
+void native_hal_eeprom_restore_power();
+
+/**
+ * @return Whether the power was cut, by native_hal_eeprom_cut_power_after().
+ */
+bool native_hal_eeprom_power_is_cut();
+
+/**
+ * Counters since the last reset: bytes written, page writes (each a write cycle
+ * of the chip) and read transfers on the bus.
+ */
+uint32_t native_hal_eeprom_bytes_written();
+uint32_t native_hal_eeprom_page_writes();
+uint32_t native_hal_eeprom_read_transfers();
+
+/**
+ * @return The most times any one cell in the range was written since the last reset.
+ */
+uint32_t native_hal_eeprom_max_cell_writes(uint32_t start, uint32_t length);
+
+#endif//NATIVE_HAL_H
@@ -0,0 +1,11 @@
+/* Host stand-in for the Arduino Due variant header.
+ * On the Due this provides the board pin map and the Serial object,
+ * both of which live in Arduino.h here.
+ */
+
+#ifndef NATIVE_HAL_VARIANT_H
+#define NATIVE_HAL_VARIANT_H
+
+#include "Arduino.h"
+
+#endif//NATIVE_HAL_VARIANT_H
@@ -2,10 +2,20 @@
 #include "controls/control.h"
 #include "utilities/logging.h"
 
+// AS5048B angle, 14 bits over two registers.
+#define AS5048B_ANGLE_REG 0xFE
+
 void Actuator::init()
 {
     #if USE_AMS_FEEDBACK
         stepper_fb.begin();
+
+        angle_read.address = AS5048_ADDRESS;
+        angle_read.reg = AS5048B_ANGLE_REG;
+        angle_read.data = angle_registers;
+        angle_read.length = sizeof(angle_registers);
+        angle_read.read = true;
+        angle_read.priority = I2c_Priority::CONTROL;
     #endif
 
     if(ENABLE_WIPER_MOTOR) 
@@ -288,19 +298,11 @@ float Actuator::get_current_speed()
 double Actuator::get_position()
 {
 #if USE_AMS_FEEDBACK
-    double angle;
-
-    //Guard position query with noInterrupt/Interrupt() guards as the touch interrupt may interfered with position capture. They are on the same bus.
-    noInterrupts();
-    if (stepper_fb.angleR(angle, U_DEG, true) != -1) {
-        // No I2C error
-        interrupts();
-        return angle;
-    }
-    else {
-        interrupts();
-        return 0;
+    if (i2c_bus_transfer(angle_read)) {
+        uint16_t raw = (angle_registers[0] << 6) | (angle_registers[1] & 0x3F);
+        last_angle = raw * (360.0 / AS5048B_RESOLUTION);
     }
+    return last_angle;
 #else
     double current_pos_deg = TIMING_PULLEY_STEPS_TO_DEGREES(stepper.get_current_position());
     if (current_pos_deg > 360.0)
@@ -311,6 +313,7 @@ double Actuator::get_position()
 
 int8_t Actuator::get_position_raw(double& angle)
 {
+    I2cBusLock lock;
     return (stepper_fb.angleR(angle, U_RAW, true));
 }
 
@@ -323,23 +326,13 @@ double Actuator::degrees_to_volume(C_Stat compliance)
         position = MAX_ACT_POS_DEG;
     }
 
-    double volume = 0.0;
-
-    switch (compliance) {
-        case C_Stat::NONE:
-            volume = D2V_COEF_A_NO_LUNG * pow(position, 4) + D2V_COEF_B_NO_LUNG * pow(position, 3) + D2V_COEF_C_NO_LUNG * pow(position, 2) + D2V_COEF_D_NO_LUNG * position;
-            break;
-        case C_Stat::TWENTY:
-            volume = D2V_COEF_A_COMP_20 * pow(position, 4) + D2V_COEF_B_COMP_20 * pow(position, 3) + D2V_COEF_C_COMP_20 * pow(position, 2) + D2V_COEF_D_COMP_20 * position;
-            break;
-        case C_Stat::FIFTY:
-            volume = D2V_COEF_A_COMP_50 * pow(position, 4) + D2V_COEF_B_COMP_50 * pow(position, 3) + D2V_COEF_C_COMP_50 * pow(position, 2) + D2V_COEF_D_COMP_50 * position;
-            break;
-        default:
-            // Unknown complaince.
-            return -1;
+    if (compliance != C_Stat::NONE && compliance != C_Stat::TWENTY && compliance != C_Stat::FIFTY) {
+        // Unknown complaince.
+        return -1;
     }
 
+    double volume = volume_table_degrees_to_ml(get_volume_table(compliance), position) / 1000.0;
+
     // Cage to max volume.
     if (volume > (MAX_BAG_VOL_L)) {
         volume = (MAX_BAG_VOL_L);
@@ -357,21 +350,13 @@ double Actuator::volume_to_degrees(C_Stat compliance, double volume)
         return -1;
     }
 
-    switch (compliance) {
-        case C_Stat::NONE:
-            degrees = (V2D_COEF_A_NO_LUNG * pow(volume, 3)) + (V2D_COEF_B_NO_LUNG * pow(volume, 2)) + (V2D_COEF_C_NO_LUNG * volume) + V2D_COEF_D_NO_LUNG;
-            break;
-        case C_Stat::TWENTY:
-            degrees = (V2D_COEF_A_COMP_20 * pow(volume, 3)) + (V2D_COEF_B_COMP_20 * pow(volume, 2)) + (V2D_COEF_C_COMP_20 * volume) + V2D_COEF_D_COMP_20;
-            break;
-        case C_Stat::FIFTY:
-            degrees = (V2D_COEF_A_COMP_50 * pow(volume, 3)) + (V2D_COEF_B_COMP_50 * pow(volume, 2)) + (V2D_COEF_C_COMP_50 * volume) + V2D_COEF_D_COMP_50;
-            break;
-        default:
-            // Unknown compliance
-            return -1;
+    if (compliance != C_Stat::NONE && compliance != C_Stat::TWENTY && compliance != C_Stat::FIFTY) {
+        // Unknown compliance
+        return -1;
     }
 
+    degrees = volume_table_ml_to_degrees(get_volume_table(compliance), volume * 1000.0);
+
     // The actuator can only move to MAX_ACT_POS_DEG, before going back. Limit it here.
     if (degrees > MAX_ACT_POS_DEG) {
         degrees = MAX_ACT_POS_DEG;
@@ -380,12 +365,29 @@ double Actuator::volume_to_degrees(C_Stat compliance, double volume)
     return degrees;
 }
 
+bool Actuator::set_volume_table(C_Stat compliance, const volume_table& table)
+{
+    if (!volume_table_is_valid(table)) {
+        return false;
+    }
+
+    volume_tables[static_cast<int>(compliance)] = table;
+    return true;
+}
+
+const volume_table& Actuator::get_volume_table(C_Stat compliance)
+{
+    return volume_tables[static_cast<int>(compliance)];
+}
+
 /* Set the current reading of the angle sensor as zero.
  * and return the zero value.
  */
 uint16_t Actuator::set_current_position_as_zero()
 {
 #if USE_AMS_FEEDBACK
+    I2cBusLock lock;
+
     // Zero the zero register first, then write the actual value.
     stepper_fb.zeroRegW(0);
     uint16_t new_zero = stepper_fb.angleRegR();
@@ -406,6 +408,8 @@ uint16_t Actuator::set_current_position_as_zero()
  */
 void Actuator::set_zero_position(uint16_t new_zero)
 {
+    I2cBusLock lock;
+
     // Zero the zero register first, then write the actual value.
     stepper_fb.zeroRegW(0);
     stepper_fb.zeroRegW(new_zero);
@@ -488,16 +492,23 @@ bool Actuator::add_correction()
     return true;
 }
 
-void Actuator::calculate_trajectory(const float& duration_s, const float& pause_s, const float& goal_pos_deg, float& vel_deg)
+bool Actuator::calculate_trajectory(const float& duration_s, const float& pause_s, const float& goal_pos_deg, float& vel_deg)
 {
-    // Get the current position of the actuator
-    const float cur_pos_deg = (float) get_position();
+    // Plan in steps from the stepper's own count, the move is commanded in steps.
+    const int32_t cur_pos_steps = int32_t(stepper.get_current_position());
+    const int32_t goal_pos_steps = int32_t(TIMING_PULLEY_DEGREES_TO_STEPS(goal_pos_deg));
+
+    const motion_limits limits = {
+            STEPPER_MAX_STEPS_PER_SECOND,
+            STEPPER_MAX_ACCEL_STEPS_PER_SEC2,
+            STEPPER_MAX_JERK_STEPS_PER_SEC3,
+    };
+    const Profile_Type type = MOTION_PROFILE_TYPE ? Profile_Type::S_CURVE : Profile_Type::TRAPEZOID;
 
-    // Calculate the distance to move.
-    const float distance_deg = abs(goal_pos_deg - cur_pos_deg);
+    bool feasible = trajectory.plan(type, goal_pos_steps - cur_pos_steps, duration_s, limits);
 
-    // Calculate velocity of travel in degrees/second.
-    vel_deg = distance_deg / duration_s;
+    // Top speed of the move, in degrees/second.
+    vel_deg = TIMING_PULLEY_STEPS_TO_DEGREES(trajectory.get_cruise_speed());
 
     // if Wiper, use vel_deg to get the time for each cycle to most closely match the velocity
     // Stepper motor does not change time that each cycle starts, just how fast the pedal moves, wiper does the opposite, bpm still gets faster either way
@@ -507,14 +518,22 @@ void Actuator::calculate_trajectory(const float& duration_s, const float& pause_
     //     wiper.set_pause(pause_s*1000);
     // }
 
-    if (TIMING_PULLEY_DEGREES_TO_STEPS(vel_deg) > STEPPER_MAX_STEPS_PER_SECOND) {
-        serial_printf("Max velocity requested! %.2f, clipping to %0.2f!\n", vel_deg, TIMING_PULLEY_STEPS_TO_DEGREES(STEPPER_MAX_STEPS_PER_SECOND));
-
-        // Cap to max velocity
-        vel_deg = TIMING_PULLEY_STEPS_TO_DEGREES(STEPPER_MAX_STEPS_PER_SECOND);
+    if (!feasible) {
+        serial_printf("Move not feasible! %ld steps in %.2f s, takes %.2f s\n",
+                      long(goal_pos_steps - cur_pos_steps), duration_s, trajectory.get_duration());
     }
 
 #if DEBUG_WAVEFORM
-    serial_printf("Pos: %f, Goal:%f, Speed: %f\n", cur_pos_deg, goal_pos_deg, vel_deg);
+    serial_printf("Pos: %ld, Goal:%ld, Speed: %f, Segments: %d\n", long(cur_pos_steps), long(goal_pos_steps), vel_deg, trajectory.get_segment_count());
 #endif
+
+    return feasible;
+}
+
+void Actuator::start_trajectory()
+{
+    stepper.set_profile(trajectory.get_segments(), trajectory.get_segment_count(), trajectory.get_direction());
+
+    // Store previous position value. Used to detect movement.
+    prev_position = get_position();
 }
@@ -3,7 +3,9 @@
 
 #include "stepper.h"
 #include "wiper.h"
+#include "volume_table.h"
 #include "controls/fault.h"
+#include "utilities/i2c_bus.h"
 
 /* The type of ticks for the motor.
  * Although the actuator can be controlled in degrees,
@@ -70,6 +72,11 @@ public:
 
     bool is_home();
     bool is_moving();
+
+    /* Degrees. With the angle sensor, read through the I2C queue, so a touch
+     * read on the bus holds it up by a chunk at most. If the read fails, or
+     * loop() has the bus, it is the last angle read.
+     */
     double get_position();
     int8_t get_position_raw(double&);
     double degrees_to_volume(C_Stat compliance);
@@ -82,7 +89,20 @@ public:
     bool target_reached();
     bool add_correction();
     double volume_to_degrees(C_Stat compliance, double volume);
-    void calculate_trajectory(const float& duration_s, const float& pause_s, const float& goal_pos_deg, float& vel_deg);
+
+    // Replaces the volume table for a compliance, e.g. with one calibrated for this unit.
+    // Returns false, and keeps the table in use, if the new one isn't valid.
+    bool set_volume_table(C_Stat compliance, const volume_table& table);
+    const volume_table& get_volume_table(C_Stat compliance);
+
+    /* Plans a move to goal_pos_deg that takes duration_s, see motion_profile.h.
+     * vel_deg is set to the top speed of the move in degrees/sec.
+     * Returns false if the move can't be done in time, the plan is then the fastest move.
+     */
+    bool calculate_trajectory(const float& duration_s, const float& pause_s, const float& goal_pos_deg, float& vel_deg);
+
+    // Starts the move planned by calculate_trajectory().
+    void start_trajectory();
 
     void wiper_set_interval(float interval);
 
@@ -94,64 +114,19 @@ private:
 
     // Feedback
     AMS_AS5048B stepper_fb;
+    i2c_transaction angle_read = {};
+    uint8_t angle_registers[2];
+    double last_angle = 0;
+
+    // Planned move.
+    MotionProfile trajectory;
 
     // Prev. value of angle sensor.
     // Used to detect movement.
     double prev_position;
 
-    // No Lung - Degrees To Volume(D2V)
-    // y = -5E-09*x^4 + 1E-06x^3 - 4E-05x^2 + 0.0003x
-    // C_Stat = none
-    // Equation was derived by mapping volume displaced per degree the paddle moved. A Fluke Biomedical VT900A Gas Flow Analyzer was used to measure the volume displaced.
-    double const D2V_COEF_A_NO_LUNG = -0.00000000539259422946378;
-    double const D2V_COEF_B_NO_LUNG = 0.00000137006464979886;
-    double const D2V_COEF_C_NO_LUNG = -0.0000370548541166471;
-    double const D2V_COEF_D_NO_LUNG = 0.000260254960634754;
-
-    // No Lung - Volume To Degrees(V2D)
-    // y = 227.452^3 - 424.84x^2 + 309.29x + 26.668
-    // C_Stat = none
-    // Equation was derived by mapping volume displaced per degree the paddle moved. A Fluke Biomedical VT900A Gas Flow Analyzer was used to measure the volume displaced.
-    double const V2D_COEF_A_NO_LUNG = 227.42;
-    double const V2D_COEF_B_NO_LUNG = -424.84;
-    double const V2D_COEF_C_NO_LUNG = 309.29;
-    double const V2D_COEF_D_NO_LUNG = 26.668;
-
-    // With Lung - Degrees To Volume(D2V)
-    // y = -3E-09*x^4 + 9E-07*x^3 - 3E-05*x^2 - 7E-05*x
-    // C_Stat = 20 (mL/cmH2O)
-    // Equation was derived by mapping volume displaced per degree the paddle moved. A Fluke Biomedical VT900A Gas Flow Analyzer was used to measure the volume displaced.
-    double const D2V_COEF_A_COMP_20 = -0.00000000318509207676739;
-    double const D2V_COEF_B_COMP_20 = 0.000000868855116173189;
-    double const D2V_COEF_C_COMP_20 = -0.0000278632433332315;
-    double const D2V_COEF_D_COMP_20 = -0.0000703187442674391;
-
-    // With Lung - Volume To Degrees(V2D)
-    // y = 612.61^3 - 812.82x^2 + 436.56x + 34.416
-    // C_Stat = 20 (mL/cmH2O)
-    // Equation was derived by mapping volume displaced per degree the paddle moved. A Fluke Biomedical VT900A Gas Flow Analyzer was used to measure the volume displaced.
-    double const V2D_COEF_A_COMP_20 = 612.61;
-    double const V2D_COEF_B_COMP_20 = -812.82;
-    double const V2D_COEF_C_COMP_20 = 436.56;
-    double const V2D_COEF_D_COMP_20 = 34.416;
-
-    // With Lung
-    // y = -3E-09*x^4 + 8E-07*x^3 - 3E-06*x^2 - 0.0006*x
-    // C_Stat = 50 (mL/cmH2O)
-    // Equation was derived by mapping volume displaced per degree the paddle moved. A Fluke Biomedical VT900A Gas Flow Analyzer was used to measure the volume displaced.
-    double const D2V_COEF_A_COMP_50 = -0.00000000342520216878951;
-    double const D2V_COEF_B_COMP_50 = 0.000000834768084837607;
-    double const D2V_COEF_C_COMP_50 = -0.00000305968137895296;
-    double const D2V_COEF_D_COMP_50 = -0.000643516160449664;
-
-    // With Lung - Volume To Degrees(V2D)
-    // y = 263.07^3 - 449.69x^2 + 321.88x + 30.01
-    // C_Stat = 50 (mL/cmH2O)
-    // Equation was derived by mapping volume displaced per degree the paddle moved. A Fluke Biomedical VT900A Gas Flow Analyzer was used to measure the volume displaced.
-    double const V2D_COEF_A_COMP_50 = 263.07;
-    double const V2D_COEF_B_COMP_50 = -449.69;
-    double const V2D_COEF_C_COMP_50 = 321.88;
-    double const V2D_COEF_D_COMP_50 = 30.01;
+    // Volume against angle, in C_Stat order. See volume_table.h.
+    volume_table volume_tables[3] = {VOLUME_TABLE_NO_LUNG, VOLUME_TABLE_COMP_50, VOLUME_TABLE_COMP_20};
 
     float degrees_to_steps(const float& d_val);
     float steps_to_degrees(const float& s_val);
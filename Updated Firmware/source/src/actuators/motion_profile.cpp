@@ -0,0 +1,245 @@
+#include "motion_profile.h"
+
+// Bisection steps when solving for a speed, plenty for float.
+#define MOTION_PROFILE_SOLVER_ITERATIONS 32
+
+// Cruise phases shorter than this are dropped, in seconds.
+#define MOTION_PROFILE_MIN_CRUISE_S 0.0005f
+
+bool MotionProfile::plan(Profile_Type type, int32_t distance_steps, float duration_s, const motion_limits& limits)
+{
+    this->type = type;
+    this->limits = limits;
+
+    direction = distance_steps < 0 ? -1 : 1;
+    uint32_t steps = uint32_t(distance_steps < 0 ? -distance_steps : distance_steps);
+    distance = steps;
+    segment_count = 0;
+
+    if (steps == 0) {
+        feasible = true;
+        duration = duration_s;
+        cruise_speed = 0;
+        set_ramp(0);
+        return true;
+    }
+
+    // Fastest cruise speed that still leaves time to speed up and slow down.
+    float max_speed = limits.max_speed;
+    if (duration_s > 0 && 2 * ramp_time(max_speed) > duration_s) {
+        float lo = 0;
+        float hi = max_speed;
+        for (int i = 0; i < MOTION_PROFILE_SOLVER_ITERATIONS; i++) {
+            float mid = 0.5f * (lo + hi);
+            if (2 * ramp_time(mid) > duration_s) {
+                hi = mid;
+            }
+            else {
+                lo = mid;
+            }
+        }
+        max_speed = lo;
+    }
+
+    feasible = duration_s > 0 && distance_for(max_speed, duration_s) >= distance;
+
+    if (feasible) {
+        // Lowest cruise speed that covers the distance in time. Distance grows with the speed.
+        float lo = 0;
+        float hi = max_speed;
+        for (int i = 0; i < MOTION_PROFILE_SOLVER_ITERATIONS; i++) {
+            float mid = 0.5f * (lo + hi);
+            if (distance_for(mid, duration_s) < distance) {
+                lo = mid;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        cruise_speed = hi;
+        duration = duration_s;
+    }
+    else {
+        // Too far for the time. Plan the fastest move, it ends late.
+        float v = limits.max_speed;
+        if (v * ramp_time(v) > distance) {
+            // Never reaches top speed: speed up and slow down only.
+            float lo = 0;
+            float hi = v;
+            for (int i = 0; i < MOTION_PROFILE_SOLVER_ITERATIONS; i++) {
+                float mid = 0.5f * (lo + hi);
+                if (mid * ramp_time(mid) < distance) {
+                    lo = mid;
+                }
+                else {
+                    hi = mid;
+                }
+            }
+            v = hi;
+            duration = 2 * ramp_time(v);
+        }
+        else {
+            duration = distance / v + ramp_time(v);
+        }
+        cruise_speed = v;
+    }
+
+    set_ramp(cruise_speed);
+    build_segments(steps);
+
+    return feasible;
+}
+
+float MotionProfile::ramp_time(float v) const
+{
+    if (type == Profile_Type::TRAPEZOID) {
+        return v / limits.max_accel;
+    }
+
+    // Reaching full acceleration takes a/j, and adds that much speed.
+    float a = limits.max_accel;
+    float j = limits.max_jerk;
+    if (v >= a * a / j) {
+        return v / a + a / j;
+    }
+    return 2 * sqrtf(v / j);
+}
+
+void MotionProfile::set_ramp(float v)
+{
+    float a = limits.max_accel;
+    float j = limits.max_jerk;
+
+    if (type == Profile_Type::TRAPEZOID) {
+        ramp_accel = a;
+        ramp_jerk_time = 0;
+        ramp_accel_time = v / a;
+    }
+    else if (v >= a * a / j) {
+        ramp_accel = a;
+        ramp_jerk_time = a / j;
+        ramp_accel_time = v / a - a / j;
+    }
+    else {
+        // Acceleration peaks below the limit.
+        ramp_accel = sqrtf(v * j);
+        ramp_jerk_time = ramp_accel / j;
+        ramp_accel_time = 0;
+    }
+
+    ramp_total_time = 2 * ramp_jerk_time + ramp_accel_time;
+}
+
+float MotionProfile::ramp_position(float t) const
+{
+    float tj = ramp_jerk_time;
+    float tc = ramp_accel_time;
+    float a = ramp_accel;
+    float j = tj > 0 ? a / tj : 0;
+
+    // Jerk up to full acceleration.
+    if (t <= tj) {
+        return j * t * t * t / 6;
+    }
+    float v1 = a * tj / 2;
+    float p1 = a * tj * tj / 6;
+
+    // Constant acceleration.
+    if (t <= tj + tc) {
+        float tau = t - tj;
+        return p1 + v1 * tau + a * tau * tau / 2;
+    }
+    float v2 = v1 + a * tc;
+    float p2 = p1 + v1 * tc + a * tc * tc / 2;
+
+    // Jerk down to cruise speed.
+    float tau = t - tj - tc;
+    if (tau > tj) {
+        tau = tj;
+    }
+    return p2 + v2 * tau + a * tau * tau / 2 - j * tau * tau * tau / 6;
+}
+
+float MotionProfile::distance_for(float v, float duration_s) const
+{
+    // The speed ramps are symmetric, each covers v * ramp_time / 2.
+    return v * (duration_s - ramp_time(v));
+}
+
+float MotionProfile::position_at(float t) const
+{
+    if (t <= 0) {
+        return 0;
+    }
+    if (t >= duration) {
+        return distance;
+    }
+    if (t <= ramp_total_time) {
+        return ramp_position(t);
+    }
+    if (t <= duration - ramp_total_time) {
+        return cruise_speed * ramp_total_time / 2 + cruise_speed * (t - ramp_total_time);
+    }
+    return distance - ramp_position(duration - t);
+}
+
+float MotionProfile::time_at(float p) const
+{
+    float lo = 0;
+    float hi = duration;
+    for (int i = 0; i < MOTION_PROFILE_SOLVER_ITERATIONS; i++) {
+        float mid = 0.5f * (lo + hi);
+        if (position_at(mid) < p) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return hi;
+}
+
+/* Cuts the move at even times through each ramp, and once around the cruise.
+ * Each segment ends on the last whole step before its cut, at the time the move
+ * reaches that step, and runs at the average speed since the previous one.
+ * Steps go out at the end of their interval, so every segment end, and the last
+ * step of the move, lands where the profile has it.
+ */
+void MotionProfile::build_segments(uint32_t steps)
+{
+    float times[MOTION_PROFILE_MAX_SEGMENTS];
+    uint8_t count = 0;
+
+    for (int i = 1; i <= MOTION_PROFILE_RAMP_SEGMENTS; i++) {
+        times[count++] = ramp_total_time * i / MOTION_PROFILE_RAMP_SEGMENTS;
+    }
+    if (duration - 2 * ramp_total_time > MOTION_PROFILE_MIN_CRUISE_S) {
+        times[count++] = duration - ramp_total_time;
+    }
+    for (int i = 1; i <= MOTION_PROFILE_RAMP_SEGMENTS; i++) {
+        times[count++] = duration - ramp_total_time + ramp_total_time * i / MOTION_PROFILE_RAMP_SEGMENTS;
+    }
+
+    uint32_t done_steps = 0;
+    float segment_start = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        uint32_t target_steps = (i == count - 1) ? steps : uint32_t(position_at(times[i]) + 0.001f);
+        if (target_steps > steps) {
+            target_steps = steps;
+        }
+        if (target_steps <= done_steps) {
+            continue;
+        }
+
+        float segment_end = (target_steps == steps) ? duration : time_at(target_steps);
+        float dt = segment_end - segment_start;
+        uint32_t segment_steps = target_steps - done_steps;
+
+        segments[segment_count].steps = segment_steps;
+        segments[segment_count].speed = dt > 0 ? segment_steps / dt : limits.max_speed;
+        segment_count++;
+
+        done_steps = target_steps;
+        segment_start = segment_end;
+    }
+}
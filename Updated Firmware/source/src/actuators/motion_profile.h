@@ -0,0 +1,102 @@
+#ifndef UVENT_MOTION_PROFILE_H
+#define UVENT_MOTION_PROFILE_H
+
+#include <Arduino.h>
+
+/* Motion planner for actuator moves.
+ *
+ * A move is planned once, when it starts, to take exactly the requested time:
+ * speed up, cruise, slow down to a stop on the target. The cruise speed is the
+ * lowest one that makes the deadline. Speeding up is either at constant
+ * acceleration (trapezoid) or with limited jerk as well (S-curve).
+ *
+ * The plan is handed to the stepper as a short list of constant speed segments,
+ * each a whole number of steps. The segment times add up to the move time, so
+ * a move that fits the limits ends on its deadline.
+ *
+ * If the distance can't be covered in the time within the limits, the plan is
+ * the fastest move instead. It ends late, and plan() says so.
+ */
+
+enum class Profile_Type {
+    TRAPEZOID,
+    S_CURVE
+};
+
+struct motion_limits {
+    float max_speed;// steps/s
+    float max_accel;// steps/s^2
+    float max_jerk; // steps/s^3, S-curve only
+};
+
+struct motion_segment {
+    uint32_t steps;
+    float speed;// steps/s
+};
+
+// Segments each speed change is cut into, and the longest a plan can get.
+#define MOTION_PROFILE_RAMP_SEGMENTS 8
+#define MOTION_PROFILE_MAX_SEGMENTS (2 * MOTION_PROFILE_RAMP_SEGMENTS + 1)
+
+class MotionProfile {
+public:
+    /**
+     * Plans a move.
+     * @param type Shape of the speed changes.
+     * @param distance_steps Signed distance to move.
+     * @param duration_s Time the move should take.
+     * @param limits Speed, acceleration and jerk limits.
+     * @return true if the move takes duration_s, false if it could not and the fastest move was planned.
+     */
+    bool plan(Profile_Type type, int32_t distance_steps, float duration_s, const motion_limits& limits);
+
+    bool is_feasible() const { return feasible; }
+
+    // Time the planned move takes, duration_s or longer.
+    float get_duration() const { return duration; }
+
+    // Top speed of the move, steps/s.
+    float get_cruise_speed() const { return cruise_speed; }
+
+    // Distance covered t seconds into the move, in steps, without sign.
+    float position_at(float t) const;
+
+    // 1 or -1.
+    int8_t get_direction() const { return direction; }
+    uint8_t get_segment_count() const { return segment_count; }
+    const motion_segment* get_segments() const { return segments; }
+
+private:
+    // Time and distance to reach speed v from rest.
+    float ramp_time(float v) const;
+    float ramp_position(float t) const;
+    void set_ramp(float v);
+
+    // Time at which the move has covered p steps.
+    float time_at(float p) const;
+
+    // Distance covered in duration with a cruise speed of v.
+    float distance_for(float v, float duration_s) const;
+
+    void build_segments(uint32_t distance);
+
+    Profile_Type type = Profile_Type::TRAPEZOID;
+    motion_limits limits = {0, 0, 0};
+
+    bool feasible = true;
+    float duration = 0;
+    float cruise_speed = 0;
+    float distance = 0;
+    int8_t direction = 1;
+
+    // Ramp to cruise speed: jerk phase, constant acceleration phase, jerk phase.
+    float ramp_accel = 0;
+    float ramp_jerk_time = 0;
+    float ramp_accel_time = 0;
+    float ramp_total_time = 0;
+
+    motion_segment segments[MOTION_PROFILE_MAX_SEGMENTS];
+    uint8_t segment_count = 0;
+};
+
+#endif
@@ -0,0 +1,297 @@
+#include "step_generator.h"
+#include "../config/uvent_conf.h"
+#include "utilities/perf.h"
+#include <DueTimer.h>
+
+// Step pulse width in ticks, rounded up.
+#define STEP_GENERATOR_PULSE_TICKS ((STEPPER_STEP_PULSE_US * STEP_GENERATOR_TICK_HZ + 999999UL) / 1000000UL)
+
+static step_generator_callback on_segment_done = nullptr;
+
+// Current segment, in timer ticks.
+static uint32_t segment_period = 1;
+static uint32_t segment_pulse = 0;
+static uint32_t segment_steps = 0;
+static uint32_t segment_ticks = 0;
+static volatile bool segment_running = false;
+
+// Steps out after ticks, counting rising edges.
+static uint32_t steps_at(uint32_t ticks)
+{
+    uint32_t steps = (uint32_t) (((uint64_t) ticks + segment_pulse) / segment_period);
+    return steps < segment_steps ? steps : segment_steps;
+}
+
+// Ticks from ticks to the end of the step interval in progress, 0 once all steps are out.
+static uint32_t interval_left_at(uint32_t ticks)
+{
+    uint32_t steps = steps_at(ticks);
+    if (steps >= segment_steps) {
+        return 0;
+    }
+    return (steps + 1) * segment_period - ticks;
+}
+
+// Fits the segment to the timer, shared by both implementations.
+static void plan_segment(uint32_t period_ticks, uint32_t steps)
+{
+    uint32_t min_period = 2 * STEP_GENERATOR_PULSE_TICKS;
+    if (period_ticks < min_period) {
+        period_ticks = min_period;
+    }
+    if (period_ticks > STEP_GENERATOR_MAX_PERIOD_TICKS) {
+        period_ticks = STEP_GENERATOR_MAX_PERIOD_TICKS;
+    }
+
+    uint32_t max_steps = UINT32_MAX / period_ticks;
+
+    segment_period = period_ticks;
+    segment_pulse = STEP_GENERATOR_PULSE_TICKS;
+    segment_steps = steps < max_steps ? steps : max_steps;
+    segment_ticks = segment_steps * segment_period;
+}
+
+#if defined(ARDUINO_ARCH_SAM)
+
+/* Due step pin 9 is PC21, PWML4 on peripheral B.
+ * PWML is the inverse of the channel output. With CPOL set, the channel output is high
+ * for CDTY ticks and low for the rest, so the pin is low for CDTY ticks and then high
+ * for the pulse at the end of each period.
+ *
+ * The segment timer is TC0 channel 1, the channel behind Timer1. DueTimer owns
+ * TC1_Handler, it clears the status and calls the callback attached to Timer1.
+ */
+#define STEP_GENERATOR_TC TC0
+#define STEP_GENERATOR_TC_CHANNEL 1
+#define STEP_GENERATOR_TC_IRQ TC1_IRQn
+#define STEP_GENERATOR_TC_ID ID_TC1
+#define STEP_GENERATOR_TIMER Timer1
+
+/* NVIC priorities, lower is more urgent. Everything comes up at 0, so the other
+ * interrupts the firmware uses are moved down a level for the segment interrupt to
+ * preempt them: the control handler (TC0), the tone (TC2, TC5), the I2C poll (TC3),
+ * the ADC sampler and the display DMA. See the latency budget in step_generator.h.
+ */
+#define STEP_GENERATOR_IRQ_PRIORITY 0
+#define STEP_GENERATOR_OTHER_IRQ_PRIORITY 1
+
+static const IRQn_Type other_irqs[] = {TC0_IRQn, TC2_IRQn, TC3_IRQn, TC5_IRQn, ADC_IRQn, DMAC_IRQn};
+
+static const PinDescription& step_pin = g_APinDescription[STEPPER_STEP_PIN];
+
+// Hands the pin back to the PIO, driven low.
+static void release_pin()
+{
+    step_pin.pPort->PIO_CODR = step_pin.ulPin;
+    step_pin.pPort->PIO_PER = step_pin.ulPin;
+}
+
+static uint32_t timer_ticks()
+{
+    return STEP_GENERATOR_TC->TC_CHANNEL[STEP_GENERATOR_TC_CHANNEL].TC_CV;
+}
+
+static void segment_isr()
+{
+    PerfScope perf(Perf_Probe::ACTUATOR);
+
+    // The counter stopped on RC. Take the pin first, the next pulse is a full interval away.
+    release_pin();
+    PWM->PWM_DIS = 1u << step_pin.ulPWMChannel;
+    segment_running = false;
+
+    if (on_segment_done) {
+        on_segment_done();
+    }
+}
+
+void step_generator_init(step_generator_callback segment_done)
+{
+    on_segment_done = segment_done;
+
+    pinMode(STEPPER_STEP_PIN, OUTPUT);
+    release_pin();
+
+    pmc_enable_periph_clk(ID_PWM);
+    PWM->PWM_DIS = 1u << step_pin.ulPWMChannel;
+
+    /* Count MCK/128, stop on RC so the count still reads the segment length at the end.
+     * Only the RC compare interrupts.
+     */
+    pmc_enable_periph_clk(STEP_GENERATOR_TC_ID);
+    TC_Configure(STEP_GENERATOR_TC, STEP_GENERATOR_TC_CHANNEL,
+                 TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC | TC_CMR_TCCLKS_TIMER_CLOCK4 | TC_CMR_CPCSTOP);
+    STEP_GENERATOR_TC->TC_CHANNEL[STEP_GENERATOR_TC_CHANNEL].TC_IDR = ~TC_IER_CPCS;
+    STEP_GENERATOR_TC->TC_CHANNEL[STEP_GENERATOR_TC_CHANNEL].TC_IER = TC_IER_CPCS;
+
+    for (IRQn_Type irq : other_irqs) {
+        NVIC_SetPriority(irq, STEP_GENERATOR_OTHER_IRQ_PRIORITY);
+    }
+    NVIC_SetPriority(STEP_GENERATOR_TC_IRQ, STEP_GENERATOR_IRQ_PRIORITY);
+
+    STEP_GENERATOR_TIMER.attachInterrupt(segment_isr);
+    NVIC_ClearPendingIRQ(STEP_GENERATOR_TC_IRQ);
+    NVIC_EnableIRQ(STEP_GENERATOR_TC_IRQ);
+}
+
+uint32_t step_generator_start(uint32_t period_ticks, uint32_t steps)
+{
+    plan_segment(period_ticks, steps);
+    if (segment_steps == 0) {
+        return 0;
+    }
+
+    /* The PWM period register is 16 bit. Slow steps divide the PWM clock further,
+     * and the interval is rounded to a whole number of PWM clocks so both counters agree.
+     */
+    uint32_t divider = segment_period / 65536 + 1;
+    uint32_t pwm_period = (segment_period + divider / 2) / divider;
+    uint32_t pwm_pulse = (segment_pulse + divider - 1) / divider;
+    if (pwm_pulse >= pwm_period) {
+        pwm_pulse = pwm_period - 1;
+    }
+    segment_period = pwm_period * divider;
+    segment_pulse = pwm_pulse * divider;
+    if (segment_steps > UINT32_MAX / segment_period) {
+        segment_steps = UINT32_MAX / segment_period;
+    }
+    segment_ticks = segment_steps * segment_period;
+
+    // CLKB = MCK/128/divider. CLKA belongs to analogWrite(), keep it.
+    PWM->PWM_CLK = (PWM->PWM_CLK & (PWM_CLK_DIVA_Msk | PWM_CLK_PREA_Msk)) | PWM_CLK_PREB(7) | PWM_CLK_DIVB(divider);
+
+    uint32_t channel = step_pin.ulPWMChannel;
+    PWM->PWM_CH_NUM[channel].PWM_CMR = PWM_CMR_CPRE_CLKB | PWM_CMR_CPOL;
+    PWM->PWM_CH_NUM[channel].PWM_CPRD = pwm_period;
+    PWM->PWM_CH_NUM[channel].PWM_CDTY = pwm_period - pwm_pulse;
+
+    TC_SetRC(STEP_GENERATOR_TC, STEP_GENERATOR_TC_CHANNEL, segment_ticks);
+    PIO_Configure(step_pin.pPort, PIO_PERIPH_B, step_pin.ulPin, PIO_DEFAULT);
+
+    /* Start both counters back to back, a few MCK cycles apart. That is well under
+     * a tick, so they count the same edges.
+     */
+    segment_running = true;
+    PWM->PWM_ENA = 1u << channel;
+    STEP_GENERATOR_TC->TC_CHANNEL[STEP_GENERATOR_TC_CHANNEL].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+
+    return segment_steps;
+}
+
+uint32_t step_generator_stop(uint32_t* interval_left)
+{
+    if (interval_left) {
+        *interval_left = 0;
+    }
+    if (!segment_running) {
+        return 0;
+    }
+
+    // Don't cut a pulse short, the drive may or may not count it. It is only a few microsec.
+    while (timer_ticks() < segment_ticks && timer_ticks() % segment_period >= segment_period - segment_pulse) {
+    }
+
+    STEP_GENERATOR_TC->TC_CHANNEL[STEP_GENERATOR_TC_CHANNEL].TC_CCR = TC_CCR_CLKDIS;
+    release_pin();
+    PWM->PWM_DIS = 1u << step_pin.ulPWMChannel;
+
+    // Drop an RC compare that raced with the stop, the segment is accounted for here.
+    TC_GetStatus(STEP_GENERATOR_TC, STEP_GENERATOR_TC_CHANNEL);
+    NVIC_ClearPendingIRQ(STEP_GENERATOR_TC_IRQ);
+
+    segment_running = false;
+    uint32_t ticks = timer_ticks();
+    if (interval_left) {
+        *interval_left = interval_left_at(ticks);
+    }
+    segment_steps = steps_at(ticks);
+    return segment_steps;
+}
+
+uint32_t step_generator_steps_issued()
+{
+    return segment_running ? steps_at(timer_ticks()) : 0;
+}
+
+#else
+
+/* Host emulation. The ticks are derived from micros(), and Timer1 fires once at the
+ * end of the segment, on the first microsec past its last tick.
+ */
+static uint32_t segment_start_us = 0;
+
+static uint32_t timer_ticks()
+{
+    uint64_t elapsed_us = (uint32_t) (micros() - segment_start_us);
+    uint64_t ticks = elapsed_us * STEP_GENERATOR_TICK_HZ / 1000000UL;
+    return ticks < segment_ticks ? (uint32_t) ticks : segment_ticks;
+}
+
+static void segment_isr()
+{
+    PerfScope perf(Perf_Probe::ACTUATOR);
+
+    Timer1.stop();
+    segment_running = false;
+
+    if (on_segment_done) {
+        on_segment_done();
+    }
+}
+
+void step_generator_init(step_generator_callback segment_done)
+{
+    on_segment_done = segment_done;
+
+    pinMode(STEPPER_STEP_PIN, OUTPUT);
+    digitalWrite(STEPPER_STEP_PIN, LOW);
+
+    Timer1.attachInterrupt(segment_isr);
+}
+
+uint32_t step_generator_start(uint32_t period_ticks, uint32_t steps)
+{
+    plan_segment(period_ticks, steps);
+    if (segment_steps == 0) {
+        return 0;
+    }
+
+    uint64_t duration_us = ((uint64_t) segment_ticks * 1000000UL + STEP_GENERATOR_TICK_HZ - 1) / STEP_GENERATOR_TICK_HZ;
+
+    segment_running = true;
+    segment_start_us = micros();
+    Timer1.start((double) duration_us);
+
+    return segment_steps;
+}
+
+uint32_t step_generator_stop(uint32_t* interval_left)
+{
+    if (interval_left) {
+        *interval_left = 0;
+    }
+    if (!segment_running) {
+        return 0;
+    }
+
+    uint32_t ticks = timer_ticks();
+    Timer1.stop();
+    segment_running = false;
+    if (interval_left) {
+        *interval_left = interval_left_at(ticks);
+    }
+    segment_steps = steps_at(ticks);
+    return segment_steps;
+}
+
+uint32_t step_generator_steps_issued()
+{
+    return segment_running ? steps_at(timer_ticks()) : 0;
+}
+
+#endif
+
+bool step_generator_busy()
+{
+    return segment_running;
+}
@@ -0,0 +1,71 @@
+#ifndef UVENT_STEP_GENERATOR_H
+#define UVENT_STEP_GENERATOR_H
+
+#include <Arduino.h>
+
+/* Hardware step pulse generator for the stepper drive.
+ *
+ * A move at constant speed is one segment: a number of steps at a fixed interval.
+ * The PWM channel of the step pin clocks the pulses out by itself, so every
+ * edge lands on a timer tick. A timer channel (TC0 channel 1, Timer1) counts the
+ * same ticks, tells how many steps are out so far and interrupts once, at
+ * the end of the segment, to stop the PWM.
+ *
+ * Each step interval ends with the pulse: the pin goes high STEPPER_STEP_PULSE_US
+ * before the interval is up. Step n has gone out once n intervals minus the
+ * pulse width have passed.
+ *
+ * Latency budget: the PWM runs on until the segment interrupt stops it. If that
+ * takes longer than one step interval minus the pulse after the end of the segment,
+ * 1.66 ms at STEPPER_MAX_STEPS_PER_SECOND, an extra step goes out that is never
+ * counted and the position is off from then on. So the segment interrupt has the
+ * highest NVIC priority in the firmware and preempts every other handler, including
+ * the control handler waiting on the I2C bus. What is left is the time interrupts
+ * are masked, the noInterrupts() sections, which must stay far under the budget.
+ * They take a few microsec, the longest is step_generator_stop() waiting out a pulse.
+ *
+ * Host builds emulate the same timing on Timer1, so positions match the board.
+ */
+
+// Both the PWM and the timer channel count MCK/128, 656.25 kHz on the Due.
+#define STEP_GENERATOR_TICK_HZ 656250UL
+
+// Longest step interval, the PWM period register is 16 bit and its clock divides by up to 255.
+#define STEP_GENERATOR_MAX_PERIOD_TICKS (255UL * 65535UL)
+
+// Called from the timer interrupt when a segment has issued all of its steps.
+typedef void (* step_generator_callback)();
+
+/**
+ * Sets up the PWM channel and timer. The step pin stays a plain output until a segment starts.
+ * @param segment_done Called from interrupt context at the end of each segment.
+ */
+void step_generator_init(step_generator_callback segment_done);
+
+/**
+ * Starts a segment, stop the running one first. The first pulse comes one interval after the start.
+ * @param period_ticks Step interval in ticks, clipped to [2 * pulse width, STEP_GENERATOR_MAX_PERIOD_TICKS].
+ * @param steps Number of steps to issue.
+ * @return The number of steps that will be issued, fewer than steps if the
+ * segment would not fit in the 32 bit timer.
+ */
+uint32_t step_generator_start(uint32_t period_ticks, uint32_t steps);
+
+/**
+ * Stops the running segment, letting a pulse in progress finish first.
+ * A segment that ended with its interrupt still pending is stopped here
+ * instead, and its callback is not called.
+ * @param interval_left If given, set to the ticks the stopped segment still had to
+ * go to the end of its current step interval, 0 if it had issued all of its steps.
+ * @return The number of steps issued by the segment, 0 if none was running.
+ */
+uint32_t step_generator_stop(uint32_t* interval_left = nullptr);
+
+/**
+ * @return The number of steps issued so far by the running segment, 0 if none is running.
+ */
+uint32_t step_generator_steps_issued();
+
+bool step_generator_busy();
+
+#endif
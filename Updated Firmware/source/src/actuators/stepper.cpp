@@ -2,11 +2,19 @@
 #include "../config/uvent_conf.h"
 #include "utilities/logging.h"
 #include <Arduino.h>
+#if USE_HW_STEP_GENERATOR
+#include "step_generator.h"
+#endif
 
 /* The 5718L stepper moves counter-clockwise for positive speeds
  * and clockwise for negative speeds.
  */
 
+#if USE_HW_STEP_GENERATOR
+// The generator calls back without an object, there is only one stepper.
+static Stepper* hw_stepper = nullptr;
+#endif
+
 // Initialize the stepper motor.
 void Stepper::init()
 {
@@ -26,22 +34,283 @@ void Stepper::init()
     pinMode(STEPPER_STEP_PIN, OUTPUT);
     pinMode(STEPPER_DISABLE_PIN, OUTPUT);
 
+#if USE_HW_STEP_GENERATOR
+    hw_stepper = this;
+    step_generator_init(segment_done);
+#else
     // Max speed in steps per second.
     stepper_5718L.setMaxSpeed(STEPPER_MAX_STEPS_PER_SECOND);
 
     // Stop the motor.
     stepper_5718L.setSpeed(0);
+#endif
+}
+
+void Stepper::set_enable(bool en)
+{
+    digitalWrite(STEPPER_DISABLE_PIN, !(en));
+}
+
+#if USE_HW_STEP_GENERATOR
+
+/* Nothing to service, the step generator issues the steps.
+ * The actuator handler does not need to run at all.
+ */
+bool Stepper::run()
+{
+    return false;
+}
+
+// Run the stepper at a set speed
+void Stepper::set_speed(float steps_per_second)
+{
+    steps_per_second = constrain(steps_per_second, -STEPPER_MAX_STEPS_PER_SECOND, STEPPER_MAX_STEPS_PER_SECOND);
+
+    noInterrupts();
+    if (steps_per_second != speed) {
+        float old_speed = speed;
+        speed = steps_per_second;
+        retime_segment(old_speed);
+    }
+    interrupts();
+}
+
+void Stepper::home()
+{
+    /* Move the paddle through a full rev.
+     * Home should be within this distance.
+     */
+    noInterrupts();
+    target = current_position() + int32_t(TIMING_PULLEY_STEPS_PER_REV);
+    speed = STEPPER_HOMING_SPEED_IN_STEPS_SEC;
+    restart_segment();
+    interrupts();
+}
+
+void Stepper::home_expiration()
+{
+    /* Move the paddle through a full rev.
+     * Home should be within this distance.
+     */
+    noInterrupts();
+    target = current_position() - int32_t(TIMING_PULLEY_STEPS_PER_REV);
+    speed = STEPPER_HOMING_SPEED_IN_STEPS_SEC;
+    restart_segment();
+    interrupts();
+}
+
+bool Stepper::is_moving()
+{
+    noInterrupts();
+    bool moving = !(speed == 0 && target == current_position());
+    interrupts();
+
+    return moving;
+}
+
+bool Stepper::remaining_steps_to_go()
+{
+    noInterrupts();
+    bool remaining = target != current_position();
+    interrupts();
+
+    return remaining;
+}
+
+void Stepper::set_position(double steps)
+{
+    noInterrupts();
+    if (int32_t(steps) != target) {
+        target = int32_t(steps);
+        restart_segment();
+    }
+    interrupts();
+}
+
+void Stepper::set_position_relative(double steps)
+{
+    noInterrupts();
+    target = current_position() + int32_t(steps);
+    restart_segment();
+    interrupts();
+}
+
+void Stepper::set_position_as_home(int32_t home_position)
+{
+    // Like AccelStepper::setCurrentPosition(), this also stops the motor.
+    noInterrupts();
+    step_generator_stop();
+    segment_direction = 0;
+    segment_steps = 0;
+    profile_count = 0;
+    position = home_position;
+    target = home_position;
+    speed = 0;
+    interrupts();
+}
+
+bool Stepper::target_reached()
+{
+    noInterrupts();
+    bool reached = target == current_position();
+    interrupts();
+
+    return reached;
+}
+
+uint32_t Stepper::get_current_position()
+{
+    noInterrupts();
+    int32_t steps = current_position();
+    interrupts();
+
+    return steps;
+}
+
+// Call with interrupts off.
+int32_t Stepper::current_position()
+{
+    return position + segment_direction * int32_t(step_generator_steps_issued());
+}
+
+void Stepper::set_profile(const motion_segment* segments, uint8_t count, int8_t direction)
+{
+    uint32_t steps = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        steps += segments[i].steps;
+    }
+
+    noInterrupts();
+    position += segment_direction * int32_t(step_generator_stop());
+    segment_direction = 0;
+    segment_steps = 0;
+
+    target = position + direction * int32_t(steps);
+    profile = segments;
+    profile_count = count;
+    profile_index = 0;
+    profile_steps_left = count ? segments[0].steps : 0;
+
+    start_segment();
+    interrupts();
+}
+
+// Call with interrupts off.
+void Stepper::restart_segment()
+{
+    // Keep the steps the running segment got out, then plan again from there.
+    position += segment_direction * int32_t(step_generator_stop());
+    segment_direction = 0;
+    segment_steps = 0;
+    profile_count = 0;
+
+    start_segment();
 }
 
+// Call with interrupts off.
+void Stepper::retime_segment(float old_speed)
+{
+    uint32_t interval_left = 0;
+    position += segment_direction * int32_t(step_generator_stop(&interval_left));
+    bool was_running = segment_direction != 0;
+    segment_direction = 0;
+    segment_steps = 0;
+    profile_count = 0;
+
+    /* A new segment waits a whole interval for its first step. The control loop changes
+     * the speed every tick, more often than a slow step comes round, so the step in
+     * progress goes on at the new speed: what was left of its interval, scaled.
+     */
+    if (was_running && interval_left && speed != 0) {
+        lead_in_ticks = uint32_t(interval_left * fabs(old_speed / speed) + 0.5f);
+        if (lead_in_ticks == 0) {
+            lead_in_ticks = 1;
+        }
+    }
+
+    start_segment();
+}
+
+void Stepper::start_segment()
+{
+    // Only the first segment after a retime has a lead in.
+    uint32_t lead_in = lead_in_ticks;
+    lead_in_ticks = 0;
+
+    // Not set up, e.g. the wiper motor is in use and owns Timer1.
+    if (hw_stepper != this) {
+        return;
+    }
+
+    int32_t distance = target - position;
+    if (distance == 0) {
+        return;
+    }
+
+    uint32_t steps = uint32_t(distance > 0 ? distance : -distance);
+    if (profile_index < profile_count) {
+        speed = profile[profile_index].speed;
+        steps = profile_steps_left;
+    }
+    if (speed == 0) {
+        return;
+    }
+
+    segment_direction = distance > 0 ? 1 : -1;
+    digitalWrite(STEPPER_DIRECTION_PIN, segment_direction > 0 ? HIGH : LOW);
+
+    uint32_t period_ticks = uint32_t(STEP_GENERATOR_TICK_HZ / fabs(speed) + 0.5);
+
+    // The step in progress on its own, segment_done() starts the rest at the full interval.
+    if (lead_in) {
+        period_ticks = lead_in;
+        steps = 1;
+    }
+    segment_steps = step_generator_start(period_ticks, steps);
+}
+
+// From the step generator interrupt, at the end of a segment.
+void Stepper::segment_done()
+{
+    Stepper* stepper = hw_stepper;
+
+    stepper->position += stepper->segment_direction * int32_t(stepper->segment_steps);
+
+    if (stepper->profile_index < stepper->profile_count) {
+        stepper->profile_steps_left -= stepper->segment_steps;
+        if (stepper->profile_steps_left == 0 && ++stepper->profile_index < stepper->profile_count) {
+            stepper->profile_steps_left = stepper->profile[stepper->profile_index].steps;
+        }
+    }
+
+    stepper->segment_direction = 0;
+    stepper->segment_steps = 0;
+
+    // Next segment of the profile, or the rest of one cut short to fit the timer.
+    stepper->start_segment();
+}
+
+#else
+
 // Service the Accelstepper driver.
 bool Stepper::run()
 {
-    return stepper_5718L.runSpeedToPosition();
+    bool stepped = stepper_5718L.runSpeedToPosition();
+
+    // On to the next profile segment once this one is done.
+    if (profile_index < profile_count && stepper_5718L.distanceToGo() == 0) {
+        if (++profile_index < profile_count) {
+            start_profile_segment();
+        }
+    }
+
+    return stepped;
 }
 
 // Run the stepper at a set speed
 void Stepper::set_speed(float steps_per_second)
 {
+    profile_count = 0;
     stepper_5718L.setSpeed(steps_per_second);
 }
 
@@ -50,6 +319,7 @@ void Stepper::home()
     /* Move the paddle through a full rev.
      * Home should be within this distance.
      */
+    profile_count = 0;
     stepper_5718L.move(TIMING_PULLEY_STEPS_PER_REV);
     stepper_5718L.setSpeed(STEPPER_HOMING_SPEED_IN_STEPS_SEC);
 }
@@ -59,6 +329,7 @@ void Stepper::home_expiration()
     /* Move the paddle through a full rev.
      * Home should be within this distance.
      */
+    profile_count = 0;
     stepper_5718L.move(-TIMING_PULLEY_STEPS_PER_REV);
     stepper_5718L.setSpeed(STEPPER_HOMING_SPEED_IN_STEPS_SEC);
 }
@@ -75,16 +346,19 @@ bool Stepper::remaining_steps_to_go()
 
 void Stepper::set_position(double steps)
 {
+    profile_count = 0;
     stepper_5718L.moveTo(steps);
 }
 
 void Stepper::set_position_relative(double steps)
 {
+    profile_count = 0;
     stepper_5718L.move(steps);
 }
 
 void Stepper::set_position_as_home(int32_t position)
 {
+    profile_count = 0;
     stepper_5718L.setCurrentPosition(position);
 }
 
@@ -94,12 +368,30 @@ bool Stepper::target_reached()
     return (distance_to_go == 0);
 }
 
-void Stepper::set_enable(bool en)
+uint32_t Stepper::get_current_position()
 {
-    digitalWrite(STEPPER_DISABLE_PIN, !(en));
+    return stepper_5718L.currentPosition();
 }
 
-uint32_t Stepper::get_current_position()
+void Stepper::set_profile(const motion_segment* segments, uint8_t count, int8_t direction)
 {
-    return stepper_5718L.currentPosition();
-}
\ No newline at end of file
+    profile = segments;
+    profile_count = count;
+    profile_index = 0;
+    profile_direction = direction;
+
+    if (count) {
+        start_profile_segment();
+    }
+}
+
+// Moves to the end of the current profile segment at its speed.
+void Stepper::start_profile_segment()
+{
+    const motion_segment& segment = profile[profile_index];
+
+    stepper_5718L.move(profile_direction * int32_t(segment.steps));
+    stepper_5718L.setSpeed(segment.speed);
+}
+
+#endif
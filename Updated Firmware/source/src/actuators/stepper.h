@@ -2,8 +2,11 @@
 #define UVENT_STEPPER_H
 
 #include "../../config/uvent_conf.h"
-#include <AccelStepper.h>
 #include <ams_as5048b.h>
+#include "motion_profile.h"
+#if !USE_HW_STEP_GENERATOR
+#include <AccelStepper.h>
+#endif
 
 class Stepper {
 public:
@@ -25,9 +28,54 @@ public:
     void set_enable(bool en);
     uint32_t get_current_position();
 
+    /* Runs a planned move, segment after segment, from the current position.
+     * The segments are not copied and must stay put until the move is done.
+     * Any of the calls above that set a target or speed cancel the rest of the move.
+     */
+    void set_profile(const motion_segment* segments, uint8_t count, int8_t direction);
+
 private:
+    // Planned move, if any. Done once profile_index reaches profile_count.
+    const motion_segment* profile = nullptr;
+    volatile uint8_t profile_count = 0;
+    volatile uint8_t profile_index = 0;
+
+#if USE_HW_STEP_GENERATOR
+    /* Moves run at constant speed, like AccelStepper::runSpeedToPosition(),
+     * or follow a profile.
+     * Each change of target or speed stops the running segment and starts a new
+     * one from wherever the motor got to. A change of speed alone keeps the phase
+     * of the step in progress, see retime_segment().
+     */
+    void restart_segment();
+    void retime_segment(float old_speed);
+    void start_segment();
+    int32_t current_position();
+    static void segment_done();
+
+    // Position at the start of the running segment, in steps.
+    volatile int32_t position = 0;
+    volatile int32_t target = 0;
+
+    // Steps per second. Only the magnitude is used, the direction comes from the target.
+    float speed = 0;
+
+    // Direction and length of the running segment, direction is 0 when stopped.
+    volatile int32_t segment_direction = 0;
+    volatile uint32_t segment_steps = 0;
+
+    // Steps of the current profile segment not yet handed to the generator.
+    volatile uint32_t profile_steps_left = 0;
+
+    // Interval before the next step of a retimed segment, in ticks. 0 for a whole interval.
+    uint32_t lead_in_ticks = 0;
+#else
+    void start_profile_segment();
+    int8_t profile_direction = 1;
+
     // Accelstepper object for Stepper 5718L
     AccelStepper stepper_5718L{AccelStepper::DRIVER, STEPPER_STEP_PIN, STEPPER_DIRECTION_PIN};
+#endif
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "volume_table.h"
+
+float volume_table_degrees_to_ml(const volume_table& table, float degrees)
+{
+    if (degrees <= 0) {
+        return 0;
+    }
+
+    float position = degrees / VOLUME_TABLE_STEP_DEG;
+    uint32_t point = (uint32_t) position;
+    if (point >= VOLUME_TABLE_POINTS - 1) {
+        return table.volume_ml[VOLUME_TABLE_POINTS - 1];
+    }
+
+    float start = table.volume_ml[point];
+    return start + (position - point) * (table.volume_ml[point + 1] - start);
+}
+
+float volume_table_ml_to_degrees(const volume_table& table, float volume_ml)
+{
+    if (volume_ml <= 0) {
+        return 0;
+    }
+    if (volume_ml >= table.volume_ml[VOLUME_TABLE_POINTS - 1]) {
+        return (VOLUME_TABLE_POINTS - 1) * VOLUME_TABLE_STEP_DEG;
+    }
+
+    // Find the points either side, volume_ml[low] <= volume_ml < volume_ml[high].
+    uint32_t low = 0;
+    uint32_t high = VOLUME_TABLE_POINTS - 1;
+    while (high - low > 1) {
+        uint32_t mid = (low + high) / 2;
+        if (table.volume_ml[mid] <= volume_ml) {
+            low = mid;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    float start = table.volume_ml[low];
+    return (low + (volume_ml - start) / (table.volume_ml[high] - start)) * VOLUME_TABLE_STEP_DEG;
+}
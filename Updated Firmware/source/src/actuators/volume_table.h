@@ -0,0 +1,53 @@
+#ifndef UVENT_VOLUME_TABLE_H
+#define UVENT_VOLUME_TABLE_H
+
+#include <Arduino.h>
+
+/* Bag volume against paddle angle, as a lookup table.
+ *
+ * The volume pushed out of the bag is measured every VOLUME_TABLE_STEP_DEG of
+ * paddle travel, from 0 up to MAX_ACT_POS_DEG. In between, and in the other
+ * direction, it is a straight line between the two nearest points. Both ways
+ * use the same points, so an angle worked out for a volume gives that volume
+ * back.
+ *
+ * Volumes have to go up with the angle, starting from 0 at home. The volume for
+ * an angle is an index and a multiply, the angle for a volume a binary search.
+ */
+
+// Points in a table, one every VOLUME_TABLE_STEP_DEG from 0 degrees.
+#define VOLUME_TABLE_POINTS 10
+#define VOLUME_TABLE_STEP_DEG 20
+
+struct volume_table {
+    uint16_t volume_ml[VOLUME_TABLE_POINTS];
+};
+
+/* Defaults, from Documentation/calibration transforms/deg vs volume.xlsx.
+ * Averages of the runs at 20 deg/s, measured with a Fluke Biomedical VT900A
+ * Gas Flow Analyzer. With no lung, and with a lung at a static compliance
+ * of 50 and 20 mL/cmH2O.
+ */
+constexpr volume_table VOLUME_TABLE_NO_LUNG = {{0, 3, 23, 109, 272, 472, 744, 1025, 1147, 1182}};
+constexpr volume_table VOLUME_TABLE_COMP_50 = {{0, 1, 12, 78, 218, 399, 613, 830, 983, 1062}};
+constexpr volume_table VOLUME_TABLE_COMP_20 = {{0, 1, 3, 33, 125, 269, 438, 606, 737, 812}};
+
+// True if the volumes start at 0 and go up at every point.
+constexpr bool volume_table_is_valid(const volume_table& table, int point = 1)
+{
+    return point == VOLUME_TABLE_POINTS
+            ? table.volume_ml[0] == 0
+            : table.volume_ml[point] > table.volume_ml[point - 1] && volume_table_is_valid(table, point + 1);
+}
+
+static_assert(volume_table_is_valid(VOLUME_TABLE_NO_LUNG), "VOLUME_TABLE_NO_LUNG must start at 0 and go up");
+static_assert(volume_table_is_valid(VOLUME_TABLE_COMP_50), "VOLUME_TABLE_COMP_50 must start at 0 and go up");
+static_assert(volume_table_is_valid(VOLUME_TABLE_COMP_20), "VOLUME_TABLE_COMP_20 must start at 0 and go up");
+
+// Volume in mL for an angle. Angles past the table give its last volume.
+float volume_table_degrees_to_ml(const volume_table& table, float degrees);
+
+// Angle for a volume in mL. Volumes past the table give its last angle.
+float volume_table_ml_to_degrees(const volume_table& table, float volume_ml);
+
+#endif
@@ -1,6 +1,7 @@
 #include "wiper.h"
 #include "../config/uvent_conf.h"
 #include "utilities/logging.h"
+#include "utilities/util.h"
 #include <Arduino.h>
 
 // Initialize the wiper motor.
@@ -33,12 +34,12 @@ bool Wiper::run()
     if (firstCycle == true)
     {
         digitalWrite(RELAY1_CONTROL_PIN, HIGH);
-        time1 = millis();
+        time1 = now_ms();
         relayOn = true;
         firstCycle = false;
     }
 
-    timeDiff = millis() - time1;
+    timeDiff = now_ms() - time1;
     if (timeDiff <= interval && firstLoop == false) // Run the wiper motor
     {
         return false;
@@ -53,7 +54,7 @@ bool Wiper::run()
         // Turn on Relay 2, wiper will finish current revolution due to park feature
         digitalWrite(RELAY2_CONTROL_PIN, HIGH);
 
-        timeDiff = millis() - time1;
+        timeDiff = now_ms() - time1;
 
         if (timeDiff <= interval)
         {
@@ -3,9 +3,43 @@
  */
 
 #include <Arduino.h>
+#include "utilities/util.h"
 #include "alarm.h"
 
-Alarm::Alarm(const String& default_text, const int& min_bad_to_trigger,
+struct alarm_def {
+    const char* text;
+    uint8_t min_bad_to_trigger;
+    uint8_t min_good_to_clear;
+    AlarmLevel alarm_level;
+};
+
+// By Indices. Texts stay in flash, the alarms only point at them.
+static constexpr alarm_def alarm_defs[NUM_ALARMS] = {
+        {"HIGH PRESSURE", 1, 2, EMERGENCY},
+        {"LOW PRES DISCONNECT", 1, 1, EMERGENCY},
+        {"HIGH RESIST PRESSURE", 1, 1, NOTIFY},
+        {"UNMET TIDAL VOLUME", 1, 1, EMERGENCY},
+        {"NO TIDAL PRESSURE", 2, 1, EMERGENCY},
+        {"OVER CURRENT FAULT", 1, 2, EMERGENCY},
+        {"MECHANICAL FAILURE", 1, 1, EMERGENCY},
+        {"CONFIRM? [RESET]", 1, 1, NOTIFY},
+        {"TURNING OFF", 1, 1, OFF_LEVEL}};
+
+constexpr size_t alarm_text_length(const char* text)
+{
+    return *text ? 1 + alarm_text_length(text + 1) : 0;
+}
+
+// Banner with every alarm ON, and the terminator.
+constexpr size_t alarm_banner_length(int index = 0)
+{
+    return index == NUM_ALARMS ? 1 : alarm_text_length(alarm_defs[index].text) + sizeof(ALARM_BANNER_SPACER) - 1 + alarm_banner_length(index + 1);
+}
+
+static_assert(alarm_banner_length() <= ALARM_BANNER_SIZE, "ALARM_BANNER_SIZE is too small for the alarm texts");
+static_assert(NUM_ALARMS <= 16, "AlarmManager::onMask() has a bit per alarm");
+
+Alarm::Alarm(const char* default_text, const int& min_bad_to_trigger,
              const int& min_good_to_clear, const AlarmLevel& alarm_level) : text_(default_text),
                                                                             min_bad_to_trigger_(min_bad_to_trigger),
                                                                             min_good_to_clear_(min_good_to_clear),
@@ -42,13 +76,22 @@ void Alarm::setCondition(const bool& bad, const unsigned long& seq)
     }
 }
 
-String AlarmManager::getText() const
+AlarmManager::AlarmManager(const int& speaker_pin, uint32_t const* cycle_count) : speaker_(speaker_pin),
+                                                                                 cycle_count_(cycle_count)
+{
+    for (int i = 0; i < NUM_ALARMS; i++) {
+        const alarm_def& def = alarm_defs[i];
+        alarms_[i] = Alarm(def.text, def.min_bad_to_trigger, def.min_good_to_clear, def.alarm_level);
+    }
+}
+
+const char* AlarmManager::getText() const
 {
     const int num_on = numON();
-    String text = "";
+    const char* text = "";
     if (num_on > 0) {
         // determine which of the on alarms to display
-        const int index = millis() % (num_on * kDisplayTime) / kDisplayTime;
+        const int index = now_ms() % (num_on * kDisplayTime) / kDisplayTime;
         int count_on = 0;
         int i;
         for (i = 0; i < NUM_ALARMS; i++) {
@@ -81,6 +124,44 @@ void AlarmManager::allOff()
     }
 }
 
+// Adds text at length, as much as fits. Returns the new length.
+static size_t banner_append(char* banner, size_t size, size_t length, const char* text)
+{
+    while (*text != '\0' && length + 1 < size) {
+        banner[length++] = *text++;
+    }
+    banner[length] = '\0';
+    return length;
+}
+
+const char* AlarmManager::getBanner()
+{
+    return getBanner(onMask());
+}
+
+const char* AlarmManager::getBanner(uint16_t mask)
+{
+    if (mask == banner_mask_) {
+        return banner_;
+    }
+    banner_mask_ = mask;
+
+    // With more than one, each is followed by the spacer, so the text scrolls round evenly.
+    const bool spacers = (mask & (mask - 1)) != 0;
+    size_t length = 0;
+    banner_[0] = '\0';
+    for (int i = 0; i < NUM_ALARMS; i++) {
+        if (!(mask & (1 << i))) {
+            continue;
+        }
+        length = banner_append(banner_, sizeof(banner_), length, alarms_[i].text());
+        if (spacers) {
+            length = banner_append(banner_, sizeof(banner_), length, ALARM_BANNER_SPACER);
+        }
+    }
+    return banner_;
+}
+
 int AlarmManager::numON() const
 {
     int num = 0;
@@ -90,6 +171,17 @@ int AlarmManager::numON() const
     return num;
 }
 
+uint16_t AlarmManager::onMask() const
+{
+    uint16_t mask = 0;
+    for (int i = 0; i < NUM_ALARMS; i++) {
+        if (alarms_[i].isON()) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
 AlarmLevel AlarmManager::getHighestLevel() const
 {
     AlarmLevel alarm_level = NO_ALARM;
@@ -16,7 +16,7 @@ class Alarm {
 public:
     Alarm(){};
 
-    Alarm(const String& default_text, const int& min_bad_to_trigger,
+    Alarm(const char* default_text, const int& min_bad_to_trigger,
           const int& min_good_to_clear, const AlarmLevel& alarm_level);
 
     // Reset to default state
@@ -31,16 +31,16 @@ public:
     inline const bool& isON() const { return on_; }
 
     // Get the text of this alarm
-    inline String text() const { return text_; }
+    inline const char* text() const { return text_; }
 
     // Get the alarm level of this alarm
     inline AlarmLevel alarmLevel() const { return alarm_level_; }
 
 private:
-    String text_;
-    uint8_t min_bad_to_trigger_;
-    uint8_t min_good_to_clear_;
-    AlarmLevel alarm_level_;
+    const char* text_ = "";
+    uint8_t min_bad_to_trigger_ = 1;
+    uint8_t min_good_to_clear_ = 1;
+    AlarmLevel alarm_level_ = NO_ALARM;
     bool on_ = false;
     uint8_t consecutive_bad_ = 0;
     uint8_t consecutive_good_ = 0;
@@ -61,6 +61,12 @@ enum Indices {
     TURNING_OFF,
     NUM_ALARMS
 };
+
+// Goes between the alarm texts in the banner.
+#define ALARM_BANNER_SPACER " -- "
+
+// Room for the text of every alarm with a spacer after each, checked in alarm.cpp.
+#define ALARM_BANNER_SIZE 256
 /**
  * AlarmManager
  * Manages multple alarms on the same screen space.
@@ -73,18 +79,8 @@ class AlarmManager {
     static const unsigned long kDisplayTime = 2 * 1000UL;
 
 public:
-    AlarmManager(const int& speaker_pin,
-                 unsigned long const* cycle_count) : speaker_(speaker_pin),
-                                                     cycle_count_(cycle_count)
-    {
-        alarms_[HIGH_PRESSU] = Alarm("HIGH PRESSURE", 1, 2, EMERGENCY);
-        alarms_[LOW_PRESSUR] = Alarm("LOW PRES DISCONNECT", 1, 1, EMERGENCY);
-        alarms_[BAD_PLATEAU] = Alarm("HIGH RESIST PRESSURE", 1, 1, NOTIFY);
-        alarms_[UNMET_VOLUM] = Alarm("UNMET TIDAL VOLUME", 1, 1, EMERGENCY);
-        alarms_[NO_TIDAL_PR] = Alarm("NO TIDAL PRESSURE", 2, 1, EMERGENCY);
-        alarms_[OVER_CURREN] = Alarm("OVER CURRENT FAULT", 1, 2, EMERGENCY);
-        alarms_[MECH_FAILUR] = Alarm("MECHANICAL FAILURE", 1, 1, EMERGENCY);
-    }
+    // Alarms are set up from the table in alarm.cpp.
+    AlarmManager(const int& speaker_pin, uint32_t const* cycle_count);
 
     // Setup during arduino setup()
     void begin();
@@ -166,12 +162,22 @@ public:
     void snooze();
     void disable_snooze();
 
-    // Get text to display
-    String getText() const;
+    // Get text to display, one alarm at a time. Empty if no alarm is ON.
+    const char* getText() const;
+
+    // Get the text of every alarm that is ON, one after the other, for the alert box.
+    // Only rebuilt when the alarms that are ON change, no allocation.
+    const char* getBanner();
+
+    // The same for the alarms in mask, a bit per alarm as from onMask(), ON or not.
+    const char* getBanner(uint16_t mask);
 
     // Get number of alarms that are ON
     int numON() const;
 
+    // Get a bit per alarm, by Indices, set if it is ON
+    uint16_t onMask() const;
+
     inline Alarm* getAlarmList()
     {
         return alarms_;
@@ -181,7 +187,11 @@ private:
     Speaker speaker_;
 
     Alarm alarms_[NUM_ALARMS];
-    unsigned long const* cycle_count_;
+    uint32_t const* cycle_count_;
+
+    // Alarms the banner was last built for
+    uint16_t banner_mask_ = 0;
+    char banner_[ALARM_BANNER_SIZE] = "";
 
     // Get highest priority level of the alarms that are ON
     AlarmLevel getHighestLevel() const;
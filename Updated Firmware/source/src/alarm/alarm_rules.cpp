@@ -0,0 +1,135 @@
+#include "alarm_rules.h"
+#include "utilities/perf.h"
+
+static constexpr alarm_rule alarm_rules[] = {
+        {HIGH_PRESSU, Alarm_Signal::PRESSURE, Alarm_Cadence::SAMPLE, Alarm_Compare::ABOVE, q16_from_double(ALARM_HIGH_PRESSURE_CMH2O)},
+        {LOW_PRESSUR, Alarm_Signal::PIP, Alarm_Cadence::BREATH, Alarm_Compare::BELOW, q16_from_double(ALARM_LOW_PIP_CMH2O)},
+        {BAD_PLATEAU, Alarm_Signal::RESISTIVE_PRESSURE, Alarm_Cadence::BREATH, Alarm_Compare::ABOVE, q16_from_double(ALARM_MAX_RESISTIVE_CMH2O)},
+        {UNMET_VOLUM, Alarm_Signal::VTI_SHORTFALL, Alarm_Cadence::BREATH, Alarm_Compare::ABOVE, q16_from_double(ALARM_UNMET_VOLUME_PERCENT)},
+        {NO_TIDAL_PR, Alarm_Signal::DRIVING_PRESSURE, Alarm_Cadence::BREATH, Alarm_Compare::BELOW, q16_from_double(ALARM_MIN_DRIVING_CMH2O)},
+};
+
+#define ALARM_RULE_COUNT (sizeof(alarm_rules) / sizeof(alarm_rule))
+
+// Only the pressure is there for every sample, the rest is per breath.
+constexpr bool alarm_rule_is_valid(const alarm_rule& rule)
+{
+    return rule.alarm < NUM_ALARMS &&
+           (rule.signal == Alarm_Signal::PRESSURE) == (rule.cadence == Alarm_Cadence::SAMPLE);
+}
+
+constexpr bool alarm_rules_are_valid(uint32_t index = 0)
+{
+    return index == ALARM_RULE_COUNT || (alarm_rule_is_valid(alarm_rules[index]) && alarm_rules_are_valid(index + 1));
+}
+
+static_assert(alarm_rules_are_valid(), "An alarm rule has a signal that isn't measured at its cadence");
+
+void AlarmRules::update()
+{
+    PerfScope perf(Perf_Probe::ALARM_RULES);
+
+    const breath_record& breath = p_breath_analyzer->get_last_breath();
+
+    if (p_breath_analyzer->get_phase() == Breath_Phase::NONE) {
+        samples_bad = 0;
+        last_breath_number = breath.number;
+        return;
+    }
+
+    Alarm* alarms = p_alarm_manager->getAlarmList();
+
+    if (p_breath_analyzer->get_update_samples() > 0) {
+        update_samples(alarms);
+    }
+
+    if (breath.number != last_breath_number) {
+        last_breath_number = breath.number;
+        update_breath(alarms, breath);
+    }
+}
+
+void AlarmRules::update_samples(Alarm* alarms)
+{
+    const q16_t max_pressure = p_breath_analyzer->get_update_max_pressure();
+    const q16_t min_pressure = p_breath_analyzer->get_update_min_pressure();
+
+    sample_seq++;
+
+    uint16_t bad = 0;
+    for (const alarm_rule& rule : alarm_rules) {
+        if (rule.cadence != Alarm_Cadence::SAMPLE) {
+            continue;
+        }
+        if (rule.compare == Alarm_Compare::ABOVE ? max_pressure > rule.threshold : min_pressure < rule.threshold) {
+            bad |= 1 << rule.alarm;
+        }
+    }
+
+    for (int i = 0; i < NUM_ALARMS; i++) {
+        if (bad & (1 << i)) {
+            alarms[i].setCondition(true, sample_seq);
+        }
+    }
+    samples_bad |= bad;
+}
+
+void AlarmRules::update_breath(Alarm* alarms, const breath_record& breath)
+{
+    uint16_t checked = 0;
+    uint16_t bad = 0;
+    for (const alarm_rule& rule : alarm_rules) {
+        checked |= 1 << rule.alarm;
+        if (rule.cadence != Alarm_Cadence::BREATH) {
+            continue;
+        }
+        float value = breath_signal(rule.signal, breath);
+        float threshold = q16_to_float(rule.threshold);
+        if (rule.compare == Alarm_Compare::ABOVE ? value > threshold : value < threshold) {
+            bad |= 1 << rule.alarm;
+        }
+    }
+
+    // A bad sample this breath has counted already, and keeps the alarm from counting as good.
+    for (int i = 0; i < NUM_ALARMS; i++) {
+        uint16_t bit = 1 << i;
+        if (!(checked & bit)) {
+            continue;
+        }
+        if (bad & bit) {
+            alarms[i].setCondition(true, breath.number);
+        }
+        else if (!(samples_bad & bit)) {
+            alarms[i].setCondition(false, breath.number);
+        }
+    }
+    samples_bad = 0;
+}
+
+float AlarmRules::breath_signal(Alarm_Signal signal, const breath_record& breath) const
+{
+    switch (signal) {
+        case Alarm_Signal::PIP:
+            return breath.pip;
+        case Alarm_Signal::PLATEAU:
+            return breath.plateau;
+        case Alarm_Signal::PEEP:
+            return breath.peep;
+        case Alarm_Signal::RESISTIVE_PRESSURE:
+            return breath.pip - breath.plateau;
+        case Alarm_Signal::DRIVING_PRESSURE:
+            return breath.plateau - breath.peep;
+        case Alarm_Signal::VTI_SHORTFALL: {
+            float set_ml = p_waveform->get_params()->volume_ml;
+            return volume_controlled && set_ml > 0 ? 100.0f * (set_ml - breath.vti_ml) / set_ml : 0;
+        }
+        case Alarm_Signal::VTE:
+            return breath.vte_ml;
+        case Alarm_Signal::MINUTE_VOLUME:
+            return breath.minute_volume_l;
+        case Alarm_Signal::RR:
+            return breath.rr;
+        default:
+            return 0;
+    }
+}
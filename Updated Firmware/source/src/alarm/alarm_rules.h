@@ -0,0 +1,92 @@
+#ifndef UVENT_ALARM_RULES_H
+#define UVENT_ALARM_RULES_H
+
+#include "../config/uvent_conf.h"
+#include "alarm.h"
+#include "controls/waveform.h"
+#include "sensors/breath_analyzer.h"
+
+/* Drives the alarms from the measurements, by a table of rules.
+ *
+ * A rule is an alarm, a signal, which side of a threshold is bad, and when it
+ * is checked: on every sample, or once a breath. The table is in alarm_rules.cpp,
+ * adding an alarm is adding a row there (and its text to the alarm table), the
+ * state machine doesn't change.
+ *
+ * Sample rules run on the pressure range of the samples the breath analyzer
+ * took since the last tick, so a short peak between ticks isn't missed. A bad
+ * sample counts towards the alarm straight away; the alarm only counts as good
+ * again once a whole breath went by without one. Breath rules run on the
+ * breath_record, as soon as the breath analyzer closes a breath.
+ * Debounce and priority are the alarm's own: its min_bad_to_trigger_ and
+ * min_good_to_clear_, and its level. An alarm with more than one rule is bad
+ * if any of them is.
+ *
+ * Nothing is checked while not ventilating. Cost is a pass over the sample
+ * rules per tick, and over the breath rules once a breath, timed by the
+ * ALARM_RULES perf probe.
+ */
+
+enum class Alarm_Signal {
+    PRESSURE,          // Airway pressure, per sample (cmH2O)
+    PIP,               // cmH2O
+    PLATEAU,           // cmH2O
+    PEEP,              // cmH2O
+    RESISTIVE_PRESSURE,// PIP - plateau (cmH2O)
+    DRIVING_PRESSURE,  // Plateau - PEEP (cmH2O)
+    VTI_SHORTFALL,     // Set volume not breathed in, % of the set volume. 0 unless volume controlled
+    VTE,               // mL
+    MINUTE_VOLUME,     // L/min
+    RR                 // Breaths/min
+};
+
+enum class Alarm_Cadence {
+    SAMPLE,
+    BREATH
+};
+
+enum class Alarm_Compare {
+    ABOVE,// Bad above the threshold
+    BELOW // Bad below the threshold
+};
+
+struct alarm_rule {
+    Indices alarm;
+    Alarm_Signal signal;
+    Alarm_Cadence cadence;
+    Alarm_Compare compare;
+    q16_t threshold;
+};
+
+class AlarmRules {
+public:
+    AlarmRules(AlarmManager* alarm_manager, BreathAnalyzer* breath_analyzer, Waveform* waveform)
+        : p_alarm_manager(alarm_manager), p_breath_analyzer(breath_analyzer), p_waveform(waveform){};
+
+    // Checks the rules against what was measured this tick. Call from the control handler, after the state machine.
+    void update();
+
+    // Whether the set volume is the target of the breaths, or only a limit as in PCV.
+    void set_volume_controlled(bool controlled) { volume_controlled = controlled; }
+
+private:
+    void update_samples(Alarm* alarms);
+    void update_breath(Alarm* alarms, const breath_record& breath);
+    float breath_signal(Alarm_Signal signal, const breath_record& breath) const;
+
+    AlarmManager* p_alarm_manager;
+    BreathAnalyzer* p_breath_analyzer;
+    Waveform* p_waveform;
+
+    // Counts the ticks, the sequence for the sample rules.
+    uint32_t sample_seq = 0;
+
+    // Alarms a sample was bad for, this breath. A bit per alarm, by Indices.
+    uint16_t samples_bad = 0;
+
+    uint32_t last_breath_number = 0;
+
+    bool volume_controlled = true;
+};
+
+#endif//UVENT_ALARM_RULES_H
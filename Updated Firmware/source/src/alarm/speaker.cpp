@@ -36,7 +36,7 @@ void Speaker::update(const AlarmLevel& alarm_level)
         toggleSnooze();
     }
     // check if snooze time is up
-    if (snoozed_ && millis() - snooze_time_ > kSnoozeTime) {
+    if (snoozed_ && now_ms() - snooze_time_ > kSnoozeTime) {
         snoozed_ = false;
         if (snooze_complete_cb) {
             snooze_complete_cb();
@@ -67,7 +67,7 @@ void Speaker::toggleSnooze()
     else {
         snoozed_ = true;
 
-        snooze_time_ = millis();
+        snooze_time_ = now_ms();
         Serial.println("Snooze true");
     }
 }
@@ -9,6 +9,7 @@
 #define UVENT_TONE_H
 
 #include <Arduino.h>
+#include "utilities/util.h"
 #include "tone_driver.h"
 #include "note.h"
 
@@ -30,12 +31,12 @@ public:
             return;
         }
         if (!playing_) {// Do once when tone starts
-            tone_timer_ = millis();
+            tone_timer_ = now_ms();
             tone_step_ = 0;
             playing_ = true;
         }
         tone_step_ %= length_;// Start again if tone finished
-        if (millis() > tone_timer_) {
+        if (now_ms() > tone_timer_) {
             tone_rrb(*pin_, notes_[tone_step_].note, notes_[tone_step_].duration);
             tone_timer_ += notes_[tone_step_].duration + notes_[tone_step_].pause;
             tone_step_++;
@@ -0,0 +1,120 @@
+#include "chart_feed.h"
+#include "sensors/adc_sampler.h"
+
+static_assert((CHART_FEED_QUEUE_COLUMNS & (CHART_FEED_QUEUE_COLUMNS - 1)) == 0, "CHART_FEED_QUEUE_COLUMNS must be a power of 2");
+
+// Most samples taken in one tick, more than one control tick's worth.
+#define CHART_FEED_MAX_SAMPLES 32
+
+// Nearest whole unit, clamped to what a chart holds.
+static int16_t q16_to_chart(q16_t value)
+{
+    int32_t units = (value + (Q16_ONE >> 1)) >> 16;
+    if (units > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (units < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t) units;
+}
+
+void ChartFeed::update()
+{
+    uint32_t rate_hz = adc_sampler_running() ? ADC_SAMPLER_RATE_HZ : 1000000UL / CONTROL_HANDLER_PERIOD_US;
+    for (auto& channel : channels) {
+        if (channel.reconfigure) {
+            channel.decimator.configure((uint64_t) rate_hz * channel.sweep_ms / 1000, channel.columns);
+            channel.reconfigure = false;
+        }
+    }
+
+    feed_channel& pressure = channels[(uint8_t) Chart_Feed_Channel::PRESSURE];
+    feed_channel& flow = channels[(uint8_t) Chart_Feed_Channel::FLOW];
+
+    if (!adc_sampler_running()) {
+        // No sampler, one reading per control tick.
+        add_sample(pressure, p_gauge_sensor->get_pressure_q16<Units_pressure::cmH20>());
+        add_sample(flow, p_diff_sensor->get_flow_q16<Units_flow::lpm, Order_type::third>(true));
+        return;
+    }
+
+#if USE_ADC_SAMPLER
+    adc_sample_pair pairs[CHART_FEED_MAX_SAMPLES];
+    for (;;) {
+        uint32_t count = adc_sampler_read_pairs(next_sample, pairs, CHART_FEED_MAX_SAMPLES);
+        if (count == 0) {
+            break;
+        }
+
+        /* Every sample goes in, not only the extremes of the counts: flow
+         * is a polynomial of them, reversed, so their lowest isn't always its lowest.
+         */
+        for (uint32_t i = 0; i < count; i++) {
+            add_sample(pressure, pairs[i].pressure);
+            add_sample(flow, pairs[i].flow);
+        }
+    }
+#endif
+}
+
+void ChartFeed::add_sample(feed_channel& channel, q16_t value)
+{
+    q16_t column_min;
+    q16_t column_max;
+    uint32_t finished = channel.decimator.add(value, column_min, column_max);
+    if (finished == 0) {
+        return;
+    }
+
+    chart_column column = {q16_to_chart(column_min), q16_to_chart(column_max)};
+    uint32_t head = channel.queue_head;
+    for (uint32_t i = 0; i < finished; i++) {
+        if (head - channel.queue_tail >= CHART_FEED_QUEUE_COLUMNS) {
+            dropped += finished - i;
+            break;
+        }
+        channel.queue[head & (CHART_FEED_QUEUE_COLUMNS - 1)] = column;
+        head++;
+    }
+    __sync_synchronize();
+    channel.queue_head = head;
+}
+
+void ChartFeed::set_sweep(Chart_Feed_Channel channel, uint16_t columns, uint32_t sweep_ms)
+{
+    feed_channel& feed = channels[(uint8_t) channel];
+
+    // The control handler only reads these once reconfigure is set.
+    feed.reconfigure = false;
+    __sync_synchronize();
+    feed.columns = columns;
+    feed.sweep_ms = sweep_ms;
+    __sync_synchronize();
+    feed.reconfigure = true;
+    __sync_synchronize();
+
+    // Columns cut for the old sweep.
+    feed.queue_tail = feed.queue_head;
+}
+
+uint32_t ChartFeed::read(Chart_Feed_Channel channel, chart_column* out, uint32_t max_columns)
+{
+    feed_channel& feed = channels[(uint8_t) channel];
+    if (feed.reconfigure) {
+        return 0;
+    }
+
+    uint32_t tail = feed.queue_tail;
+    uint32_t queued = feed.queue_head - tail;
+    __sync_synchronize();
+    if (queued > max_columns) {
+        queued = max_columns;
+    }
+    for (uint32_t i = 0; i < queued; i++) {
+        out[i] = feed.queue[(tail + i) & (CHART_FEED_QUEUE_COLUMNS - 1)];
+    }
+    __sync_synchronize();
+    feed.queue_tail = tail + queued;
+    return queued;
+}
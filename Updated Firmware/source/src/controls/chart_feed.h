@@ -0,0 +1,88 @@
+#ifndef UVENT_CHART_FEED_H
+#define UVENT_CHART_FEED_H
+
+#include "../config/uvent_conf.h"
+#include "sensors/pressure_sensor.h"
+#include "utilities/min_max_decimator.h"
+#include <Arduino.h>
+
+/* Pressure and flow for the charts, at the sampling rate instead of one reading per poll.
+ *
+ * update() takes every sample the ADC sampler made since the last tick, converted
+ * (one reading per tick without the sampler), and cuts the stream into
+ * one column per pixel of the chart with a MinMaxDecimator, so a sweep across
+ * the chart takes its time base. Finished columns are queued in RAM, and the
+ * readout task takes them with read() and draws each from its lowest to its
+ * highest value. A peak shorter than the poll interval still shows.
+ *
+ * Nothing is decimated until set_sweep() gives the chart's columns and time base.
+ * If the queue is full, because loop() fell behind, new columns are dropped.
+ */
+
+#define CHART_FEED_CHANNELS 2
+
+enum class Chart_Feed_Channel : uint8_t {
+    PRESSURE = 0,// cmH2O
+    FLOW = 1     // L/min
+};
+
+/**
+ * A column in chart units.
+ */
+struct chart_column {
+    int16_t min;
+    int16_t max;
+};
+
+class ChartFeed {
+public:
+    ChartFeed(PressureSensor* gauge_sensor, PressureSensor* diff_sensor)
+        : p_gauge_sensor(gauge_sensor), p_diff_sensor(diff_sensor){};
+
+    // Decimates this tick's samples. Call from the control handler.
+    void update();
+
+    /**
+     * Sets the columns across the chart and the time one sweep takes, from loop().
+     * Queued columns are dropped, the change is made on the next update().
+     */
+    void set_sweep(Chart_Feed_Channel channel, uint16_t columns, uint32_t sweep_ms);
+
+    // Columns and time base set for the channel, 0 if not set yet.
+    uint16_t get_columns(Chart_Feed_Channel channel) const { return channels[(uint8_t) channel].columns; }
+    uint32_t get_sweep_ms(Chart_Feed_Channel channel) const { return channels[(uint8_t) channel].sweep_ms; }
+
+    /**
+     * Takes finished columns off the queue, oldest first. Call from loop().
+     * @return The number copied to out.
+     */
+    uint32_t read(Chart_Feed_Channel channel, chart_column* out, uint32_t max_columns);
+
+    uint32_t get_dropped() const { return dropped; }
+
+private:
+    struct feed_channel {
+        MinMaxDecimator decimator;
+        uint16_t columns = 0;
+        uint32_t sweep_ms = 0;
+        volatile bool reconfigure = false;
+
+        // Written by update(), read by read().
+        chart_column queue[CHART_FEED_QUEUE_COLUMNS];
+        volatile uint32_t queue_head = 0;
+        volatile uint32_t queue_tail = 0;
+    };
+
+    void add_sample(feed_channel& channel, q16_t value);
+
+    PressureSensor* p_gauge_sensor;
+    PressureSensor* p_diff_sensor;
+
+    feed_channel channels[CHART_FEED_CHANNELS];
+
+    uint32_t next_sample = 0;
+
+    volatile uint32_t dropped = 0;
+};
+
+#endif
@@ -4,43 +4,25 @@
 #include "../config/uvent_conf.h"
 #include "actuators/actuator.h"
 #include "eeprom/storage.h"
+#include "eeprom/black_box.h"
 #include "sensors/pressure_sensor.h"
+#include "sensors/adc_sampler.h"
+#include "sensors/breath_analyzer.h"
 #include "waveform.h"
 #include "alarm/alarm.h"
+#include "alarm/alarm_rules.h"
+#include "utilities/perf.h"
+#include "utilities/seqlock.h"
+#include "utilities/spsc_queue.h"
+#include "telemetry.h"
+#include "chart_feed.h"
 #include <AccelStepper.h>
 #include <DueTimer.h>
 #include <ams_as5048b.h>
 #include <display/screens/screen.h>
 #include <display/layouts/layouts.h>
 
-#include "pcvmachine.h"
-#include "pressurePID.h"
-
-// PID Controller Instance
-// PressurePID pid;
-
 // Instance to control the paddle
-
-// const double Kp = 0.0011;       // VALUES OBTAINED FROM A RESEARCH PAPER
-// const double Ki = 0.012;
-// const double Kd = 0.000015;
-
-// const double Kp = 1.0;       // TEST VALUES
-// const double Ki = 0.0;
-// const double Kd = 0.0;
-
-// float prevError = 0;
-// float prevIntegral = 0;
-// float bias = 0;
-
-// // Used for timing purposes
-// bool firstPID = true;
-// float timeSincePID = 0;
-
-// float target = 15.0;
-
-// bool startPID = false;
-
 Actuator actuator;
 
 // Storage instance
@@ -51,6 +33,10 @@ PressureSensor gauge_sensor = {PRESSURE_GAUGE_PIN};
 
 // Differential Pressure Sensor instance
 PressureSensor diff_sensor = {PRESSURE_DIFF_PIN};
+
+// Per breath measurements from the pressure and flow
+BreathAnalyzer breath_analyzer = {&gauge_sensor, &diff_sensor};
+
 // Waveform instance
 Waveform waveform;
 
@@ -59,17 +45,59 @@ uint32_t cycle_count = 0;
 // Alarms
 AlarmManager alarm_manager{SPEAKER_PIN, &cycle_count};
 
+// Drives the alarms from the measurements
+AlarmRules alarm_rules(&alarm_manager, &breath_analyzer, &waveform);
+
 /* State machine instance. Takes in a pointer to actuator
  * as there are actuator commands within the state machine.
  */
-Machine machine(States::ST_STARTUP, &actuator, &waveform, &gauge_sensor, &alarm_manager, &cycle_count);
-PCVMachine pcvMachine(States::ST_STARTUP, &actuator, &waveform, &gauge_sensor, &alarm_manager, &cycle_count);
+Machine machine(States::ST_STARTUP, &actuator, &waveform, &gauge_sensor, &breath_analyzer, &alarm_manager, &cycle_count);
+
+// Binary telemetry stream, off until asked for.
+Telemetry telemetry(&machine, &actuator, &gauge_sensor, &diff_sensor, &waveform, &cycle_count);
+
+// Breaths, alarms and faults kept on the EEPROM across power cycles.
+BlackBox black_box(&machine, &breath_analyzer, &alarm_manager);
+
+// Sampled pressure and flow, a column per chart pixel.
+ChartFeed chart_feed(&gauge_sensor, &diff_sensor);
+
+// Written by the control handler, read by loop().
+static SeqLock<waveform_params> waveform_snapshot;
+static SeqLock<control_status> status_snapshot;
+static SpscQueue<state_transition, CONTROL_TRANSITION_QUEUE_ENTRIES> state_transitions;
+
+/* Publishes the tick's waveform parameters and status, and queues a state change.
+ * From the control handler, or loop() in a build without one.
+ */
+static void publish_snapshots()
+{
+    static bool published = false;
+    static States last_state;
+
+    control_status status;
+    status.state = machine.get_current_state();
+    status.alarm_mask = alarm_manager.onMask();
+    status.alarm_count = alarm_manager.numON();
+    status.cycle_count = cycle_count;
+
+    if (published && status.state != last_state) {
+        state_transitions.push({now_ms(), last_state, status.state});
+    }
+    last_state = status.state;
+    published = true;
+
+    waveform_snapshot.write(*waveform.get_params());
+    status_snapshot.write(status);
+}
 
 
 // Bool to keep track of the alert box
 static bool alert_box_already_visible = false;
 
-void loop_test_readout(lv_timer_t* timer)
+static void handle_state_changes();
+
+void loop_test_readout(MainScreen* screen)
 {
 
     static bool timer_delay_complete = false;
@@ -78,7 +106,7 @@ void loop_test_readout(lv_timer_t* timer)
     static uint32_t last_readout_refresh = 0;
 
     // Don't poll the sensors before we're sure everything's had a chance to init
-    if (!timer_delay_complete && (millis() >= SENSOR_POLL_STARTUP_DELAY)) {
+    if (!timer_delay_complete && (now_ms() >= SENSOR_POLL_STARTUP_DELAY)) {
         timer_delay_complete = true;
 
         // Set some dummy alarms
@@ -90,7 +118,7 @@ void loop_test_readout(lv_timer_t* timer)
         alarm_manager.update();
     }
     if (!timer_delay_complete) {
-        LV_LOG_TRACE("Timer is not ready yet, returning (%d)", millis());
+        LV_LOG_TRACE("Timer is not ready yet, returning (%d)", now_ms());
         return;
     }
 
@@ -103,8 +131,8 @@ void loop_test_readout(lv_timer_t* timer)
     }
 #endif
 
-    // Main screen, passed through via user data in main.cpp
-    auto* screen = static_cast<MainScreen*>(timer->user_data);
+    // No control handler runs in this build, the dummy alarms are published from here.
+    publish_snapshots();
 
     // Check for errors
     handle_alerts();
@@ -152,19 +180,38 @@ void loop_test_readout(lv_timer_t* timer)
     screen->try_refresh_charts();
 }
 
-void loop_update_readouts(lv_timer_t* timer)
+/* Moves the columns finished since the last poll into a chart with a time base.
+ * Until the feed has the chart's width and time base, sets them instead.
+ */
+static void feed_chart(SensorChart* chart, Chart_Feed_Channel channel)
+{
+    if (chart->columns != chart_feed.get_columns(channel) || chart->time_base_ms != chart_feed.get_sweep_ms(channel)) {
+        chart_feed.set_sweep(channel, chart->columns, chart->time_base_ms);
+        return;
+    }
+
+    chart_column columns[CHART_FEED_QUEUE_COLUMNS];
+    uint32_t count = chart_feed.read(channel, columns, CHART_FEED_QUEUE_COLUMNS);
+    for (uint32_t i = 0; i < count; i++) {
+        chart->add_column(columns[i].min, columns[i].max);
+    }
+}
+
+void loop_update_readouts(MainScreen* screen)
 {
+    PerfScope perf(Perf_Probe::UPDATE_READOUTS);
+
     static bool timer_delay_complete = false;
 
     // Internal timers, components might have different refresh times
     static uint32_t last_readout_refresh = 0;
 
     // Don't poll the sensors before we're sure everything's had a chance to init
-    if (!timer_delay_complete && (millis() >= SENSOR_POLL_STARTUP_DELAY)) {
+    if (!timer_delay_complete && (now_ms() >= SENSOR_POLL_STARTUP_DELAY)) {
         timer_delay_complete = true;
     }
     if (!timer_delay_complete) {
-        LV_LOG_TRACE("Timer is not ready yet, returning (%d)", millis());
+        LV_LOG_TRACE("Timer is not ready yet, returning (%d)", now_ms());
         return;
     }
 
@@ -177,87 +224,48 @@ void loop_update_readouts(lv_timer_t* timer)
     }
 #endif
 
-    // Main screen, passed through via user data in main.cpp
-    auto* screen = static_cast<MainScreen*>(timer->user_data);
-
     // Check for errors
     handle_alerts();
 
     // Poll gauge sensor, add point to graph and update readout obj.
     // Will not refresh until explicitly told
 
-    // JOSH PRESSURE could take this value, compare it to a target, then call a function to adjust adjustable values to reduce/increase pressure
     double cur_pressure = control_get_gauge_pressure();
 
-    // will probably have to change how timing works, first calculation may be uneccesarily massive, could limit speed too and leave timing maybe
-
-    if(pcvMachine.get_last_state() == States::ST_OFF && pcvMachine.get_current_state() == States::ST_INSPR)
-    {
-        pcvMachine.startPID = true;
+    // Charts with a time base plot the sampled pressure, the others a point per poll.
+    SensorChart* pressure_chart = screen->get_chart(CHART_IDX_PRESSURE);
+    if (pressure_chart->time_base_ms) {
+        feed_chart(pressure_chart, Chart_Feed_Channel::PRESSURE);
     }
-    
-    // if(pcvMachine.startPID == true)
-    // {
-        if(pcvMachine.firstPID == true)
-        {
-            float error = pcvMachine.target - cur_pressure;
-            float integral = pcvMachine.prevIntegral + error;           // MOVE OUT OF HERE AND INTO PCVMACHINE.CPP ONCE VALUES MAKE SENSE
-            float derivative = (error - pcvMachine.prevError);
-             
-            // double output = Kp*error + Ki*integral + Kd*derivative + bias;
-            double output = pcvMachine.Kp*error + pcvMachine.Ki*integral + pcvMachine.Kd*derivative + pcvMachine.bias;
-
-            pcvMachine.prevError = error;
-            pcvMachine.prevIntegral = integral;
-
-            screen->get_chart(CHART_IDX_PRESSURE)->add_data_point(output);      // STOPPING THE SCREEN FROM TURNING ON
-            set_readout(AdjValueType::CUR_PRESSURE, output);
-
-            pcvMachine.firstPID = false;
-            pcvMachine.timeSincePID = millis();
-        }
-
-        else
-        {
-            float error = pcvMachine.target - cur_pressure;
-            float integral = pcvMachine.prevIntegral + (error * (millis() - pcvMachine.timeSincePID));           // ERROR WILL KEEP GETTING MORE MASSIVE UNLESS PRESSURE GOES OVER TARGET
-            float derivative = (error - pcvMachine.prevError) / (millis() - pcvMachine.timeSincePID);
-            
-            float output = pcvMachine.Kp*error + pcvMachine.Ki*integral + pcvMachine.Kd*derivative + pcvMachine.bias;
-
-            pcvMachine.prevError = error;
-            pcvMachine.prevIntegral = integral;
-
-            screen->get_chart(CHART_IDX_PRESSURE)->add_data_point(output);
-            set_readout(AdjValueType::CUR_PRESSURE, output);
-
-            pcvMachine.timeSincePID = millis();
-        }  
-    // } 
-
-    if(machine.get_current_state() == States::ST_OFF)
-    {
-        pcvMachine.startPID = false;
+    else {
+        pressure_chart->add_data_point(cur_pressure);
     }
+    set_readout(AdjValueType::CUR_PRESSURE, cur_pressure);
 
-
-    // screen->get_chart(CHART_IDX_PRESSURE)->add_data_point(cur_pressure);                // IMPORTANT JOSH PRESSURE, UNCOMMENT IF WANT PRESSURE PRINTED
-    // set_readout(AdjValueType::CUR_PRESSURE, cur_pressure);
+    handle_state_changes();
 
     // Poll sensors, update readout obj.
     // Will not refresh until explicitly told
     // Waveform parameters
-    waveform_params* p_wave_params = control_get_waveform_params();
-    set_readout(AdjValueType::TIDAL_VOLUME, p_wave_params->m_tidal_volume);   // JOSH PRESSURE
-    set_readout(AdjValueType::RESPIRATION_RATE, p_wave_params->m_rr);
-    set_readout(AdjValueType::IE_RATIO_LEFT, p_wave_params->m_ie_i);
-    set_readout(AdjValueType::IE_RATIO_RIGHT, p_wave_params->m_ie_e);
-    set_readout(AdjValueType::PEEP, p_wave_params->m_peep);
-    set_readout(AdjValueType::PIP, p_wave_params->m_pip);
-    set_readout(AdjValueType::PLAT_PRESSURE, p_wave_params->m_plateau_press);
+    // From one tick, never half way through the control handler updating them.
+    waveform_params wave_params;
+    control_get_waveform_snapshot(wave_params);
+    set_readout(AdjValueType::TIDAL_VOLUME, wave_params.m_tidal_volume);   // JOSH PRESSURE
+    set_readout(AdjValueType::RESPIRATION_RATE, wave_params.m_rr);
+    set_readout(AdjValueType::IE_RATIO_LEFT, wave_params.m_ie_i);
+    set_readout(AdjValueType::IE_RATIO_RIGHT, wave_params.m_ie_e);
+    set_readout(AdjValueType::PEEP, wave_params.m_peep);
+    set_readout(AdjValueType::PIP, wave_params.m_pip);
+    set_readout(AdjValueType::PLAT_PRESSURE, wave_params.m_plateau_press);
 
     double cur_flow = diff_sensor.get_flow(units_flow::lpm, true, Order_type::third);
-    screen->get_chart(CHART_IDX_FLOW)->add_data_point(cur_flow);
+    SensorChart* flow_chart = screen->get_chart(CHART_IDX_FLOW);
+    if (flow_chart->time_base_ms) {
+        feed_chart(flow_chart, Chart_Feed_Channel::FLOW);
+    }
+    else {
+        flow_chart->add_data_point(cur_flow);
+    }
     set_readout(AdjValueType::FLOW, cur_flow);
 
     // TODO add more sensors HERE
@@ -277,13 +285,34 @@ void loop_update_readouts(lv_timer_t* timer)
     screen->try_refresh_charts();
 }
 
+/* State changes since the last poll, in order. Logged, none is missed
+ * however quickly the machine went through it.
+ */
+static void handle_state_changes()
+{
+    uint8_t state_count = 0;
+    const char** state_names = control_get_state_list(&state_count);
+
+    state_transition transition;
+    while (control_next_state_transition(transition)) {
+        if ((uint8_t) transition.from < state_count && (uint8_t) transition.to < state_count) {
+            LV_LOG_INFO("%u ms: %s to %s", transition.time_ms, state_names[(int) transition.from],
+                        state_names[(int) transition.to]);
+        }
+    }
+}
+
 void handle_alerts()
 {
-    static uint16_t last_alarm_count = 0;
-    uint16_t alarm_count = control_get_alarm_count();
+    static uint16_t last_alarm_mask = 0;
+
+    // Count and mask from the same tick.
+    control_status status;
+    control_get_status(status);
+    uint16_t alarm_count = status.alarm_count;
     if (alarm_count <= 0 && alert_box_already_visible) {
         alert_box_already_visible = false;
-        last_alarm_count = 0;
+        last_alarm_mask = 0;
         set_alert_count_visual(0);
         set_alert_text("");
         set_alert_box_visible(false);
@@ -295,24 +324,14 @@ void handle_alerts()
         set_alert_box_visible(true);
     }
 
-    if (last_alarm_count != alarm_count) {
-        last_alarm_count = alarm_count;
-
-        Alarm* alarm_arr = control_get_alarm_list();
-        String alarm_strings[NUM_ALARMS];
-        uint16_t buf_size = 0;
-        uint16_t alarm_list_idx = 0;
-        for (uint16_t i = 0; i < NUM_ALARMS; i++) {
-            Alarm* a = &alarm_arr[i];
-            if (!a->isON()) {
-                continue;
-            }
-            buf_size += a->text().length();
-            alarm_strings[alarm_list_idx++] = a->text();
-        }
+    // The same number of alarms can still be different ones.
+    uint16_t alarm_mask = status.alarm_mask;
+    if (last_alarm_mask != alarm_mask) {
+        last_alarm_mask = alarm_mask;
 
+        // The text from the same snapshot as the count, the alarms may have moved on since.
         set_alert_count_visual(alarm_count);
-        set_alert_text(alarm_strings, alarm_count, buf_size);
+        set_alert_text(control_get_alarm_banner(alarm_mask));
     }
 }
 
@@ -436,6 +455,8 @@ double get_readout(AdjValueType type)
 
 void control_handler()
 {
+    PerfScope perf(Perf_Probe::CONTROL_HANDLER);
+
     static bool ledOn = false;
 
     // LED to visually show state machine is running.
@@ -446,6 +467,16 @@ void control_handler()
 
     // Run the state machine
     machine.run();
+
+    alarm_rules.update();
+
+    black_box.update();
+
+    telemetry.update();
+
+    chart_feed.update();
+
+    publish_snapshots();
 }
 
 /* Interrupt callback to service the actuator
@@ -454,6 +485,8 @@ void control_handler()
  */
 void actuator_handler()
 {
+    PerfScope perf(Perf_Probe::ACTUATOR);
+
     actuator.run();
 }
 
@@ -475,6 +508,11 @@ void control_init()                                         // JOSH PRESSURE
         storage.load_defaults();
     }
 
+    // After the settings, the black box shares the EEPROM with them.
+    if (!black_box.init()) {
+        Serial.println("Black box not found.");
+    }
+
     // Initialize the actuator, NEED TO CALL THIS AGAIN IF MOTOR IS SWITCHED
     actuator.init();
 
@@ -488,29 +526,38 @@ void control_init()                                         // JOSH PRESSURE
      * The below few lines, load the zero value from the EEPROM into the angle sensor register
      * at statup. Control can then use the value from the angle sensor to home the actuator.
      */
-    uvent_settings settings;
-    storage.get_settings(settings);
-    actuator.set_zero_position(settings.actuator_home_offset_adc_counts);
+    uint16_t home_offset_adc_counts;
+    storage.get_setting(Setting::ACTUATOR_HOME_OFFSET, home_offset_adc_counts);
+    actuator.set_zero_position(home_offset_adc_counts);
+
+    // Volume tables calibrated for this unit, if there are any. Otherwise the defaults stay.
+    volume_calibration calibration;
+    if (storage.get_volume_calibration(calibration)) {
+        actuator.set_volume_table(C_Stat::NONE, calibration.no_lung);
+        actuator.set_volume_table(C_Stat::FIFTY, calibration.comp_50);
+        actuator.set_volume_table(C_Stat::TWENTY, calibration.comp_20);
+    }
 
     // Initialize the Gauge Pressure Sensor
     gauge_sensor.init(MAX_GAUGE_PRESSURE, MIN_GAUGE_PRESSURE, RESISTANCE_1, RESISTANCE_2, 0);
 
     // Initialize the Differential Pressure Sensor
-    if (settings.diff_pressure_type == PRESSURE_SENSOR_TYPE_0) {
+    uint16_t diff_pressure_type;
+    storage.get_setting(Setting::DIFF_PRESSURE_TYPE, diff_pressure_type);
+    if (diff_pressure_type == PRESSURE_SENSOR_TYPE_0) {
         diff_sensor.init(MAX_DIFF_PRESSURE_TYPE_0, MIN_DIFF_PRESSURE_TYPE_0, RESISTANCE_1, RESISTANCE_2, 0);
     }
-    else if (settings.diff_pressure_type == PRESSURE_SENSOR_TYPE_1) {
+    else if (diff_pressure_type == PRESSURE_SENSOR_TYPE_1) {
         diff_sensor.init(MAX_DIFF_PRESSURE_TYPE_1, MIN_DIFF_PRESSURE_TYPE_1, RESISTANCE_1, RESISTANCE_2, 0);
     }
 
-    // Initialize the state machine
+#if USE_ADC_SAMPLER
+    // Sample both pressure sensors from here on, the sensors read from the sampler.
+    adc_sampler_init(&gauge_sensor, &diff_sensor);
+#endif
 
-    if(pcv == false) {
-        machine.setup();
-    }
-    if(pcv == true) {
-        pcvMachine.setup();
-    }
+    // Initialize the state machine
+    machine.setup();
 
     /* Setup a timer and a function handler to run
      * the state machine.
@@ -518,11 +565,14 @@ void control_init()                                         // JOSH PRESSURE
     Timer0.attachInterrupt(control_handler);
     Timer0.start(CONTROL_HANDLER_PERIOD_US);
 
+#if !USE_HW_STEP_GENERATOR || ENABLE_WIPER_MOTOR
     /* Setup a timer and a function handler to run
      * the actuation.
+     * The hardware step generator needs no servicing, and uses Timer1 itself.
      */
     Timer1.attachInterrupt(actuator_handler);
     Timer1.start(ACTUATOR_HANDLER_PERIOD_US);
+#endif
 
 #endif
 }
@@ -532,8 +582,14 @@ void control_init()                                         // JOSH PRESSURE
  * Since this is called by the loop(), the call interval
  * in not periodic.
  */
-void control_service()
+void control_service_telemetry()
+{
+    telemetry.service();
+}
+
+void control_service_storage()
 {
+    black_box.service();
 }
 
 /* Get the current angular position of the actuator
@@ -591,10 +647,10 @@ void control_write_ventilator_params()
 
 void control_get_serial(char* serial_buffer)
 {
-    uvent_settings settings{};
-    storage.get_settings(settings);
+    char serial[sizeof(uvent_settings::serial)];
+    storage.get_setting(Setting::SERIAL_NUMBER, serial);
 
-    memcpy(serial_buffer, settings.serial, 12);
+    memcpy(serial_buffer, serial, 12);
 }
 
 /* Request to switch the state of the state machine.
@@ -618,19 +674,22 @@ void control_change_state(States new_state)
     
 // }
 
-void control_change_mode(ControlModes new_mode)  // Change motors to be utilized in machine.cpp
+/* Switch between volume and pressure controlled breaths, only while off.
+ */
+bool control_change_mode(ControlModes new_mode)
 {
-   
-        
-        if(machine.get_current_state() == States::ST_OFF)  // DON'T NECESSARILY NEED THIS CHECK, BUT HAVING IT ENSURES NOTHING CAN GO WRONG, COULD MAYBE MAKE THE MOTOR HOME ITSELF THEN SWITCH IF STILL ON
-        {
-            // machine.change_mode(new_mode);
-            // NEED SOME KIND OF CONTROL_CHANGE_MODE() THAT CHANGES WHICH MACHINE OBJECT IS CREATED BEFORE IT'S INTIALIZED
-            control_init();            
-        }
-        
-    
-    
+    if (machine.get_current_state() != States::ST_OFF) {
+        return false;
+    }
+
+    machine.change_mode(new_mode);
+    alarm_rules.set_volume_controlled(new_mode == ControlModes::VCV);
+    return true;
+}
+
+ControlModes control_get_mode()
+{
+    return machine.get_mode();
 }
 
 void control_actuator_manual_move(Tick_Type tt, double angle, double speed)
@@ -641,7 +700,9 @@ void control_actuator_manual_move(Tick_Type tt, double angle, double speed)
 
 States control_get_state()
 {
-    return machine.get_current_state();
+    control_status status;
+    control_get_status(status);
+    return status.state;
 }
 
 const char* control_get_state_string()
@@ -679,6 +740,49 @@ double control_calc_volume_to_degrees(C_Stat compliance, double volume)
     return actuator.volume_to_degrees(compliance, volume);
 }
 
+bool control_set_volume_table(C_Stat compliance, const volume_table& table)
+{
+    return actuator.set_volume_table(compliance, table);
+}
+
+const volume_table& control_get_volume_table(C_Stat compliance)
+{
+    return actuator.get_volume_table(compliance);
+}
+
+/* Store the volume tables in use as this unit's calibration.
+ */
+void control_save_volume_tables()
+{
+    volume_calibration calibration;
+    calibration.no_lung = actuator.get_volume_table(C_Stat::NONE);
+    calibration.comp_50 = actuator.get_volume_table(C_Stat::FIFTY);
+    calibration.comp_20 = actuator.get_volume_table(C_Stat::TWENTY);
+
+    storage.set_volume_calibration(calibration);
+}
+
+/* Go back to the default volume tables, and forget the calibration.
+ */
+void control_reset_volume_tables()
+{
+    actuator.set_volume_table(C_Stat::NONE, VOLUME_TABLE_NO_LUNG);
+    actuator.set_volume_table(C_Stat::FIFTY, VOLUME_TABLE_COMP_50);
+    actuator.set_volume_table(C_Stat::TWENTY, VOLUME_TABLE_COMP_20);
+
+    storage.clear_volume_calibration();
+}
+
+Telemetry* control_get_telemetry()
+{
+    return &telemetry;
+}
+
+void control_dump_black_box(uint32_t count)
+{
+    black_box.dump(count);
+}
+
 void control_actuator_set_enable(bool en)
 {
     actuator.set_enable(en);
@@ -689,6 +793,21 @@ waveform_params* control_get_waveform_params(void)
     return (waveform.get_params());
 }
 
+void control_get_waveform_snapshot(waveform_params& out)
+{
+    waveform_snapshot.read(out);
+}
+
+void control_get_status(control_status& out)
+{
+    status_snapshot.read(out);
+}
+
+bool control_next_state_transition(state_transition& out)
+{
+    return state_transitions.pop(out);
+}
+
 void control_calculate_waveform()
 {
     waveform.calculate_waveform();
@@ -701,12 +820,7 @@ void control_waveform_display_details()
 
 double control_get_gauge_pressure()
 {
-    // if(pcv == false){                                                // JOSH PRESSURE
-        return gauge_sensor.get_pressure(units_pressure::cmH20);
-    // }
-    // if(pcv == true){
-    //     // pull adjustable value
-    // }
+    return gauge_sensor.get_pressure(units_pressure::cmH20);
 }
 
 double control_get_diff_pressure()
@@ -746,11 +860,22 @@ int16_t control_get_alarm_count()
     return alarm_manager.numON();
 }
 
-String control_get_alarm_text()
+const char* control_get_alarm_text()
 {
     return (alarm_manager.getText());
 }
 
+// Built for the alarms in alarm_mask, e.g. from a status snapshot, not the ones ON now.
+const char* control_get_alarm_banner(uint16_t alarm_mask)
+{
+    return (alarm_manager.getBanner(alarm_mask));
+}
+
+uint16_t control_get_alarm_mask()
+{
+    return alarm_manager.onMask();
+}
+
 void control_set_alarm_all_off()
 {
     alarm_manager.allOff();
@@ -4,6 +4,26 @@
 #include <display/screens/screen.h>
 #include "controls/machine.h"
 #include "interface/interface.h"
+#include "telemetry.h"
+
+/**
+ * What the control handler last saw, published every tick.
+ */
+struct control_status {
+    States state;
+    uint16_t alarm_mask;
+    int16_t alarm_count;
+    uint32_t cycle_count;
+};
+
+/**
+ * A change of state of the machine, seen by the control handler.
+ */
+struct state_transition {
+    uint32_t time_ms;
+    States from;
+    States to;
+};
 
 /**
  * Set all the adjustable values to their last target, or load defaults if no last target exists.
@@ -12,17 +32,17 @@
 void init_adjustable_values();
 
 /**
- * Dummy timer function to be used in testing.
+ * Dummy readout task to be used in testing.
  * Functionally should do the same thing as loop_update_readouts, but prints dummy values to the screen.
- * @param timer The LVGL timer that controls this loop. Contains user data with a screen pointer for the cur screen.
+ * @param screen The main screen, with the readouts and charts.
  */
-void loop_test_readout(lv_timer_t* timer);
+void loop_test_readout(MainScreen* screen);
 /**
- * Timer function to poll sensors and update values accordingly.
+ * Readout task to poll sensors and update values accordingly, run from the scheduler in main.cpp.
  * This should not be called manually under normal circumstances
- * @param timer The LVGL timer that controls this loop. Contains user data with a screen pointer for the cur screen.
+ * @param screen The main screen, with the readouts and charts.
  */
-void loop_update_readouts(lv_timer_t* timer);
+void loop_update_readouts(MainScreen* screen);
 
 /**
  * Handles showing/hiding the alert box.
@@ -50,7 +70,10 @@ double get_readout(AdjValueType type);
 void control_update_waveform_param(AdjValueType type, float new_value);
 
 void control_init();
-void control_service();
+
+// loop() tasks, neither touches LVGL: send queued telemetry, write the black box.
+void control_service_telemetry();
+void control_service_storage();
 double control_get_actuator_position();
 int8_t control_get_actuator_position_raw(double& angle);
 void control_eeprom_write_default();
@@ -59,7 +82,12 @@ void control_write_ventilator_params();
 void control_get_serial(char* serial_buffer);
 void control_change_state(States);
 // void control_change_motor(Motors);
-void control_change_mode(ControlModes);
+/**
+ * Volume or pressure controlled breaths, see PCV_PID_KP in uvent_conf.h.
+ * @return false, and no change, unless the machine is off.
+ */
+bool control_change_mode(ControlModes);
+ControlModes control_get_mode();
 void control_actuator_manual_move(Tick_Type tt, double angle, double speed);
 States control_get_state();
 const char* control_get_state_string();
@@ -69,8 +97,27 @@ bool control_is_crc_ok();
 double control_get_degrees_to_volume(C_Stat compliance = C_Stat::FIFTY);
 double control_get_degrees_to_volume_ml(C_Stat compliance = C_Stat::FIFTY);
 double control_calc_volume_to_degrees(C_Stat compliance, double volume);
+bool control_set_volume_table(C_Stat compliance, const volume_table& table);
+const volume_table& control_get_volume_table(C_Stat compliance);
+void control_save_volume_tables();
+void control_reset_volume_tables();
 void control_actuator_set_enable(bool en);
+Telemetry* control_get_telemetry();
+void control_dump_black_box(uint32_t count);
 waveform_params* control_get_waveform_params(void);
+
+/* Consistent copies of what the control handler works on, for loop(). They
+ * are published at the end of every tick and copied out without turning
+ * interrupts off, see utilities/seqlock.h. The values are a tick old at most.
+ */
+void control_get_waveform_snapshot(waveform_params& out);
+void control_get_status(control_status& out);
+
+/**
+ * Takes the oldest state change not taken yet. Only the readout task takes them.
+ * @return false if there are none.
+ */
+bool control_next_state_transition(state_transition& out);
 void control_calculate_waveform();
 void control_waveform_display_details();
 double control_get_gauge_pressure();
@@ -78,8 +125,10 @@ double control_get_diff_pressure();
 void control_setup_alarm_cb();
 void control_alarm_snooze();
 void control_toggle_alarm_snooze();
-String control_get_alarm_text();
+const char* control_get_alarm_text();
+const char* control_get_alarm_banner(uint16_t alarm_mask);
 int16_t control_get_alarm_count();
+uint16_t control_get_alarm_mask();
 void control_set_alarm_all_off();
 Alarm* control_get_alarm_list();
 void control_alarm_test();
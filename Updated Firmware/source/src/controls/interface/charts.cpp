@@ -1,5 +1,6 @@
 #include <utilities/util.h>
 #include <display/main_display.h>
+#include "../config/uvent_conf.h"
 #include "charts.h"
 
 static void on_graph_readout_update(lv_event_t* evt)
@@ -22,9 +23,10 @@ static void on_graph_readout_update(lv_event_t* evt)
 
 SensorChart::SensorChart(const char* name, int32_t min_val, int32_t max_val, uint32_t chart_points,
         uint32_t refresh_time,
-        bool use_dots, lv_coord_t dot_size, lv_coord_t line_width)
+        bool use_dots, lv_coord_t dot_size, lv_coord_t line_width, bool sweep, uint32_t time_base_ms)
         : name(name), range_min(min_val), range_max(max_val), chart_points(chart_points), refresh_time(refresh_time),
-          use_dots(use_dots), dot_size(dot_size), line_width(line_width) { }
+          use_dots(use_dots && !time_base_ms), dot_size(dot_size), line_width(line_width), sweep(sweep),
+          time_base_ms(time_base_ms) { }
 
 void SensorChart::generate_chart(lv_obj_t* parent, AdjValueType tracked_type = UNKNOWN)
 {
@@ -62,7 +64,7 @@ void SensorChart::generate_chart(lv_obj_t* parent, AdjValueType tracked_type = U
     /*Add data series*/
     lv_chart_add_series(chart, lv_palette_main(LV_PALETTE_GREEN), LV_CHART_AXIS_PRIMARY_Y);
     lv_chart_set_point_count(chart, chart_points);
-    lv_chart_set_update_mode(chart, LV_CHART_UPDATE_MODE_SHIFT);
+    lv_chart_set_update_mode(chart, sweep ? LV_CHART_UPDATE_MODE_CIRCULAR : LV_CHART_UPDATE_MODE_SHIFT);
     lv_obj_t* readout_label = lv_label_create(chart);
     lv_obj_set_style_text_font(readout_label, &lv_font_montserrat_28, LV_PART_MAIN);
     lv_label_set_text_fmt(readout_label, "--");
@@ -75,7 +77,38 @@ void SensorChart::generate_chart(lv_obj_t* parent, AdjValueType tracked_type = U
     }
 }
 
-void SensorChart::add_data_point(double data) const
+void SensorChart::fit_to_width()
+{
+    if (!chart) {
+        return;
+    }
+
+    lv_obj_update_layout(chart);
+    lv_coord_t width = lv_obj_get_content_width(chart);
+    if (width < 2) {
+        return;
+    }
+
+    if (time_base_ms) {
+        columns = width;
+        chart_points = 2 * columns;
+        lv_chart_set_point_count(chart, chart_points);
+    }
+
+    uint16_t point_count = lv_chart_get_point_count(chart);
+    erase_points = ((uint32_t) CHART_SWEEP_GAP_PX * (point_count - 1) + width - 1) / width;
+    if (erase_points < 1) {
+        erase_points = 1;
+    }
+}
+
+void SensorChart::add_column(lv_coord_t min, lv_coord_t max)
+{
+    add_data_point(min);
+    add_data_point(max);
+}
+
+void SensorChart::add_data_point(double data)
 {
     if (!chart) {
         return;
@@ -84,6 +117,17 @@ void SensorChart::add_data_point(double data) const
 
     uint16_t point_count = lv_chart_get_point_count(chart);
     series->y_points[series->start_point] = data;
+
+    if (sweep) {
+        // The gap ahead of the newest point, no line is drawn to or from a blank point.
+        for (uint16_t i = 1; i <= erase_points && i < point_count; i++) {
+            series->y_points[(series->start_point + i) % point_count] = LV_CHART_POINT_NONE;
+        }
+        if (unrefreshed_points < point_count) {
+            unrefreshed_points++;
+        }
+    }
+
     series->start_point = (series->start_point + 1) % point_count;
 }
 
@@ -92,10 +136,66 @@ bool SensorChart::should_refresh()
     return has_time_elapsed(&last_refreshed, refresh_time);
 }
 
-void SensorChart::refresh_chart() const
+void SensorChart::refresh_chart()
 {
     if (!chart) {
         return;
     }
-    lv_chart_refresh(chart);
+
+    if (!sweep) {
+        lv_chart_refresh(chart);
+        return;
+    }
+
+    if (unrefreshed_points == 0) {
+        return;
+    }
+
+    lv_chart_series_t* series = lv_chart_get_series_next(chart, nullptr);
+    uint16_t point_count = lv_chart_get_point_count(chart);
+
+    /* From the point before the first new one, its line to the new one is drawn
+     * now, through the gap ahead of the newest to the point after it, whose line
+     * into the gap is gone.
+     */
+    uint32_t span = unrefreshed_points + 2 + erase_points;
+    unrefreshed_points = 0;
+    if (span >= point_count) {
+        lv_chart_refresh(chart);
+        return;
+    }
+
+    uint16_t first = (series->start_point + 2 * point_count - span + erase_points + 1) % point_count;
+    uint16_t last = (first + span - 1) % point_count;
+    if (first <= last) {
+        invalidate_points(first, last);
+    }
+    else {
+        // Round the right edge and back from the left.
+        invalidate_points(first, point_count - 1);
+        invalidate_points(0, last);
+    }
+}
+
+/* Invalidates the strip of the chart from point first to point last, with the
+ * lines and dots that reach past them.
+ */
+void SensorChart::invalidate_points(uint16_t first, uint16_t last) const
+{
+    uint16_t point_count = lv_chart_get_point_count(chart);
+    if (point_count < 2) {
+        lv_chart_refresh(chart);
+        return;
+    }
+
+    // Where lv_chart puts the points.
+    lv_coord_t width = lv_obj_get_content_width(chart);
+    lv_coord_t x_ofs = chart->coords.x1 + lv_obj_get_style_pad_left(chart, LV_PART_MAIN);
+    lv_coord_t reach = line_width + (use_dots ? dot_size : 0) + 1;
+
+    lv_area_t area;
+    lv_area_copy(&area, &chart->coords);
+    area.x1 = x_ofs + (int32_t) width * first / (point_count - 1) - reach;
+    area.x2 = x_ofs + (int32_t) width * last / (point_count - 1) + reach;
+    lv_obj_invalidate_area(chart, &area);
 }
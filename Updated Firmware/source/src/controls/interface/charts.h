@@ -6,6 +6,19 @@
 
 /**
  * Chart that gets its data from a polled sensor
+ *
+ * A scrolling chart moves every point left on each refresh, so the whole chart
+ * is drawn and sent to the display again. A sweeping chart writes each new
+ * point over the oldest one, left to right and back round like a patient
+ * monitor, with a few blank points ahead of it to keep the new trace apart from
+ * the old. A refresh only invalidates the strip the new points and that gap
+ * cover, so the cost is in the points added, not the size of the chart.
+ *
+ * With a time base the chart has two points per pixel column, and is fed a
+ * column at a time with add_column(), the lowest and highest value in it, so a
+ * peak between polls is drawn. The columns come from ChartFeed at the rate that
+ * sweeps the chart in the time base, as many pixels a second as before, so no
+ * more is drawn or sent to the display.
  */
 struct SensorChart {
     const char* name{};
@@ -18,10 +31,15 @@ struct SensorChart {
     bool use_dots = false;      /**< Whether or not to use actual points on the data screen, or just a line */
     lv_coord_t dot_size{};
     lv_coord_t line_width{};
+    bool sweep = false;         /**< Sweep across the chart instead of scrolling it */
+    uint16_t unrefreshed_points = 0; /**< Points added since the last refresh, sweeping only */
+    uint16_t erase_points = 1;  /**< Points blanked ahead of the newest, sweeping only */
+    uint32_t time_base_ms = 0;  /**< Time across the chart, 0 for a point per poll */
+    uint16_t columns = 0;       /**< Pixel columns across, with a time base */
 
     SensorChart() = default;
     SensorChart(const char* name, int32_t min_val, int32_t max_val, uint32_t chart_points, uint32_t refresh_time,
-            bool use_dots, lv_coord_t dot_size, lv_coord_t line_width);
+            bool use_dots, lv_coord_t dot_size, lv_coord_t line_width, bool sweep = false, uint32_t time_base_ms = 0);
 
     /**
      * Creates the chart based on obj parameters. The chart pointer is stored as `chart`
@@ -29,12 +47,27 @@ struct SensorChart {
      * @param parent The parent this chart should be added to
      */
     void generate_chart(lv_obj_t* parent, AdjValueType tracked_type);
-    void add_data_point(double data) const;
+    /**
+     * Sizes what depends on the chart's width, once every chart around it is generated:
+     * the points, with a time base, and the sweep gap.
+     */
+    void fit_to_width();
+    void add_data_point(double data);
+    /**
+     * Adds one pixel column, drawn from min to max. Only with a time base.
+     */
+    void add_column(lv_coord_t min, lv_coord_t max);
     /**
      * @return If enough time has passed to allow a refresh of the chart screen
      */
     bool should_refresh();
-    void refresh_chart() const;
+    /**
+     * Redraws what changed: the whole chart when scrolling, the new points when sweeping.
+     */
+    void refresh_chart();
+
+private:
+    void invalidate_points(uint16_t first, uint16_t last) const;
 };
 
 #endif //UVENT_CHARTS_H
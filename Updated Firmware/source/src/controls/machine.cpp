@@ -3,6 +3,7 @@
 #include <display/layouts/layouts.h>
 #include "machine.h"
 #include "actuators/actuator.h"
+#include "sensors/adc_sampler.h"
 #include "utilities/util.h"
 
 // Stringify states
@@ -20,7 +21,7 @@ const char* state_string[] =
                 stringify(ST_DEBUG),
                 stringify(ST_OFF)};
 
-Machine::Machine(States st, Actuator* act, Waveform* wave, PressureSensor* gp, AlarmManager* al, uint32_t* cc)  // no differential pressure sensor, just gauge
+Machine::Machine(States st, Actuator* act, Waveform* wave, PressureSensor* gp, BreathAnalyzer* ba, AlarmManager* al, uint32_t* cc)  // gauge pressure, and breath measurements
 {
     p_actuator = act;
     state = st;
@@ -33,6 +34,7 @@ Machine::Machine(States st, Actuator* act, Waveform* wave, PressureSensor* gp, A
     p_alarm_manager = al;
     cycle_count = cc;
     p_gauge_pressure = gp;
+    p_breath_analyzer = ba;
 }
 
 // Set the current state in the state machine
@@ -51,11 +53,44 @@ void Machine::set_state(States new_state)
 //     p_actuator->change_motor(new_motor);
 // }
 
-// void Machine::set_mode(ControlModes new_mode)  // Set control mode
-// {
-//     mode = new_mode;                                                        // SHOULD ONLY HAVE TO CHECK MODE IN MACHINE.CPP TO CHANGE FUNCTIONALITY                                  
-//     // p_actuator->change_motor(new_motor);
-// }
+/* Start of a pressure controlled breath. The paddle is sent to the set volume,
+ * at no speed, and the PID sets the speed from here on. The speed goes to 0 first,
+ * or the new target would start a move at whatever speed the last breath ended on.
+ */
+void Machine::pcv_start()
+{
+    float travel_deg = p_actuator->volume_to_degrees(C_Stat::FIFTY, p_waveparams->volume_ml / 1000);
+
+    pressure_pid.set_output_limits(0, PCV_MAX_SPEED_DEG_P_SEC);
+    pressure_pid.set_rate_limit(PCV_MAX_ACCEL_DEG_P_SEC2);
+    pressure_pid.reset();
+
+    p_actuator->set_speed(Tick_Type::TT_DEGREES, 0);
+    p_actuator->set_position(Tick_Type::TT_DEGREES, travel_deg);
+}
+
+void Machine::pcv_update()
+{
+    float speed = pressure_pid.update(p_waveparams->pip, pcv_pressure());
+
+    // At the set volume the paddle can give no more, keep the integral from winding up on it.
+    if (p_actuator->target_reached()) {
+        pressure_pid.set_output_limits(0, 0);
+        speed = 0;
+    }
+
+    p_actuator->set_speed(Tick_Type::TT_DEGREES, speed);
+}
+
+// Gauge pressure in cmH2O, the mean of the newest samples with the sampler.
+float Machine::pcv_pressure()
+{
+    if (adc_sampler_running()) {
+        q16_t counts = q16_from_int(adc_sampler_average(PRESSURE_GAUGE_PIN, PCV_PRESSURE_SAMPLES));
+        return q16_to_float(p_gauge_pressure->get_pressure_q16_from_counts<units_pressure::cmH20>(counts));
+    }
+    return q16_to_float(p_gauge_pressure->get_pressure_q16<units_pressure::cmH20>());
+}
 
 
 // State functions
@@ -106,6 +141,10 @@ void Machine::state_inspiration()
 
         state_first_entry = false;
 
+        // End-expiration: close the last breath and publish its measurements.
+        p_breath_analyzer->set_phase(Breath_Phase::INSPIRATION);
+        p_waveform->set_measured_params(p_breath_analyzer->get_last_breath());
+
         // Calculate the waveform parameters
         if (p_waveform->calculate_waveform() == -1) {
             // Set the fault ID:
@@ -117,29 +156,34 @@ void Machine::state_inspiration()
             return;
         }
 
-        float goal_pos_deg = p_actuator->volume_to_degrees(C_Stat::FIFTY, p_waveparams->volume_ml / 1000); // Takes tidal volume and calculates motor rotation amount
-        float vel_deg = 0;
+        breath_mode = mode;
+        if (breath_mode == ControlModes::PCV) {
+            pcv_start();
+        }
+        else {
+            float goal_pos_deg = p_actuator->volume_to_degrees(C_Stat::FIFTY, p_waveparams->volume_ml / 1000); // Takes tidal volume and calculates motor rotation amount
+            float vel_deg = 0;
 
-        // Calculate how much and at what speed the actuator should move.
-        p_actuator->calculate_trajectory(p_waveparams->tIn, p_waveparams->tHoldIn - p_waveparams->tIn, goal_pos_deg, vel_deg);
-        // if(motor == Motors::WIPER)
-        // {
-        //     p_actuator->calculate_trajectory(p_waveparams->tPeriod, goal_pos_deg, vel_deg);
+            // Calculate how much and at what speed the actuator should move.
+            p_actuator->calculate_trajectory(p_waveparams->tIn, p_waveparams->tHoldIn - p_waveparams->tIn, goal_pos_deg, vel_deg);
+            // if(motor == Motors::WIPER)
+            // {
+            //     p_actuator->calculate_trajectory(p_waveparams->tPeriod, goal_pos_deg, vel_deg);
 
-        // }
+            // }
 
-        // Move the actuator
-        p_actuator->set_position(Tick_Type::TT_DEGREES, goal_pos_deg);
-        p_actuator->set_speed(Tick_Type::TT_DEGREES, vel_deg);
+            // Move the actuator
+            p_actuator->start_trajectory();
+        }
+    }
+
+    if (breath_mode == ControlModes::PCV) {
+        pcv_update();
     }
 
     // Check if target has been reached.
     if (p_waveform->is_inspiration_done()) {
-        // Keep track of max pip.
-        p_waveform->set_current_pip(p_gauge_pressure->get_pressure(units_pressure::cmH20)); //JOSH PRESSURE
-
-        // Note the volume dispensed. Keep this as a copy of the command volume.
-        p_waveparams->m_tidal_volume = p_waveparams->volume_ml;
+        p_breath_analyzer->set_phase(Breath_Phase::HOLD);
 
         set_state(States::ST_INSPR_HOLD);
     }
@@ -153,12 +197,15 @@ void Machine::state_inspiration_hold()
     if (state_first_entry) {
         state_first_entry = false;
     }
-    if (p_waveform->is_inspiration_hold_done()) {
-        // Save the plateau pressure.
-        p_waveparams->m_plateau_press = p_gauge_pressure->get_pressure(units_pressure::cmH20);  // JOSH PRESSURE
 
-        // Mark the inspiration time
-        p_waveform->mark_inspiration_time(now_s());
+    // The pressure is held through the hold too, the expiration's move takes the paddle over.
+    if (breath_mode == ControlModes::PCV) {
+        pcv_update();
+    }
+
+    if (p_waveform->is_inspiration_hold_done()) {
+        // The plateau is measured through the hold.
+        p_breath_analyzer->set_phase(Breath_Phase::EXPIRATION);
 
         set_state(States::ST_EXPR);
     }
@@ -186,8 +233,7 @@ void Machine::state_expiration()
         // }
 
         // Move the actuator
-        p_actuator->set_position(Tick_Type::TT_DEGREES, goal_pos_deg);
-        p_actuator->set_speed(Tick_Type::TT_DEGREES, vel_deg);
+        p_actuator->start_trajectory();
     }
 
     // Check if target has been reached.
@@ -206,9 +252,6 @@ void Machine::state_peep_pause()
     }
 
     if (p_waveform->is_peep_pause_done()) {
-        // Save the peep pressure.
-        p_waveparams->m_peep = p_gauge_pressure->get_pressure(units_pressure::cmH20);   // JOSH PRESSURE
-        p_waveform->set_pip_peak_and_reset();
         set_state(States::ST_EXPR_HOLD);
     }
 }
@@ -224,13 +267,6 @@ void Machine::state_expiration_hold()
 
     if (p_waveform->is_expiration_done()) {
         set_state(States::ST_INSPR);
-        p_waveform->calculate_respiration_rate();
-
-        // Mark the inspiration time
-        p_waveform->mark_expiration_time(now_s());
-
-        // Calculate waveform params for UI reporting
-        p_waveform->calculate_current_parameters();
     }
 }
 
@@ -242,6 +278,7 @@ void Machine::state_actuator_home()
     if (state_first_entry) {
         state_first_entry = false;
             disable_start_button();
+        p_breath_analyzer->set_phase(Breath_Phase::NONE);
 
         // Check if the paddle is at home position
         // If not move the paddle to home.
@@ -329,6 +366,7 @@ void Machine::state_fault()
 
         // Stop the actuator
         p_actuator->set_speed(Tick_Type::TT_DEGREES, 0);
+        p_breath_analyzer->set_phase(Breath_Phase::NONE);
 
         Serial.print("Fault code : ");
         Serial.println((int) fault_id);
@@ -347,6 +385,9 @@ void Machine::state_off()
         // Reset the cycle counter
         *cycle_count = 0;
 
+        // Not breathing, stop measuring volumes.
+        p_breath_analyzer->set_phase(Breath_Phase::NONE);
+
         // Reset all alarms.
         p_alarm_manager->allOff();
     }
@@ -358,6 +399,9 @@ void Machine::run()
     machine_timer++;
     handle_errors();
 
+    // Measure pressure and flow up to now, into the part of the breath they belong to.
+    p_breath_analyzer->update();
+
     // State Machine
     switch (state) {
         case States::ST_STARTUP:
@@ -437,21 +481,15 @@ void Machine::change_state(States st)
 //     set_motor(m);
 // }
 
-// void Machine::change_mode(ControlModes cm)  // Change motor
-// {
-//     set_mode(cm);
-// }
+void Machine::change_mode(ControlModes cm)
+{
+    // Read when a breath starts, a breath under way finishes as it started.
+    mode = cm;
+}
 
 void Machine::handle_errors()
 {
-    // These pressure alarms only make sense after homing
-    if (state_first_entry && state == States::ST_INSPR) {
-        p_alarm_manager->badPlateau(false);
-        p_alarm_manager->lowPressure(false);
-        p_alarm_manager->noTidalPres(false);
-        p_alarm_manager->highPressure(p_gauge_pressure->get_pressure(units_pressure::cmH20) > PRESSURE_MAX);
-    }
-
+    // The measured alarms are driven by the alarm rules, see alarm/alarm_rules.h.
     p_alarm_manager->update();
 }
 
@@ -7,6 +7,8 @@
 #include "waveform.h"
 #include "alarm/alarm.h"
 #include "sensors/pressure_sensor.h"
+#include "sensors/breath_analyzer.h"
+#include "pressurePID.h"
 
 #define stringify(name) #name
 
@@ -28,7 +30,7 @@ enum class States {
 class Machine {
 public:
     // Constructor
-    Machine(States, Actuator*, Waveform*, PressureSensor* gauge_pressure, AlarmManager*, uint32_t* cycle_count);
+    Machine(States, Actuator*, Waveform*, PressureSensor* gauge_pressure, BreathAnalyzer* breath_analyzer, AlarmManager*, uint32_t* cycle_count);
 
     void setup();
     void run();
@@ -37,11 +39,14 @@ public:
     States get_current_state();
     void change_state(States);
     // void change_motor(Motors);
-    
-    // void change_mode(ControlModes);
+
+    // Volume or pressure controlled breaths, from the next breath on.
+    void change_mode(ControlModes);
+    ControlModes get_mode() const { return mode; }
 
     void handle_errors();
     void set_fault(Fault);
+    Fault get_fault() const { return fault_id; }
 
     // States get_last_state();        // JOSH PRESSURE
     // States lastState;
@@ -51,7 +56,11 @@ private:
     States state;
     Motors motor;
 
-    ControlModes mode;
+    ControlModes mode = ControlModes::VCV;
+    ControlModes breath_mode = ControlModes::VCV;// Mode of the breath under way
+
+    // Pressure control, through inspiration and its hold in PCV.
+    PressurePID pressure_pid{PCV_PID_KP, PCV_PID_KI, PCV_PID_KD, PCV_PID_DERIVATIVE_TAU_S, CONTROL_HANDLER_PERIOD_US / 1e6f};
 
     // Boolean to signify initial startup upon powering on the ventilator
     bool firstInit = true;
@@ -77,7 +86,7 @@ private:
     bool actuator_force_fault_debug = false;
 
     // Fault code
-    Fault fault_id;
+    Fault fault_id = Fault::FT_NONE;
 
     Actuator* p_actuator;
 
@@ -88,11 +97,18 @@ private:
 
     PressureSensor* p_gauge_pressure;
 
+    BreathAnalyzer* p_breath_analyzer;
+
     bool inspiration_state_triggered;
 
     // Set the current state in the state machine
     void set_state(States);
 
+    // PCV: start the paddle on a breath, and set its speed each tick.
+    void pcv_start();
+    void pcv_update();
+    float pcv_pressure();
+
     // Boolean indicating if machine is in state ST_EXPR to correct homing bug.
     bool in_expiration;
 
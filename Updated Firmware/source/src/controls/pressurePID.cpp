@@ -1,21 +1,70 @@
 #include "pressurePID.h"
 
-    float PressurePID::calculatePressurePID(float actualValue, float desiredValue, float iterationTime) { // maybe make non-static? values are in pressure units
+static float clamp(float value, float low, float high)
+{
+    return value < low ? low : (value > high ? high : value);
+}
 
+PressurePID::PressurePID(float kp, float ki, float kd, float derivative_tau_s, float dt_s)
+    : kp(kp), ki(ki), kd(kd), dt_s(dt_s), derivative_alpha(dt_s / (derivative_tau_s + dt_s))
+{
+}
 
-        float error = desiredValue - actualValue;
-        float integral = prevIntegral + error * iterationTime;
-        float derivative = (error - prevError) / iterationTime;
-        
-        float output = Kp*error + Ki*integral + Kd*derivative + bias;
+void PressurePID::set_output_limits(float min_output, float max_output)
+{
+    this->min_output = min_output;
+    this->max_output = max_output;
+    integral = clamp(integral, min_output, max_output);
+    output = clamp(output, min_output, max_output);
+}
 
-        prevError = error;
-        prevIntegral = integral;
+void PressurePID::set_rate_limit(float max_change_per_s)
+{
+    max_step = max_change_per_s * dt_s;
+}
 
-        // DO SOMETHING WITH ITERATION TIME HERE
-        
-        // iteration time could be tPeriod? Might not update fast enough and need to check during other states besides just in inspiration
+void PressurePID::reset()
+{
+    first = true;
+    integral = 0;
+    slope = 0;
+    error = 0;
+    output = clamp(0, min_output, max_output);
+}
 
-        return output;
-        
+// To the output limits, and the rate limit from the last output.
+float PressurePID::limit(float value) const
+{
+    value = clamp(value, min_output, max_output);
+    if (max_step > 0) {
+        value = clamp(value, output - max_step, output + max_step);
     }
+    return value;
+}
+
+float PressurePID::update(float target, float measured)
+{
+    if (first) {
+        last_measured = measured;
+        first = false;
+    }
+
+    error = target - measured;
+
+    slope += derivative_alpha * ((measured - last_measured) / dt_s - slope);
+    last_measured = measured;
+
+    float proportional = kp * error - kd * slope;
+    float integral_step = ki * error * dt_s;
+
+    // Integrate unless the output is held short of what it asks, and the step would ask for more.
+    float wanted = proportional + integral + integral_step;
+    float held = limit(wanted);
+    if (wanted == held || (wanted - held) * integral_step < 0) {
+        integral = clamp(integral + integral_step, min_output, max_output);
+    }
+
+    output = limit(proportional + integral);
+
+    return output;
+}
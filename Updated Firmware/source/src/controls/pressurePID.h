@@ -1,24 +1,64 @@
 #ifndef UVENT_PRESSUREPID_H
 #define UVENT_PRESSUREPID_H
 
-class PressurePID { 
+/* PID on the airway pressure, for pressure controlled breaths.
+ *
+ * Stepped once per control handler tick, with a fixed step of dt_s, so the
+ * integral and derivative don't move with jitter in when the tick runs. The
+ * output is a paddle speed, in degrees/sec.
+ *
+ * The derivative is taken on the measured pressure, not the error, so a new
+ * target doesn't kick the paddle, and goes through a first order low pass
+ * with time constant derivative_tau_s to keep the sensor noise off it.
+ *
+ * The output is clamped to the limits, and moves by at most the rate limit a
+ * second, so the stepper isn't asked for more than it can accelerate. While
+ * it is held back by either, the integral only moves the other way, so it
+ * doesn't wind up.
+ */
+class PressurePID {
 public:
-    const double Kp = 0.0011;       // CHANGE FOR TUNING
-    const double Ki = 0.012;
-    const double Kd = 0.000015;
+    PressurePID(float kp, float ki, float kd, float derivative_tau_s, float dt_s);
 
-    float prevError = 0;
-    float prevIntegral = 0;
-    float bias = 0;
+    void set_output_limits(float min_output, float max_output);
 
-    // Used for timing purposes
-    bool firstPID = true;
-    float timeSincePID = 0;
+    // Most the output moves in a second, 0 for no limit.
+    void set_rate_limit(float max_change_per_s);
 
-    float target = 15.0; // CHANGE IN FUTURE DEPENDING ON GOOD ALLOWABLE VALUES, 15 IS JUST FOR TESTING PURPOSES
+    // Starts again from no output, e.g. at the start of a breath.
+    void reset();
 
-    float calculatePressurePID(float actualValue, float desiredValue, float iterationTime);
+    /**
+     * One step.
+     * @param target Pressure to hold, cmH2O.
+     * @param measured Pressure measured this tick, cmH2O.
+     * @return The new output, within the limits.
+     */
+    float update(float target, float measured);
 
+    float get_output() const { return output; }
+
+    float get_error() const { return error; }
+
+private:
+    float limit(float value) const;
+
+    float kp;
+    float ki;
+    float kd;
+    float dt_s;
+    float derivative_alpha;// Share of a new slope taken each step
+
+    float min_output = 0;
+    float max_output = 0;
+    float max_step = 0;// Rate limit over a step, 0 for none
+
+    bool first = true;
+    float integral = 0;   // In output units
+    float slope = 0;      // Filtered, cmH2O/s
+    float last_measured = 0;
+    float error = 0;
+    float output = 0;
 };
 
-#endif //UVENT_PRESSUREPID_H
+#endif//UVENT_PRESSUREPID_H
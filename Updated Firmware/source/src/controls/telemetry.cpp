@@ -0,0 +1,235 @@
+#include "telemetry.h"
+#include "sensors/adc_sampler.h"
+#include "utilities/util.h"
+#include <CRC32.h>
+
+static_assert((TELEMETRY_BUFFER_BYTES & (TELEMETRY_BUFFER_BYTES - 1)) == 0, "TELEMETRY_BUFFER_BYTES must be a power of 2");
+
+// Header and CRC around the payload.
+#define TELEMETRY_HEADER_BYTES 4
+#define TELEMETRY_CRC_BYTES 4
+#define TELEMETRY_MAX_PAYLOAD sizeof(telemetry_samples)
+#define TELEMETRY_MAX_RAW (TELEMETRY_HEADER_BYTES + TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_BYTES)
+
+// COBS adds a byte per 254 and one more, plus the two delimiters.
+#define TELEMETRY_MAX_FRAME (TELEMETRY_MAX_RAW + TELEMETRY_MAX_RAW / 254 + 1 + 2)
+
+static_assert(sizeof(telemetry_breath) <= TELEMETRY_MAX_PAYLOAD, "telemetry_samples must be the largest record");
+
+/* COBS: each run of non-zero bytes is led by its length + 1, which stands for
+ * the 0 that follows it. A run of 254 has no 0 after it.
+ * Returns the encoded length.
+ */
+static uint32_t cobs_encode(const uint8_t* in, uint32_t length, uint8_t* out)
+{
+    uint32_t code_pos = 0;
+    uint32_t out_pos = 1;
+    uint8_t code = 1;
+
+    for (uint32_t i = 0; i < length; i++) {
+        if (in[i] != 0) {
+            out[out_pos++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xFF) {
+            out[code_pos] = code;
+            code_pos = out_pos++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+
+    return out_pos;
+}
+
+// Q16 to hundredths, held to int16.
+static int16_t q16_to_centi(q16_t value)
+{
+    int32_t centi = q16_t(((int64_t) value * 100 + (Q16_ONE >> 1)) >> 16);
+    if (centi > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (centi < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return centi;
+}
+
+Telemetry::Telemetry(Machine* machine, Actuator* actuator, PressureSensor* gauge_sensor, PressureSensor* diff_sensor,
+                     Waveform* waveform, uint32_t* cycle_count)
+    : p_machine(machine),
+      p_actuator(actuator),
+      p_gauge_sensor(gauge_sensor),
+      p_diff_sensor(diff_sensor),
+      p_waveform(waveform),
+      p_cycle_count(cycle_count)
+{
+}
+
+void Telemetry::set_enable(bool enable)
+{
+    enabled = enable;
+}
+
+void Telemetry::update()
+{
+    if (!enabled) {
+        // Start afresh when turned on.
+        started = false;
+        return;
+    }
+
+    if (!started) {
+        next_sample = adc_sampler_running() ? adc_sampler_pair_count() : 0;
+        last_cycle_count = *p_cycle_count;
+        last_state = p_machine->get_current_state();
+        started = true;
+    }
+
+    uint32_t time_ms = now_ms();
+    States state = p_machine->get_current_state();
+
+    if (state != last_state) {
+        telemetry_state record = {time_ms, (uint8_t) last_state, (uint8_t) state};
+        send(Telemetry_Record::STATE, &record, sizeof(record));
+        last_state = state;
+    }
+
+    update_samples();
+
+    telemetry_tick tick = {time_ms, (uint8_t) state, int16_t(p_actuator->get_position() * 100)};
+    send(Telemetry_Record::TICK, &tick, sizeof(tick));
+
+    // A new breath has started, the measured values of the one before are in.
+    if (*p_cycle_count != last_cycle_count) {
+        last_cycle_count = *p_cycle_count;
+
+        const waveform_params* p = p_waveform->get_params();
+        telemetry_breath breath = {
+                .time_ms = time_ms,
+                .cycle = last_cycle_count,
+                .bpm = p->bpm,
+                .volume_ml = p->volume_ml,
+                .ie_i = p->ie_i,
+                .ie_e = p->ie_e,
+                .pip = p->pip,
+                .peep = p->peep,
+                .plateau_time = p->plateau_time,
+                .m_pip = p->m_pip,
+                .m_peep = p->m_peep,
+                .m_plateau_press = p->m_plateau_press,
+                .m_rr = p->m_rr,
+                .m_ie_i = p->m_ie_i,
+                .m_ie_e = p->m_ie_e,
+                .m_vti = p->m_vti,
+                .m_vte = p->m_vte,
+                .m_minute_volume = p->m_minute_volume,
+                .m_compliance = p->m_compliance,
+                .m_resistance = p->m_resistance,
+        };
+        send(Telemetry_Record::BREATH, &breath, sizeof(breath));
+    }
+}
+
+void Telemetry::update_samples()
+{
+    telemetry_samples record;
+
+    if (!adc_sampler_running()) {
+        // No sampler, one reading per control tick.
+        record.first_sample = next_sample++;
+        record.rate_hz = 1000000UL / CONTROL_HANDLER_PERIOD_US;
+        record.count = 1;
+        record.samples[0].pressure = q16_to_centi(p_gauge_sensor->get_pressure_q16<Units_pressure::cmH20>());
+        record.samples[0].flow = q16_to_centi(p_diff_sensor->get_flow_q16<Units_flow::lpm, Order_type::third>(true));
+        send(Telemetry_Record::SAMPLES, &record, sizeof(record) - sizeof(record.samples) + sizeof(telemetry_sample));
+        return;
+    }
+
+#if USE_ADC_SAMPLER
+    adc_sample_pair pairs[TELEMETRY_MAX_SAMPLES];
+    for (;;) {
+        uint32_t count = adc_sampler_read_pairs(next_sample, pairs, TELEMETRY_MAX_SAMPLES);
+        if (count == 0) {
+            break;
+        }
+
+        record.first_sample = next_sample - count;
+        record.rate_hz = ADC_SAMPLER_RATE_HZ;
+        record.count = count;
+        for (uint32_t i = 0; i < count; i++) {
+            record.samples[i].pressure = q16_to_centi(pairs[i].pressure);
+            record.samples[i].flow = q16_to_centi(pairs[i].flow);
+        }
+        send(Telemetry_Record::SAMPLES, &record, sizeof(record) - sizeof(record.samples) + count * sizeof(telemetry_sample));
+    }
+#endif
+}
+
+bool Telemetry::send(Telemetry_Record type, const void* payload, uint16_t length)
+{
+    uint8_t raw[TELEMETRY_MAX_RAW];
+    raw[0] = TELEMETRY_VERSION;
+    raw[1] = (uint8_t) type;
+    raw[2] = sequence & 0xFF;
+    raw[3] = sequence >> 8;
+    memcpy(&raw[TELEMETRY_HEADER_BYTES], payload, length);
+
+    CRC32 crc;
+    uint32_t raw_length = TELEMETRY_HEADER_BYTES + length;
+    uint32_t checksum = crc.calculate(raw, raw_length);
+    memcpy(&raw[raw_length], &checksum, TELEMETRY_CRC_BYTES);
+    raw_length += TELEMETRY_CRC_BYTES;
+
+    // The sequence counts dropped frames too, so the gaps show.
+    sequence++;
+
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    frame[0] = 0;
+    uint32_t frame_length = 1 + cobs_encode(raw, raw_length, &frame[1]);
+    frame[frame_length++] = 0;
+
+    uint32_t head = queue_head;
+    uint32_t free_bytes = TELEMETRY_BUFFER_BYTES - (head - queue_tail);
+    if (frame_length > free_bytes) {
+        frames_dropped++;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < frame_length; i++) {
+        queue[(head + i) & (TELEMETRY_BUFFER_BYTES - 1)] = frame[i];
+    }
+    __sync_synchronize();
+    queue_head = head + frame_length;
+    frames_queued++;
+
+    return true;
+}
+
+void Telemetry::service()
+{
+    uint32_t tail = queue_tail;
+    uint32_t queued = queue_head - tail;
+    __sync_synchronize();
+
+    int room = TELEMETRY_SERIAL.availableForWrite();
+    while (queued > 0 && room > 0) {
+        // Up to the end of the queue, the rest on the next pass.
+        uint32_t start = tail & (TELEMETRY_BUFFER_BYTES - 1);
+        uint32_t length = TELEMETRY_BUFFER_BYTES - start;
+        if (length > queued) {
+            length = queued;
+        }
+        if (length > (uint32_t) room) {
+            length = room;
+        }
+
+        TELEMETRY_SERIAL.write(&queue[start], length);
+        tail += length;
+        queued -= length;
+        room -= length;
+    }
+
+    __sync_synchronize();
+    queue_tail = tail;
+}
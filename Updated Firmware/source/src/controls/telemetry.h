@@ -0,0 +1,134 @@
+#ifndef UVENT_TELEMETRY_H
+#define UVENT_TELEMETRY_H
+
+#include "../config/uvent_conf.h"
+#include "machine.h"
+#include <Arduino.h>
+
+/* Binary telemetry stream on TELEMETRY_SERIAL.
+ *
+ * Pressure and flow at the sampling rate, the paddle position and state every
+ * control tick, each state change, and the waveform parameters once a breath.
+ * tools/telemetry.py decodes and records it on the host.
+ *
+ * Frame, little endian:
+ *   version u8, record type u8, sequence u16, payload, CRC32 u32 of all before it
+ * COBS encoded, so there is no 0 byte in it, with a 0 byte either side.
+ * Text on the same port, e.g. command replies, ends up between frames and
+ * fails the CRC, the decoder drops it.
+ *
+ * Records are built and queued by update(), from the control handler, and
+ * service() hands them to the port from loop(), as much as the port takes
+ * without waiting. If the queue is full a whole record is dropped, never part
+ * of one. The sequence number shows the gaps.
+ *
+ * Off until set_enable(true).
+ */
+
+#define TELEMETRY_VERSION 2
+
+// Most samples in one record, more than one control tick's worth.
+#define TELEMETRY_MAX_SAMPLES 32
+
+enum class Telemetry_Record : uint8_t {
+    SAMPLES = 1,
+    TICK = 2,
+    STATE = 3,
+    BREATH = 4
+};
+
+struct __attribute__((packed)) telemetry_sample {
+    int16_t pressure;// cmH2O / 100
+    int16_t flow;    // L/min / 100
+};
+
+struct __attribute__((packed)) telemetry_samples {
+    uint32_t first_sample;// Running count of the first sample, consecutive records follow on
+    uint16_t rate_hz;
+    uint8_t count;
+    telemetry_sample samples[TELEMETRY_MAX_SAMPLES];// Only count of them are sent
+};
+
+struct __attribute__((packed)) telemetry_tick {
+    uint32_t time_ms;
+    uint8_t state;
+    int16_t position;// degrees / 100
+};
+
+struct __attribute__((packed)) telemetry_state {
+    uint32_t time_ms;
+    uint8_t from;
+    uint8_t to;
+};
+
+struct __attribute__((packed)) telemetry_breath {
+    uint32_t time_ms;
+    uint32_t cycle;
+    // Set
+    uint16_t bpm;
+    float volume_ml;
+    float ie_i;
+    float ie_e;
+    uint16_t pip;
+    uint16_t peep;
+    uint16_t plateau_time;
+    // Measured, for the breath before
+    float m_pip;
+    float m_peep;
+    float m_plateau_press;
+    float m_rr;
+    float m_ie_i;
+    float m_ie_e;
+    float m_vti;
+    float m_vte;
+    float m_minute_volume;
+    float m_compliance;
+    float m_resistance;
+};
+
+class Telemetry {
+public:
+    Telemetry(Machine* machine, Actuator* actuator, PressureSensor* gauge_sensor, PressureSensor* diff_sensor,
+              Waveform* waveform, uint32_t* cycle_count);
+
+    void set_enable(bool enable);
+    bool is_enabled() const { return enabled; }
+
+    // Builds the records for this tick. Call from the control handler, after the state machine.
+    void update();
+
+    // Writes queued records to the port, without blocking. Call from loop().
+    void service();
+
+    uint32_t get_frames_queued() const { return frames_queued; }
+    uint32_t get_frames_dropped() const { return frames_dropped; }
+
+private:
+    void update_samples();
+    bool send(Telemetry_Record type, const void* payload, uint16_t length);
+
+    Machine* p_machine;
+    Actuator* p_actuator;
+    PressureSensor* p_gauge_sensor;
+    PressureSensor* p_diff_sensor;
+    Waveform* p_waveform;
+    uint32_t* p_cycle_count;
+
+    volatile bool enabled = false;
+    bool started = false;
+
+    uint16_t sequence = 0;
+    uint32_t next_sample = 0;
+    uint32_t last_cycle_count = 0;
+    States last_state = States::ST_STARTUP;
+
+    // Encoded frames on their way to the port. Written by update(), read by service().
+    uint8_t queue[TELEMETRY_BUFFER_BYTES];
+    volatile uint32_t queue_head = 0;
+    volatile uint32_t queue_tail = 0;
+
+    volatile uint32_t frames_queued = 0;
+    volatile uint32_t frames_dropped = 0;
+};
+
+#endif
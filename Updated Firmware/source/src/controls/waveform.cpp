@@ -2,6 +2,7 @@
 #include "utilities/util.h"
 #include "utilities/logging.h"
 #include "waveform.h"
+#include "sensors/breath_analyzer.h"
 
 waveform_params* Waveform::get_params(void)
 {
@@ -68,19 +69,6 @@ void Waveform::display_details() const
     serial_printf("plateau:\t %d\n", params.plateau_time);
 }
 
-void Waveform::set_pip_peak_and_reset()
-{
-    m_pip_peak = current_m_pip_peak;
-    current_m_pip_peak = 0.0;
-}
-
-void Waveform::set_current_pip(float pip_value)
-{
-    // Set measured pip. Compare the incoming with previous value, to get the max.
-    params.m_pip = max(pip_value, current_m_pip_peak);
-    current_m_pip_peak = params.m_pip;
-}
-
 void Waveform::reset_measured_params()
 {
     params.m_pip = 0.0;
@@ -90,51 +78,25 @@ void Waveform::reset_measured_params()
     params.m_ie_i = 0.0;
     params.m_ie_e = 0.0;
     params.m_tidal_volume = 0.0;
+    params.m_vti = 0.0;
+    params.m_vte = 0.0;
+    params.m_minute_volume = 0.0;
+    params.m_compliance = 0.0;
+    params.m_resistance = 0.0;
 }
 
-void Waveform::calculate_respiration_rate()
+void Waveform::set_measured_params(const breath_record& breath)
 {
-    float breath_time_s = now_s() - params.tCycleTimer;
-
-    // Convert to breaths per minute
-    params.m_rr = 60.0 / breath_time_s;
-}
-
-void Waveform::mark_inspiration_time(float now)
-{
-    inspiration_time = now - params.tCycleTimer;
-}
-
-void Waveform::mark_expiration_time(float now)
-{
-    // Substract inspiration time.
-    expiration_time = now - params.tCycleTimer - inspiration_time;
-}
-
-void Waveform::calculate_current_parameters()
-{
-    // Current respiration rate in breaths per minute
-    params.m_rr = round(60.0 / (now_s() - params.tCycleTimer));
-
-    float total_i_e_time = inspiration_time + expiration_time;
-
-    // Calculate slice of each part from the total ie time.
-    float i_slice = inspiration_time / total_i_e_time;
-    float e_slice = expiration_time / total_i_e_time;
-
-    // Calculated IE ratios change on which time was larger.
-    if (expiration_time > inspiration_time) {
-        // Current i in ie
-        params.m_ie_i = 1;// i_slice / i_slice;
-
-        // Current e in ie
-        params.m_ie_e = e_slice / i_slice;
-    }
-    else {
-        // Current i in ie
-        params.m_ie_i = i_slice / e_slice;// i_slice / i_slice;
-
-        // Current e in ie
-        params.m_ie_e = 1;// e_slice / e_slice;
-    }
+    params.m_pip = breath.pip;
+    params.m_peep = breath.peep;
+    params.m_plateau_press = breath.plateau;
+    params.m_rr = breath.rr;
+    params.m_ie_i = breath.ie_i;
+    params.m_ie_e = breath.ie_e;
+    params.m_tidal_volume = breath.vti_ml;
+    params.m_vti = breath.vti_ml;
+    params.m_vte = breath.vte_ml;
+    params.m_minute_volume = breath.minute_volume_l;
+    params.m_compliance = breath.compliance;
+    params.m_resistance = breath.resistance;
 }
\ No newline at end of file
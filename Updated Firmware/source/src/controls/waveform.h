@@ -25,9 +25,16 @@ struct waveform_params {
     float m_rr;           // Measured respiration rate as breaths per minute
     float m_ie_i;         // Measured I of IE ratio
     float m_ie_e;         // Measured E of IE ratio
-    float m_tidal_volume; // Estimated volume during inspiration.
+    float m_tidal_volume; // Measured volume during inspiration, same as m_vti.
+    float m_vti;          // Measured inspired volume (mL)
+    float m_vte;          // Measured expired volume (mL)
+    float m_minute_volume;// Measured expired volume per minute (L/min)
+    float m_compliance;   // Measured static compliance (mL/cmH2O)
+    float m_resistance;   // Measured inspiratory resistance (cmH2O/(L/s))
 };
 
+struct breath_record;
+
 class Waveform {
 public:
     waveform_params* get_params();
@@ -37,22 +44,12 @@ public:
     bool is_expiration_done();
     bool is_peep_pause_done();
     void display_details() const;
-    void set_pip_peak_and_reset();
-    void set_current_pip(float pip_value);
     void reset_measured_params();
-    void calculate_respiration_rate();
-    void mark_inspiration_time(float now);
-    void mark_expiration_time(float now);
-    void calculate_current_parameters();
+    void set_measured_params(const breath_record& breath);
 
 private:
     const float MIN_PEEP_PAUSE = 0.05;// Time (s) to pause after exhalation / before watching for an assisted inhalation
 
-    float m_pip_peak;        // Max of pip.
-    float current_m_pip_peak;// Keeps track of max measured pip in a breath cycle.
-    float inspiration_time;
-    float expiration_time;
-
     waveform_params params = {      // JOSH PRESSURE     need to add pressure to this?
             .tCycleTimer = 0,
             .tIn = 0.0,
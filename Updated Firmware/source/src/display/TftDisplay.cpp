@@ -1,7 +1,9 @@
 #include <utilities/util.h>
 #include <function_timings.h>
 #include <utilities/logging.h>
+#include <utilities/perf.h>
 #include "TftDisplay.h"
+#include "flush_pipeline.h"
 #include "../../config/uvent_conf.h"
 
 uint32_t debug_toggle_timer = 0;
@@ -11,6 +13,11 @@ void wrapped_flush_display(struct _lv_disp_drv_t* lv_disp_drv, const lv_area_t*
     static_cast<TftDisplay*>(lv_disp_drv->user_data)->flush_display(lv_disp_drv, area, color_p);
 }
 
+void wrapped_wait_for_flush(struct _lv_disp_drv_t* lv_disp_drv)
+{
+    static_cast<TftDisplay*>(lv_disp_drv->user_data)->wait_for_flush(lv_disp_drv);
+}
+
 void wrapped_read_inputs(struct _lv_indev_drv_t* lv_indev_drv, lv_indev_data_t* data)
 {
     static_cast<TftDisplay*>(lv_indev_drv->user_data)->read_inputs(lv_indev_drv, data);
@@ -51,19 +58,15 @@ bool TftDisplay::init()
     lv_init();
 
 #if USE_DMA_INTERRUPT
+    // LVGL renders into one buffer while the DMA sends the other.
     Serial.println("Compiled with DMA & Interrupts, allocating second pixel buffer...");
     lv_disp_draw_buf_init(&lv_screen_buffer, pixel_buffer_1, pixel_buffer_2, BUFFER_SIZE);
-    lv_screen_buffer.buf1 = pixel_buffer_1;
-    lv_screen_buffer.buf2 = pixel_buffer_2;
-    lv_screen_buffer.buf_act = lv_screen_buffer.buf1;
-    lv_screen_buffer.size = BUFFER_SIZE;
+    display_flush_init(&lv_screen_buffer, DISPLAY_BUFFER_LINES, true);
 #else
+    // The CPU sends each strip itself, nothing overlaps, so the tallest strip is always best.
     Serial.println("Compiled without DMA & Interrupts, no additional buffer required...");
     lv_disp_draw_buf_init(&lv_screen_buffer, pixel_buffer_1, nullptr, BUFFER_SIZE);
-    lv_screen_buffer.buf1 = pixel_buffer_1;
-    lv_screen_buffer.buf2 = nullptr;
-    lv_screen_buffer.buf_act = lv_screen_buffer.buf1;
-    lv_screen_buffer.size = BUFFER_SIZE;
+    display_flush_init(&lv_screen_buffer, DISPLAY_BUFFER_LINES, false);
 #endif
 
     lv_disp_drv_init(&lv_display_driver);                 // Initialize the display
@@ -71,6 +74,7 @@ bool TftDisplay::init()
     lv_display_driver.hor_res = SCREEN_WIDTH;             // Set Resolution
     lv_display_driver.ver_res = SCREEN_HEIGHT;
     lv_display_driver.flush_cb = wrapped_flush_display;     // Callback for display writing
+    lv_display_driver.wait_cb = wrapped_wait_for_flush;     // Callback while both buffers are busy
     lv_display_driver.draw_buf = &lv_screen_buffer;
     lv_disp_drv_register(&lv_display_driver);             // register Display
 
@@ -96,11 +100,14 @@ void TftDisplay::flush_display(struct _lv_disp_drv_t* lv_disp_drv, const lv_area
     lv_coord_t width = lv_area_get_width(area);
     lv_coord_t height = lv_area_get_height(area);
 
+    display_flush_started(width * height);
+
 #if USE_DMA_INTERRUPT
 
     tft_display.drawPixelsAreaDMA((uint16_t*) color_p, width * height, area->x1, area->y1, width,
             &lv_display_driver,
             [](void* cb_data) {
+                display_flush_done();
                 lv_disp_flush_ready((lv_disp_drv_t*) cb_data);
             });
 
@@ -115,9 +122,21 @@ void TftDisplay::flush_display(struct _lv_disp_drv_t* lv_disp_drv, const lv_area
 
 void TftDisplay::flush_display_complete()
 {
+    display_flush_done();
     lv_disp_flush_ready(&lv_display_driver);
 }
 
+void TftDisplay::wait_for_flush(struct _lv_disp_drv_t* lv_disp_drv)
+{
+    LV_UNUSED(lv_disp_drv);
+
+    uint32_t start = perf_cycles();
+    if (flush_wait_hook) {
+        flush_wait_hook();
+    }
+    display_flush_waited(perf_cycles() - start);
+}
+
 void TftDisplay::onDMAInterrupt()
 {
 #if USE_DMA_INTERRUPT
@@ -158,5 +177,9 @@ void TftDisplay::update()
     if (!RA_GET_DEBUG_STATE() && has_time_elapsed(&debug_toggle_timer, 10000)) {
         RA_SET_DEBUG(true);
     }
+
+    PerfScope perf(Perf_Probe::LV_TASK_HANDLER);
+    display_flush_frame_begin();
     lv_task_handler();
+    display_flush_frame_end();
 }
\ No newline at end of file
@@ -38,10 +38,12 @@
 #define MINPRESSURE 40
 #define MAXPRESSURE 1000
 
-#define BUFFER_SIZE (SCREEN_WIDTH * 15)
+#define BUFFER_SIZE (SCREEN_WIDTH * DISPLAY_BUFFER_LINES)
 
 void wrapped_flush_display(struct _lv_disp_drv_t* lv_disp_drv, const lv_area_t* area, lv_color_t* color_p);
 
+void wrapped_wait_for_flush(struct _lv_disp_drv_t* lv_disp_drv);
+
 void wrapped_read_inputs(struct _lv_indev_drv_t* lv_indev_drv, lv_indev_data_t* data);
 
 /**
@@ -98,6 +100,21 @@ public:
 
     void flush_display_complete();
 
+    /**
+     * <p>
+     * Registered with LVGL on init.
+     * Called over and over while LVGL has a strip ready and both buffers are busy.
+     * Runs the flush wait hook, and counts the time for the flush stats (flush_pipeline.h).
+     * </p>
+     */
+    void wait_for_flush(struct _lv_disp_drv_t* lv_disp_drv);
+
+    /**
+     * Sets the work done while LVGL waits for the display, instead of spinning.
+     * It runs in the middle of lv_task_handler(), so it must not touch LVGL.
+     */
+    void set_flush_wait_hook(void (*hook)()) { flush_wait_hook = hook; }
+
     void onDMAInterrupt();
 
 protected:
@@ -112,6 +129,8 @@ private:
     lv_color_t pixel_buffer_2[BUFFER_SIZE]{};
 #endif
     lv_indev_drv_t lv_input_driver{};
+
+    void (*flush_wait_hook)() = nullptr;
 };
 
 #endif //UVENT_TFTDISPLAY_H
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include "flush_pipeline.h"
+#include "utilities/perf.h"
+#include "utilities/util.h"
+
+// A trial strip height is kept if its frames are this much faster per pixel, the rest is noise.
+#define DISPLAY_TUNE_MARGIN 0.97f
+
+static lv_disp_draw_buf_t* p_draw_buf = nullptr;
+static uint16_t buffer_lines = 0;
+static bool tuning = false;
+
+static display_flush_stats stats{};
+static uint32_t stats_start_ms = 0;
+
+// The pass of lv_task_handler() going on.
+static uint32_t frame_start = 0;
+static uint32_t frame_strips = 0;
+static uint32_t frame_px = 0;
+static uint32_t frame_wait = 0;
+
+// A frame whose last flush was still going when lv_task_handler() returned.
+static bool tail_pending = false;
+static uint32_t tail_start = 0;
+static uint32_t tail_px = 0;
+
+// Written by display_flush_done(), from the DMA interrupt.
+static volatile bool flushing = false;
+static volatile uint32_t flush_start = 0;
+static volatile uint32_t last_done = 0;
+static volatile uint64_t bus_cycles = 0;
+
+// Strip height tuning: the height in use, one being tried, and the frames measured.
+static uint16_t strip_lines = 0;
+static uint16_t trial_lines = 0;
+static int8_t trial_direction = 1;
+static float strip_score = 0;
+static uint64_t tune_cycles = 0;
+static uint64_t tune_px = 0;
+static uint32_t tune_frames = 0;
+
+static void set_strip_lines(uint16_t lines)
+{
+    p_draw_buf->size = (uint32_t) lines * SCREEN_WIDTH;
+    stats.strip_lines = lines;
+}
+
+/* Every DISPLAY_TUNE_FRAMES frames: measure the height in use, then try a
+ * neighbour of it, and move to the neighbour if it was faster.
+ */
+static void tune_strip(uint32_t cycles, uint32_t px)
+{
+    tune_cycles += cycles;
+    tune_px += px;
+    if (++tune_frames < DISPLAY_TUNE_FRAMES) {
+        return;
+    }
+
+    float score = tune_px ? (float) tune_cycles / tune_px : 0;
+    tune_cycles = 0;
+    tune_px = 0;
+    tune_frames = 0;
+
+    if (trial_lines) {
+        if (score < strip_score * DISPLAY_TUNE_MARGIN) {
+            strip_lines = trial_lines;
+        }
+        else {
+            trial_direction = -trial_direction;
+        }
+        trial_lines = 0;
+        set_strip_lines(strip_lines);
+        return;
+    }
+
+    strip_score = score;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int32_t lines = strip_lines + trial_direction * DISPLAY_STRIP_STEP_LINES;
+        if (lines >= DISPLAY_STRIP_MIN_LINES && lines <= buffer_lines) {
+            trial_lines = lines;
+            set_strip_lines(trial_lines);
+            return;
+        }
+        trial_direction = -trial_direction;
+    }
+}
+
+static void frame_done(uint32_t cycles, uint32_t px)
+{
+    stats.frame_cycles += cycles;
+    if (tuning) {
+        tune_strip(cycles, px);
+    }
+}
+
+// A frame's last flush that ended after lv_task_handler() returned.
+static void check_tail()
+{
+    if (tail_pending && !flushing) {
+        tail_pending = false;
+        frame_done(last_done - tail_start, tail_px);
+    }
+}
+
+void display_flush_init(lv_disp_draw_buf_t* draw_buf, uint16_t max_lines, bool tune)
+{
+    p_draw_buf = draw_buf;
+    buffer_lines = max_lines;
+    tuning = tune && max_lines > DISPLAY_STRIP_MIN_LINES;
+    strip_lines = max_lines;
+    display_flush_reset();
+    set_strip_lines(strip_lines);
+}
+
+uint16_t display_flush_merge_areas(lv_disp_t* disp)
+{
+    uint16_t merged = 0;
+    for (uint16_t i = 0; i < disp->inv_p; i++) {
+        for (uint16_t j = i + 1; j < disp->inv_p; j++) {
+            lv_area_t box;
+            _lv_area_join(&box, &disp->inv_areas[i], &disp->inv_areas[j]);
+            uint32_t apart = lv_area_get_size(&disp->inv_areas[i]) + lv_area_get_size(&disp->inv_areas[j]);
+            if (lv_area_get_size(&box) > apart + DISPLAY_MERGE_SLACK_PX) {
+                continue;
+            }
+
+            // j goes into i, and i may reach others it didn't before, so start over from it.
+            lv_area_copy(&disp->inv_areas[i], &box);
+            for (uint16_t k = j; k + 1 < disp->inv_p; k++) {
+                lv_area_copy(&disp->inv_areas[k], &disp->inv_areas[k + 1]);
+            }
+            disp->inv_p--;
+            merged++;
+            j = i;
+        }
+    }
+    return merged;
+}
+
+void display_flush_frame_begin()
+{
+    check_tail();
+
+    lv_disp_t* disp = lv_disp_get_default();
+    if (disp) {
+        stats.areas += disp->inv_p;
+        stats.merged += display_flush_merge_areas(disp);
+    }
+
+    frame_strips = 0;
+    frame_px = 0;
+    frame_wait = 0;
+    frame_start = perf_cycles();
+}
+
+void display_flush_frame_end()
+{
+    uint32_t now = perf_cycles();
+    stats.render_cycles += now - frame_start - frame_wait;
+    stats.wait_cycles += frame_wait;
+    if (frame_strips == 0) {
+        return;
+    }
+
+    stats.frames++;
+    if (flushing) {
+        tail_pending = true;
+        tail_start = frame_start;
+        tail_px = frame_px;
+    }
+    else {
+        frame_done(last_done - frame_start, frame_px);
+    }
+}
+
+void display_flush_started(uint32_t px)
+{
+    // A frame may start while the last one's tail is still going, LVGL waits for it first.
+    check_tail();
+
+    frame_strips++;
+    frame_px += px;
+    stats.strips++;
+    stats.flushed_px += px;
+
+    flush_start = perf_cycles();
+    flushing = true;
+}
+
+void display_flush_done()
+{
+    uint32_t now = perf_cycles();
+    bus_cycles += now - flush_start;
+    last_done = now;
+    flushing = false;
+}
+
+void display_flush_waited(uint32_t cycles)
+{
+    frame_wait += cycles;
+}
+
+void display_flush_get_stats(display_flush_stats& out)
+{
+    noInterrupts();
+    out = stats;
+    out.bus_cycles = bus_cycles;
+    interrupts();
+    out.elapsed_ms = now_ms() - stats_start_ms;
+}
+
+void display_flush_reset()
+{
+    noInterrupts();
+    uint16_t lines = stats.strip_lines;
+    stats = {};
+    stats.strip_lines = lines;
+    bus_cycles = 0;
+    interrupts();
+    stats_start_ms = now_ms();
+}
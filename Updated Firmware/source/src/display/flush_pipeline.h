@@ -0,0 +1,77 @@
+#ifndef UVENT_FLUSH_PIPELINE_H
+#define UVENT_FLUSH_PIPELINE_H
+
+#include <lvgl.h>
+#include "../../config/uvent_conf.h"
+
+/* What goes on between LVGL and the display, from loop().
+ *
+ * With two draw buffers LVGL renders the next strip into one while the DMA
+ * sends the other. It only waits when it's done with a strip before the send
+ * is, and the display driver's wait_cb spends that on loop() work that doesn't
+ * touch LVGL. The last strip of a frame is never waited for.
+ *
+ * Before each pass of lv_task_handler(), invalidated areas are merged when the
+ * box around two of them adds fewer than DISPLAY_MERGE_SLACK_PX pixels: LVGL
+ * only joins areas that overlap, and every area is rendered and sent on its
+ * own, with a window set on the RA8875 for it, so two charts' strips or a row
+ * of labels side by side cost less as one.
+ *
+ * The strip height, how much of a buffer LVGL fills, is tuned from what frames
+ * take: every DISPLAY_TUNE_FRAMES frames that drew something, the mean time
+ * from the start of a frame's render to the end of its last flush, per pixel,
+ * is compared with a strip DISPLAY_STRIP_STEP_LINES taller or shorter, and the
+ * faster one kept. Short strips overlap rendering and sending more closely, tall
+ * ones cost fewer windows and passes over the screen's objects, and which wins
+ * depends on how long rendering takes next to the SPI transfer.
+ *
+ * Timing is on the perf cycle counter. The stats cover the time since the last reset.
+ */
+
+struct display_flush_stats {
+    uint32_t elapsed_ms;    // Time the stats cover
+    uint32_t frames;        // Passes of lv_task_handler() that flushed
+    uint32_t strips;        // Flushes
+    uint64_t flushed_px;
+    uint64_t render_cycles; // In lv_task_handler(), less the waits
+    uint64_t wait_cycles;   // Waiting for the display to take a buffer
+    uint64_t bus_cycles;    // From a flush starting to it being done
+    uint64_t frame_cycles;  // From a frame starting to its last flush being done
+    uint32_t areas;         // Invalidated, before merging
+    uint32_t merged;        // Taken into another one
+    uint16_t strip_lines;   // Now
+};
+
+/**
+ * Starts the stats, and the tuning of the strip height if tune is set.
+ *
+ * @param draw_buf LVGL's draw buffer, its size is the strip height.
+ * @param max_lines Lines each of its buffers has room for.
+ */
+void display_flush_init(lv_disp_draw_buf_t* draw_buf, uint16_t max_lines, bool tune);
+
+/**
+ * Merges the display's invalidated areas, see above.
+ *
+ * @return The number of areas taken into another one.
+ */
+uint16_t display_flush_merge_areas(lv_disp_t* disp);
+
+/**
+ * Call before and after lv_task_handler(). Merges the areas.
+ */
+void display_flush_frame_begin();
+void display_flush_frame_end();
+
+// From the flush callback, before the send starts, and when it's done, from the interrupt if DMA.
+void display_flush_started(uint32_t px);
+void display_flush_done();
+
+// Time LVGL spent waiting for a buffer, from the driver's wait_cb.
+void display_flush_waited(uint32_t cycles);
+
+void display_flush_get_stats(display_flush_stats& out);
+
+void display_flush_reset();
+
+#endif//UVENT_FLUSH_PIPELINE_H
@@ -283,7 +283,7 @@ static void add_volume_mode_select_button()                                    /
 
         auto change_volume_cb = [](lv_event_t* evt) {
 
-            control_change_mode(ControlModes::PCV);
+            control_change_mode(ControlModes::VCV);
         
         };
         
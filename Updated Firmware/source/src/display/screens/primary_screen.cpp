@@ -3,6 +3,9 @@
 #include <controls/control.h>
 #include "screen.h"
 
+static_assert(CHART_TIME_BASE_MS_VALID(GAUGE_PRESSURE_CHART_TIME_BASE_MS), "GAUGE_PRESSURE_CHART_TIME_BASE_MS must be 0, 6000, 12000 or 24000");
+static_assert(CHART_TIME_BASE_MS_VALID(FLOW_CHART_TIME_BASE_MS), "FLOW_CHART_TIME_BASE_MS must be 0, 6000, 12000 or 24000");
+
 MainScreen::MainScreen()
         : Screen()
 {
@@ -15,7 +18,9 @@ MainScreen::MainScreen()
             FLOW_CHART_REFRESH_TIME,
             FLOW_CHART_LINE_MODE,
             FLOW_CHART_DOT_SIZE,
-            FLOW_CHART_LINE_WIDTH
+            FLOW_CHART_LINE_WIDTH,
+            FLOW_CHART_SWEEP,
+            FLOW_CHART_TIME_BASE_MS
     );
     //if(pcv == false) {
     charts[CHART_IDX_PRESSURE] = SensorChart(
@@ -26,7 +31,9 @@ MainScreen::MainScreen()
             GAUGE_PRESSURE_CHART_REFRESH_TIME,
             GAUGE_PRESSURE_CHART_LINE_MODE,
             GAUGE_PRESSURE_CHART_DOT_SIZE,
-            GAUGE_PRESSURE_CHART_LINE_WIDTH
+            GAUGE_PRESSURE_CHART_LINE_WIDTH,
+            GAUGE_PRESSURE_CHART_SWEEP,
+            GAUGE_PRESSURE_CHART_TIME_BASE_MS
     );
     //}
 
@@ -142,9 +149,14 @@ void MainScreen::generate_charts()
     // else if(pcv == true) {
     // charts[CHART_IDX_VOLUME].generate_chart(chart_container, TIDAL_VOLUME);     // JOSH PRESSURE    cur_volume?
     // }
+
+    // The charts share the container's width, it is only known once they are all in.
+    for (auto& chart : charts) {
+        chart.fit_to_width();
+    }
 }
 
-const SensorChart* MainScreen::get_chart(uint8_t idx)
+SensorChart* MainScreen::get_chart(uint8_t idx)
 {
     if (idx >= MAIN_SCREEN_CHART_COUNT) {
         return nullptr;
@@ -26,7 +26,7 @@ public:
 
     void open_config();
     void attach_settings_cb();
-    const SensorChart* get_chart(uint8_t idx);
+    SensorChart* get_chart(uint8_t idx);
     void try_refresh_charts();
 private:
     void generate_charts();
@@ -0,0 +1,357 @@
+#include "black_box.h"
+#include "utilities/logging.h"
+#include "utilities/i2c_bus.h"
+#include "utilities/util.h"
+#include <CRC32.h>
+
+#define BLACK_BOX_ENTRY_BYTES 16
+#define BLACK_BOX_ENTRIES (EXT_EEPROM_BLACK_BOX_BYTES / BLACK_BOX_ENTRY_BYTES)
+
+static_assert(sizeof(black_box_entry) == BLACK_BOX_ENTRY_BYTES, "A black box entry must be 16 bytes");
+static_assert(EXT_EEPROM_PAGE_BYTES % BLACK_BOX_ENTRY_BYTES == 0, "Black box entries must not cross a page");
+static_assert(EXT_EEPROM_BLACK_BOX_LOC % EXT_EEPROM_PAGE_BYTES == 0 && EXT_EEPROM_BLACK_BOX_BYTES % EXT_EEPROM_PAGE_BYTES == 0,
+              "The black box must be whole pages");
+static_assert(EXT_EEPROM_BLACK_BOX_LOC >= EXT_EEPROM_JOURNAL_LOC + (uint32_t) EXT_EEPROM_JOURNAL_SLOTS * EXT_EEPROM_JOURNAL_SLOT_BYTES,
+              "The black box runs into the settings journal");
+static_assert(EXT_EEPROM_BLACK_BOX_LOC + EXT_EEPROM_BLACK_BOX_BYTES <= EEPROM_TEST_1_MEM_1, "The black box runs into the EEPROM test area");
+
+static uint16_t entry_check(const black_box_entry& entry)
+{
+    return (uint16_t) CRC32::calculate((const uint8_t*) &entry, offsetof(black_box_entry, check));
+}
+
+static bool entry_is_intact(const black_box_entry& entry, uint32_t slot)
+{
+    return entry.sequence % BLACK_BOX_ENTRIES == slot && entry.check == entry_check(entry);
+}
+
+// The steps of a breath, going from one to the next is already in the breath's entry.
+static bool is_breath_state(States state)
+{
+    return state >= States::ST_INSPR && state <= States::ST_EXPR_HOLD;
+}
+
+// cmH2O in half cmH2O, held to a byte.
+static uint8_t pressure_to_half(float cmh2o)
+{
+    float half = cmh2o * 2 + 0.5f;
+    return half <= 0 ? 0 : (half >= 255 ? 255 : (uint8_t) half);
+}
+
+// mL in 8 mL, held to a byte.
+static uint8_t volume_to_eighth(float ml)
+{
+    float eighth = ml / 8 + 0.5f;
+    return eighth <= 0 ? 0 : (eighth >= 255 ? 255 : (uint8_t) eighth);
+}
+
+bool BlackBox::init()
+{
+    // The search for the newest entry and the boot entry hold it too.
+    I2cBusLock lock;
+    if (external_eeprom.begin() == false) {
+        return false;
+    }
+
+    external_eeprom.setMemorySize(EXT_EEPROM_SIZE_BYTES);
+    external_eeprom.setPageSize(EXT_EEPROM_PAGE_BYTES);
+
+    black_box_entry newest;
+    next_sequence = find_newest(newest) ? newest.sequence + 1 : 0;
+    written = next_sequence;
+    queue_head = 0;
+    queue_tail = 0;
+    ready = true;
+
+    record(Black_Box_Event::BOOT, nullptr);
+    return true;
+}
+
+void BlackBox::update()
+{
+    if (!ready) {
+        return;
+    }
+
+    uint8_t data[sizeof(black_box_entry::data)];
+
+    const breath_record& breath = p_breath_analyzer->get_last_breath();
+    if (breath.number != last_breath_number) {
+        last_breath_number = breath.number;
+        if (breath.number != 0) {
+            memset(data, 0, sizeof(data));
+            data[0] = pressure_to_half(breath.pip);
+            data[1] = pressure_to_half(breath.plateau);
+            data[2] = pressure_to_half(breath.peep);
+            data[3] = volume_to_eighth(breath.vti_ml);
+            data[4] = volume_to_eighth(breath.vte_ml);
+            record(Black_Box_Event::BREATH, data);
+        }
+    }
+
+    uint16_t alarm_mask = p_alarm_manager->onMask();
+    if (alarm_mask != last_alarm_mask) {
+        Alarm* alarms = p_alarm_manager->getAlarmList();
+        for (int i = 0; i < NUM_ALARMS; i++) {
+            if ((alarm_mask ^ last_alarm_mask) & (1 << i)) {
+                memset(data, 0, sizeof(data));
+                data[0] = i;
+                data[1] = alarms[i].isON();
+                data[2] = (uint8_t) alarms[i].alarmLevel();
+                record(Black_Box_Event::ALARM, data);
+            }
+        }
+        last_alarm_mask = alarm_mask;
+    }
+
+    States state = p_machine->get_current_state();
+    if (state != last_state && !(is_breath_state(state) && is_breath_state(last_state))) {
+        memset(data, 0, sizeof(data));
+        data[0] = (uint8_t) last_state;
+        data[1] = (uint8_t) state;
+        record(Black_Box_Event::STATE, data);
+    }
+    last_state = state;
+
+    Fault fault = p_machine->get_fault();
+    if (fault != last_fault) {
+        last_fault = fault;
+        if (fault != Fault::FT_NONE) {
+            memset(data, 0, sizeof(data));
+            data[0] = (uint8_t) fault;
+            data[1] = (uint8_t) state;
+            record(Black_Box_Event::FAULT, data);
+        }
+    }
+}
+
+void BlackBox::record(Black_Box_Event event, const uint8_t* data)
+{
+    if (!ready) {
+        return;
+    }
+
+    // Room for a LOST entry ahead of this one, if any were dropped.
+    uint32_t head = queue_head;
+    uint32_t room = BLACK_BOX_QUEUE_ENTRIES - (head - queue_tail);
+    if (room < (lost > 0 ? 2u : 1u)) {
+        if (lost < UINT16_MAX) {
+            lost++;
+        }
+        lost_total++;
+        return;
+    }
+
+    if (lost > 0) {
+        black_box_entry& entry = queue[head % BLACK_BOX_QUEUE_ENTRIES];
+        entry.sequence = next_sequence++;
+        entry.time_ms = now_ms();
+        entry.event = (uint8_t) Black_Box_Event::LOST;
+        memset(entry.data, 0, sizeof(entry.data));
+        memcpy(entry.data, &lost, sizeof(lost));
+        lost = 0;
+        head++;
+    }
+
+    black_box_entry& entry = queue[head % BLACK_BOX_QUEUE_ENTRIES];
+    entry.sequence = next_sequence++;
+    entry.time_ms = now_ms();
+    entry.event = (uint8_t) event;
+    if (data != nullptr) {
+        memcpy(entry.data, data, sizeof(entry.data));
+    }
+    else {
+        memset(entry.data, 0, sizeof(entry.data));
+    }
+
+    // Only breaths wait for a page to fill.
+    if (event != Black_Box_Event::BREATH) {
+        urgent_until = entry.sequence + 1;
+    }
+    queue_head = head + 1;
+}
+
+void BlackBox::service()
+{
+    if (!ready) {
+        return;
+    }
+
+    while (write_batch(false)) {
+    }
+}
+
+void BlackBox::flush()
+{
+    if (!ready) {
+        return;
+    }
+
+    while (write_batch(true)) {
+    }
+}
+
+/* Writes the queued entries up to the end of the page the first of them is in,
+ * if all is set, an entry other than a breath is waiting, the batch fills the
+ * page, or the first has waited BLACK_BOX_FLUSH_MS. Returns whether it wrote.
+ */
+bool BlackBox::write_batch(bool all)
+{
+    uint32_t tail = queue_tail;
+    uint32_t pending = queue_head - tail;
+    if (pending == 0) {
+        return false;
+    }
+
+    const black_box_entry& first = queue[tail % BLACK_BOX_QUEUE_ENTRIES];
+    uint32_t address = entry_address(first.sequence);
+    uint32_t to_page_end = (EXT_EEPROM_PAGE_BYTES - address % EXT_EEPROM_PAGE_BYTES) / BLACK_BOX_ENTRY_BYTES;
+    uint32_t count = pending < to_page_end ? pending : to_page_end;
+
+    bool due = all || written < urgent_until || count == to_page_end || now_ms() - first.time_ms >= BLACK_BOX_FLUSH_MS;
+    if (!due) {
+        return false;
+    }
+
+    uint8_t buffer[EXT_EEPROM_PAGE_BYTES];
+    for (uint32_t i = 0; i < count; i++) {
+        black_box_entry entry = queue[(tail + i) % BLACK_BOX_QUEUE_ENTRIES];
+        entry.check = entry_check(entry);
+        memcpy(&buffer[i * BLACK_BOX_ENTRY_BYTES], &entry, BLACK_BOX_ENTRY_BYTES);
+    }
+
+    I2cBusLock lock;
+    external_eeprom.write(address, buffer, count * BLACK_BOX_ENTRY_BYTES);
+
+    written = first.sequence + count;
+    queue_tail = tail + count;
+    return true;
+}
+
+uint32_t BlackBox::get_count() const
+{
+    return written < BLACK_BOX_ENTRIES ? written : BLACK_BOX_ENTRIES;
+}
+
+bool BlackBox::get_entry(uint32_t index, black_box_entry& entry)
+{
+    uint32_t count = get_count();
+    if (!ready || index >= count) {
+        return false;
+    }
+
+    uint32_t sequence = written - count + index;
+    return read_entry(sequence % BLACK_BOX_ENTRIES, entry) && entry.sequence == sequence;
+}
+
+void BlackBox::dump(uint32_t count)
+{
+    flush();
+
+    uint32_t stored = get_count();
+    if (count > stored) {
+        count = stored;
+    }
+
+    serial_printf("---- BLACK BOX: %lu of %lu entries ---\n", (unsigned long) count, (unsigned long) stored);
+    for (uint32_t i = stored - count; i < stored; i++) {
+        black_box_entry entry;
+        if (get_entry(i, entry)) {
+            print_entry(entry);
+        }
+        else {
+            serial_printf("%lu: unreadable\n", (unsigned long) (written - stored + i));
+        }
+    }
+    if (lost_total > 0) {
+        serial_printf("Lost since start: %lu\n", (unsigned long) lost_total);
+    }
+}
+
+void BlackBox::print_entry(const black_box_entry& entry)
+{
+    uint32_t ms = entry.time_ms;
+    serial_printf("%lu %lu:%02lu:%02lu.%03lu ", (unsigned long) entry.sequence, (unsigned long) (ms / 3600000),
+                  (unsigned long) (ms / 60000 % 60), (unsigned long) (ms / 1000 % 60), (unsigned long) (ms % 1000));
+
+    uint8_t state_count;
+    const char** states = p_machine->get_state_list(&state_count);
+    const uint8_t* d = entry.data;
+
+    switch ((Black_Box_Event) entry.event) {
+        case Black_Box_Event::BOOT:
+            serial_printf("BOOT\n");
+            break;
+        case Black_Box_Event::BREATH:
+            serial_printf("BREATH pip %.1f plat %.1f peep %.1f vti %u vte %u\n", d[0] / 2.0, d[1] / 2.0, d[2] / 2.0, d[3] * 8, d[4] * 8);
+            break;
+        case Black_Box_Event::ALARM:
+            serial_printf("ALARM %s %s\n", d[0] < NUM_ALARMS ? p_alarm_manager->getAlarmList()[d[0]].text() : "?", d[1] ? "on" : "off");
+            break;
+        case Black_Box_Event::FAULT:
+            serial_printf("FAULT %u in %s\n", d[0], d[1] < state_count ? states[d[1]] : "?");
+            break;
+        case Black_Box_Event::STATE:
+            serial_printf("STATE %s -> %s\n", d[0] < state_count ? states[d[0]] : "?", d[1] < state_count ? states[d[1]] : "?");
+            break;
+        case Black_Box_Event::LOST:
+            serial_printf("LOST %u entries\n", d[0] | (d[1] << 8));
+            break;
+        default:
+            serial_printf("event %u\n", entry.event);
+            break;
+    }
+}
+
+uint32_t BlackBox::entry_address(uint32_t sequence) const
+{
+    return EXT_EEPROM_BLACK_BOX_LOC + (sequence % BLACK_BOX_ENTRIES) * BLACK_BOX_ENTRY_BYTES;
+}
+
+bool BlackBox::read_entry(uint32_t slot, black_box_entry& entry)
+{
+    I2cBusLock lock;
+    external_eeprom.get(EXT_EEPROM_BLACK_BOX_LOC + slot * BLACK_BOX_ENTRY_BYTES, entry);
+    return entry_is_intact(entry, slot);
+}
+
+/* The newest intact entry. Going round from the start of the region, the
+ * sequence counts up by one to the newest, found by a binary search. If the
+ * first entry isn't intact every page is read instead.
+ */
+bool BlackBox::find_newest(black_box_entry& newest)
+{
+    black_box_entry first;
+    if (read_entry(0, first)) {
+        // Entry lo carries on from the first, entry hi doesn't.
+        uint32_t lo = 0;
+        uint32_t hi = BLACK_BOX_ENTRIES;
+        newest = first;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            black_box_entry entry;
+            if (read_entry(mid, entry) && entry.sequence == first.sequence + mid) {
+                lo = mid;
+                newest = entry;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        return true;
+    }
+
+    bool found = false;
+    black_box_entry page[EXT_EEPROM_PAGE_BYTES / BLACK_BOX_ENTRY_BYTES];
+    for (uint32_t slot = 0; slot < BLACK_BOX_ENTRIES; slot += EXT_EEPROM_PAGE_BYTES / BLACK_BOX_ENTRY_BYTES) {
+        I2cBusLock lock;
+        external_eeprom.read(EXT_EEPROM_BLACK_BOX_LOC + slot * BLACK_BOX_ENTRY_BYTES, (uint8_t*) page, sizeof(page));
+        for (uint32_t i = 0; i < EXT_EEPROM_PAGE_BYTES / BLACK_BOX_ENTRY_BYTES; i++) {
+            if (entry_is_intact(page[i], slot + i) && (!found || page[i].sequence > newest.sequence)) {
+                found = true;
+                newest = page[i];
+            }
+        }
+    }
+    return found;
+}
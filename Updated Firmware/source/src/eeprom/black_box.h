@@ -0,0 +1,114 @@
+#ifndef UVENT_BLACK_BOX_H
+#define UVENT_BLACK_BOX_H
+
+#include "../config/uvent_conf.h"
+#include "SparkFun_External_EEPROM.h"
+#include "alarm/alarm.h"
+#include "controls/machine.h"
+#include "sensors/breath_analyzer.h"
+
+/* Black box: a record of what the ventilator did, kept on the external EEPROM
+ * across power cycles, for looking back after an incident with the log dump command.
+ *
+ * Every breath's measurements, each alarm going on or off, faults, state
+ * changes (other than from one step of a breath to the next) and each start
+ * are an entry. The region at EXT_EEPROM_BLACK_BOX_LOC holds the newest 2848 of
+ * them, round and round: 2 h 22 min of breaths at 20 bpm, 1 h 35 min at 30 bpm,
+ * less with alarms and state changes among them.
+ *
+ * Entry, 16 bytes: sequence, time, event, 5 bytes of data and a check, the low
+ * half of the CRC32 of the rest. Like the settings journal (journal.h) the entry
+ * with sequence n is always at n % entries, so the newest is found at start with
+ * a binary search, and an entry the power went during fails its check and is
+ * left out. Time is ms since that start, each start is a BOOT entry.
+ *
+ * update() runs from the control handler and only queues entries in RAM, it
+ * never waits on the EEPROM. service() writes them from loop(), a batch at a
+ * time, never across a page. The EEPROM library splits a batch into writes of
+ * up to its Wire buffer less the 2 address bytes, so a full page is 5 writes
+ * with the 32 byte buffer, each with its own write cycle. Breaths wait for a
+ * page's worth, or BLACK_BOX_FLUSH_MS; anything else goes at the next service().
+ * If the queue is full entries are dropped, and counted in a LOST entry.
+ */
+
+enum class Black_Box_Event : uint8_t {
+    BOOT = 1, // Power on, the time starts again
+    BREATH = 2,// PIP, plateau, PEEP (cmH2O * 2), VTi, VTe (mL / 8)
+    ALARM = 3, // Alarm index, on, level
+    FAULT = 4, // Fault code, state
+    STATE = 5, // From, to
+    LOST = 6   // Entries dropped before this one, u16
+};
+
+struct __attribute__((packed)) black_box_entry {
+    uint32_t sequence;
+    uint32_t time_ms;
+    uint8_t event;
+    uint8_t data[5];
+    uint16_t check;
+};
+
+class BlackBox {
+public:
+    BlackBox(Machine* machine, BreathAnalyzer* breath_analyzer, AlarmManager* alarm_manager)
+        : p_machine(machine), p_breath_analyzer(breath_analyzer), p_alarm_manager(alarm_manager){};
+
+    // Finds the newest entry and records a BOOT. Call once, before the control handler starts.
+    bool init();
+
+    // Queues entries for what changed this tick. Call from the control handler, after the alarm rules.
+    void update();
+
+    // Queues one entry. From the control handler only, or before it starts.
+    void record(Black_Box_Event event, const uint8_t* data);
+
+    // Writes a batch of queued entries, if one is due. Call from loop().
+    void service();
+
+    // Writes everything queued.
+    void flush();
+
+    // Entries stored, and one of them by age, 0 the oldest. Returns false if it doesn't read back intact.
+    uint32_t get_count() const;
+    bool get_entry(uint32_t index, black_box_entry& entry);
+
+    // Prints the newest count entries, oldest first.
+    void dump(uint32_t count);
+
+    uint32_t get_lost() const { return lost_total; }
+
+private:
+    uint32_t entry_address(uint32_t sequence) const;
+    bool read_entry(uint32_t slot, black_box_entry& entry);
+    bool find_newest(black_box_entry& newest);
+    bool write_batch(bool all);
+    void print_entry(const black_box_entry& entry);
+
+    ExternalEEPROM external_eeprom;
+    Machine* p_machine;
+    BreathAnalyzer* p_breath_analyzer;
+    AlarmManager* p_alarm_manager;
+
+    bool ready = false;
+
+    // Sequence of the next entry queued, and of the next one to be written.
+    uint32_t next_sequence = 0;
+    uint32_t written = 0;
+
+    // Entries on their way to the EEPROM. Written by record(), read by service().
+    black_box_entry queue[BLACK_BOX_QUEUE_ENTRIES];
+    volatile uint32_t queue_head = 0;
+    volatile uint32_t queue_tail = 0;
+    // Entries up to this sequence are written at the next service().
+    volatile uint32_t urgent_until = 0;
+    uint16_t lost = 0;
+    volatile uint32_t lost_total = 0;
+
+    // What was last recorded
+    uint32_t last_breath_number = 0;
+    uint16_t last_alarm_mask = 0;
+    States last_state = States::ST_STARTUP;
+    Fault last_fault = Fault::FT_NONE;
+};
+
+#endif//UVENT_BLACK_BOX_H
@@ -0,0 +1,179 @@
+#include "journal.h"
+#include <CRC32.h>
+#include "utilities/i2c_bus.h"
+
+// A record, header to CRC, is read and written whole through a buffer this size. Slots fit in a page.
+#define JOURNAL_BUFFER_BYTES EXT_EEPROM_PAGE_BYTES
+
+void Journal::mount()
+{
+    found = false;
+    checked = false;
+    newest = {};
+
+    if (slots == 0 || slot_bytes > JOURNAL_BUFFER_BYTES || slot_bytes <= sizeof(journal_header) + sizeof(uint32_t)) {
+        checked = true;
+        return;
+    }
+
+    // If there is nothing in slot 0, read() looks through the rest.
+    found = find_newest_header(newest);
+}
+
+bool Journal::append(uint16_t format, const uint8_t* payload, uint16_t length)
+{
+    if (length > max_payload()) {
+        return false;
+    }
+
+    uint8_t buffer[JOURNAL_BUFFER_BYTES];
+
+    // Never over the newest intact record, which needs to be known.
+    if (!checked) {
+        check_newest(buffer);
+    }
+
+    journal_header header;
+    header.sequence = found ? newest.sequence + 1 : 0;
+    header.format = format;
+    header.length = length;
+
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), payload, length);
+    uint32_t crc = CRC32::calculate(buffer, sizeof(header) + length);
+    memcpy(buffer + sizeof(header) + length, &crc, sizeof(crc));
+
+    /* The library writes the slot in several chunks, each its own write cycle.
+     * The power can go between or during any of them, the CRC over the whole
+     * record at its end is what shows such a torn slot for what it is.
+     */
+    I2cBusLock lock;
+    p_eeprom->write(slot_address(header.sequence % slots), buffer, sizeof(header) + length + sizeof(crc));
+
+    found = true;
+    checked = true;
+    newest = header;
+    return true;
+}
+
+bool Journal::read(uint8_t* payload, uint16_t size)
+{
+    uint8_t buffer[JOURNAL_BUFFER_BYTES];
+    if (!check_newest(buffer)) {
+        return false;
+    }
+
+    uint16_t length = newest.length < size ? newest.length : size;
+    memcpy(payload, buffer + sizeof(journal_header), length);
+    return true;
+}
+
+/* Reads the newest record whole into buffer, or the one before it if the power
+ * went while it was written, or the newest intact record anywhere.
+ */
+bool Journal::check_newest(uint8_t* buffer)
+{
+    checked = true;
+
+    if (found) {
+        // The header is known already, the record is read in one go.
+        journal_header header;
+        uint16_t slot = get_slot();
+        I2cBusLock lock;
+        p_eeprom->read(slot_address(slot), buffer, sizeof(journal_header) + newest.length + sizeof(uint32_t));
+        if (record_is_intact(slot, buffer, header) && header.sequence == newest.sequence) {
+            return true;
+        }
+
+        uint16_t before = slot == 0 ? slots - 1 : slot - 1;
+        if (read_record(before, header, buffer) && header.sequence + 1 == newest.sequence) {
+            newest = header;
+            return true;
+        }
+    }
+
+    found = false;
+    newest = {};
+    return scan_all(buffer);
+}
+
+/* Reads a slot's header. Returns false if it can't be a record in that slot.
+ */
+bool Journal::read_header(uint16_t slot, journal_header& header)
+{
+    I2cBusLock lock;
+    p_eeprom->get(slot_address(slot), header);
+    return header.sequence % slots == slot && header.length <= max_payload();
+}
+
+/* Reads a slot's whole record into buffer. Returns false unless it is intact.
+ */
+bool Journal::read_record(uint16_t slot, journal_header& header, uint8_t* buffer)
+{
+    if (!read_header(slot, header)) {
+        return false;
+    }
+
+    memcpy(buffer, &header, sizeof(header));
+    I2cBusLock lock;
+    p_eeprom->read(slot_address(slot) + sizeof(header), buffer + sizeof(header), header.length + sizeof(uint32_t));
+    return record_is_intact(slot, buffer, header);
+}
+
+/* Whether a record read into buffer belongs in the slot, and its CRC matches.
+ */
+bool Journal::record_is_intact(uint16_t slot, const uint8_t* buffer, journal_header& header)
+{
+    memcpy(&header, buffer, sizeof(header));
+    if (header.sequence % slots != slot || header.length > max_payload()) {
+        return false;
+    }
+
+    uint32_t crc;
+    memcpy(&crc, buffer + sizeof(header) + header.length, sizeof(crc));
+    return crc == CRC32::calculate(buffer, sizeof(header) + header.length);
+}
+
+/* The header in the last slot, going round from slot 0, whose sequence carries on from slot 0's.
+ * Returns false if slot 0 doesn't hold a record.
+ */
+bool Journal::find_newest_header(journal_header& header)
+{
+    journal_header first;
+    if (!read_header(0, first)) {
+        return false;
+    }
+
+    // Slot lo carries on from slot 0, slot hi doesn't.
+    uint32_t lo = 0;
+    uint32_t hi = slots;
+    header = first;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        journal_header mid_header;
+        if (read_header(mid, mid_header) && mid_header.sequence == first.sequence + mid) {
+            lo = mid;
+            header = mid_header;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return true;
+}
+
+/* Reads every slot, and leaves the newest record with a good CRC in buffer.
+ */
+bool Journal::scan_all(uint8_t* buffer)
+{
+    uint8_t record[JOURNAL_BUFFER_BYTES];
+    for (uint16_t slot = 0; slot < slots; slot++) {
+        journal_header header;
+        if (read_record(slot, header, record) && (!found || header.sequence > newest.sequence)) {
+            found = true;
+            newest = header;
+            memcpy(buffer, record, sizeof(record));
+        }
+    }
+    return found;
+}
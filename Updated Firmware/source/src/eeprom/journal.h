@@ -0,0 +1,82 @@
+#ifndef UVENT_JOURNAL_H
+#define UVENT_JOURNAL_H
+
+#include "../config/uvent_conf.h"
+#include "SparkFun_External_EEPROM.h"
+
+/* Append-only record journal in a region of the external EEPROM.
+ *
+ * The region is cut into equal, page aligned slots. Every write is a new
+ * record with the next sequence number, in the slot after the last one, so the
+ * writes go round the whole region and each cell is written once per lap
+ * instead of on every save. Only the newest record counts.
+ *
+ * A record is a header (sequence, format and length), the payload, and a CRC32
+ * of both, worked out from the copy in RAM before it is written. The EEPROM
+ * library writes a slot in several chunks, so the power can go with any part
+ * of it in; the CRC only matches once all of it made it in. If the power goes
+ * while it is written, the record before it is still the newest. Nothing is
+ * ever written over the newest valid record.
+ *
+ * The record with sequence n is always in slot n % slots. Going round the
+ * region from slot 0 the sequence counts up by one up to the newest record,
+ * mount() finds it with a binary search on the headers alone. read() reads it
+ * whole and checks its CRC. If that is a record the power went during, the one
+ * before it is taken. Anything else (an empty journal, slot 0 cut off half
+ * written, or bad cells) falls back to reading every slot and taking the newest
+ * with a good CRC.
+ *
+ * The sequence is 32-bit, it won't wrap within the cells' life.
+ */
+
+struct __attribute__((packed)) journal_header {
+    uint32_t sequence;
+    uint16_t format;// What the payload is, up to the owner of the journal
+    uint16_t length;// Payload bytes
+};
+
+class Journal {
+public:
+    Journal(ExternalEEPROM* eeprom, uint32_t start, uint16_t slot_bytes, uint16_t slots)
+        : p_eeprom(eeprom), start(start), slot_bytes(slot_bytes), slots(slots){};
+
+    // Finds where the newest record should be, from the headers. Call after the EEPROM is set up.
+    void mount();
+
+    // Writes a new record, which becomes the newest. Returns false if the payload doesn't fit a slot.
+    bool append(uint16_t format, const uint8_t* payload, uint16_t length);
+
+    // Reads the newest intact record's payload, up to size bytes. Returns false if there is none.
+    bool read(uint8_t* payload, uint16_t size);
+
+    // Whether there is a record. Until read() checked them, it goes by the headers.
+    bool has_record() const { return found; }
+    uint32_t get_sequence() const { return newest.sequence; }
+    uint16_t get_format() const { return newest.format; }
+    uint16_t get_length() const { return newest.length; }
+    uint16_t get_slot() const { return newest.sequence % slots; }
+    uint16_t get_slots() const { return slots; }
+
+    // Largest payload a slot holds.
+    uint16_t max_payload() const { return slot_bytes - sizeof(journal_header) - sizeof(uint32_t); }
+
+private:
+    uint32_t slot_address(uint16_t slot) const { return start + (uint32_t) slot * slot_bytes; }
+    bool read_header(uint16_t slot, journal_header& header);
+    bool read_record(uint16_t slot, journal_header& header, uint8_t* buffer);
+    bool record_is_intact(uint16_t slot, const uint8_t* buffer, journal_header& header);
+    bool find_newest_header(journal_header& header);
+    bool check_newest(uint8_t* buffer);
+    bool scan_all(uint8_t* buffer);
+
+    ExternalEEPROM* p_eeprom;
+    uint32_t start;
+    uint16_t slot_bytes;
+    uint16_t slots;
+
+    bool found = false;
+    bool checked = false;// The newest record was read whole, or written, since mount()
+    journal_header newest = {};
+};
+
+#endif//UVENT_JOURNAL_H
@@ -1,42 +1,134 @@
 #include "../config/uvent_conf.h"
 #include <CRC32.h>
 #include <utilities/logging.h>
+#include "utilities/i2c_bus.h"
 #include "storage.h"
 
+// Tag and length, before each setting's value in a tagged record.
+#define SETTING_ENTRY_HEADER_BYTES 2
+
+// Where each tagged setting is in uvent_settings.
+struct setting_field {
+    Setting tag;
+    uint8_t offset;
+    uint8_t size;
+};
+
+#define SETTING_FIELD(tag, member) {Setting::tag, offsetof(uvent_settings, member), sizeof(uvent_settings::member)}
+
+static constexpr setting_field setting_fields[] = {
+        SETTING_FIELD(SERIAL_NUMBER, serial),
+        SETTING_FIELD(DIFF_PRESSURE_TYPE, diff_pressure_type),
+        SETTING_FIELD(ACTUATOR_HOME_OFFSET, actuator_home_offset_adc_counts),
+        SETTING_FIELD(TIDAL_VOLUME, tidal_volume),
+        SETTING_FIELD(RESPIRATION_RATE, respiration_rate),
+        SETTING_FIELD(PEEP_LIMIT, peep_limit),
+        SETTING_FIELD(PIP_LIMIT, pip_limit),
+        SETTING_FIELD(PLATEAU_TIME, plateau_time),
+        SETTING_FIELD(IE_RATIO_LEFT, ie_ratio_left),
+        SETTING_FIELD(IE_RATIO_RIGHT, ie_ratio_right),
+};
+
+#define SETTING_FIELD_COUNT (sizeof(setting_fields) / sizeof(setting_field))
+
+constexpr bool setting_tag_is_unique(uint32_t index, uint32_t other = 0)
+{
+    return other == SETTING_FIELD_COUNT ||
+           ((other == index || setting_fields[other].tag != setting_fields[index].tag) && setting_tag_is_unique(index, other + 1));
+}
+
+constexpr bool setting_tags_are_unique(uint32_t index = 0)
+{
+    return index == SETTING_FIELD_COUNT || (setting_tag_is_unique(index) && setting_tags_are_unique(index + 1));
+}
+
+constexpr uint32_t tagged_record_bytes(uint32_t index = 0)
+{
+    return index == SETTING_FIELD_COUNT ? 0 : SETTING_ENTRY_HEADER_BYTES + setting_fields[index].size + tagged_record_bytes(index + 1);
+}
+
+static_assert(setting_tags_are_unique(), "Two settings have the same tag");
+static_assert(tagged_record_bytes() + sizeof(journal_header) + sizeof(uint32_t) <= EXT_EEPROM_JOURNAL_SLOT_BYTES,
+              "The settings don't fit a journal slot");
+static_assert(EXT_EEPROM_PAGE_BYTES % EXT_EEPROM_JOURNAL_SLOT_BYTES == 0 && EXT_EEPROM_JOURNAL_LOC % EXT_EEPROM_PAGE_BYTES == 0,
+              "Journal slots must not cross a page");
+static_assert(EXT_EEPROM_JOURNAL_LOC >= EXT_EEPROM_VOLUME_CAL_LOC + sizeof(volume_calibration),
+              "The journal runs into the volume calibration");
+static_assert(EXT_EEPROM_JOURNAL_LOC + (uint32_t) EXT_EEPROM_JOURNAL_SLOTS * EXT_EEPROM_JOURNAL_SLOT_BYTES <= EEPROM_TEST_1_MEM_1,
+              "The journal runs into the EEPROM test area");
+
+static const setting_field* find_field(Setting tag)
+{
+    for (const setting_field& field : setting_fields) {
+        if (field.tag == tag) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
 bool Storage::init()
 {
     // Init the EEPROM
+    I2cBusLock lock;
     if (external_eeprom.begin() == false) {
         Serial.println(F("No memory detected..."));
         return false;
     }
 
+    external_eeprom.setMemorySize(EXT_EEPROM_SIZE_BYTES);
+    external_eeprom.setPageSize(EXT_EEPROM_PAGE_BYTES);
+
+    // The settings themselves are read when first asked for.
+    settings_journal.mount();
+    record_loaded = false;
+
     return true;
 }
 
 void Storage::get_settings(uvent_settings& outset)
 {
 #if ENABLE_CONTROL
-    external_eeprom.get(EXT_EEPROM_SETTINGS_LOC, outset);
+    memcpy(&outset, &def_settings, sizeof(uvent_settings));
+    for (const setting_field& field : setting_fields) {
+        get_setting(field.tag, (uint8_t*) &outset + field.offset, field.size);
+    }
 #else
     Serial.println("In debug mode, defaults will be copied into the requested obj");
     memcpy(&outset, &def_settings, sizeof(uvent_settings));
 #endif
 }
 
-void Storage::set_settings(uvent_settings& inset)
+bool Storage::get_setting(Setting tag, void* value, uint8_t size)
 {
-    external_eeprom.put(EXT_EEPROM_SETTINGS_LOC, inset);
+#if ENABLE_CONTROL
+    load_settings();
+
+    uint8_t stored_size;
+    const uint8_t* stored = find_setting(tag, stored_size);
+    if (stored != nullptr && stored_size == size) {
+        memcpy(value, stored, size);
+        return true;
+    }
+#endif
+
+    const setting_field* field = find_field(tag);
+    if (field != nullptr && field->size == size) {
+        memcpy(value, (const uint8_t*) &def_settings + field->offset, size);
+    }
+    return false;
+}
 
-    // Update the EEPROM CRC
-    external_eeprom.put(EXT_EEPROM_CRC_LOC, crc_calculate());
+void Storage::set_settings(uvent_settings& inset)
+{
+    load_settings();
+    save_settings(inset, true);
 }
 
 void Storage::display_storage()
 {
     uvent_settings temp_set;
-
-    external_eeprom.get(EXT_EEPROM_SETTINGS_LOC, temp_set);
+    get_settings(temp_set);
 
     Serial.println("---- UVENT SETTINGS ---");
     Serial.print("Serial no.: ");
@@ -51,46 +143,154 @@ void Storage::display_storage()
     serial_printf("PIP: %d\n", temp_set.pip_limit);
     serial_printf("Plateau: %d\n", temp_set.plateau_time);
     serial_printf("IE: %.1f : %.1f\n", temp_set.ie_ratio_left, temp_set.ie_ratio_right);
+    if (settings_journal.has_record()) {
+        serial_printf("Journal: record %lu in slot %u of %u, %u bytes\n", (unsigned long) settings_journal.get_sequence(),
+                      settings_journal.get_slot(), settings_journal.get_slots(), record_length);
+    }
+    else {
+        Serial.println("Journal: empty");
+    }
 }
 
-bool Storage::is_crc_ok()
+bool Storage::get_volume_calibration(volume_calibration& outcal)
 {
-    // First get the CRC from the EEPROM
-    uint32_t stored_crc;
-    external_eeprom.get(EXT_EEPROM_CRC_LOC, stored_crc);
+    I2cBusLock lock;
+    external_eeprom.get(EXT_EEPROM_VOLUME_CAL_LOC, outcal);
 
-    uint32_t calc_crc = crc_calculate();
+    if (outcal.magic != VOLUME_CALIBRATION_MAGIC) {
+        return false;
+    }
+
+    CRC32 crc;
+    return (outcal.crc == crc.calculate((uint8_t*) &outcal, offsetof(volume_calibration, crc)));
+}
+
+void Storage::set_volume_calibration(volume_calibration& incal)
+{
+    CRC32 crc;
+    incal.magic = VOLUME_CALIBRATION_MAGIC;
+    incal.crc = crc.calculate((uint8_t*) &incal, offsetof(volume_calibration, crc));
+
+    I2cBusLock lock;
+    external_eeprom.put(EXT_EEPROM_VOLUME_CAL_LOC, incal);
+}
+
+void Storage::clear_volume_calibration()
+{
+    uint32_t no_magic = 0;
+    I2cBusLock lock;
+    external_eeprom.put(EXT_EEPROM_VOLUME_CAL_LOC, no_magic);
+}
+
+bool Storage::is_crc_ok()
+{
+    load_settings();
+    return settings_ok;
+}
 
-    Serial.print("Stored CRC is:");
-    Serial.print(stored_crc);
+/* Reads the newest record, once. If the journal is empty, moves the settings
+ * from before the journal into it.
+ */
+void Storage::load_settings()
+{
+    if (record_loaded) {
+        return;
+    }
+    record_loaded = true;
+    record_length = 0;
+    settings_ok = false;
 
-    Serial.print(", Calculated CRC is:");
-    Serial.println(calc_crc);
+    if (settings_journal.read(record, sizeof(record))) {
+        if (settings_journal.get_format() == STORAGE_SETTINGS_FORMAT_TAGGED) {
+            record_length = settings_journal.get_length();
+            settings_ok = true;
+        }
+        else {
+            serial_printf("Settings record format %u not known\n", settings_journal.get_format());
+        }
+        return;
+    }
 
-    return (calc_crc == stored_crc);
+    uvent_settings older;
+    if (load_legacy_settings(older)) {
+        Serial.println("Moving the settings into the journal.");
+        save_settings(older, false);
+    }
 }
 
-/* Load the latest settings from the EEPROM and return the 
- * CRC.
+/* The settings and their CRC where they were kept before the journal.
  */
-uint32_t Storage::crc_calculate()
+bool Storage::load_legacy_settings(uvent_settings& outset)
 {
-    // Calculate a checksum one byte at a time.
+    uint32_t stored_crc;
+    I2cBusLock lock;
+    external_eeprom.get(EXT_EEPROM_CRC_LOC, stored_crc);
+    external_eeprom.get(EXT_EEPROM_SETTINGS_LOC, outset);
+
     CRC32 crc;
-    uint8_t byte_buffer[sizeof(uvent_settings)];
+    return stored_crc == crc.calculate((uint8_t*) &outset, sizeof(uvent_settings));
+}
+
+/* A setting's value in the newest record, nullptr if it isn't there.
+ */
+const uint8_t* Storage::find_setting(Setting tag, uint8_t& size) const
+{
+    uint16_t i = 0;
+    while (i + SETTING_ENTRY_HEADER_BYTES <= record_length) {
+        uint8_t entry_size = record[i + 1];
+        if (i + SETTING_ENTRY_HEADER_BYTES + entry_size > record_length) {
+            break;
+        }
+        if (record[i] == (uint8_t) tag) {
+            size = entry_size;
+            return &record[i + SETTING_ENTRY_HEADER_BYTES];
+        }
+        i += SETTING_ENTRY_HEADER_BYTES + entry_size;
+    }
+    return nullptr;
+}
+
+/* Saves the settings as a tagged record, if it differs from the newest.
+ * Settings with tags this firmware doesn't know are kept, unless keep_unknown is false.
+ */
+void Storage::save_settings(const uvent_settings& inset, bool keep_unknown)
+{
+    uint8_t encoded[sizeof(record)];
+    uint16_t length = 0;
+    for (const setting_field& field : setting_fields) {
+        encoded[length] = (uint8_t) field.tag;
+        encoded[length + 1] = field.size;
+        memcpy(&encoded[length + SETTING_ENTRY_HEADER_BYTES], (const uint8_t*) &inset + field.offset, field.size);
+        length += SETTING_ENTRY_HEADER_BYTES + field.size;
+    }
 
-    // Get the latest data settings from the EEPROM.
-    external_eeprom.get(EXT_EEPROM_SETTINGS_LOC, byte_buffer);
+    // Saved by newer firmware, written back as they were.
+    uint16_t i = 0;
+    while (keep_unknown && i + SETTING_ENTRY_HEADER_BYTES <= record_length) {
+        uint16_t entry_bytes = SETTING_ENTRY_HEADER_BYTES + record[i + 1];
+        if (i + entry_bytes > record_length) {
+            break;
+        }
+        if (find_field((Setting) record[i]) == nullptr && length + entry_bytes <= settings_journal.max_payload()) {
+            memcpy(&encoded[length], &record[i], entry_bytes);
+            length += entry_bytes;
+        }
+        i += entry_bytes;
+    }
+
+    // Nothing changed, leave the EEPROM be.
+    if (settings_ok && length == record_length && memcmp(encoded, record, length) == 0) {
+        return;
+    }
 
-    // Generate the final CRC32 checksum.
-    return (crc.calculate(byte_buffer, sizeof(uvent_settings)));
+    settings_journal.append(STORAGE_SETTINGS_FORMAT_TAGGED, encoded, length);
+    memcpy(record, encoded, length);
+    record_length = length;
+    settings_ok = true;
 }
 
 void Storage::load_defaults()
 {
-    // Write the defaults.
-    external_eeprom.put(EXT_EEPROM_SETTINGS_LOC, def_settings);
-
-    // Update the EEPROM CRC
-    external_eeprom.put(EXT_EEPROM_CRC_LOC, crc_calculate());
-}
\ No newline at end of file
+    load_settings();
+    save_settings(def_settings, false);
+}
@@ -3,6 +3,8 @@
 
 #include "../config/uvent_conf.h"
 #include "SparkFun_External_EEPROM.h"
+#include "actuators/volume_table.h"
+#include "journal.h"
 
 // UVent settings structure
 struct __attribute__((packed)) uvent_settings {
@@ -25,17 +27,89 @@ struct __attribute__((packed)) uvent_settings {
     double ie_ratio_right;
 };
 
+/* Journal record format of the settings: each setting as its tag, length and
+ * value, in any order. 1 was the uvent_settings struct as it is, don't reuse it.
+ */
+#define STORAGE_SETTINGS_FORMAT_TAGGED 2
+
+/* Tags of the settings in a tagged record.
+ * A new setting is a new tag. A tag is never reused, nor its value's size
+ * changed, a setting that needs another type gets a new tag instead.
+ */
+enum class Setting : uint8_t {
+    SERIAL_NUMBER = 1,       // char[13]
+    DIFF_PRESSURE_TYPE = 2,  // uint16_t
+    ACTUATOR_HOME_OFFSET = 3,// uint16_t, ADC counts
+    TIDAL_VOLUME = 4,        // uint16_t
+    RESPIRATION_RATE = 5,    // uint8_t
+    PEEP_LIMIT = 6,          // uint8_t
+    PIP_LIMIT = 7,           // uint8_t
+    PLATEAU_TIME = 8,        // uint16_t
+    IE_RATIO_LEFT = 9,       // double
+    IE_RATIO_RIGHT = 10      // double
+};
+
+/* Volume tables measured on this unit, in place of the defaults in volume_table.h.
+ * Kept apart from the settings, so loading default settings leaves them be.
+ */
+#define VOLUME_CALIBRATION_MAGIC 0x564F4C31// "VOL1"
+
+struct __attribute__((packed)) volume_calibration {
+    uint32_t magic;
+    volume_table no_lung;
+    volume_table comp_50;
+    volume_table comp_20;
+    uint32_t crc;// Of everything before it
+};
+
+/* The settings are saved to a journal on the EEPROM (see journal.h), as tagged records.
+ *
+ * Loading is lazy: init() only finds the newest record from the journal's
+ * headers. The record is read and checked the first time a setting is asked
+ * for, once, and kept in RAM. Each setting is taken out of it as it is asked
+ * for, by its tag. Saving adds a record, unless nothing changed.
+ *
+ * Between versions: a setting missing from the record (saved by older
+ * firmware) reads as its default, the rest are kept. A tag this firmware
+ * doesn't know (saved by newer firmware) is skipped, and written back with the
+ * next save, so it is still there if the newer firmware comes back.
+ * Settings from before the journal, the struct at EXT_EEPROM_SETTINGS_LOC,
+ * are moved into the journal at the first start with an empty journal.
+ */
 class Storage {
 public:
+    // Sets up the EEPROM and finds the settings.
     bool init();
+    // Whether the settings were found intact.
     bool is_crc_ok();
     void load_defaults();
     void get_settings(uvent_settings&);
     void set_settings(uvent_settings&);
     void display_storage();
 
+    // Copies one setting into value. If it isn't stored, its default is copied and false returned.
+    bool get_setting(Setting tag, void* value, uint8_t size);
+
+    template<typename T>
+    bool get_setting(Setting tag, T& value)
+    {
+        return get_setting(tag, &value, sizeof(T));
+    }
+
+    // Returns false if there is no calibration stored, or it is corrupted.
+    bool get_volume_calibration(volume_calibration&);
+    void set_volume_calibration(volume_calibration&);
+    void clear_volume_calibration();
+
 private:
     ExternalEEPROM external_eeprom;
+    Journal settings_journal{&external_eeprom, EXT_EEPROM_JOURNAL_LOC, EXT_EEPROM_JOURNAL_SLOT_BYTES, EXT_EEPROM_JOURNAL_SLOTS};
+
+    // The newest record's tagged settings.
+    uint8_t record[EXT_EEPROM_JOURNAL_SLOT_BYTES];
+    uint16_t record_length = 0;
+    bool record_loaded = false;
+    bool settings_ok = false;
 
     // Defaults cal. settings
     uvent_settings def_settings = {
@@ -51,7 +125,10 @@ private:
             .ie_ratio_right = DEF_IE,
     };
 
-    uint32_t crc_calculate();
+    void load_settings();
+    bool load_legacy_settings(uvent_settings&);
+    const uint8_t* find_setting(Setting tag, uint8_t& size) const;
+    void save_settings(const uvent_settings&, bool keep_unknown);
 };
 
 #endif
\ No newline at end of file
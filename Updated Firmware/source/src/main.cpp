@@ -13,6 +13,9 @@
 #include "sensors/test_pressure_sensors.h"
 #include "display/main_display.h"
 #include "utilities/parser.h"
+#include "utilities/perf.h"
+#include "utilities/scheduler.h"
+#include "utilities/memtest.h"
 #include "eeprom/test_eeprom.h"
 
 #include <SPI.h>
@@ -68,8 +71,30 @@ StartupScreen startup_screen;
 Parser parser;
 test_eeprom eeprom_test;
 
-// Timers
-lv_timer_t* update_readout_timer = nullptr;
+// Readouts task, started once the main screen is up
+static int readouts_task = -1;
+
+static void run_gui()
+{
+    tft_display.update();
+}
+
+static void run_readouts()
+{
+#if ENABLE_CONTROL
+    loop_update_readouts(&main_screen);
+#else
+    // Dummy values, polls sensors, updates graphs, etc.
+    loop_test_readout(&main_screen);
+#endif
+}
+
+static void run_parser()
+{
+    parser.service();
+}
+
+static void serve_web_client();
 
 static void on_startup_confirm_button(lv_event_t* evt)
 {
@@ -87,13 +112,8 @@ static void on_startup_confirm_button(lv_event_t* evt)
     // Arm the speaker so it talks to LVGL on mute/unmute
     control_setup_alarm_cb();
 
-    // LVGL Timer to poll sensors and update screen data
-#if ENABLE_CONTROL
-    update_readout_timer = lv_timer_create(loop_update_readouts, SENSOR_POLL_INTERVAL, &main_screen);
-#else
-    // Setup an LVGL timer to loop/update display. Polls sensors, updates graphs, etc.
-    update_readout_timer = lv_timer_create(loop_test_readout, SENSOR_POLL_INTERVAL, &main_screen);
-#endif
+    // Poll sensors and update screen data
+    scheduler_set_enabled(readouts_task, true);
 }
 
 static void setup_screens()
@@ -113,6 +133,9 @@ void setup()
 {
     Serial.begin(SERIAL_BAUD_RATE);
 
+    // Handler timings, see the perf command.
+    perf_init();
+
     if (!tft_display.init()) {
         while (1);
     }
@@ -121,6 +144,18 @@ void setup()
     // Load EEPROM storage
     control_init();
 
+    /* The work of loop(). The background tasks don't touch LVGL, so they may run
+     * while LVGL waits on the display DMA. The parser's commands can touch it.
+     */
+    scheduler_add("gui", run_gui, TASK_GUI_PERIOD_US, PERF_LVGL_BUDGET_US, false);
+    readouts_task = scheduler_add("readouts", run_readouts, SENSOR_POLL_INTERVAL * 1000UL, PERF_LVGL_BUDGET_US, false);
+    scheduler_set_enabled(readouts_task, false);
+    scheduler_add("parser", run_parser, TASK_PARSER_PERIOD_US, TASK_PARSER_BUDGET_US, false);
+    scheduler_add("telemetry", control_service_telemetry, TASK_TELEMETRY_PERIOD_US, TASK_TELEMETRY_BUDGET_US, true);
+    scheduler_add("storage", control_service_storage, TASK_STORAGE_PERIOD_US, TASK_STORAGE_BUDGET_US, true);
+    scheduler_add("web", serve_web_client, TASK_WEB_PERIOD_US, TASK_WEB_BUDGET_US, false);
+    tft_display.set_flush_wait_hook(scheduler_yield);
+
     /*******************************/
     /* Setup & arrange the display */
     /*******************************/
@@ -153,16 +188,16 @@ void setup()
   Serial.print("server is at ");
   Serial.println(Ethernet.localIP());
 
+    // Nothing should allocate from here on, see the mem command.
+    mem_mark_setup();
 
-
+    // Task timings and idle time from here, see the perf command.
+    scheduler_reset_stats();
 }
 
 void loop()
 {
-    tft_display.update();
-    delay(5);
-
-    parser.service();
+    scheduler_run();
 
 #if ENABLE_TEST_PRESSURE_SENSORS
     //test_sensors_read_pressure(250, true, Units_pressure::cmH20, Units_pressure::mbar);
@@ -177,11 +212,10 @@ void loop()
     eeprom_test.select_test();
     delay(1000);
 #endif
+}
 
-    control_service();
-
-
-
+static void serve_web_client()
+{
     //IOV LOOP CONTROL 
     // listen for incoming clients
   EthernetClient client = server.available();
@@ -253,6 +287,7 @@ ISR(DMAC_Handler)
 {
     RA_DEBUG_STOP(SPI_TIMING);
     RA_DEBUG_START(INTERRUPT);
+    PerfScope perf(Perf_Probe::DMA_ISR);
     tft_display.onDMAInterrupt();
     RA_DEBUG_STOP(INTERRUPT);
 }
@@ -0,0 +1,249 @@
+#include "adc_sampler.h"
+#include <DueTimer.h>
+
+#define ADC_SAMPLER_CHANNELS 2
+
+static const uint32_t sampled_pins[ADC_SAMPLER_CHANNELS] = {PRESSURE_GAUGE_PIN, PRESSURE_DIFF_PIN};
+static adc_sample_ring rings[ADC_SAMPLER_CHANNELS];
+static bool running = false;
+
+// Converted pairs, in step with the rings. Only touched from the control handler.
+static PressureSensor* p_gauge_sensor = nullptr;
+static PressureSensor* p_diff_sensor = nullptr;
+static adc_sample_pair pairs[ADC_SAMPLER_BUFFER_SAMPLES];
+static uint32_t pairs_converted = 0;
+static uint32_t pairs_oldest = 0;// Converted without a gap from here on
+
+// Samples converted per read of the rings.
+#define ADC_SAMPLER_CONVERT_SAMPLES 32
+
+// analogRead() takes either A0.. or the number after A0.
+static uint32_t analog_pin_number(uint32_t pin)
+{
+    return pin >= A0 ? pin - A0 : pin;
+}
+
+static int ring_index(uint32_t pin)
+{
+    for (int i = 0; i < ADC_SAMPLER_CHANNELS; i++) {
+        if (analog_pin_number(sampled_pins[i]) == analog_pin_number(pin)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#if defined(ARDUINO_ARCH_SAM)
+
+// Two blocks, the PDC fills one while the other is set out.
+static uint16_t dma_blocks[2][ADC_SAMPLER_BLOCK_SAMPLES * ADC_SAMPLER_CHANNELS];
+static uint8_t dma_block_done = 0;
+
+// ADC channel of each sampled pin, to match the channel tag of each result.
+static uint32_t adc_channels[ADC_SAMPLER_CHANNELS];
+
+void ADC_Handler()
+{
+    if (!(ADC->ADC_ISR & ADC_ISR_ENDRX)) {
+        return;
+    }
+
+    // The PDC has moved on to the other block. Results carry their channel in bits 12-15.
+    uint16_t* block = dma_blocks[dma_block_done];
+    for (uint32_t i = 0; i < ADC_SAMPLER_BLOCK_SAMPLES * ADC_SAMPLER_CHANNELS; i++) {
+        uint32_t channel = block[i] >> 12;
+        for (int c = 0; c < ADC_SAMPLER_CHANNELS; c++) {
+            if (adc_channels[c] == channel) {
+                rings[c].push(block[i] & 0x0FFF);
+            }
+        }
+    }
+
+    // Queue it up again after the one being filled, this also clears ENDRX.
+    ADC->ADC_RNPR = (uint32_t) block;
+    ADC->ADC_RNCR = ADC_SAMPLER_BLOCK_SAMPLES * ADC_SAMPLER_CHANNELS;
+    dma_block_done ^= 1;
+}
+
+void adc_sampler_init(PressureSensor* gauge_sensor, PressureSensor* diff_sensor)
+{
+    p_gauge_sensor = gauge_sensor;
+    p_diff_sensor = diff_sensor;
+
+    // Both channels on every trigger, 12 bit, results tagged with their channel.
+    ADC->ADC_PTCR = ADC_PTCR_RXTDIS;
+    ADC->ADC_CHDR = 0xFFFF;
+    for (int i = 0; i < ADC_SAMPLER_CHANNELS; i++) {
+        adc_channels[i] = g_APinDescription[A0 + analog_pin_number(sampled_pins[i])].ulADCChannelNumber;
+        ADC->ADC_CHER = 1u << adc_channels[i];
+    }
+    ADC->ADC_EMR |= ADC_EMR_TAG;
+    ADC->ADC_MR = (ADC->ADC_MR & ~(ADC_MR_TRGSEL_Msk | ADC_MR_FREERUN_ON | ADC_MR_LOWRES_BITS_10))
+                  | ADC_MR_TRGEN_EN | ADC_MR_TRGSEL_ADC_TRIG4;
+
+    dma_block_done = 0;
+    ADC->ADC_RPR = (uint32_t) dma_blocks[0];
+    ADC->ADC_RCR = ADC_SAMPLER_BLOCK_SAMPLES * ADC_SAMPLER_CHANNELS;
+    ADC->ADC_RNPR = (uint32_t) dma_blocks[1];
+    ADC->ADC_RNCR = ADC_SAMPLER_BLOCK_SAMPLES * ADC_SAMPLER_CHANNELS;
+    ADC->ADC_IDR = 0xFFFFFFFF;
+    ADC->ADC_IER = ADC_IER_ENDRX;
+    ADC->ADC_PTCR = ADC_PTCR_RXTEN;
+
+    NVIC_ClearPendingIRQ(ADC_IRQn);
+    NVIC_EnableIRQ(ADC_IRQn);
+
+    /* PWM channel 0 at MCK/32 counts one sample period. Comparison 0 matches once
+     * per period and pulses event line 0, the ADC trigger. No pin is driven.
+     */
+    pmc_enable_periph_clk(ID_PWM);
+    PWM->PWM_DIS = PWM_DIS_CHID0;
+    PWM->PWM_CH_NUM[0].PWM_CMR = PWM_CMR_CPRE_MCK_DIV_32;
+    PWM->PWM_CH_NUM[0].PWM_CPRD = VARIANT_MCK / 32 / ADC_SAMPLER_RATE_HZ;
+    PWM->PWM_CH_NUM[0].PWM_CDTY = 0;
+    PWM->PWM_CMP[0].PWM_CMPV = PWM_CMPV_CV(1);
+    PWM->PWM_CMP[0].PWM_CMPM = PWM_CMPM_CEN;
+    PWM->PWM_ELMR[0] = PWM_ELMR_CSEL0;
+    PWM->PWM_ENA = PWM_ENA_CHID0;
+
+    running = true;
+}
+
+#else
+
+// Host: the shim's analogRead() plays the ADC.
+static void sample_handler()
+{
+    for (int i = 0; i < ADC_SAMPLER_CHANNELS; i++) {
+        rings[i].push(analogRead(sampled_pins[i]));
+    }
+}
+
+void adc_sampler_init(PressureSensor* gauge_sensor, PressureSensor* diff_sensor)
+{
+    p_gauge_sensor = gauge_sensor;
+    p_diff_sensor = diff_sensor;
+
+    analogReadResolution(ADC_RESOLUTION);
+
+    Timer4.attachInterrupt(sample_handler);
+    Timer4.start(1000000.0 / ADC_SAMPLER_RATE_HZ);
+
+    running = true;
+}
+
+#endif
+
+bool adc_sampler_running()
+{
+    return running;
+}
+
+const adc_sample_ring* adc_sampler_ring(uint32_t pin)
+{
+    int i = ring_index(pin);
+    return i < 0 ? nullptr : &rings[i];
+}
+
+uint16_t adc_sampler_latest(uint32_t pin)
+{
+    int i = ring_index(pin);
+    return i < 0 ? 0 : rings[i].latest();
+}
+
+uint16_t adc_sampler_average(uint32_t pin, uint32_t samples)
+{
+    int i = ring_index(pin);
+    if (i < 0) {
+        return 0;
+    }
+
+    const adc_sample_ring& ring = rings[i];
+    uint32_t available = ring.count();
+    if (samples > available) {
+        samples = available;
+    }
+    if (samples > adc_sample_ring::readable()) {
+        samples = adc_sample_ring::readable();
+    }
+    if (samples == 0) {
+        return 0;
+    }
+
+    // The newest samples make up one decimated output.
+    uint16_t average = 0;
+    uint32_t next = available - samples;
+    ring.read_since(next, &average, 1, samples);
+
+    return average;
+}
+
+// Converts the pairs sampled since the last call.
+static void convert_pairs()
+{
+    const adc_sample_ring& gauge_ring = rings[0];
+    const adc_sample_ring& diff_ring = rings[1];
+
+    uint16_t gauge_counts[ADC_SAMPLER_CONVERT_SAMPLES];
+    uint16_t diff_counts[ADC_SAMPLER_CONVERT_SAMPLES];
+    for (;;) {
+        uint32_t next = pairs_converted;
+        uint32_t count = gauge_ring.read_since(next, gauge_counts, ADC_SAMPLER_CONVERT_SAMPLES);
+        if (count == 0) {
+            break;
+        }
+
+        // Skipped ahead if it fell behind, start from the same sample on both.
+        // If the differential ring isn't as far on yet, the rest is converted next time.
+        uint32_t first = next - count;
+        next = first;
+        count = diff_ring.read_since(next, diff_counts, count);
+        if (count == 0) {
+            break;
+        }
+        if (first != pairs_converted) {
+            pairs_oldest = first;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            adc_sample_pair& pair = pairs[(first + i) & (ADC_SAMPLER_BUFFER_SAMPLES - 1)];
+            pair.pressure = p_gauge_sensor->get_pressure_q16_from_counts<Units_pressure::cmH20>(q16_from_int(gauge_counts[i]));
+            pair.flow = p_diff_sensor->get_flow_q16_from_counts<Units_flow::lpm, Order_type::third>(q16_from_int(diff_counts[i]), true);
+        }
+        pairs_converted = first + count;
+    }
+}
+
+uint32_t adc_sampler_read_pairs(uint32_t& next, adc_sample_pair* out, uint32_t max_out)
+{
+    if (!running) {
+        return 0;
+    }
+    convert_pairs();
+
+    uint32_t end = pairs_converted;
+    uint32_t kept = end - pairs_oldest;
+    if (kept > ADC_SAMPLER_BUFFER_SAMPLES) {
+        kept = ADC_SAMPLER_BUFFER_SAMPLES;
+    }
+    if (end - next > kept) {
+        next = end - kept;
+    }
+
+    uint32_t count = end - next;
+    if (count > max_out) {
+        count = max_out;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        out[i] = pairs[next++ & (ADC_SAMPLER_BUFFER_SAMPLES - 1)];
+    }
+    return count;
+}
+
+uint32_t adc_sampler_pair_count()
+{
+    if (running) {
+        convert_pairs();
+    }
+    return pairs_converted;
+}
@@ -0,0 +1,77 @@
+#ifndef UVENT_ADC_SAMPLER_H
+#define UVENT_ADC_SAMPLER_H
+
+#include "../config/uvent_conf.h"
+#include "pressure_sensor.h"
+#include "utilities/ring_buffer.h"
+#include <Arduino.h>
+
+/* Free running sampler for the pressure sensor inputs.
+ *
+ * The ADC converts the gauge and differential channels together at a fixed
+ * ADC_SAMPLER_RATE_HZ, paced in hardware. The PDC moves the results to memory
+ * without the CPU, and an interrupt every ADC_SAMPLER_BLOCK_SAMPLES sets them
+ * out in one ring buffer per channel (raw 12 bit counts).
+ *
+ * While the sampler runs the ADC belongs to it, analogRead() must not be used
+ * on any channel. PressureSensor reads from the sampler instead.
+ *
+ * Pacing on the SAM3X: ADC triggers can only come from the TC0 channels, taken
+ * by Timer0-2, or the PWM event lines. PWM channel 0 counts out the sample period
+ * without driving a pin, and its comparison unit 0 pulses event line 0 once per period.
+ *
+ * The control handler's readers take pressure and flow through adc_sampler_read_pairs().
+ * The samples of both channels are paired up and converted once, the first time
+ * any of them asks, and kept for the others in a buffer as long as the rings.
+ *
+ * Host builds sample through analogRead() from Timer4.
+ */
+
+typedef RingBuffer<uint16_t, ADC_SAMPLER_BUFFER_SAMPLES> adc_sample_ring;
+
+// A gauge sample and the differential sample taken with it, converted.
+struct adc_sample_pair {
+    q16_t pressure;// cmH2O
+    q16_t flow;    // L/min, zeroed
+};
+
+/**
+ * Starts sampling PRESSURE_GAUGE_PIN and PRESSURE_DIFF_PIN.
+ * @param gauge_sensor, diff_sensor Convert the samples for adc_sampler_read_pairs().
+ */
+void adc_sampler_init(PressureSensor* gauge_sensor, PressureSensor* diff_sensor);
+
+bool adc_sampler_running();
+
+/**
+ * @param pin Analog pin, as given to analogRead().
+ * @return The samples of the pin, nullptr if it is not sampled.
+ */
+const adc_sample_ring* adc_sampler_ring(uint32_t pin);
+
+/**
+ * @return The newest sample of the pin, 0 if it is not sampled.
+ */
+uint16_t adc_sampler_latest(uint32_t pin);
+
+/**
+ * @return The mean of the newest samples of the pin, 0 if it is not sampled.
+ */
+uint16_t adc_sampler_average(uint32_t pin, uint32_t samples);
+
+/**
+ * Reads the pairs of samples taken since the last call, oldest first, for a reader that
+ * wants every sample. If the reader fell more than the buffer behind, it skips ahead
+ * to the oldest pair kept. Call from the control handler only.
+ * @param next Running count of the next pair to read, keep it between calls.
+ * The first pair copied is number next - the return value, after the call.
+ * @return The number of pairs copied.
+ */
+uint32_t adc_sampler_read_pairs(uint32_t& next, adc_sample_pair* out, uint32_t max_out);
+
+/**
+ * @return The running count of pairs taken so far, where a reader starts to only get new ones.
+ */
+uint32_t adc_sampler_pair_count();
+
+#endif
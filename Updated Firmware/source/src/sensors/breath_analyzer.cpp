@@ -0,0 +1,241 @@
+#include "breath_analyzer.h"
+#include "adc_sampler.h"
+
+// Samples taken from the sampler rings per read.
+#define BREATH_ANALYZER_READ_SAMPLES 32
+
+// Q16 L/min times microsec to mL
+#define VOLUME_TO_ML (1000.0f / (65536.0f * 60.0f * 1000000.0f))
+
+#if USE_ADC_SAMPLER
+static_assert(ADC_SAMPLER_RATE_HZ % BREATH_ANALYZER_RATE_HZ == 0, "BREATH_ANALYZER_RATE_HZ must divide ADC_SAMPLER_RATE_HZ");
+#endif
+
+void BreathAnalyzer::update()
+{
+    update_samples = 0;
+
+    if (phase == Breath_Phase::NONE) {
+        // Keep up with the sampler, so the next breath starts from fresh samples.
+        if (adc_sampler_running()) {
+            next_sample = adc_sampler_pair_count();
+        }
+        group_pressure_sum = 0;
+        group_flow_sum = 0;
+        group_samples = 0;
+        return;
+    }
+
+    if (!adc_sampler_running()) {
+        // No sampler, one reading per control tick.
+        add_sample(p_gauge_sensor->get_pressure_q16<units_pressure::cmH20>(),
+                   p_diff_sensor->get_flow_q16<units_flow::lpm, Order_type::third>(true), CONTROL_HANDLER_PERIOD_US);
+        return;
+    }
+
+#if USE_ADC_SAMPLER
+    const uint32_t decimation = ADC_SAMPLER_RATE_HZ / BREATH_ANALYZER_RATE_HZ;
+    const uint32_t dt_us = 1000000UL / BREATH_ANALYZER_RATE_HZ;
+
+    // The pairs are converted once for every reader, average them in groups of decimation.
+    adc_sample_pair pairs[BREATH_ANALYZER_READ_SAMPLES];
+    for (;;) {
+        uint32_t count = adc_sampler_read_pairs(next_sample, pairs, BREATH_ANALYZER_READ_SAMPLES);
+        if (count == 0) {
+            break;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            group_pressure_sum += pairs[i].pressure;
+            group_flow_sum += pairs[i].flow;
+            if (++group_samples == decimation) {
+                add_sample(q16_t(group_pressure_sum / (int32_t) decimation), q16_t(group_flow_sum / (int32_t) decimation), dt_us);
+                group_pressure_sum = 0;
+                group_flow_sum = 0;
+                group_samples = 0;
+            }
+        }
+    }
+#endif
+}
+
+void BreathAnalyzer::add_sample(q16_t pressure_cmh2o, q16_t flow_lpm, uint32_t dt_us)
+{
+    flow_lpm -= flow_offset_lpm;
+    int64_t volume = (int64_t) flow_lpm * dt_us;
+
+    breath_time_us += dt_us;
+
+    if (update_samples == 0 || pressure_cmh2o > update_max_pressure) {
+        update_max_pressure = pressure_cmh2o;
+    }
+    if (update_samples == 0 || pressure_cmh2o < update_min_pressure) {
+        update_min_pressure = pressure_cmh2o;
+    }
+    update_samples++;
+
+    // Split by direction. The patient is still breathing out as the paddle starts to push.
+    if (volume > 0) {
+        inspired += volume;
+    }
+    else {
+        expired -= volume;
+    }
+
+    if (phase == Breath_Phase::INSPIRATION || phase == Breath_Phase::HOLD) {
+        if (pressure_cmh2o > peak_pressure) {
+            peak_pressure = pressure_cmh2o;
+        }
+    }
+
+    if (phase == Breath_Phase::INSPIRATION && flow_lpm > peak_flow) {
+        peak_flow = flow_lpm;
+        peak_flow_pressure = pressure_cmh2o;
+        peak_flow_inspired = inspired;
+    }
+
+    window_pressure[window_count % window_size] = pressure_cmh2o;
+    window_flow[window_count % window_size] = flow_lpm;
+    window_count++;
+    window_dt_us = dt_us;
+}
+
+q16_t BreathAnalyzer::window_mean(const q16_t* window) const
+{
+    if (window_count == 0) {
+        return 0;
+    }
+
+    // The window is in time, without the sampler there are fewer samples in it.
+    uint32_t samples = window_dt_us > 0 ? (BREATH_ANALYZER_WINDOW_MS * 1000UL + window_dt_us - 1) / window_dt_us : 1;
+    if (samples > window_count) {
+        samples = window_count;
+    }
+    if (samples > window_size) {
+        samples = window_size;
+    }
+
+    int64_t sum = 0;
+    for (uint32_t i = 1; i <= samples; i++) {
+        sum += window[(window_count - i) % window_size];
+    }
+    return q16_t(sum / samples);
+}
+
+void BreathAnalyzer::set_phase(Breath_Phase new_phase)
+{
+    if (new_phase == phase) {
+        return;
+    }
+
+    switch (new_phase) {
+        case Breath_Phase::NONE:
+            // The breath in progress won't be finished, and the next run starts afresh.
+            breath_started = false;
+            start_measured = false;
+            last_breath = {};
+            break;
+        case Breath_Phase::INSPIRATION:
+            close_breath();
+            break;
+        case Breath_Phase::HOLD:
+            break;
+        case Breath_Phase::EXPIRATION:
+            // End of the hold, or of inspiration if there was none.
+            plateau = window_mean(window_pressure);
+            inspiration_time_us = breath_time_us;
+            break;
+    }
+
+    phase = new_phase;
+    window_count = 0;
+}
+
+void BreathAnalyzer::close_breath()
+{
+    q16_t peep = window_mean(window_pressure);
+    q16_t end_flow = window_mean(window_flow);
+
+    // The first breath wasn't followed from its start, the end of it will do.
+    if (!start_measured) {
+        start_peep = peep;
+        start_flow = end_flow;
+    }
+
+    // Only a breath that was followed from the start counts.
+    if (breath_started && inspiration_time_us > 0 && breath_time_us > inspiration_time_us) {
+        breath_record& b = last_breath;
+        uint32_t expiration_time_us = breath_time_us - inspiration_time_us;
+
+        b.number++;
+        b.pip = q16_to_float(peak_pressure);
+        b.plateau = q16_to_float(plateau);
+        b.peep = q16_to_float(peep);
+        b.vti_ml = inspired * VOLUME_TO_ML;
+        b.vte_ml = expired * VOLUME_TO_ML;
+        b.rr = 60000000.0f / breath_time_us;
+        b.minute_volume_l = (b.vte_ml / 1000.0f) * b.rr;
+
+        // The smaller side of the ratio is 1.
+        if (expiration_time_us > inspiration_time_us) {
+            b.ie_i = 1;
+            b.ie_e = (float) expiration_time_us / inspiration_time_us;
+        }
+        else {
+            b.ie_i = (float) inspiration_time_us / expiration_time_us;
+            b.ie_e = 1;
+        }
+
+        b.compliance = 0;
+        b.resistance = 0;
+        if (b.vti_ml > 0 && peak_flow > 0) {
+            /* If the lung hadn't emptied, gas was still flowing out through the
+             * airway as the breath started and the lung was above the PEEP read at
+             * the wye, by R * flow. With P = PEEP + R * flow_out at the start,
+             * plateau = PEEP + VTi / C and Ppeak = PEEP + V / C + R * flow at peak
+             * flow, solved for R and then C.
+             */
+            float plateau_cmh2o = b.plateau;
+            float start_peep_cmh2o = q16_to_float(start_peep);
+            float start_flow_out = max(-q16_to_float(start_flow), 0.0f) / 60.0f;// L/s
+            float peak_flow_in = q16_to_float(peak_flow) / 60.0f;             // L/s
+            float k = (peak_flow_inspired * VOLUME_TO_ML) / b.vti_ml;         // Share of VTi in at peak flow
+
+            float resistance = (q16_to_float(peak_flow_pressure) - k * plateau_cmh2o - (1 - k) * start_peep_cmh2o) /
+                               (peak_flow_in + (1 - k) * start_flow_out);
+            if (resistance > 0) {
+                b.resistance = resistance;
+            }
+
+            float driving_pressure = plateau_cmh2o - (start_peep_cmh2o + b.resistance * start_flow_out);
+            if (driving_pressure >= BREATH_ANALYZER_MIN_DRIVING_CMH2O) {
+                b.compliance = b.vti_ml / driving_pressure;
+            }
+            else {
+                b.resistance = 0;
+            }
+        }
+
+        // Back at end-expiration the net volume should be back to zero, what is left is offset.
+        constexpr q16_t max_drift_lpm = q16_from_double(FLOW_DRIFT_MAX_LPM);
+        constexpr q16_t drift_gain = q16_from_double(FLOW_DRIFT_GAIN);
+        q16_t drift_lpm = q16_t((inspired - expired) / (int64_t) breath_time_us);
+        if (drift_lpm >= -max_drift_lpm && drift_lpm <= max_drift_lpm) {
+            flow_offset_lpm += q16_mul(drift_lpm, drift_gain);
+        }
+    }
+
+    breath_started = true;
+    breath_time_us = 0;
+    inspiration_time_us = 0;
+    inspired = 0;
+    expired = 0;
+    peak_pressure = 0;
+    plateau = 0;
+    start_peep = peep;
+    start_flow = end_flow;
+    start_measured = window_count > 0;
+    peak_flow = 0;
+    peak_flow_pressure = 0;
+    peak_flow_inspired = 0;
+}
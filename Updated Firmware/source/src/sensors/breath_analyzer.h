@@ -0,0 +1,142 @@
+#ifndef UVENT_BREATH_ANALYZER_H
+#define UVENT_BREATH_ANALYZER_H
+
+#include "../config/uvent_conf.h"
+#include "pressure_sensor.h"
+#include <Arduino.h>
+
+/* Per breath measurements from the gauge pressure and the differential flow.
+ *
+ * Pressure and flow are taken at a fixed BREATH_ANALYZER_RATE_HZ. With the ADC
+ * sampler running, every sample since the last update is taken, already converted,
+ * with adc_sampler_read_pairs() and averaged down to that rate. Without the sampler
+ * it is one reading per update, at the update rate.
+ * Per sample it is all fixed point, floats are only used once a breath to set the results.
+ *
+ * The state machine says which part of the breath it is in. Each new
+ * inspiration closes the breath before it and fills in one breath_record, which
+ * is all anything else needs: the waveform parameters for the display, the
+ * telemetry and the alarms read it from there, nothing is worked out twice.
+ *
+ * Volumes: flow into the patient adds up to VTi, flow out of the patient to VTe.
+ * The tail of the exhale that carries on into the next inspiration counts to the
+ * next VTe, breath for breath the volumes match.
+ *
+ * Pressures: PIP is the highest sample through inspiration and the hold, not a
+ * reading at a state change. Plateau and PEEP are the mean of the last
+ * BREATH_ANALYZER_WINDOW_MS of the hold and of expiration.
+ *
+ * Mechanics, with the one compartment model P = PEEP + V / C + R * flow:
+ *  - compliance = VTi / (plateau - PEEP), with no flow at the end of the hold.
+ *  - resistance from the pressure, flow and volume so far at peak inspiratory flow.
+ * PEEP here is the end-expiratory pressure the breath started from. If the lung
+ * hadn't emptied by then it is higher in the lung than at the wye (auto-PEEP),
+ * worked out from the flow still coming out and the resistance.
+ *
+ * Drift: the volume is taken back to zero at each end-expiration. Over a whole
+ * breath what goes in comes back out, so a net volume left over is sensor
+ * offset spread over the breath. A share of it, FLOW_DRIFT_GAIN, is taken off the
+ * flow from the next breath on, so a few breaths of gas trapping or a single
+ * cough don't throw it off. Offsets past FLOW_DRIFT_MAX_LPM are left alone, those
+ * are a leak or a patient still settling. A smaller steady leak can't be told
+ * apart from offset, and is taken out as well.
+ *
+ * update() and set_phase() are meant to run from the control handler.
+ */
+
+enum class Breath_Phase {
+    NONE,       // Not ventilating, nothing is measured
+    INSPIRATION,// Paddle pushing
+    HOLD,       // Inspiration hold, the plateau
+    EXPIRATION  // Expiration, up to the next inspiration
+};
+
+struct breath_record {
+    uint32_t number;      // Breaths measured since ventilation started, 0 for none yet
+    float pip;            // Peak pressure (cmH2O)
+    float plateau;        // End of hold pressure (cmH2O)
+    float peep;           // End of expiration pressure (cmH2O)
+    float vti_ml;         // Inspired volume (mL)
+    float vte_ml;         // Expired volume (mL)
+    float minute_volume_l;// Expired volume per minute at this breath's rate (L/min)
+    float ie_i;           // I of IE ratio, inspiration includes the hold
+    float ie_e;           // E of IE ratio
+    float rr;             // Respiration rate from this breath's length (breaths/min)
+    float compliance;     // Static compliance (mL/cmH2O), 0 if not measured
+    float resistance;     // Inspiratory resistance (cmH2O/(L/s)), 0 if not measured
+};
+
+class BreathAnalyzer {
+public:
+    BreathAnalyzer(PressureSensor* gauge_sensor, PressureSensor* diff_sensor)
+        : p_gauge_sensor(gauge_sensor), p_diff_sensor(diff_sensor){};
+
+    // Takes the samples since the last call. Call once per control tick.
+    void update();
+
+    // Moves on to the next part of the breath. Starting an inspiration closes the breath before it.
+    void set_phase(Breath_Phase phase);
+
+    Breath_Phase get_phase() const { return phase; }
+
+    // The last breath, all 0 until one is measured after ventilation starts.
+    const breath_record& get_last_breath() const { return last_breath; }
+
+    // Pressure range of the samples taken by the last update(), for checks on every sample.
+    uint32_t get_update_samples() const { return update_samples; }
+    q16_t get_update_max_pressure() const { return update_max_pressure; }
+    q16_t get_update_min_pressure() const { return update_min_pressure; }
+
+    // Offset taken off the flow, L/min.
+    float get_flow_offset_lpm() const { return q16_to_float(flow_offset_lpm); }
+
+private:
+    void add_sample(q16_t pressure_cmh2o, q16_t flow_lpm, uint32_t dt_us);
+    q16_t window_mean(const q16_t* window) const;
+    void close_breath();
+
+    PressureSensor* p_gauge_sensor;
+    PressureSensor* p_diff_sensor;
+
+    Breath_Phase phase = Breath_Phase::NONE;
+
+    // Sampler read position and the partly summed group of samples, Q16.
+    uint32_t next_sample = 0;
+    int64_t group_pressure_sum = 0;
+    int64_t group_flow_sum = 0;
+    uint32_t group_samples = 0;
+
+    q16_t flow_offset_lpm = 0;
+
+    uint32_t update_samples = 0;
+    q16_t update_max_pressure = 0;
+    q16_t update_min_pressure = 0;
+
+    // Newest samples of the phase in progress, for the plateau and end-expiration.
+    static constexpr uint32_t window_size = (BREATH_ANALYZER_RATE_HZ * BREATH_ANALYZER_WINDOW_MS + 999) / 1000;
+    q16_t window_pressure[window_size];
+    q16_t window_flow[window_size];
+    uint32_t window_count = 0;
+    uint32_t window_dt_us = 0;
+
+    // Breath in progress, volumes as Q16 L/min times microsec
+    bool breath_started = false;
+    uint32_t breath_time_us = 0;
+    uint32_t inspiration_time_us = 0;
+    int64_t inspired = 0;
+    int64_t expired = 0;
+    q16_t peak_pressure = 0;
+    q16_t plateau = 0;
+    q16_t start_peep = 0;
+    q16_t start_flow = 0;
+    bool start_measured = false;
+
+    // At the peak inspiratory flow so far
+    q16_t peak_flow = 0;
+    q16_t peak_flow_pressure = 0;
+    int64_t peak_flow_inspired = 0;
+
+    breath_record last_breath = {};
+};
+
+#endif
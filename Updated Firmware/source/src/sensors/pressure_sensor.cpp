@@ -1,4 +1,5 @@
 #include "pressure_sensor.h"
+#include "adc_sampler.h"
 
 PressureSensor::PressureSensor(int analog_pin, double max_psi, double min_psi, int resistance_ohms_1, int resistance_ohms_2) : analog_pin(analog_pin)
 {
@@ -24,6 +25,8 @@ void PressureSensor::init(double max_psi, double min_psi, int resistance_ohms_1,
     double constant_C = (max_psi - min_psi) / (0.8 * VOLTAGE_SUPPLY);
     constant_A = constant_C * voltage_step;
     constant_B = 0.1 * VOLTAGE_SUPPLY * constant_C - min_psi;
+    constant_A_q32 = q32_from_double(constant_A);
+    constant_B_q32 = q32_from_double(constant_B);
 
     // Set zeroed value to 0
     offset_adc_counts = pressure_offset_adc_counts;
@@ -31,23 +34,12 @@ void PressureSensor::init(double max_psi, double min_psi, int resistance_ohms_1,
 
 double PressureSensor::get_pressure(Units_pressure units, bool zero)
 {
-    int analog_val;
-    double pressure_applied;
-
-    // Get analog value, if after zeroing the value is less than 0 then set to zero.
-    if (zero) {
-        analog_val = analogRead(analog_pin) - offset_adc_counts;
-        if (analog_val < 0) {
-            analog_val = 0;
-        }
-    }
-    else {
-        analog_val = analogRead(analog_pin);
-    }
+    return get_pressure_from_counts(read_adc_counts(), units, zero);
+}
 
-    // Calculate pressure from constants in the constructor
-    // More information about these calculations in the README.md
-    pressure_applied = (analog_val * constant_A) - constant_B;
+double PressureSensor::get_pressure_from_counts(double adc_counts, Units_pressure units, bool zero)
+{
+    double pressure_applied = pressure_from_counts(adc_counts, zero);
 
     if (units != Units_pressure::psi) {
         determine_units_pressure(pressure_applied, units);
@@ -57,19 +49,25 @@ double PressureSensor::get_pressure(Units_pressure units, bool zero)
 }
 
 double PressureSensor::get_flow(Units_flow units, bool zero, Order_type order)
+{
+    return get_flow_from_counts(read_adc_counts(), units, zero, order);
+}
+
+double PressureSensor::get_flow_from_counts(double adc_counts, Units_flow units, bool zero, Order_type order)
 {
     double flow = 0;
-    double x = get_pressure(Units_pressure::mbar, zero);
+    double x = pressure_from_counts(adc_counts, zero);
+    determine_units_pressure(x, Units_pressure::mbar);
 
     // Equations were derived by mapping values taking from a flow meter into excel and curve fitting the data
     if (order == Order_type::first) {
         flow = COEF_A_1ST_ORDER * x;
     }
     else if (order == Order_type::second) {
-        flow = COEF_A_2ND_ORDER * pow(x, 2) + COEF_B_2ND_ORDER * x;
+        flow = COEF_A_2ND_ORDER * x * x + COEF_B_2ND_ORDER * x;
     }
     else if (order == Order_type::third) {
-        flow = COEF_A_3RD_ORDER * pow(x, 3) + COEF_B_3RD_ORDER * pow(x, 2) + COEF_C_3RD_ORDER * x;
+        flow = ((COEF_A_3RD_ORDER * x + COEF_B_3RD_ORDER) * x + COEF_C_3RD_ORDER) * x;
     }
 
     if (units != Units_flow::lpm) {
@@ -90,8 +88,14 @@ void PressureSensor::calculate_zero(int32_t& pressure_offset_adc_counts, Zero_ty
     int const average_samples = 100;
 
     if (zero_type != Zero_type::DONT_ZERO) {
-        for (int i = 0; i < average_samples; i++) {
-            offset_adc_counts += analogRead(analog_pin);
+        if (adc_sampler_running()) {
+            // The sampler owns the ADC, take the average of its newest samples.
+            offset_adc_counts += adc_sampler_average(analog_pin, average_samples) * average_samples;
+        }
+        else {
+            for (int i = 0; i < average_samples; i++) {
+                offset_adc_counts += analogRead(analog_pin);
+            }
         }
 
         offset_adc_counts /= average_samples;
@@ -103,6 +107,29 @@ void PressureSensor::calculate_zero(int32_t& pressure_offset_adc_counts, Zero_ty
     }
 }
 
+double PressureSensor::pressure_from_counts(double adc_counts, bool zero)
+{
+    // Get analog value, if after zeroing the value is less than 0 then set to zero.
+    if (zero) {
+        adc_counts -= offset_adc_counts;
+        if (adc_counts < 0) {
+            adc_counts = 0;
+        }
+    }
+
+    // Calculate pressure from constants in the constructor
+    // More information about these calculations in the README.md
+    return (adc_counts * constant_A) - constant_B;
+}
+
+int PressureSensor::read_adc_counts()
+{
+    if (adc_sampler_running()) {
+        return adc_sampler_latest(analog_pin);
+    }
+    return analogRead(analog_pin);
+}
+
 void PressureSensor::determine_units_pressure(double& pressure, Units_pressure units)
 {
     switch (units) {
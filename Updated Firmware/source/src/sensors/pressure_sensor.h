@@ -2,6 +2,7 @@
 #define PRESSURE_SENSOR
 
 #include "../config/uvent_conf.h"
+#include "utilities/fixed_point.h"
 #include <Arduino.h>
 
 typedef enum class units_pressure {
@@ -73,6 +74,87 @@ public:
     // order: Whether to use the 3rd order, 2nd order, or 1st order flow equation
     double get_flow(Units_flow units = Units_flow::lpm, bool zero = false, Order_type order = Order_type::second);
 
+    // Definition: returns the flow for a given ADC reading, for readings taken from the ADC sampler
+    // Argument ->
+    // adc_counts: the ADC reading, can be an average of several
+    // units, zero, order: as for get_flow
+    double get_flow_from_counts(double adc_counts, Units_flow units = Units_flow::lpm, bool zero = false, Order_type order = Order_type::second);
+
+    // Definition: Returns the pressure for a given ADC reading
+    // Arguments ->
+    // adc_counts: the ADC reading, can be an average of several
+    // units, zero: as for get_pressure
+    double get_pressure_from_counts(double adc_counts, Units_pressure units = Units_pressure::psi, bool zero = false);
+
+    /* Fixed point versions of the above, for the control handler. No floating point is used.
+     * The units and the flow equation are chosen at compile time, so there is no switch
+     * on them at run time. Results are Q16 and must fit +-32767 in the chosen units.
+     * adc_counts is Q16 as well, to keep the fraction of an averaged reading.
+     */
+    template<Units_pressure UNITS>
+    q16_t get_pressure_q16(bool zero = false)
+    {
+        return get_pressure_q16_from_counts<UNITS>(q16_from_int(read_adc_counts()), zero);
+    }
+
+    template<Units_pressure UNITS>
+    q16_t get_pressure_q16_from_counts(q16_t adc_counts, bool zero = false) const
+    {
+        if (zero) {
+            adc_counts -= q16_from_int(offset_adc_counts);
+            if (adc_counts < 0) {
+                adc_counts = 0;
+            }
+        }
+
+        // psi in Q32 as an intermediate, a Q16 psi is too coarse for the low range sensors.
+        constexpr q16_t to_units = q16_from_double(psi_to_units(UNITS));
+        int64_t psi = (((int64_t) adc_counts * constant_A_q32) >> 16) - constant_B_q32;
+
+        return q16_t((psi * to_units + (int64_t(1) << 31)) >> 32);
+    }
+
+    template<Units_flow UNITS, Order_type ORDER = Order_type::second>
+    q16_t get_flow_q16(bool zero = false)
+    {
+        return get_flow_q16_from_counts<UNITS, ORDER>(q16_from_int(read_adc_counts()), zero);
+    }
+
+    template<Units_flow UNITS, Order_type ORDER = Order_type::second>
+    q16_t get_flow_q16_from_counts(q16_t adc_counts, bool zero = false) const
+    {
+        static_assert(UNITS != Units_flow::mlpm, "Flow in mL/min doesn't fit Q16, use mL/s");
+
+        q16_t x = get_pressure_q16_from_counts<Units_pressure::mbar>(adc_counts, zero);
+        q16_t flow;
+
+        // Same equations as get_flow(), in Horner form
+        constexpr q16_t a1 = q16_from_double(COEF_A_1ST_ORDER);
+        constexpr q16_t a2 = q16_from_double(COEF_A_2ND_ORDER);
+        constexpr q16_t b2 = q16_from_double(COEF_B_2ND_ORDER);
+        constexpr q16_t a3 = q16_from_double(COEF_A_3RD_ORDER);
+        constexpr q16_t b3 = q16_from_double(COEF_B_3RD_ORDER);
+        constexpr q16_t c3 = q16_from_double(COEF_C_3RD_ORDER);
+        constexpr q16_t to_units = q16_from_double(lpm_to_units(UNITS));
+
+        if (ORDER == Order_type::first) {
+            flow = q16_mul(a1, x);
+        }
+        else if (ORDER == Order_type::second) {
+            flow = q16_mul(q16_mul(a2, x) + b2, x);
+        }
+        else {
+            flow = q16_mul(q16_mul(q16_mul(a3, x) + b3, x) + c3, x);
+        }
+
+        if (UNITS != Units_flow::lpm) {
+            flow = q16_mul(flow, to_units);
+        }
+
+        // Reverse the flow, due to tubing layout.
+        return -flow;
+    }
+
     // Definition: zero_value will be reset to 0
     // Arguments ->
     // pressure_offset_adc_counts: the analog offset of the pressure sensor
@@ -87,45 +169,45 @@ public:
 private:
     // CONVERSION TABLE
     // pressure
-    double const PSI_TO_MBAR = 68.9476;
-    double const PSI_TO_BAR = 0.0689476;
-    double const PSI_TO_MMHG = 51.7149;
-    double const PSI_TO_INHG = 2.03602;
-    double const PSI_TO_CMH20 = 70.307;
-    double const PSI_TO_INH20 = 27.7076;
-    double const PSI_TO_ATM = 0.068046;
-    double const PSI_TO_KPA = 6.89476;
+    static constexpr double PSI_TO_MBAR = 68.9476;
+    static constexpr double PSI_TO_BAR = 0.0689476;
+    static constexpr double PSI_TO_MMHG = 51.7149;
+    static constexpr double PSI_TO_INHG = 2.03602;
+    static constexpr double PSI_TO_CMH20 = 70.307;
+    static constexpr double PSI_TO_INH20 = 27.7076;
+    static constexpr double PSI_TO_ATM = 0.068046;
+    static constexpr double PSI_TO_KPA = 6.89476;
     // flow
-    double const LPM_TO_LPS = 0.01667;
-    double const LPM_TO_MLPM = 1000;
-    double const LPM_TO_MLPS = 16.67;
-    double const LPM_TO_CFM = 0.03531;
+    static constexpr double LPM_TO_LPS = 0.01667;
+    static constexpr double LPM_TO_MLPM = 1000;
+    static constexpr double LPM_TO_MLPS = 16.67;
+    static constexpr double LPM_TO_CFM = 0.03531;
 
     // Coefficents for 1st order equation for Flow vs Differential Pressure. Created using a fluke flow and inputing values from that device into excel
     // Equation: y = 45.089x
     // R value: 0.9975
     // Standard Deviation of values calculated with curve fit vs recorded from fluke flow: 1.36 lpm
-    double const COEF_A_1ST_ORDER = 45.089;
+    static constexpr double COEF_A_1ST_ORDER = 45.089;
 
     // Coefficents for 2nd order equation for Flow vs Differential Pressure. Created using a fluke flow and inputing values from that device into excel
     // Equation: y = -1.4452x^2 + 44.573x
     // R value: 0.9996
     // Standard Deviation of values calculated with curve fit vs recorded from fluke flow: 1.04 lpm
-    double const COEF_A_2ND_ORDER = -1.4452;
-    double const COEF_B_2ND_ORDER = 44.573;
+    static constexpr double COEF_A_2ND_ORDER = -1.4452;
+    static constexpr double COEF_B_2ND_ORDER = 44.573;
 
     // Coefficents for 3nd order equation for Flow vs Differential Pressure. Created using a fluke flow and inputing values from that device into excel
     // Equation: -0.4608x^3 - 1.5564x^2 + 45.477x;
     // R value: 0.9996
     // Standard Deviation of values calculated with curve fit vs recorded from fluke flow: 1.17 lpm
-    double const COEF_A_3RD_ORDER = -0.4608;
-    double const COEF_B_3RD_ORDER = -1.5564;
-    double const COEF_C_3RD_ORDER = 45.477;
+    static constexpr double COEF_A_3RD_ORDER = -0.4608;
+    static constexpr double COEF_B_3RD_ORDER = -1.5564;
+    static constexpr double COEF_C_3RD_ORDER = 45.477;
 
     // Voltage Supply
     // Units: Volts
-    double const VOLTAGE_SUPPLY = 5.0;
-    double const VOLTAGE_ADC_REF = 3.3;
+    static constexpr double VOLTAGE_SUPPLY = 5.0;
+    static constexpr double VOLTAGE_ADC_REF = 3.3;
 
     // Pin on the arduino connecting the sensor
     int analog_pin;
@@ -134,12 +216,45 @@ private:
     double constant_A;
     double constant_B;
 
+    // The same in psi as Q32, for the fixed point versions
+    int64_t constant_A_q32;
+    int64_t constant_B_q32;
+
     // value that holds the pressure_offset_adc_counts
     int32_t offset_adc_counts;
 
     // the differential resolution is half the maximum resolution
     int diff_zero_resolution;
 
+    // Definition: Returns the latest ADC reading, from the ADC sampler when it runs
+    int read_adc_counts();
+
+    // Definition: Returns the pressure in psi for an ADC reading
+    double pressure_from_counts(double adc_counts, bool zero);
+
+    // Definition: Conversion factors from psi and lpm, for units known at compile time
+    static constexpr double psi_to_units(Units_pressure units)
+    {
+        return units == Units_pressure::mbar    ? PSI_TO_MBAR
+               : units == Units_pressure::bar   ? PSI_TO_BAR
+               : units == Units_pressure::mmHg  ? PSI_TO_MMHG
+               : units == Units_pressure::inHg  ? PSI_TO_INHG
+               : units == Units_pressure::cmH20 ? PSI_TO_CMH20
+               : units == Units_pressure::inH20 ? PSI_TO_INH20
+               : units == Units_pressure::atm   ? PSI_TO_ATM
+               : units == Units_pressure::kPa   ? PSI_TO_KPA
+                                                : 1.0;
+    }
+
+    static constexpr double lpm_to_units(Units_flow units)
+    {
+        return units == Units_flow::lps    ? LPM_TO_LPS
+               : units == Units_flow::mlpm ? LPM_TO_MLPM
+               : units == Units_flow::mlps ? LPM_TO_MLPS
+               : units == Units_flow::cfm  ? LPM_TO_CFM
+                                           : 1.0;
+    }
+
     // Definition: Modifies the measured pressure in the users choosen units of measurement
     // Arguments ->
     // pressure: the pressure measured in units psi
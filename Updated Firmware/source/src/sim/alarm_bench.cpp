@@ -0,0 +1,116 @@
+#include "alarm_bench.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "../../config/uvent_conf.h"
+#include "alarm/alarm.h"
+#include "utilities/memtest.h"
+
+// Passes through every combination of alarms.
+#define ALARM_BENCH_PASSES 200
+
+static volatile unsigned long bench_allocations = 0;
+
+#ifdef __GLIBC__
+/* Counts every allocation in the process on the way to glibc's own allocator.
+ * Only the bench reads the count, the rest of the program just pays for an increment.
+ */
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size)
+{
+    bench_allocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    bench_allocations++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    bench_allocations++;
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+// Keeps the reads from being optimised out.
+static volatile size_t bench_sink;
+
+// Every alarm that is on is in the banner.
+static bool banner_is_right(Alarm* alarms, const char* banner)
+{
+    for (int i = 0; i < NUM_ALARMS; i++) {
+        bool in_banner = strstr(banner, alarms[i].text()) != nullptr;
+        if (alarms[i].isON() != in_banner) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int alarm_bench_run()
+{
+    uint32_t cycle_count = 0;
+    AlarmManager alarm_manager{SPEAKER_PIN, &cycle_count};
+    Alarm* alarms = alarm_manager.getAlarmList();
+
+    mem_mark_setup();
+    unsigned long allocations = bench_allocations;
+
+    uint32_t updates = 0;
+    uint32_t rebuilds = 0;
+    uint32_t bad_banners = 0;
+    const char* last_banner = nullptr;
+    uint16_t last_mask = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < ALARM_BENCH_PASSES; pass++) {
+        for (uint32_t pattern = 0; pattern < (1UL << NUM_ALARMS); pattern++) {
+            // A breath per pattern, enough to meet every alarm's trigger and clear counts.
+            for (int breath = 0; breath < 2; breath++) {
+                cycle_count++;
+                for (int i = 0; i < NUM_ALARMS; i++) {
+                    alarms[i].setCondition(pattern & (1UL << i), cycle_count);
+                }
+            }
+
+            bench_sink = alarm_manager.numON();
+            bench_sink = strlen(alarm_manager.getText());
+            uint16_t mask = alarm_manager.onMask();
+            const char* banner = alarm_manager.getBanner();
+            if (mask != last_mask) {
+                rebuilds++;
+                last_mask = mask;
+                if (!banner_is_right(alarms, banner)) {
+                    bad_banners++;
+                }
+            }
+            last_banner = banner;
+            updates++;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    allocations = bench_allocations - allocations;
+    int32_t growth = mem_heap_growth();
+
+    printf("Alarm text path: %u updates, %u banner rebuilds, %.1f ns per update\n", updates, rebuilds, ns / updates);
+    printf("Last banner: \"%s\"\n", last_banner ? last_banner : "");
+#ifdef __GLIBC__
+    printf("Allocations: %lu\n", allocations);
+#else
+    printf("Allocations: not counted on this host\n");
+#endif
+    printf("Heap growth: %d bytes\n", (int) growth);
+    printf("Wrong banners: %u\n", bad_banners);
+
+    return (allocations == 0 && growth == 0 && bad_banners == 0) ? 0 : 1;
+}
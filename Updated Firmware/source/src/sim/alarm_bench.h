@@ -0,0 +1,16 @@
+#ifndef UVENT_ALARM_BENCH_H
+#define UVENT_ALARM_BENCH_H
+
+/* Host check that the alarm text path doesn't allocate.
+ *
+ * Turns the alarms on and off in every combination, over and over, and reads
+ * the alarm count, the rotating alarm text and the alert banner after each,
+ * the way the display loop does. Every malloc() in the process is counted
+ * (glibc hosts), as is the heap growth from utilities/memtest.h. Each banner is
+ * checked against the alarms that are on.
+ *
+ * @return 0 if nothing was allocated and every banner was right.
+ */
+int alarm_bench_run();
+
+#endif//UVENT_ALARM_BENCH_H
@@ -0,0 +1,188 @@
+#include "channel_bench.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "controls/waveform.h"
+#include "utilities/seqlock.h"
+#include "utilities/spsc_queue.h"
+
+// How long the two threads run against each other.
+#define CHANNEL_BENCH_MS 2000
+
+#define CHANNEL_BENCH_QUEUE_ENTRIES 64
+
+// Entries that must get through the queue, so its indices wrap many times while both sides run.
+#define CHANNEL_BENCH_MIN_WRAPS 1000
+
+struct bench_entry {
+    uint32_t number;
+    uint32_t check;
+};
+
+static SeqLock<waveform_params> snapshot;
+static SpscQueue<bench_entry, CHANNEL_BENCH_QUEUE_ENTRIES> queue;
+
+// Written field by field without a lock, as a control the check has to catch torn.
+static volatile waveform_params unguarded;
+
+static std::atomic<bool> stop_producer{false};
+static uint32_t pushed = 0;
+static uint32_t writes = 0;
+
+// Every field from the count n.
+static void fill(waveform_params& p, uint32_t n)
+{
+    float f = (float) (n & 0xFFFF);
+    p.tCycleTimer = f;
+    p.tIn = f;
+    p.tHoldIn = f;
+    p.tEx = f;
+    p.tPeriod = f;
+    p.bpm = (uint16_t) n;
+    p.volume_ml = f;
+    p.ie_i = f;
+    p.ie_e = f;
+    p.pip = (uint16_t) n;
+    p.peep = (uint16_t) n;
+    p.plateau_time = (uint16_t) n;
+    p.m_pip = f;
+    p.m_peep = f;
+    p.m_plateau_press = f;
+    p.m_rr = f;
+    p.m_ie_i = f;
+    p.m_ie_e = f;
+    p.m_tidal_volume = f;
+    p.m_vti = f;
+    p.m_vte = f;
+    p.m_minute_volume = f;
+    p.m_compliance = f;
+    p.m_resistance = f;
+}
+
+// Whether all the fields came from one write.
+static bool is_whole(const waveform_params& p)
+{
+    float f = p.tCycleTimer;
+    uint16_t n = p.bpm;
+    return (float) n == f && p.tIn == f && p.tHoldIn == f && p.tEx == f && p.tPeriod == f && p.volume_ml == f
+           && p.ie_i == f && p.ie_e == f && p.pip == n && p.peep == n && p.plateau_time == n && p.m_pip == f
+           && p.m_peep == f && p.m_plateau_press == f && p.m_rr == f && p.m_ie_i == f && p.m_ie_e == f
+           && p.m_tidal_volume == f && p.m_vti == f && p.m_vte == f && p.m_minute_volume == f
+           && p.m_compliance == f && p.m_resistance == f;
+}
+
+static void producer()
+{
+    uint32_t n = 0;
+    while (!stop_producer.load(std::memory_order_relaxed)) {
+        n++;
+        waveform_params p;
+        fill(p, n);
+        snapshot.write(p);
+
+        /* The control's stores are spread out, as an interrupt landing part way
+         * through an update would spread them, so a read can come in between.
+         */
+        unguarded.tCycleTimer = p.tCycleTimer;
+        std::this_thread::yield();
+        unguarded.bpm = p.bpm;
+        std::this_thread::yield();
+        unguarded.m_resistance = p.m_resistance;
+
+        /* The control handler queues a few entries a tick, which loop() keeps up with.
+         * Pushing as fast as possible would keep the queue full and only try the drop
+         * path, so hold back while it is over half full.
+         */
+        while (queue.size() >= CHANNEL_BENCH_QUEUE_ENTRIES / 2 && !stop_producer.load(std::memory_order_relaxed)) {
+            std::this_thread::yield();
+        }
+        queue.push({n, ~n});
+        pushed++;
+    }
+    writes = n;
+}
+
+int channel_bench_run()
+{
+    std::thread writer(producer);
+
+    uint32_t reads = 0;
+    uint32_t torn = 0;
+    uint32_t backwards = 0;
+    uint32_t last_sequence = 0;
+
+    uint32_t taken = 0;
+    uint32_t out_of_order = 0;
+    uint32_t bad_entries = 0;
+    uint32_t last_number = 0;
+
+    uint32_t unguarded_reads = 0;
+    uint32_t unguarded_torn = 0;
+
+    // Every entry the queue has, then whatever the producer got in meanwhile.
+    auto take = [&]() {
+        bench_entry entry;
+        while (queue.pop(entry)) {
+            taken++;
+            if (entry.check != ~entry.number) {
+                bad_entries++;
+            }
+            if (entry.number <= last_number) {
+                out_of_order++;
+            }
+            last_number = entry.number;
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(CHANNEL_BENCH_MS)) {
+        for (int i = 0; i < 64; i++) {
+            waveform_params p;
+            uint32_t sequence = snapshot.read(p);
+            reads++;
+            if (sequence != 0 && !is_whole(p)) {
+                torn++;
+            }
+            if (sequence < last_sequence) {
+                backwards++;
+            }
+            last_sequence = sequence;
+
+            float first = unguarded.tCycleTimer;
+            uint16_t middle = unguarded.bpm;
+            float last = unguarded.m_resistance;
+            unguarded_reads++;
+            if ((float) middle != first || last != first) {
+                unguarded_torn++;
+            }
+
+            take();
+        }
+
+        // Let the producer in. On a host with a single core, it would otherwise only run when this thread's time slice is up.
+        std::this_thread::yield();
+    }
+
+    stop_producer = true;
+    writer.join();
+    take();
+
+    uint32_t dropped = queue.get_dropped();
+    bool counted = taken + dropped == pushed;
+    bool wrapped = taken >= CHANNEL_BENCH_MIN_WRAPS * CHANNEL_BENCH_QUEUE_ENTRIES;
+
+    printf("Snapshot: %u writes, %u reads, %u torn, %u went backwards\n", writes, reads, torn, backwards);
+    printf("Queue: %u pushed, %u taken, %u dropped as full, %u out of order, %u damaged, %s\n", pushed, taken,
+           dropped, out_of_order, bad_entries, counted ? "all accounted for" : "LOST ENTRIES");
+    printf("Queue wrapped %u times, %s\n", taken / CHANNEL_BENCH_QUEUE_ENTRIES,
+           wrapped ? "enough" : "TOO FEW");
+    printf("Without the seqlock: %u of %u copies torn, %s\n", unguarded_torn, unguarded_reads,
+           unguarded_torn > 0 ? "the check sees a torn read" : "NONE SEEN, the check can't be trusted");
+
+    return (torn == 0 && backwards == 0 && out_of_order == 0 && bad_entries == 0 && counted && wrapped && reads > 0
+            && unguarded_torn > 0)
+                   ? 0
+                   : 1;
+}
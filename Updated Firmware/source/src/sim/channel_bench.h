@@ -0,0 +1,28 @@
+#ifndef UVENT_CHANNEL_BENCH_H
+#define UVENT_CHANNEL_BENCH_H
+
+/* Host stress check of the lock-free channels from the control handler to loop().
+ *
+ * One thread plays the control handler: it writes waveform_params to a SeqLock
+ * with every field set from a running count, as fast as it can, and pushes
+ * numbered entries to an SpscQueue, holding back while the queue is over half
+ * full. Another plays loop(): it reads the snapshot and takes the entries, over
+ * and over, at the same time.
+ *
+ *  - Every snapshot read must have all its fields from the same write, and the
+ *    writes must only go forward.
+ *  - Entries must come out in order, and the ones taken and the ones dropped
+ *    as full must add up to the ones pushed.
+ *  - Enough entries must be taken for the queue's indices to wrap round
+ *    CHANNEL_BENCH_MIN_WRAPS times with both sides running.
+ *
+ *  - As a control, the same struct is also written without the seqlock, a
+ *    field at a time with the thread giving way between them, and read
+ *    alongside. Some of those copies must come out torn, or the check above
+ *    couldn't have seen a torn snapshot either.
+ *
+ * @return 0 if every check passed.
+ */
+int channel_bench_run();
+
+#endif//UVENT_CHANNEL_BENCH_H
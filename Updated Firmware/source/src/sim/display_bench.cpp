@@ -0,0 +1,282 @@
+#include "display_bench.h"
+
+#include <cmath>
+#include <cstdio>
+#include <native_hal.h>
+#include "../../config/uvent_conf.h"
+#include "alarm/alarm.h"
+#include "controls/control.h"
+#include "display/main_display.h"
+#include "display/layouts/layouts.h"
+#include "display/screens/screen.h"
+#include "headless_display.h"
+#include "utilities/min_max_decimator.h"
+#include "utilities/util.h"
+
+// Length of each part of the script, in frames or ms.
+#define DISPLAY_BENCH_IDLE_FRAMES 30
+#define DISPLAY_BENCH_CHARTS_MS 10000
+#define DISPLAY_BENCH_ALARM_STEP_MS 1500
+#define DISPLAY_BENCH_ALARMS_OFF_MS 3000
+
+// Breaths drawn into the charts.
+#define DISPLAY_BENCH_BPM 20
+
+static HeadlessDisplay bench_display;
+static MainScreen bench_main_screen;
+static StartupScreen bench_startup_screen;
+
+static FILE* bench_frames_csv = nullptr;
+
+struct bench_part {
+    const char* name;
+    uint32_t frames;
+    double render_us;
+    double max_render_us;
+    uint64_t flushed_px;
+    uint32_t max_flushed_px;
+    uint32_t flushes;
+    uint32_t invalidated;
+    uint32_t merged;
+};
+
+static void bench_frame(bench_part& part)
+{
+    native_hal_advance_us(LV_DISP_DEF_REFR_PERIOD * 1000);
+    const display_frame& frame = bench_display.update();
+
+    part.frames++;
+    part.render_us += frame.render_us;
+    if (frame.render_us > part.max_render_us) {
+        part.max_render_us = frame.render_us;
+    }
+    part.flushed_px += frame.flushed_px;
+    if (frame.flushed_px > part.max_flushed_px) {
+        part.max_flushed_px = frame.flushed_px;
+    }
+    part.flushes += frame.flushes;
+    part.invalidated += frame.invalidated;
+    part.merged += frame.merged;
+
+    if (bench_frames_csv) {
+        fprintf(bench_frames_csv, "%s,%u,%.1f,%u,%u,%u,%u,%u\n", part.name, now_ms(), frame.render_us, frame.flushes,
+                frame.flushed_px, frame.invalidated, frame.invalidated_px, frame.merged);
+    }
+}
+
+static void print_part(const bench_part& part)
+{
+    uint32_t frames = part.frames ? part.frames : 1;
+    printf("%-10s %4u frames  render mean %8.1f us max %8.1f us  flushed mean %7.0f px max %6u px  %4.1f flushes  %4.1f areas, %4.1f merged\n",
+           part.name, part.frames, part.render_us / frames, part.max_render_us, (double) part.flushed_px / frames,
+           part.max_flushed_px, (double) part.flushes / frames, (double) part.invalidated / frames,
+           (double) part.merged / frames);
+}
+
+static void save_screen(const char* out_dir, const char* name)
+{
+    if (!out_dir) {
+        return;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.ppm", out_dir, name);
+    if (!bench_display.save_ppm(path)) {
+        printf("Can't write %s\n", path);
+    }
+}
+
+/* What main.cpp does once the startup screen is confirmed, less the readout
+ * timer: the script polls in its place.
+ */
+static void bench_confirm_startup()
+{
+    bench_startup_screen.cleanup();
+    active_floating_window = nullptr;
+    bench_main_screen.select_screen();
+    init_main_display();
+    bench_main_screen.setup();
+    control_setup_alarm_cb();
+}
+
+// The made up breaths, at a time in ms.
+static void bench_breath(uint32_t time_ms, double& pressure, double& flow)
+{
+    double breath = fmod(time_ms * DISPLAY_BENCH_BPM / 60000.0, 1.0);
+    pressure = breath < 0.33 ? 5 + 25 * sin(breath / 0.33 * M_PI / 2) : 5 + 25 * exp(-(breath - 0.33) * 12);
+    flow = breath < 0.33 ? 50 : -80 * exp(-(breath - 0.33) * 8);
+}
+
+/* What ChartFeed does for a chart with a time base: samples at ADC_SAMPLER_RATE_HZ
+ * since the last poll, cut into columns. A point per poll for the others.
+ */
+struct bench_chart_feed {
+    MinMaxDecimator decimator;
+    uint32_t sampled_until_ms = 0;
+
+    void poll(SensorChart* chart, bool flow_channel)
+    {
+        double pressure;
+        double flow;
+        if (!chart->time_base_ms) {
+            bench_breath(now_ms(), pressure, flow);
+            chart->add_data_point(flow_channel ? flow : pressure);
+            return;
+        }
+
+        if (decimator.get_columns() != chart->columns) {
+            decimator.configure(ADC_SAMPLER_RATE_HZ * chart->time_base_ms / 1000, chart->columns);
+            sampled_until_ms = now_ms();
+        }
+
+        for (uint32_t i = 0; i < (now_ms() - sampled_until_ms) * ADC_SAMPLER_RATE_HZ / 1000; i++) {
+            bench_breath(sampled_until_ms + i * 1000 / ADC_SAMPLER_RATE_HZ, pressure, flow);
+            q16_t column_min;
+            q16_t column_max;
+            uint32_t finished = decimator.add(q16_from_double(flow_channel ? flow : pressure), column_min, column_max);
+            for (uint32_t k = 0; k < finished; k++) {
+                chart->add_column((column_min + (Q16_ONE >> 1)) >> 16, (column_max + (Q16_ONE >> 1)) >> 16);
+            }
+        }
+        sampled_until_ms = now_ms();
+    }
+};
+
+static bench_chart_feed bench_pressure_feed;
+static bench_chart_feed bench_flow_feed;
+
+/* What loop_update_readouts() does with the sensors, with breaths made up
+ * from the time instead.
+ */
+static void bench_poll(uint32_t& last_readout_refresh)
+{
+    double pressure;
+    double flow;
+    bench_breath(now_ms(), pressure, flow);
+
+    handle_alerts();
+
+    bench_pressure_feed.poll(bench_main_screen.get_chart(CHART_IDX_PRESSURE), false);
+    set_readout(AdjValueType::CUR_PRESSURE, pressure);
+    bench_flow_feed.poll(bench_main_screen.get_chart(CHART_IDX_FLOW), true);
+    set_readout(AdjValueType::FLOW, flow);
+    set_readout(AdjValueType::TIDAL_VOLUME, 400 + (now_ms() / 1000) % 20);
+    set_readout(AdjValueType::PIP, 30);
+    set_readout(AdjValueType::PEEP, 5);
+
+    if (has_time_elapsed(&last_readout_refresh, READOUT_REFRESH_INTERVAL)) {
+        for (auto& value : adjustable_values) {
+            if (!value.is_dirty()) {
+                continue;
+            }
+            value.refresh_readout();
+            value.clear_dirty();
+        }
+    }
+
+    bench_main_screen.try_refresh_charts();
+}
+
+// Frames for ms, polling like the readout task. Calls step before each poll.
+template<typename F>
+static void bench_run_for(bench_part& part, uint32_t ms, uint32_t& last_readout_refresh, F step)
+{
+    uint32_t start = now_ms();
+    uint32_t last_poll = start;
+    while (now_ms() - start < ms) {
+        if (now_ms() - last_poll >= SENSOR_POLL_INTERVAL) {
+            last_poll = now_ms();
+            step();
+            bench_poll(last_readout_refresh);
+        }
+        bench_frame(part);
+    }
+}
+
+int display_bench_run(const char* out_dir)
+{
+    native_hal_serial_set_echo(false);
+    native_hal_set_virtual_clock(true);
+
+    if (out_dir) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/frames.csv", out_dir);
+        bench_frames_csv = fopen(path, "w");
+        if (!bench_frames_csv) {
+            printf("Can't write %s\n", path);
+            return 1;
+        }
+        fprintf(bench_frames_csv, "part,time_ms,render_us,flushes,flushed_px,invalidated,invalidated_px,merged\n");
+    }
+
+    if (!bench_display.init()) {
+        printf("The headless display didn't register with LVGL\n");
+        return 1;
+    }
+
+    // As setup() in main.cpp.
+    init_adjustable_values();
+    bench_startup_screen.init();
+    bench_main_screen.init();
+    bench_startup_screen.select_screen();
+    bench_startup_screen.on_complete = [](lv_event_t* evt) { LV_UNUSED(evt); };
+    bench_startup_screen.setup();
+
+    bench_part startup = {"startup"};
+    bench_frame(startup);
+    bool whole_screen = bench_display.get_last_frame().flushed_px == SCREEN_WIDTH * SCREEN_HEIGHT;
+    for (int i = 1; i < 5; i++) {
+        bench_frame(startup);
+    }
+    save_screen(out_dir, "startup");
+
+    bench_part confirmed = {"main"};
+    bench_confirm_startup();
+    for (int i = 0; i < 5; i++) {
+        bench_frame(confirmed);
+    }
+
+    bench_part idle = {"idle"};
+    for (int i = 0; i < DISPLAY_BENCH_IDLE_FRAMES; i++) {
+        bench_frame(idle);
+    }
+
+    uint32_t last_readout_refresh = now_ms();
+    bench_part charts = {"charts"};
+    bench_run_for(charts, DISPLAY_BENCH_CHARTS_MS, last_readout_refresh, []() {});
+    save_screen(out_dir, "charts");
+
+    // One more alarm on every step, each held on over the polls after it.
+    Alarm* alarms = control_get_alarm_list();
+    uint32_t seq = 0;
+    bench_part alarm = {"alarms"};
+    for (int on = 1; on <= NUM_ALARMS; on++) {
+        bench_run_for(alarm, DISPLAY_BENCH_ALARM_STEP_MS, last_readout_refresh, [&]() {
+            seq++;
+            for (int i = 0; i < NUM_ALARMS; i++) {
+                alarms[i].setCondition(i < on, seq);
+            }
+        });
+    }
+    save_screen(out_dir, "alarms");
+
+    bench_part alarms_off = {"alarms off"};
+    control_set_alarm_all_off();
+    bench_run_for(alarms_off, DISPLAY_BENCH_ALARMS_OFF_MS, last_readout_refresh, []() {});
+
+    if (bench_frames_csv) {
+        fclose(bench_frames_csv);
+        bench_frames_csv = nullptr;
+    }
+
+    print_part(startup);
+    print_part(confirmed);
+    print_part(idle);
+    print_part(charts);
+    print_part(alarm);
+    print_part(alarms_off);
+    printf("First frame drew the whole screen: %s\n", whole_screen ? "yes" : "NO");
+
+    native_hal_serial_set_echo(true);
+    return whole_screen ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#ifndef UVENT_DISPLAY_BENCH_H
+#define UVENT_DISPLAY_BENCH_H
+
+/* Host benchmark of the screens' draw cost, on the headless display (headless_display.h).
+ *
+ * Brings up the startup screen, confirms it into the main screen, and then
+ * runs a script on the virtual clock: idle frames, breaths going into the
+ * charts and readouts at the firmware's poll rate, alarms coming on one at a
+ * time with the alert banner, and all of them going off. A frame is one
+ * lv_task_handler() call every LV_DISP_DEF_REFR_PERIOD.
+ *
+ * For each part of the script it prints the frames, the time spent rendering
+ * them (the host's, not the Due's, so compare runs on the same machine), the
+ * pixels flushed, which the Due sends over SPI, and the areas invalidated and
+ * how many of them were merged.
+ * Given a directory, it also writes every frame to frames.csv there and the
+ * screen after the startup, charts and alarms parts as PPM images.
+ *
+ * @return 0 if the first frame drew the whole screen.
+ */
+int display_bench_run(const char* out_dir);
+
+#endif//UVENT_DISPLAY_BENCH_H
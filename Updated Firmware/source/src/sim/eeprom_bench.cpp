@@ -0,0 +1,396 @@
+#include "eeprom_bench.h"
+
+#include <cstdio>
+#include <cstring>
+#include <CRC32.h>
+#include <native_hal.h>
+#include "../../config/uvent_conf.h"
+#include "eeprom/black_box.h"
+#include "eeprom/storage.h"
+
+// Saves for the wear and restart check.
+#define EEPROM_BENCH_SAVES 10000
+
+// Laps of the journal the power is cut through.
+#define EEPROM_BENCH_CUT_LAPS 2
+
+// Laps of the black box the power is cut through, and breaths whose page writes are counted.
+#define EEPROM_BENCH_BLACK_BOX_LAPS 2
+#define EEPROM_BENCH_BREATHS 800
+
+#define BLACK_BOX_ENTRIES (EXT_EEPROM_BLACK_BOX_BYTES / sizeof(black_box_entry))
+
+#define JOURNAL_BYTES ((uint32_t) EXT_EEPROM_JOURNAL_SLOTS * EXT_EEPROM_JOURNAL_SLOT_BYTES)
+
+// A tag this firmware doesn't know, as if saved by newer firmware.
+#define NEWER_SETTING_TAG 200
+
+static bool settings_equal(const uvent_settings& a, const uvent_settings& b)
+{
+    return memcmp(&a, &b, sizeof(uvent_settings)) == 0;
+}
+
+// Settings that differ from the defaults, and from each other for each n.
+static uvent_settings bench_settings(uint32_t n)
+{
+    uvent_settings settings = {
+            .serial = "210317B0042",
+            .diff_pressure_type = PRESSURE_SENSOR_TYPE_0,
+            .actuator_home_offset_adc_counts = 1234,
+            .tidal_volume = (uint16_t) (n % 60000),
+            .respiration_rate = (uint8_t) (n % 251),
+            .peep_limit = DEF_PEEP,
+            .pip_limit = DEF_PIP,
+            .plateau_time = DEF_PLATEAU,
+            .ie_ratio_left = 1,
+            .ie_ratio_right = 1.0 + (n % 7) * 0.5,
+    };
+    return settings;
+}
+
+static bool check_blank()
+{
+    native_hal_eeprom_reset();
+
+    Storage storage;
+    storage.init();
+    bool ok = !storage.is_crc_ok();
+    storage.load_defaults();
+
+    Storage restarted;
+    restarted.init();
+    uvent_settings settings;
+    restarted.get_settings(settings);
+    ok = ok && restarted.is_crc_ok() && settings.tidal_volume == (uint16_t) (DEF_BAG_VOL_ML) &&
+         strcmp(settings.serial, UVENT_SERIAL_IDENTIFIER) == 0;
+
+    printf("Blank EEPROM, defaults loaded and found again: %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static ExternalEEPROM* bench_eeprom()
+{
+    static ExternalEEPROM eeprom;
+    eeprom.begin();
+    eeprom.setMemorySize(EXT_EEPROM_SIZE_BYTES);
+    eeprom.setPageSize(EXT_EEPROM_PAGE_BYTES);
+    return &eeprom;
+}
+
+static bool check_migrated(Storage& storage, const uvent_settings& older)
+{
+    uvent_settings settings;
+    storage.get_settings(settings);
+    bool ok = storage.is_crc_ok() && settings_equal(settings, older);
+
+    // Only the journal from here on.
+    uvent_settings changed = bench_settings(8);
+    storage.set_settings(changed);
+    Storage restarted;
+    restarted.init();
+    restarted.get_settings(settings);
+    return ok && restarted.is_crc_ok() && settings_equal(settings, changed) && strcmp(settings.serial, older.serial) == 0 &&
+           settings.actuator_home_offset_adc_counts == older.actuator_home_offset_adc_counts;
+}
+
+static bool check_legacy_layout()
+{
+    // Where the settings were kept before the journals.
+    native_hal_eeprom_reset();
+    uvent_settings legacy = bench_settings(7);
+    ExternalEEPROM* eeprom = bench_eeprom();
+    eeprom->put(EXT_EEPROM_SETTINGS_LOC, legacy);
+    eeprom->put(EXT_EEPROM_CRC_LOC, CRC32::calculate((uint8_t*) &legacy, sizeof(uvent_settings)));
+
+    Storage storage;
+    storage.init();
+    bool ok = check_migrated(storage, legacy);
+    printf("Settings from before the journal moved into it: %s\n", ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+static bool check_versions()
+{
+    native_hal_eeprom_reset();
+    uvent_settings settings = bench_settings(9);
+
+    // Saved by newer firmware: a setting this one doesn't know, and one it does, left out.
+    uint8_t record[EXT_EEPROM_JOURNAL_SLOT_BYTES];
+    uint16_t length = 0;
+    const uint8_t newer_value[3] = {1, 2, 3};
+    record[length++] = NEWER_SETTING_TAG;
+    record[length++] = sizeof(newer_value);
+    memcpy(&record[length], newer_value, sizeof(newer_value));
+    length += sizeof(newer_value);
+    record[length++] = (uint8_t) Setting::SERIAL_NUMBER;
+    record[length++] = sizeof(settings.serial);
+    memcpy(&record[length], settings.serial, sizeof(settings.serial));
+    length += sizeof(settings.serial);
+    record[length++] = (uint8_t) Setting::ACTUATOR_HOME_OFFSET;
+    record[length++] = sizeof(settings.actuator_home_offset_adc_counts);
+    memcpy(&record[length], &settings.actuator_home_offset_adc_counts, sizeof(settings.actuator_home_offset_adc_counts));
+    length += sizeof(settings.actuator_home_offset_adc_counts);
+
+    Journal journal(bench_eeprom(), EXT_EEPROM_JOURNAL_LOC, EXT_EEPROM_JOURNAL_SLOT_BYTES, EXT_EEPROM_JOURNAL_SLOTS);
+    journal.mount();
+    journal.append(STORAGE_SETTINGS_FORMAT_TAGGED, record, length);
+
+    // Lazy, nothing is read past the journal's headers until a setting is asked for.
+    uint32_t reads = native_hal_eeprom_read_transfers();
+    Storage storage;
+    storage.init();
+    uint32_t init_reads = native_hal_eeprom_read_transfers() - reads;
+    uint16_t home_offset = 0;
+    char serial[sizeof(settings.serial)];
+    bool ok = storage.get_setting(Setting::ACTUATOR_HOME_OFFSET, home_offset) && storage.get_setting(Setting::SERIAL_NUMBER, serial);
+    uint32_t load_reads = native_hal_eeprom_read_transfers() - reads - init_reads;
+
+    // What wasn't stored reads as its default.
+    uint16_t tidal_volume = 0;
+    ok = ok && home_offset == settings.actuator_home_offset_adc_counts && strcmp(serial, settings.serial) == 0 &&
+         !storage.get_setting(Setting::TIDAL_VOLUME, tidal_volume) && tidal_volume == (uint16_t) (DEF_BAG_VOL_ML) &&
+         storage.is_crc_ok();
+
+    // The setting from newer firmware is saved along with the rest.
+    uvent_settings changed = bench_settings(10);
+    storage.set_settings(changed);
+    journal.mount();
+    length = 0;
+    bool kept = false;
+    if (journal.read(record, sizeof(record))) {
+        length = journal.get_length();
+        for (uint16_t i = 0; i + 2 <= length; i += 2 + record[i + 1]) {
+            kept = kept || (record[i] == NEWER_SETTING_TAG && record[i + 1] == sizeof(newer_value) &&
+                            memcmp(&record[i + 2], newer_value, sizeof(newer_value)) == 0);
+        }
+    }
+
+    Storage restarted;
+    restarted.init();
+    uvent_settings found;
+    restarted.get_settings(found);
+    ok = ok && kept && settings_equal(found, changed);
+
+    printf("Settings saved by other versions: %s, start %u read transfers, first setting %u more\n", ok ? "ok" : "FAILED",
+           init_reads, load_reads);
+    return ok;
+}
+
+static bool check_wear()
+{
+    // The settings rewritten in place with their CRC, as they were.
+    native_hal_eeprom_reset();
+    ExternalEEPROM* eeprom = bench_eeprom();
+    for (uint32_t n = 0; n < EEPROM_BENCH_SAVES; n++) {
+        uvent_settings settings = bench_settings(n);
+        uint8_t read_back[sizeof(uvent_settings)];
+        eeprom->put(EXT_EEPROM_SETTINGS_LOC, settings);
+        eeprom->get(EXT_EEPROM_SETTINGS_LOC, read_back);
+        eeprom->put(EXT_EEPROM_CRC_LOC, CRC32::calculate(read_back, sizeof(read_back)));
+    }
+    uint32_t in_place_cell = native_hal_eeprom_max_cell_writes(0, EXT_EEPROM_JOURNAL_LOC);
+    uint32_t in_place_pages = native_hal_eeprom_page_writes();
+    uint32_t in_place_reads = native_hal_eeprom_read_transfers();
+
+    native_hal_eeprom_reset();
+    Storage storage;
+    storage.init();
+    uint32_t pages = native_hal_eeprom_page_writes();
+    uint32_t reads = native_hal_eeprom_read_transfers();
+    for (uint32_t n = 0; n < EEPROM_BENCH_SAVES; n++) {
+        uvent_settings settings = bench_settings(n);
+        storage.set_settings(settings);
+    }
+    // Saving what is already there costs nothing.
+    uvent_settings same = bench_settings(EEPROM_BENCH_SAVES - 1);
+    storage.set_settings(same);
+    pages = native_hal_eeprom_page_writes() - pages;
+    reads = native_hal_eeprom_read_transfers() - reads;
+    uint32_t journal_cell = native_hal_eeprom_max_cell_writes(EXT_EEPROM_JOURNAL_LOC, JOURNAL_BYTES);
+
+    uint32_t start_reads = native_hal_eeprom_read_transfers();
+    Storage restarted;
+    restarted.init();
+    uvent_settings settings;
+    restarted.get_settings(settings);
+    start_reads = native_hal_eeprom_read_transfers() - start_reads;
+    bool ok = restarted.is_crc_ok() && settings_equal(settings, same);
+
+    printf("%u saves, most writes to a cell: in place %u, journal %u\n", EEPROM_BENCH_SAVES, in_place_cell, journal_cell);
+    printf("Per save: in place %.1f page writes + %.1f read transfers, journal %.1f page writes + %.1f read transfers\n",
+           (double) in_place_pages / EEPROM_BENCH_SAVES, (double) in_place_reads / EEPROM_BENCH_SAVES,
+           (double) pages / EEPROM_BENCH_SAVES, (double) reads / EEPROM_BENCH_SAVES);
+    printf("Start after %u saves: %u read transfers, last save found: %s\n", EEPROM_BENCH_SAVES, start_reads, ok ? "ok" : "FAILED");
+    return ok && journal_cell <= EEPROM_BENCH_SAVES / EXT_EEPROM_JOURNAL_SLOTS + 1;
+}
+
+static bool check_power_cuts()
+{
+    native_hal_eeprom_reset();
+    {
+        Storage storage;
+        storage.init();
+        storage.load_defaults();
+    }
+
+    uint32_t cuts = 0;
+    uint32_t failures = 0;
+    uint32_t most_start_reads = 0;
+    uint32_t n = 0;
+    for (uint32_t save = 0; save < EEPROM_BENCH_CUT_LAPS * EXT_EEPROM_JOURNAL_SLOTS + 2; save++) {
+        // Cut at every byte of the record, up to once it is all in.
+        bool cut_short = true;
+        for (uint32_t cut = 0; cut_short; cut++) {
+            Storage storage;
+            storage.init();
+            uvent_settings before;
+            storage.get_settings(before);
+
+            uvent_settings saved = bench_settings(++n);
+            native_hal_eeprom_cut_power_after(cut);
+            storage.set_settings(saved);
+            cut_short = native_hal_eeprom_power_is_cut();
+            native_hal_eeprom_restore_power();
+
+            uint32_t start_reads = native_hal_eeprom_read_transfers();
+            Storage restarted;
+            restarted.init();
+            uvent_settings found;
+            restarted.get_settings(found);
+            start_reads = native_hal_eeprom_read_transfers() - start_reads;
+            if (start_reads > most_start_reads) {
+                most_start_reads = start_reads;
+            }
+
+            // Cut short, the junk may still happen to finish the record.
+            bool right = settings_equal(found, saved) || (cut_short && settings_equal(found, before));
+            if (!restarted.is_crc_ok() || !right) {
+                failures++;
+            }
+            cuts++;
+        }
+    }
+
+    printf("Power cut %u times part way through a save: %u restarts found the wrong settings, at most %u read transfers to start\n",
+           cuts, failures, most_start_reads);
+    return failures == 0;
+}
+
+// A breath entry that says which entry it is.
+static void record_numbered_breath(BlackBox& black_box, uint32_t sequence)
+{
+    uint8_t data[sizeof(black_box_entry::data)] = {};
+    memcpy(data, &sequence, sizeof(sequence));
+    black_box.record(Black_Box_Event::BREATH, data);
+}
+
+/* Whether the newest entries (up to a lap) read back intact, in order, each
+ * what was recorded in it.
+ */
+static bool black_box_reads_back(BlackBox& black_box)
+{
+    uint32_t count = black_box.get_count();
+    black_box_entry before = {};
+    for (uint32_t i = 0; i < count; i++) {
+        black_box_entry entry;
+        if (!black_box.get_entry(i, entry) || (i > 0 && entry.sequence != before.sequence + 1)) {
+            return false;
+        }
+        uint32_t sequence;
+        memcpy(&sequence, entry.data, sizeof(sequence));
+        if (entry.event == (uint8_t) Black_Box_Event::BREATH && sequence != entry.sequence) {
+            return false;
+        }
+        before = entry;
+    }
+    return true;
+}
+
+static bool check_black_box()
+{
+    // Breaths only go to the EEPROM once a page's worth is queued.
+    native_hal_eeprom_reset();
+    {
+        BlackBox black_box(nullptr, nullptr, nullptr);
+        black_box.init();
+        black_box.service();
+        uint32_t pages = native_hal_eeprom_page_writes();
+        for (uint32_t n = 1; n <= EEPROM_BENCH_BREATHS; n++) {
+            record_numbered_breath(black_box, n);
+            black_box.service();
+        }
+        black_box.flush();
+        pages = native_hal_eeprom_page_writes() - pages;
+        /* The library writes up to its Wire buffer, less the 2 address bytes, at a
+         * time and never across a page, so each page of breaths costs that many
+         * writes, and the first and last pages can be part filled.
+         */
+        uint32_t chunk = bench_eeprom()->getI2CBufferSize() - 2;
+        uint32_t breath_pages = (EEPROM_BENCH_BREATHS * sizeof(black_box_entry) + EXT_EEPROM_PAGE_BYTES - 1) / EXT_EEPROM_PAGE_BYTES + 1;
+        uint32_t expected = breath_pages * ((EXT_EEPROM_PAGE_BYTES + chunk - 1) / chunk);
+        printf("Black box: %u breaths in %u page writes, at most %u expected\n", EEPROM_BENCH_BREATHS, pages, expected);
+        if (pages > expected) {
+            return false;
+        }
+    }
+
+    /* Each start records a few breaths, and the power is cut a little further
+     * into the batch each time. The next start has to find the entries written
+     * before the batch, and any of the batch that made it in, and nothing torn.
+     */
+    native_hal_eeprom_reset();
+    uint32_t cuts = 0;
+    uint32_t failures = 0;
+    uint32_t recorded = 0;
+    uint32_t committed = 0;// Sequence after the last entry known to be written
+    uint32_t queued = 0;   // Sequence after the last entry queued
+    for (uint32_t start = 0; recorded < EEPROM_BENCH_BLACK_BOX_LAPS * BLACK_BOX_ENTRIES; start++) {
+        BlackBox black_box(nullptr, nullptr, nullptr);
+        black_box.init();
+
+        uint32_t count = black_box.get_count();
+        black_box_entry newest = {};
+        uint32_t found = count > 0 && black_box.get_entry(count - 1, newest) ? newest.sequence + 1 : 0;
+        if (found < committed || found > queued || !black_box_reads_back(black_box)) {
+            failures++;
+        }
+        committed = found;
+
+        // The BOOT, then up to a page and a half of breaths, so batches cross pages.
+        uint32_t breaths = start % 12;
+        for (uint32_t n = 0; n < breaths; n++) {
+            record_numbered_breath(black_box, found + 1 + n);
+        }
+        queued = found + 1 + breaths;
+        recorded += 1 + breaths;
+
+        native_hal_eeprom_cut_power_after(start * 7 % ((breaths + 2) * sizeof(black_box_entry)));
+        black_box.flush();
+        if (native_hal_eeprom_power_is_cut()) {
+            cuts++;
+        }
+        else {
+            committed = queued;
+        }
+        native_hal_eeprom_restore_power();
+    }
+
+    printf("Black box: power cut %u times part way through a write: %u restarts lost or tore entries\n", cuts, failures);
+    return failures == 0;
+}
+
+int eeprom_bench_run()
+{
+    native_hal_serial_set_echo(false);
+
+    bool ok = check_blank();
+    ok = check_legacy_layout() && ok;
+    ok = check_versions() && ok;
+    ok = check_wear() && ok;
+    ok = check_power_cuts() && ok;
+    ok = check_black_box() && ok;
+
+    native_hal_serial_set_echo(true);
+    return ok ? 0 : 1;
+}
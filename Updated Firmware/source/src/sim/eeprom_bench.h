@@ -0,0 +1,28 @@
+#ifndef UVENT_EEPROM_BENCH_H
+#define UVENT_EEPROM_BENCH_H
+
+/* Host check of the settings journal and the black box, on the native HAL's emulated EEPROM.
+ *
+ *  - A blank EEPROM comes up with the defaults.
+ *  - Settings in the layout before the journal, the struct with its CRC, are
+ *    moved into the journal, serial number and actuator home offset included.
+ *  - A record saved by newer firmware, with a setting this one doesn't know and
+ *    one it does left out, reads with the missing one at its default, and the
+ *    unknown one survives the next save. Nothing is read past the journal's
+ *    headers until a setting is asked for.
+ *  - Many saves go round the journal, and a restart finds the last one. The
+ *    most writes to any one cell, and the bus traffic per save and per start, are
+ *    printed next to what the settings rewritten in place would cost.
+ *  - The power is cut at every byte of a save, in every slot and across the
+ *    wrap, and after each a restart must find either the settings from before
+ *    the save or the saved ones, never anything else.
+ *  - The black box writes breaths a page at a time, in no more writes than the
+ *    library's Wire buffer splits those pages into. With the power cut part
+ *    way through its writes, over and over round the region, each start
+ *    still reads back every entry written before, in order, and none torn.
+ *
+ * @return 0 if every check passed.
+ */
+int eeprom_bench_run();
+
+#endif//UVENT_EEPROM_BENCH_H
@@ -0,0 +1,91 @@
+#include "headless_display.h"
+#include "display/flush_pipeline.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+static void wrapped_flush_display(struct _lv_disp_drv_t* lv_disp_drv, const lv_area_t* area, lv_color_t* color_p)
+{
+    static_cast<HeadlessDisplay*>(lv_disp_drv->user_data)->flush_display(lv_disp_drv, area, color_p);
+}
+
+bool HeadlessDisplay::init()
+{
+    lv_init();
+
+    lv_disp_draw_buf_init(&lv_screen_buffer, pixel_buffer_1, nullptr, HEADLESS_BUFFER_SIZE);
+    display_flush_init(&lv_screen_buffer, DISPLAY_BUFFER_LINES, false);
+
+    lv_disp_drv_init(&lv_display_driver);
+    lv_display_driver.user_data = this;
+    lv_display_driver.hor_res = SCREEN_WIDTH;
+    lv_display_driver.ver_res = SCREEN_HEIGHT;
+    lv_display_driver.flush_cb = wrapped_flush_display;
+    lv_display_driver.draw_buf = &lv_screen_buffer;
+    return lv_disp_drv_register(&lv_display_driver) != nullptr;
+}
+
+const display_frame& HeadlessDisplay::update()
+{
+    // Drawn from what was invalidated up to now, the refresh joins and clears them.
+    lv_disp_t* disp = lv_disp_get_default();
+    last_frame = {};
+    last_frame.invalidated = disp->inv_p;
+    for (uint16_t i = 0; i < disp->inv_p; i++) {
+        last_frame.invalidated_px += lv_area_get_size(&disp->inv_areas[i]);
+    }
+
+    flushes = 0;
+    flushed_px = 0;
+    auto start = std::chrono::steady_clock::now();
+    display_flush_stats before;
+    display_flush_get_stats(before);
+    display_flush_frame_begin();
+    lv_task_handler();
+    display_flush_frame_end();
+    last_frame.render_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    last_frame.flushes = flushes;
+    last_frame.flushed_px = flushed_px;
+    display_flush_stats after;
+    display_flush_get_stats(after);
+    last_frame.merged = after.merged - before.merged;
+    return last_frame;
+}
+
+void HeadlessDisplay::flush_display(struct _lv_disp_drv_t* lv_disp_drv, const lv_area_t* area, lv_color_t* color_p)
+{
+    lv_coord_t width = lv_area_get_width(area);
+    lv_coord_t height = lv_area_get_height(area);
+    display_flush_started(width * height);
+
+    for (lv_coord_t y = 0; y < height; y++) {
+        memcpy(&framebuffer[(area->y1 + y) * SCREEN_WIDTH + area->x1], &color_p[y * width], width * sizeof(lv_color_t));
+    }
+
+    flushes++;
+    flushed_px += width * height;
+    display_flush_done();
+    lv_disp_flush_ready(lv_disp_drv);
+}
+
+bool HeadlessDisplay::save_ppm(const char* path) const
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+    uint8_t row[SCREEN_WIDTH * 3];
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            uint32_t rgb = lv_color_to32(framebuffer[y * SCREEN_WIDTH + x]);
+            row[x * 3] = (rgb >> 16) & 0xFF;
+            row[x * 3 + 1] = (rgb >> 8) & 0xFF;
+            row[x * 3 + 2] = rgb & 0xFF;
+        }
+        fwrite(row, 1, sizeof(row), file);
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,74 @@
+#ifndef UVENT_HEADLESS_DISPLAY_H
+#define UVENT_HEADLESS_DISPLAY_H
+
+#include <lvgl.h>
+#include "../../config/uvent_conf.h"
+
+// The same draw buffer as TftDisplay, so a frame is cut into the same flushes as on the Due.
+#define HEADLESS_BUFFER_SIZE (SCREEN_WIDTH * DISPLAY_BUFFER_LINES)
+
+/**
+ * What one call to update() drew.
+ */
+struct display_frame {
+    double render_us;       /**< Wall time spent in lv_task_handler() */
+    uint32_t flushes;       /**< Calls to the flush callback */
+    uint32_t flushed_px;    /**< Pixels handed to the flush callback, what the Due sends over SPI */
+    uint16_t invalidated;   /**< Areas invalidated since the last frame, before LVGL joins them */
+    uint32_t invalidated_px;/**< Their pixels added up, overlaps counted twice */
+    uint16_t merged;        /**< Of those, merged into another one before drawing */
+};
+
+/**
+ * LVGL display driver for the native build, in place of TftDisplay.
+ * Flushes go into a framebuffer in memory, which can be written out as a PPM
+ * image, and every flush is counted so draw cost can be measured off target.
+ * Areas are merged as on the Due (display/flush_pipeline.h); the strip height
+ * isn't tuned, a flush takes no time here. There is no input device.
+ */
+class HeadlessDisplay {
+public:
+    HeadlessDisplay() = default;
+
+    ~HeadlessDisplay() = default;
+
+    /**
+     * Starts LVGL and registers the driver. Call once.
+     *
+     * @return True if successful, False otherwise.
+     */
+    bool init();
+
+    /**
+     * Runs lv_task_handler() once, as TftDisplay::update() does, and keeps what it drew.
+     *
+     * @return What was drawn, also kept for get_last_frame().
+     */
+    const display_frame& update();
+
+    const display_frame& get_last_frame() const { return last_frame; }
+
+    /**
+     * Registered with LVGL on init. Copies the area into the framebuffer.
+     */
+    void flush_display(struct _lv_disp_drv_t* lv_disp_drv, const lv_area_t* area, lv_color_t* color_p);
+
+    /**
+     * Writes the framebuffer to a binary PPM (P6) image.
+     *
+     * @return True if the file was written.
+     */
+    bool save_ppm(const char* path) const;
+
+private:
+    lv_disp_drv_t lv_display_driver{};
+    lv_disp_draw_buf_t lv_screen_buffer{};
+    lv_color_t pixel_buffer_1[HEADLESS_BUFFER_SIZE]{};
+    lv_color_t framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT]{};
+
+    display_frame last_frame{};
+    uint32_t flushes = 0;
+    uint32_t flushed_px = 0;
+};
+
+#endif//UVENT_HEADLESS_DISPLAY_H
@@ -0,0 +1,210 @@
+#include <math.h>
+#include "lung_sim.h"
+
+// Sensor supply and ADC reference, as used by PressureSensor
+static const double VOLTAGE_SUPPLY = 5.0;
+static const double VOLTAGE_ADC_REF = 3.3;
+
+static const double PSI_TO_CMH20 = 70.307;
+static const double PSI_TO_MBAR = 68.9476;
+
+// PressureSensor's 3rd order flow fit, lpm from mbar: -0.4608x^3 - 1.5564x^2 + 45.477x
+static const double FLOW_COEF_A = -0.4608;
+static const double FLOW_COEF_B = -1.5564;
+static const double FLOW_COEF_C = 45.477;
+
+// The fit only increases between its turning points, -6.97 and 4.72 mbar.
+static const double FLOW_FIT_MIN_MBAR = -6.9;
+static const double FLOW_FIT_MAX_MBAR = 4.7;
+
+// The bag and tubing smooth out the individual steps of the paddle.
+static const double BAG_FLOW_TAU_S = 0.02;
+
+// Bag flow, mL/s, that switches the patient valve between inspiration and expiration.
+static const double VALVE_SWITCH_FLOW = 5.0;
+
+LungSim::LungSim(Actuator* actuator, const lung_sim_params& params) : p_actuator(actuator), params(params)
+{
+    switch (params.compliance) {
+        case C_Stat::TWENTY:
+            compliance_ml_per_cmh2o = 20.0;
+            break;
+        case C_Stat::FIFTY:
+            compliance_ml_per_cmh2o = 50.0;
+            break;
+        default:
+            compliance_ml_per_cmh2o = 0.0;
+            break;
+    }
+
+    reset();
+}
+
+void LungSim::reset()
+{
+    bag_volume = 0;
+    bag_flow = 0;
+    lung_volume = params.peep * compliance_ml_per_cmh2o;
+    airway_pressure = compliance_ml_per_cmh2o > 0 ? params.peep : 0;
+    flow_lpm = 0;
+    expiring = true;
+
+    gauge_counts = pressure_to_counts(airway_pressure / PSI_TO_CMH20, params.gauge_max_psi, params.gauge_min_psi);
+    diff_counts = pressure_to_counts(0, params.diff_max_psi, params.diff_min_psi);
+
+    take_breath_stats();
+}
+
+void LungSim::step(double dt_s)
+{
+    if (dt_s <= 0) {
+        return;
+    }
+
+    // Volume pushed out of the bag at the current paddle angle.
+    double volume = p_actuator->degrees_to_volume(params.compliance) * 1000.0;
+    if (volume < 0) {
+        volume = 0;
+    }
+
+    double step_flow = (volume - bag_volume) / dt_s;
+    bag_volume = volume;
+    bag_flow += (dt_s / (BAG_FLOW_TAU_S + dt_s)) * (step_flow - bag_flow);
+
+    // The patient valve opens to exhale once the paddle pulls back,
+    // and stays that way until it pushes again.
+    if (bag_flow > VALVE_SWITCH_FLOW) {
+        expiring = false;
+    }
+    else if (bag_flow < -VALVE_SWITCH_FLOW) {
+        expiring = true;
+    }
+
+    // Resistances in cmH2O per mL/s
+    double r_airway = params.resistance / 1000.0;
+    double r_exp = params.exp_resistance / 1000.0;
+    double c = compliance_ml_per_cmh2o;
+
+    double flow = 0;// mL/s, positive into the patient
+
+    if (!expiring) {
+        // The one way valve stops gas coming back into the bag.
+        flow = bag_flow > 0 ? bag_flow : 0;
+        if (c > 0) {
+            lung_volume += flow * dt_s;
+        }
+    }
+    else if (c > 0) {
+        // Passive exhalation towards the PEEP volume, solved exactly for the step.
+        double peep_volume = params.peep * c;
+        if (lung_volume > peep_volume) {
+            double tau = (r_airway + r_exp) * c;
+            double next_volume = peep_volume + (lung_volume - peep_volume) * exp(-dt_s / tau);
+            flow = (next_volume - lung_volume) / dt_s;
+            lung_volume = next_volume;
+        }
+    }
+
+    double lung_pressure = c > 0 ? lung_volume / c : 0;
+    airway_pressure = lung_pressure + r_airway * flow;
+    flow_lpm = flow * 60.0 / 1000.0;
+
+    gauge_counts = pressure_to_counts(airway_pressure / PSI_TO_CMH20, params.gauge_max_psi, params.gauge_min_psi);
+    diff_counts = pressure_to_counts(flow_to_diff_mbar(flow_lpm) / PSI_TO_MBAR, params.diff_max_psi, params.diff_min_psi);
+
+    update_breath_stats(dt_s);
+}
+
+uint32_t LungSim::get_adc_counts(uint32_t channel) const
+{
+    if (channel == PRESSURE_GAUGE_PIN) {
+        return gauge_counts;
+    }
+    if (channel == PRESSURE_DIFF_PIN) {
+        return diff_counts;
+    }
+    return 0;
+}
+
+uint32_t LungSim::analog_source(uint32_t channel, void* user_data)
+{
+    return static_cast<LungSim*>(user_data)->get_adc_counts(channel);
+}
+
+lung_sim_breath LungSim::take_breath_stats()
+{
+    lung_sim_breath last = breath;
+
+    breath.peak_pressure = airway_pressure;
+    breath.min_pressure = airway_pressure;
+    breath.peak_flow = 0;
+    breath.inspired_volume = 0;
+    breath.expired_volume = 0;
+
+    return last;
+}
+
+void LungSim::update_breath_stats(double dt_s)
+{
+    if (airway_pressure > breath.peak_pressure) {
+        breath.peak_pressure = airway_pressure;
+    }
+    if (airway_pressure < breath.min_pressure) {
+        breath.min_pressure = airway_pressure;
+    }
+    if (flow_lpm > breath.peak_flow) {
+        breath.peak_flow = flow_lpm;
+    }
+    if (flow_lpm > 0) {
+        breath.inspired_volume += flow_lpm * 1000.0 / 60.0 * dt_s;
+    }
+    else {
+        breath.expired_volume -= flow_lpm * 1000.0 / 60.0 * dt_s;
+    }
+}
+
+/* Inverse of PressureSensor::get_pressure().
+ * The sensor computes psi = counts * A - B, see PressureSensor::init().
+ */
+uint32_t LungSim::pressure_to_counts(double psi, double max_psi, double min_psi) const
+{
+    const int max_resolution_units = 1 << ADC_RESOLUTION;
+
+    double voltage_step = (VOLTAGE_ADC_REF / max_resolution_units) * ((double) (RESISTANCE_1 + RESISTANCE_2) / RESISTANCE_2);
+    double constant_C = (max_psi - min_psi) / (0.8 * VOLTAGE_SUPPLY);
+    double constant_A = constant_C * voltage_step;
+    double constant_B = 0.1 * VOLTAGE_SUPPLY * constant_C - min_psi;
+
+    double counts = round((psi + constant_B) / constant_A);
+    if (counts < 0) {
+        return 0;
+    }
+    if (counts > max_resolution_units - 1) {
+        return max_resolution_units - 1;
+    }
+    return (uint32_t) counts;
+}
+
+/* Inverse of PressureSensor::get_flow() with the 3rd order fit.
+ * The sensor negates the fit for the tubing layout, so flow into the patient
+ * comes from a negative differential pressure.
+ */
+double LungSim::flow_to_diff_mbar(double lpm) const
+{
+    double target = -lpm;
+    double lo = FLOW_FIT_MIN_MBAR;
+    double hi = FLOW_FIT_MAX_MBAR;
+
+    for (int i = 0; i < 40; i++) {
+        double mid = 0.5 * (lo + hi);
+        double fit = ((FLOW_COEF_A * mid + FLOW_COEF_B) * mid + FLOW_COEF_C) * mid;
+        if (fit < target) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    return 0.5 * (lo + hi);
+}
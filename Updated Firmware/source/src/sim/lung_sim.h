@@ -0,0 +1,89 @@
+#ifndef UVENT_LUNG_SIM_H
+#define UVENT_LUNG_SIM_H
+
+#include "../../config/uvent_conf.h"
+#include "actuators/actuator.h"
+
+/* Simulated patient circuit for host builds.
+ *
+ * The paddle squeezes the AMBU bag, which pushes gas through the airway
+ * resistance into a test lung of the chosen compliance. When the paddle pulls back
+ * the bag refills from the room, and the lung empties through the expiratory
+ * limb against the PEEP valve. While the paddle holds still the circuit stays
+ * closed, so the airway pressure settles to the plateau.
+ *
+ * The bag volume comes from the actuator's own degrees to volume curve,
+ * for the same C_Stat the test lung was measured with.
+ * The results are written back as the raw ADC counts the gauge and
+ * differential sensors would produce, so PressureSensor reads them unchanged.
+ */
+
+struct lung_sim_params {
+    C_Stat compliance;    // Test lung, C_Stat::NONE leaves the circuit open to the room
+    double resistance;    // Airway resistance, cmH2O/(L/s)
+    double exp_resistance;// Expiratory limb and valve resistance, cmH2O/(L/s)
+    double peep;          // PEEP valve setting, cmH2O
+
+    // Sensor ranges, the same values the sensors are initialized with
+    double gauge_max_psi;
+    double gauge_min_psi;
+    double diff_max_psi;
+    double diff_min_psi;
+};
+
+// Per breath measurements, collected between calls to take_breath_stats()
+struct lung_sim_breath {
+    double peak_pressure;   // Highest airway pressure, cmH2O
+    double min_pressure;    // Lowest airway pressure, cmH2O
+    double peak_flow;       // Highest inspiratory flow, L/min
+    double inspired_volume; // Volume that went into the lung, mL
+    double expired_volume;  // Volume that came back out, mL
+};
+
+class LungSim {
+public:
+    LungSim(Actuator* actuator, const lung_sim_params& params);
+
+    // Empty the lung down to PEEP and clear the stats.
+    void reset();
+
+    // Advance the circuit by dt_s seconds, and update the ADC counts.
+    void step(double dt_s);
+
+    double get_airway_pressure() const { return airway_pressure; }
+    double get_flow() const { return flow_lpm; }
+    double get_lung_volume() const { return lung_volume; }
+    double get_bag_volume() const { return bag_volume; }
+    double get_compliance() const { return compliance_ml_per_cmh2o; }
+    double get_resistance() const { return params.resistance; }
+    uint32_t get_adc_counts(uint32_t channel) const;
+
+    // Returns the stats for the breath just finished and starts a new one.
+    lung_sim_breath take_breath_stats();
+
+    // Hook for native_hal_set_analog_source(), with the LungSim as user data.
+    static uint32_t analog_source(uint32_t channel, void* user_data);
+
+private:
+    Actuator* p_actuator;
+    lung_sim_params params;
+    double compliance_ml_per_cmh2o;// 0 for an open circuit
+
+    double bag_volume;       // Volume pushed out of the bag, mL
+    double bag_flow;         // Smoothed flow out of the bag, mL/s
+    double lung_volume;      // Volume above the relaxed lung, mL
+    double airway_pressure;  // cmH2O at the patient wye
+    double flow_lpm;         // Flow at the wye, positive into the patient
+    bool expiring;           // Expiratory valve open
+
+    uint32_t gauge_counts;
+    uint32_t diff_counts;
+
+    lung_sim_breath breath;
+
+    void update_breath_stats(double dt_s);
+    uint32_t pressure_to_counts(double psi, double max_psi, double min_psi) const;
+    double flow_to_diff_mbar(double lpm) const;
+};
+
+#endif//UVENT_LUNG_SIM_H
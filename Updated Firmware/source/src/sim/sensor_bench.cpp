@@ -0,0 +1,102 @@
+#include "sensor_bench.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include "../../config/uvent_conf.h"
+#include "sensors/pressure_sensor.h"
+
+// Sweeps of all 4096 counts timed per conversion.
+#define SENSOR_BENCH_SWEEPS 2000
+
+#define SENSOR_BENCH_COUNTS (1 << ADC_RESOLUTION)
+
+static PressureSensor bench_gauge_sensor = {PRESSURE_GAUGE_PIN};
+static PressureSensor bench_diff_sensor = {PRESSURE_DIFF_PIN};
+
+// Keeps the timed loops from being optimised out.
+static volatile double bench_sink_double;
+static volatile q16_t bench_sink_fixed;
+
+struct bench_case {
+    const char* name;
+    double (*convert_double)(double counts);
+    q16_t (*convert_fixed)(q16_t counts);
+};
+
+static const bench_case bench_cases[] = {
+        {"gauge cmH2O",
+         [](double c) { return bench_gauge_sensor.get_pressure_from_counts(c, Units_pressure::cmH20); },
+         [](q16_t c) { return bench_gauge_sensor.get_pressure_q16_from_counts<Units_pressure::cmH20>(c); }},
+        {"diff mbar",
+         [](double c) { return bench_diff_sensor.get_pressure_from_counts(c, Units_pressure::mbar, true); },
+         [](q16_t c) { return bench_diff_sensor.get_pressure_q16_from_counts<Units_pressure::mbar>(c, true); }},
+        {"flow L/min 1st",
+         [](double c) { return bench_diff_sensor.get_flow_from_counts(c, Units_flow::lpm, true, Order_type::first); },
+         [](q16_t c) { return bench_diff_sensor.get_flow_q16_from_counts<Units_flow::lpm, Order_type::first>(c, true); }},
+        {"flow L/min 2nd",
+         [](double c) { return bench_diff_sensor.get_flow_from_counts(c, Units_flow::lpm, true, Order_type::second); },
+         [](q16_t c) { return bench_diff_sensor.get_flow_q16_from_counts<Units_flow::lpm, Order_type::second>(c, true); }},
+        {"flow L/min 3rd",
+         [](double c) { return bench_diff_sensor.get_flow_from_counts(c, Units_flow::lpm, true, Order_type::third); },
+         [](q16_t c) { return bench_diff_sensor.get_flow_q16_from_counts<Units_flow::lpm, Order_type::third>(c, true); }},
+        {"flow mL/s 3rd",
+         [](double c) { return bench_diff_sensor.get_flow_from_counts(c, Units_flow::mlps, true, Order_type::third); },
+         [](q16_t c) { return bench_diff_sensor.get_flow_q16_from_counts<Units_flow::mlps, Order_type::third>(c, true); }},
+};
+
+template<typename F>
+static double time_ns_per_call(F fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int sweep = 0; sweep < SENSOR_BENCH_SWEEPS; sweep++) {
+        for (int counts = 0; counts < SENSOR_BENCH_COUNTS; counts++) {
+            fn(counts);
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / (double(SENSOR_BENCH_SWEEPS) * SENSOR_BENCH_COUNTS);
+}
+
+int sensor_bench_run()
+{
+    // The sensors as control_init() sets them up, with a type 0 differential sensor.
+    bench_gauge_sensor.init(MAX_GAUGE_PRESSURE, MIN_GAUGE_PRESSURE, RESISTANCE_1, RESISTANCE_2, 0);
+    bench_diff_sensor.init(MAX_DIFF_PRESSURE_TYPE_0, MIN_DIFF_PRESSURE_TYPE_0, RESISTANCE_1, RESISTANCE_2, 0);
+
+    printf("Fixed point (Q16) sensor conversions against double, over all %d ADC counts.\n", SENSOR_BENCH_COUNTS);
+    printf("One count is the change in the result for one ADC count, the resolution of the sensor.\n\n");
+    printf("%-16s %12s %12s %12s %10s %10s %8s\n", "conversion", "max error", "rms error", "one count", "double ns", "fixed ns", "speedup");
+
+    int failures = 0;
+    for (const bench_case& c : bench_cases) {
+        double max_error = 0;
+        double sum_squares = 0;
+        for (int counts = 0; counts < SENSOR_BENCH_COUNTS; counts++) {
+            double expected = c.convert_double(counts);
+            double actual = q16_to_float(c.convert_fixed(q16_from_int(counts)));
+            double error = fabs(actual - expected);
+            sum_squares += error * error;
+            if (error > max_error) {
+                max_error = error;
+            }
+        }
+        double rms_error = sqrt(sum_squares / SENSOR_BENCH_COUNTS);
+        double one_count = fabs(c.convert_double(SENSOR_BENCH_COUNTS - 1) - c.convert_double(0)) / (SENSOR_BENCH_COUNTS - 1);
+
+        double double_ns = time_ns_per_call([&](int counts) { bench_sink_double = c.convert_double(counts); });
+        double fixed_ns = time_ns_per_call([&](int counts) { bench_sink_fixed = c.convert_fixed(q16_from_int(counts)); });
+
+        bool pass = max_error < one_count;
+        if (!pass) {
+            failures++;
+        }
+
+        printf("%-16s %12.6f %12.6f %12.6f %10.2f %10.2f %7.1fx%s\n", c.name, max_error, rms_error, one_count,
+               double_ns, fixed_ns, fixed_ns > 0 ? double_ns / fixed_ns : 0, pass ? "" : "  FAIL");
+    }
+
+    printf("\nTimings are on the host, which has an FPU. The Due's Cortex-M3 does double in software.\n");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+#ifndef UVENT_SENSOR_BENCH_H
+#define UVENT_SENSOR_BENCH_H
+
+/* Host check of the fixed point sensor conversions against the double ones.
+ *
+ * Sweeps every ADC count through both paths of PressureSensor, for each of the
+ * conversions the firmware uses, and prints the largest and RMS difference and
+ * the time per call. Timings are the host's: it has an FPU, the Due does not,
+ * so on the Due the double path is slower by a wider margin.
+ *
+ * @return 0 if every fixed point result is within a count of the double one.
+ */
+int sensor_bench_run();
+
+#endif//UVENT_SENSOR_BENCH_H
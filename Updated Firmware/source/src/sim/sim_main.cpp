@@ -0,0 +1,337 @@
+/* Host runner for the native environment.
+ *
+ * Builds the same control stack that control.cpp wires up on the Due
+ * (actuator, sensors, waveform, alarms and the state machine), connects it
+ * to a simulated patient circuit, starts it breathing, and runs it on the
+ * native HAL's virtual clock, so a run takes as long as the host needs and
+ * every run of the same arguments gives the same breaths.
+ * Pass --realtime to run against the wall clock instead.
+ * Pass --telemetry and a file name to turn the binary telemetry on and record the
+ * serial port to the file, for tools/telemetry.py.
+ * Pass --log and a count to print that many of the newest black box entries at
+ * the end, from the native HAL's EEPROM, which starts blank each run.
+ * Pass --pcv and a pressure in cmH2O for pressure controlled breaths to that PIP,
+ * to tune the PID in controls/pressurePID.h against the circuit.
+ * Every call into Machine::run() and Actuator::run() is timed, so their cost can
+ * be measured without a debugger attached to a board. With the hardware step
+ * generator, Actuator::run() is not polled and only Machine::run() is timed.
+ *
+ * Usage: program [seconds] [bpm] [compliance: 20, 50 or 0 for no lung] [--realtime] [--telemetry file] [--log count] [--pcv cmH2O]
+ *        program bench    checks the fixed point sensor conversions, see sensor_bench.h
+ *        program alarms   checks the alarm text path doesn't allocate, see alarm_bench.h
+ *        program eeprom   checks the settings journal, power cuts included, see eeprom_bench.h
+ *        program display [dir]  times the screens' frames on a headless display, see display_bench.h
+ *        program channels checks the control handler's snapshots and queues from two threads, see channel_bench.h
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <Arduino.h>
+#include <DueTimer.h>
+#include <native_hal.h>
+#include "../../config/uvent_conf.h"
+#include "actuators/actuator.h"
+#include "alarm/alarm.h"
+#include "alarm/alarm_rules.h"
+#include "controls/machine.h"
+#include "controls/telemetry.h"
+#include "eeprom/black_box.h"
+#include "controls/waveform.h"
+#include "sensors/adc_sampler.h"
+#include "sensors/breath_analyzer.h"
+#include "sensors/pressure_sensor.h"
+#include "alarm_bench.h"
+#include "channel_bench.h"
+#include "display_bench.h"
+#include "eeprom_bench.h"
+#include "lung_sim.h"
+#include "sensor_bench.h"
+
+// Patient circuit update period, in microsec.
+#define LUNG_SIM_PERIOD_US 1000
+
+struct handler_timing {
+    const char* name;
+    uint32_t calls;
+    double total_ns;
+    double max_ns;
+};
+
+static Actuator sim_actuator;
+static PressureSensor sim_gauge_sensor = {PRESSURE_GAUGE_PIN};
+static PressureSensor sim_diff_sensor = {PRESSURE_DIFF_PIN};
+static BreathAnalyzer sim_breath_analyzer = {&sim_gauge_sensor, &sim_diff_sensor};
+static Waveform sim_waveform;
+static uint32_t sim_cycle_count = 0;
+static AlarmManager sim_alarm_manager{SPEAKER_PIN, &sim_cycle_count};
+static AlarmRules sim_alarm_rules(&sim_alarm_manager, &sim_breath_analyzer, &sim_waveform);
+static Machine sim_machine(States::ST_STARTUP, &sim_actuator, &sim_waveform, &sim_gauge_sensor, &sim_breath_analyzer, &sim_alarm_manager, &sim_cycle_count);
+static Telemetry sim_telemetry(&sim_machine, &sim_actuator, &sim_gauge_sensor, &sim_diff_sensor, &sim_waveform, &sim_cycle_count);
+static BlackBox sim_black_box(&sim_machine, &sim_breath_analyzer, &sim_alarm_manager);
+
+static LungSim* sim_lung = nullptr;
+
+// Peak flow read back through the differential sensor, over the current breath.
+static double sim_measured_peak_flow = 0;
+
+static handler_timing machine_timing = {"Machine::run", 0, 0, 0};
+static handler_timing alarm_rules_timing = {"AlarmRules", 0, 0, 0};
+#if !USE_HW_STEP_GENERATOR
+static handler_timing actuator_timing = {"Actuator::run", 0, 0, 0};
+#endif
+
+template<typename F>
+static void timed_call(handler_timing& timing, F fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    timing.calls++;
+    timing.total_ns += ns;
+    if (ns > timing.max_ns) {
+        timing.max_ns = ns;
+    }
+}
+
+static void sim_control_handler()
+{
+    timed_call(machine_timing, []() { sim_machine.run(); });
+    timed_call(alarm_rules_timing, []() { sim_alarm_rules.update(); });
+    sim_black_box.update();
+    sim_telemetry.update();
+}
+
+#if !USE_HW_STEP_GENERATOR
+static void sim_actuator_handler()
+{
+    timed_call(actuator_timing, []() { sim_actuator.run(); });
+}
+#endif
+
+static void sim_lung_handler()
+{
+    sim_lung->step(LUNG_SIM_PERIOD_US * 1e-6);
+
+    double flow = sim_diff_sensor.get_flow(units_flow::lpm, true, Order_type::third);
+    if (flow > sim_measured_peak_flow) {
+        sim_measured_peak_flow = flow;
+    }
+}
+
+static C_Stat parse_compliance(const char* arg)
+{
+    switch (atoi(arg)) {
+        case 20:
+            return C_Stat::TWENTY;
+        case 50:
+            return C_Stat::FIFTY;
+        default:
+            return C_Stat::NONE;
+    }
+}
+
+static const char* compliance_string(C_Stat compliance)
+{
+    switch (compliance) {
+        case C_Stat::TWENTY:
+            return "C20";
+        case C_Stat::FIFTY:
+            return "C50";
+        default:
+            return "no lung";
+    }
+}
+
+/* One line per breath: what the machine measured next to what the circuit saw.
+ * Printed at the start of each inspiration, for the breath just finished.
+ */
+static void print_breath(uint32_t breath_number)
+{
+    waveform_params* p = sim_waveform.get_params();
+    lung_sim_breath truth = sim_lung->take_breath_stats();
+
+    printf("%6u  pip %5.1f/%5.1f  plat %5.1f  peep %5.1f/%5.1f  vti %6.1f/%6.1f  vte %6.1f/%6.1f  mv %5.2f  flow %5.1f/%5.1f  rr %4.1f  c %5.1f/%5.1f  r %5.1f/%5.1f  alarms %u\n",
+           breath_number, p->m_pip, truth.peak_pressure, p->m_plateau_press, p->m_peep, truth.min_pressure,
+           p->m_vti, truth.inspired_volume, p->m_vte, truth.expired_volume, p->m_minute_volume,
+           sim_measured_peak_flow, truth.peak_flow, p->m_rr, p->m_compliance, sim_lung->get_compliance(),
+           p->m_resistance, sim_lung->get_resistance(), (unsigned) sim_alarm_manager.numON());
+
+    sim_measured_peak_flow = 0;
+}
+
+static void print_timing(const handler_timing& timing, uint32_t period_us)
+{
+    double mean_ns = timing.calls ? timing.total_ns / timing.calls : 0;
+    printf("%-14s %10u calls  mean %9.1f ns  max %9.1f ns  (%.3f%% of a %u us period)\n",
+           timing.name, timing.calls, mean_ns, timing.max_ns, 100.0 * mean_ns / (period_us * 1000.0), period_us);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return sensor_bench_run();
+    }
+    if (argc > 1 && strcmp(argv[1], "alarms") == 0) {
+        return alarm_bench_run();
+    }
+    if (argc > 1 && strcmp(argv[1], "eeprom") == 0) {
+        return eeprom_bench_run();
+    }
+    if (argc > 1 && strcmp(argv[1], "channels") == 0) {
+        return channel_bench_run();
+    }
+    if (argc > 1 && strcmp(argv[1], "display") == 0) {
+        return display_bench_run(argc > 2 ? argv[2] : nullptr);
+    }
+
+    // Options out of the way first, the rest are positional.
+    bool realtime = false;
+    const char* telemetry_path = nullptr;
+    int log_count = 0;
+    int pcv_pressure = 0;
+    int positional = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        }
+        else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetry_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            log_count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--pcv") == 0 && i + 1 < argc) {
+            pcv_pressure = atoi(argv[++i]);
+        }
+        else {
+            argv[positional++] = argv[i];
+        }
+    }
+    argc = positional;
+
+    uint32_t run_seconds = argc > 1 ? (uint32_t) atoi(argv[1]) : 10;
+    uint16_t bpm = argc > 2 ? (uint16_t) atoi(argv[2]) : BPM_MAX;
+    C_Stat compliance = argc > 3 ? parse_compliance(argv[3]) : C_Stat::FIFTY;
+
+    // Keep the firmware's own logging out of the report.
+    native_hal_serial_set_echo(false);
+
+    native_hal_set_virtual_clock(!realtime);
+
+    FILE* telemetry_file = nullptr;
+    if (telemetry_path) {
+        telemetry_file = fopen(telemetry_path, "wb");
+        if (!telemetry_file) {
+            printf("Can't open %s\n", telemetry_path);
+            return 1;
+        }
+        native_hal_serial_set_capture(telemetry_file);
+        sim_telemetry.set_enable(true);
+    }
+
+    lung_sim_params lung_params = {
+            .compliance = compliance,
+            .resistance = 20,
+            .exp_resistance = 5,
+            .peep = DEF_PEEP,
+            .gauge_max_psi = MAX_GAUGE_PRESSURE,
+            .gauge_min_psi = MIN_GAUGE_PRESSURE,
+            .diff_max_psi = MAX_DIFF_PRESSURE_TYPE_0,
+            .diff_min_psi = MIN_DIFF_PRESSURE_TYPE_0,
+    };
+    LungSim lung(&sim_actuator, lung_params);
+    sim_lung = &lung;
+
+    // The sensors read the circuit through the ADC.
+    native_hal_set_analog_source(LungSim::analog_source, &lung);
+
+    sim_actuator.init();
+    sim_gauge_sensor.init(MAX_GAUGE_PRESSURE, MIN_GAUGE_PRESSURE, RESISTANCE_1, RESISTANCE_2, 0);
+    sim_diff_sensor.init(MAX_DIFF_PRESSURE_TYPE_0, MIN_DIFF_PRESSURE_TYPE_0, RESISTANCE_1, RESISTANCE_2, 0);
+#if USE_ADC_SAMPLER
+    adc_sampler_init(&sim_gauge_sensor, &sim_diff_sensor);
+#endif
+    sim_black_box.init();
+    sim_machine.setup();
+
+    sim_waveform.get_params()->bpm = bpm;
+    if (pcv_pressure > 0) {
+        sim_waveform.get_params()->pip = (uint16_t) pcv_pressure;
+        sim_machine.change_mode(ControlModes::PCV);
+        sim_alarm_rules.set_volume_controlled(false);
+    }
+
+    Timer0.attachInterrupt(sim_control_handler);
+    Timer0.start(CONTROL_HANDLER_PERIOD_US);
+#if !USE_HW_STEP_GENERATOR
+    Timer1.attachInterrupt(sim_actuator_handler);
+    Timer1.start(ACTUATOR_HANDLER_PERIOD_US);
+#endif
+    Timer3.attachInterrupt(sim_lung_handler);
+    Timer3.start(LUNG_SIM_PERIOD_US);
+
+    // Wait out the startup state, then start ventilating.
+    while (sim_machine.get_current_state() != States::ST_OFF) {
+        native_hal_advance_us(LUNG_SIM_PERIOD_US);
+        sim_telemetry.service();
+        sim_black_box.service();
+    }
+    sim_machine.change_state(States::ST_INSPR);
+
+    printf("Running for %u s at %u bpm, %s", run_seconds, bpm, compliance_string(compliance));
+    if (pcv_pressure > 0) {
+        printf(", PCV to %d cmH2O", pcv_pressure);
+    }
+    printf("\n");
+    printf("Pressures in cmH2O, volumes in mL, minute volume and flow in L/min. Pairs are measured/circuit.\n");
+
+    uint32_t last_cycle_count = sim_cycle_count;
+    uint64_t start_us = native_hal_time_us();
+    auto wall_start = std::chrono::steady_clock::now();
+    while (native_hal_time_us() - start_us < run_seconds * 1000000ULL) {
+        native_hal_advance_us(LUNG_SIM_PERIOD_US);
+        sim_telemetry.service();
+        sim_black_box.service();
+
+        if (sim_cycle_count != last_cycle_count) {
+            print_breath(last_cycle_count);
+            last_cycle_count = sim_cycle_count;
+        }
+    }
+
+    Timer0.stop();
+#if !USE_HW_STEP_GENERATOR
+    Timer1.stop();
+#endif
+    Timer3.stop();
+
+    if (telemetry_file) {
+        sim_telemetry.service();
+        native_hal_serial_set_capture(nullptr);
+        fclose(telemetry_file);
+        printf("Telemetry: %u records to %s, %u dropped\n", sim_telemetry.get_frames_queued(), telemetry_path,
+               sim_telemetry.get_frames_dropped());
+    }
+
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    printf("Breaths started: %u, final state: %s\n", sim_cycle_count, sim_machine.get_current_state_string());
+    printf("Alarms on: %s\n", sim_alarm_manager.numON() ? sim_alarm_manager.getBanner() : "none");
+    printf("Black box: %u entries, %u lost\n", sim_black_box.get_count(), sim_black_box.get_lost());
+    if (log_count > 0) {
+        native_hal_serial_set_echo(true);
+        sim_black_box.dump(log_count);
+        native_hal_serial_set_echo(false);
+    }
+    print_timing(machine_timing, CONTROL_HANDLER_PERIOD_US);
+    print_timing(alarm_rules_timing, CONTROL_HANDLER_PERIOD_US);
+#if !USE_HW_STEP_GENERATOR
+    print_timing(actuator_timing, ACTUATOR_HANDLER_PERIOD_US);
+#endif
+    printf("Simulated %u s in %.2f s of wall time (%.1fx)\n", run_seconds, wall_s, wall_s > 0 ? run_seconds / wall_s : 0);
+
+    return 0;
+}
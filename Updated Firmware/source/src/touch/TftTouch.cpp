@@ -3,11 +3,19 @@
 
 volatile bool has_new_touch = false;
 
+// Set when a queued read of the touch registers is done, from whoever stepped the bus.
+static volatile bool touch_read_done = false;
+
 void handle_interrupt()
 {
     has_new_touch = true;
 }
 
+static void on_touch_read(i2c_transaction* transaction)
+{
+    touch_read_done = transaction->status == I2c_Status::DONE;
+}
+
 TftTouch::TftTouch(uint8_t int_pin, uint8_t rst_pin)
 {
     interrupt_pin = int_pin;
@@ -32,24 +40,45 @@ void TftTouch::init()
 
     Serial.println("Beginning I2C Wire");
     Wire.begin();
-    Wire.beginTransmission(FT_I2C_ADDRESS);
-    Wire.write(FT_DEVICE_MODE);
-    Wire.write(0);
-    Wire.endTransmission(FT_I2C_ADDRESS);
+    i2c_bus_init();
+
+    {
+        I2cBusLock lock;
+        Wire.beginTransmission(FT_I2C_ADDRESS);
+        Wire.write(FT_DEVICE_MODE);
+        Wire.write(0);
+        Wire.endTransmission(FT_I2C_ADDRESS);
+    }
+
+    touch_read.address = FT_I2C_ADDRESS;
+    touch_read.reg = FT_TOUCH1_BEGIN;
+    touch_read.data = touch_registers;
+    touch_read.length = TOUCH_READ_BYTES;
+    touch_read.read = true;
+    touch_read.priority = I2c_Priority::TOUCH;
+    touch_read.on_done = on_touch_read;
     Serial.println("Touchscreen setup done.");
 }
 
 bool TftTouch::touched()
 {
-    if (has_new_touch) {
-        has_new_touch = false;
+    /* Hand over a finished read first. The next one fills the same registers, so it is
+     * only queued on the next call, once the caller has parsed this one.
+     */
+    if (touch_read_done) {
+        touch_read_done = false;
         return true;
     }
+
+    if (has_new_touch && i2c_bus_submit(touch_read)) {
+        has_new_touch = false;
+    }
     return false;
 }
 
 void TftTouch::print_info()
 {
+    I2cBusLock lock;
     byte registers[FT_REG_COUNT];
     memset(registers, 0, FT_REG_COUNT);
     Wire.beginTransmission(FT_I2C_ADDRESS);
@@ -85,6 +114,7 @@ void TftTouch::reset() const
 
 void TftTouch::read_num_touch_points(uint8_t& points)
 {
+    I2cBusLock lock;
     Wire.beginTransmission(FT_I2C_ADDRESS);
     Wire.write(FT_TOUCH_POINTS);
     Wire.endTransmission(FT_I2C_ADDRESS);
@@ -96,22 +126,12 @@ void TftTouch::read_num_touch_points(uint8_t& points)
 
 void TftTouch::read_touch_registers(uint8_t len)
 {
-    int array_length = len * NUM_BYTES_PER_INPUT+1;
-    uint8_t raw_data[array_length];
-    memset(raw_data, 0, array_length);
-
-    Wire.beginTransmission(FT_I2C_ADDRESS);
-    Wire.write(FT_TOUCH1_BEGIN);
-    Wire.endTransmission(FT_I2C_ADDRESS);
-    Wire.requestFrom(FT_I2C_ADDRESS, array_length);
-    int idx = 0;
-    while (Wire.available()) {
-        raw_data[idx] = Wire.read();
-        idx++;
+    if (len > TOUCH_READ_POINTS) {
+        len = TOUCH_READ_POINTS;
     }
 
-    for (idx = 0; idx < len; idx++) {
-        read_touch(new_touch_data+idx, raw_data, idx);
+    for (uint8_t idx = 0; idx < len; idx++) {
+        read_touch(new_touch_data+idx, touch_registers, idx);
     }
 }
 
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include "Wire.h"
 #include "../../config/uvent_conf.h"
+#include "utilities/i2c_bus.h"
 
 #define FT_I2C_ADDRESS              0x38
 #define FT_STATUS_MASK              0b11000000
@@ -14,6 +15,10 @@
 #define READ_INPUTS_LENGTH          NUM_TOUCH_REGISTERS * NUM_BYTES_PER_INPUT
 #define FT_REG_COUNT                0xFE
 
+// Touch points read after each touch interrupt, LVGL takes one.
+#define TOUCH_READ_POINTS           1
+#define TOUCH_READ_BYTES            (TOUCH_READ_POINTS * NUM_BYTES_PER_INPUT + 1)
+
 #define FT_DEVICE_MODE              0x00
 
 #define FT_GESTURE_ID               0x01
@@ -162,7 +167,14 @@ public:
     ~TftTouch() = default;
 
     void init();
+
+    /* Queues a read of the touch registers on the I2C bus after a touch interrupt,
+     * returns true once one is done. Never waits for the bus.
+     * No read is queued until the next call, so take the points before calling again.
+     */
     bool touched();
+
+    // Takes the points from the last read, up to TOUCH_READ_POINTS.
     void read_touch_registers(uint8_t len);
     void print_info();
 
@@ -175,6 +187,10 @@ protected:
     void read_num_touch_points(uint8_t& points);
     uint8_t interrupt_pin;
     uint8_t reset_pin;
+
+    // Set up by init(), the object is copied before that.
+    i2c_transaction touch_read = {};
+    uint8_t touch_registers[TOUCH_READ_BYTES];
 };
 
 #endif //UVENT_TFTTOUCH_H
@@ -2,7 +2,12 @@
 #include "controls/control.h"
 #include "controls/machine.h"
 #include "controls/waveform.h"
+#include "display/flush_pipeline.h"
+#include "utilities/i2c_bus.h"
 #include "utilities/logging.h"
+#include "utilities/memtest.h"
+#include "utilities/perf.h"
+#include "utilities/scheduler.h"
 #include <Arduino.h>
 #include <limits.h>
 
@@ -20,6 +25,10 @@ static void command_waveform(int argc, char** argv);
 static void command_pressure(int argc, char** argv);
 static void command_alarm(int argc, char** argv);
 static void command_fault(int argc, char** argv);
+static void command_perf(int argc, char** argv);
+static void command_telemetry(int argc, char** argv);
+static void command_mem(int argc, char** argv);
+static void command_log(int argc, char** argv);
 
 /* Command response, with error code. */
 static void print_response(Error_Codes error)
@@ -76,7 +85,11 @@ command_type commands[] =
                 {"wave", command_waveform, "\t\tWaveform related commands.\r\n"},
                 {"press", command_pressure, "\t\tPressure related commands.\r\n"},
                 {"fault", command_fault, "\t\tForce a fault.\r\n"},
-                {"alarm", command_alarm, "\t\\Alarm related commands.\r\n"}};
+                {"alarm", command_alarm, "\t\\Alarm related commands.\r\n"},
+                {"perf", command_perf, "\t\tHandler timings.\r\n"},
+                {"telem", command_telemetry, "\t\tBinary telemetry stream.\r\n"},
+                {"mem", command_mem, "\t\tMemory use, and heap growth since setup.\r\n"},
+                {"log", command_log, "\t\tBlack box of breaths, alarms and faults.\r\n"}};
 
 uint16_t const command_array_size = sizeof(commands) / sizeof(command_type);
 
@@ -138,6 +151,7 @@ command_actuator(int argc, char** argv)
         Serial.println("mv_deg   - Moves the actuator to a position(degrees).");
         Serial.println("mv_steps - Moves the actuator by no. of steps(steps).");
         Serial.println("volume   - Get the tidal volume from the Ambu Bag (liters).");
+        Serial.println("vtable   - Show, set or save the volume tables.");
         Serial.println("enable   - Enable/Disable the drive.");
         return;
     }
@@ -297,6 +311,86 @@ command_actuator(int argc, char** argv)
             return;
         }
     }
+    else if (!(strcmp(argv[1], "vtable"))) {
+        if (argc == 2) {
+            // Not enough arguments.
+            print_response(Error_Codes::ER_NOT_ENOUGH_ARGS);
+            return;
+        }
+        if (!(strcmp(argv[2], "help"))) {
+            Serial.println("Format: vtable command");
+            Serial.println("show compliance     - Prints the table, volume(mL) every 20 degrees from 0.");
+            Serial.println("set compliance v... - Replaces the table, until the next restart.");
+            Serial.println("save                - Stores the tables in the EEPROM as this unit's calibration.");
+            Serial.println("reset               - Goes back to the default tables, and erases the calibration.");
+            Serial.println("compliance - none, 20, or 50");
+            return;
+        }
+
+        if (!(strcmp(argv[2], "save"))) {
+            control_save_volume_tables();
+            print_response(Error_Codes::ER_NONE);
+            return;
+        }
+        else if (!(strcmp(argv[2], "reset"))) {
+            control_reset_volume_tables();
+            print_response(Error_Codes::ER_NONE);
+            return;
+        }
+
+        if (argc == 3) {
+            // Not enough arguments.
+            print_response(Error_Codes::ER_NOT_ENOUGH_ARGS);
+            return;
+        }
+
+        C_Stat compliance;
+        if (!(strcmp(argv[3], "none"))) {
+            compliance = C_Stat::NONE;
+        }
+        else if (!(strcmp(argv[3], "20"))) {
+            compliance = C_Stat::TWENTY;
+        }
+        else if (!(strcmp(argv[3], "50"))) {
+            compliance = C_Stat::FIFTY;
+        }
+        else {
+            print_response(Error_Codes::ER_INVALID_ARG);
+            return;
+        }
+
+        if (!(strcmp(argv[2], "show"))) {
+            const volume_table& table = control_get_volume_table(compliance);
+            for (int i = 0; i < VOLUME_TABLE_POINTS; i++) {
+                serial_printf("%d %d\n", i * VOLUME_TABLE_STEP_DEG, table.volume_ml[i]);
+            }
+            return;
+        }
+        else if (!(strcmp(argv[2], "set"))) {
+            if (argc < 4 + VOLUME_TABLE_POINTS) {
+                print_response(Error_Codes::ER_NOT_ENOUGH_ARGS);
+                return;
+            }
+
+            volume_table table;
+            for (int i = 0; i < VOLUME_TABLE_POINTS; i++) {
+                int32_t volume;
+                if (!(sanitize_input(argv[4 + i], &volume)) || (volume < 0) || (volume > UINT16_MAX)) {
+                    print_response(Error_Codes::ER_INVALID_ARG);
+                    return;
+                }
+                table.volume_ml[i] = volume;
+            }
+
+            // The volumes have to start at 0 and go up.
+            print_response(control_set_volume_table(compliance, table) ? Error_Codes::ER_NONE : Error_Codes::ER_INVALID_ARG);
+            return;
+        }
+        else {
+            print_response(Error_Codes::ER_INVALID_ARG);
+            return;
+        }
+    }
     else if (!(strcmp(argv[1], "enable"))) {
         if (!(strcmp(argv[2], "help"))) {
             Serial.println("Format: enable 0/1");
@@ -330,6 +424,7 @@ command_state(int argc, char** argv)
         Serial.println("which     - Returns the current state ID.");
         Serial.println("which_str - Returns the current state string.");
         Serial.println("switch    - Force switch to a state.");
+        Serial.println("mode      - Returns, or sets while off, vcv or pcv breaths.");
     }
     else if (!(strcmp(argv[1], "which"))) {
         Serial.println((uint16_t) control_get_state());
@@ -353,6 +448,29 @@ command_state(int argc, char** argv)
 
         return;
     }
+    else if (!(strcmp(argv[1], "mode"))) {
+        if (argc == 2) {
+            Serial.println(control_get_mode() == ControlModes::PCV ? "pcv" : "vcv");
+            return;
+        }
+
+        ControlModes mode;
+        if (!(strcmp(argv[2], "vcv"))) {
+            mode = ControlModes::VCV;
+        }
+        else if (!(strcmp(argv[2], "pcv"))) {
+            mode = ControlModes::PCV;
+        }
+        else {
+            print_response(Error_Codes::ER_INVALID_ARG);
+            return;
+        }
+
+        if (!control_change_mode(mode)) {
+            Serial.println("Turn the machine off first.");
+        }
+        return;
+    }
     else if (!(strcmp(argv[1], "switch"))) {
         if (argc == 2) {
             // Not enough arguments.
@@ -654,8 +772,8 @@ command_alarm(int argc, char** argv)
         return;
     }
     else if (!(strcmp(argv[1], "text"))) {
-        String a_text = control_get_alarm_text();
-        if (a_text) {
+        const char* a_text = control_get_alarm_text();
+        if (a_text[0] != '\0') {
             Serial.println(a_text);
         }
         else {
@@ -684,4 +802,225 @@ command_alarm(int argc, char** argv)
         print_response(Error_Codes::ER_NONE);
         return;
     }
-}
\ No newline at end of file
+}
+
+/* Microsec, to a tenth, from cycles. */
+static float cycles_to_us(uint64_t cycles)
+{
+    return (float) cycles / PERF_CYCLES_PER_US;
+}
+
+/* Perf function. */
+static void
+command_perf(int argc, char** argv)
+{
+    // Check is help is requested for this command.
+    if ((argc > 1) && !(strcmp(argv[1], "help"))) {
+        Serial.println("Format: perf command");
+        Serial.println("(none)    - Execution time and period of each handler, in microsec.");
+        Serial.println("hist name - Histograms of a handler's execution time and period jitter.");
+        Serial.println("display   - Frame rate, display bus use and strips of the LVGL flushes.");
+        Serial.println("i2c       - Transactions on the I2C queue, and their longest wait, by priority.");
+        Serial.println("tasks     - Run time, overruns and deadline misses of the loop() tasks, and idle time.");
+        Serial.println("reset     - Clears the timings.");
+        return;
+    }
+    else if ((argc == 1) || !(strcmp(argv[1], "show"))) {
+        serial_printf("%-9s %8s %9s %9s %9s %8s %6s %9s %9s\n",
+                      "handler", "calls", "min", "mean", "max", "budget", "over", "per. min", "per. max");
+        for (int i = 0; i < static_cast<int>(Perf_Probe::COUNT); i++) {
+            perf_stats stats;
+            perf_get_stats(static_cast<Perf_Probe>(i), stats);
+            if (stats.calls == 0) {
+                serial_printf("%-9s %8d\n", stats.name, 0);
+                continue;
+            }
+
+            bool has_period = stats.max_period_cycles != 0;
+            serial_printf("%-9s %8lu %9.1f %9.1f %9.1f %8lu %6lu %9.1f %9.1f\n",
+                          stats.name, stats.calls, cycles_to_us(stats.min_cycles),
+                          cycles_to_us(stats.total_cycles / stats.calls), cycles_to_us(stats.max_cycles),
+                          stats.budget_us, stats.overruns,
+                          has_period ? cycles_to_us(stats.min_period_cycles) : 0.0f,
+                          has_period ? cycles_to_us(stats.max_period_cycles) : 0.0f);
+        }
+        return;
+    }
+    else if (!(strcmp(argv[1], "hist"))) {
+        if (argc == 2) {
+            // Not enough arguments.
+            print_response(Error_Codes::ER_NOT_ENOUGH_ARGS);
+            return;
+        }
+
+        for (int i = 0; i < static_cast<int>(Perf_Probe::COUNT); i++) {
+            perf_stats stats;
+            perf_get_stats(static_cast<Perf_Probe>(i), stats);
+            if (strcmp(argv[2], stats.name)) {
+                continue;
+            }
+
+            // Jitter is off the nominal period, only for the handlers that have one.
+            serial_printf("%-14s %10s %10s\n", "us", "exec", stats.period_us ? "jitter" : "");
+            for (int bin = 0; bin < PERF_HISTOGRAM_BINS; bin++) {
+                uint32_t low = (bin == 0) ? 0 : 1UL << (bin - 1);
+                if (bin == PERF_HISTOGRAM_BINS - 1) {
+                    serial_printf("%6lu+        %10lu %10lu\n", low, stats.exec_histogram[bin], stats.jitter_histogram[bin]);
+                }
+                else {
+                    serial_printf("%6lu - %-6lu %10lu %10lu\n", low, 1UL << bin, stats.exec_histogram[bin], stats.jitter_histogram[bin]);
+                }
+            }
+            return;
+        }
+
+        print_response(Error_Codes::ER_INVALID_ARG);
+        return;
+    }
+    else if (!(strcmp(argv[1], "display"))) {
+        display_flush_stats stats;
+        display_flush_get_stats(stats);
+        if (stats.elapsed_ms == 0 || stats.frames == 0) {
+            Serial.println("No frames yet.");
+            return;
+        }
+
+        float seconds = stats.elapsed_ms / 1000.0f;
+        serial_printf("frames %lu in %.1f s, %.1f fps\n", stats.frames, seconds, stats.frames / seconds);
+        serial_printf("strips %lu, %lu lines, %.0f px a frame\n", stats.strips, (uint32_t) stats.strip_lines,
+                      (float) stats.flushed_px / stats.frames);
+        serial_printf("render %.1f us, wait %.1f us, to last flush %.1f us, a frame\n",
+                      cycles_to_us(stats.render_cycles / stats.frames), cycles_to_us(stats.wait_cycles / stats.frames),
+                      cycles_to_us(stats.frame_cycles / stats.frames));
+        serial_printf("bus busy %.1f %%\n", 100.0f * cycles_to_us(stats.bus_cycles) / (stats.elapsed_ms * 1000.0f));
+        serial_printf("areas %lu, %lu merged\n", stats.areas, stats.merged);
+        return;
+    }
+    else if (!(strcmp(argv[1], "i2c"))) {
+        static const char* const priority_names[I2C_BUS_PRIORITIES] = {"control", "touch", "bulk"};
+        i2c_bus_stats stats;
+        i2c_bus_get_stats(stats);
+
+        serial_printf("%-9s %8s %8s %9s\n", "priority", "done", "failed", "max wait");
+        for (int p = 0; p < I2C_BUS_PRIORITIES; p++) {
+            serial_printf("%-9s %8lu %8lu %9.1f\n", priority_names[p], stats.transactions[p], stats.failed[p],
+                          cycles_to_us(stats.max_wait_cycles[p]));
+        }
+        serial_printf("chunks %lu, retries %lu, control reads held off %lu\n", stats.chunks, stats.retries, stats.held_off);
+        return;
+    }
+    else if (!(strcmp(argv[1], "tasks"))) {
+        uint32_t elapsed_ms;
+        uint64_t idle_cycles;
+        scheduler_get_idle(elapsed_ms, idle_cycles);
+        if (elapsed_ms == 0) {
+            Serial.println("No tasks run yet.");
+            return;
+        }
+
+        serial_printf("%-9s %8s %9s %9s %8s %6s %6s %9s %6s\n",
+                      "task", "runs", "mean", "max", "budget", "over", "miss", "max late", "cpu %");
+        for (int i = 0; i < scheduler_task_count(); i++) {
+            scheduler_task_stats stats;
+            scheduler_get_stats(i, stats);
+            serial_printf("%-9s %8lu %9.1f %9.1f %8lu %6lu %6lu %9lu %6.1f%s\n",
+                          stats.name, stats.runs, stats.runs ? cycles_to_us(stats.total_cycles / stats.runs) : 0.0f,
+                          cycles_to_us(stats.max_cycles), stats.budget_us, stats.overruns, stats.misses,
+                          stats.max_late_us, 100.0f * cycles_to_us(stats.total_cycles) / (elapsed_ms * 1000.0f),
+                          stats.enabled ? "" : " (off)");
+        }
+        serial_printf("idle %.1f %% of %.1f s\n", 100.0f * cycles_to_us(idle_cycles) / (elapsed_ms * 1000.0f),
+                      elapsed_ms / 1000.0f);
+        return;
+    }
+    else if (!(strcmp(argv[1], "reset"))) {
+        perf_reset();
+        display_flush_reset();
+        i2c_bus_reset_stats();
+        scheduler_reset_stats();
+        print_response(Error_Codes::ER_NONE);
+        return;
+    }
+}
+
+/* Telemetry function. */
+static void
+command_telemetry(int argc, char** argv)
+{
+    Telemetry* p_telemetry = control_get_telemetry();
+
+    // Check is help is requested for this command or no arguments were included.
+    if (!(strcmp(argv[1], "help")) || (argc == 1)) {
+        Serial.println("Format: telem command");
+        Serial.println("on        - Starts the stream, decode it with tools/telemetry.py.");
+        Serial.println("off       - Stops the stream.");
+        Serial.println("stats     - Records queued and dropped.");
+        return;
+    }
+    else if (!(strcmp(argv[1], "on"))) {
+        p_telemetry->set_enable(true);
+        print_response(Error_Codes::ER_NONE);
+        return;
+    }
+    else if (!(strcmp(argv[1], "off"))) {
+        p_telemetry->set_enable(false);
+        print_response(Error_Codes::ER_NONE);
+        return;
+    }
+    else if (!(strcmp(argv[1], "stats"))) {
+        serial_printf("%s, queued %lu, dropped %lu\n", p_telemetry->is_enabled() ? "on" : "off",
+                      p_telemetry->get_frames_queued(), p_telemetry->get_frames_dropped());
+        return;
+    }
+    else {
+        print_response(Error_Codes::ER_INVALID_ARG);
+        return;
+    }
+}
+
+/* Memory function. */
+static void
+command_mem(int argc, char** argv)
+{
+    // Check is help is requested for this command.
+    if ((argc > 1) && !(strcmp(argv[1], "help"))) {
+        Serial.println("Format: mem command");
+        Serial.println("(none)    - Memory use. The heap should not grow after setup.");
+        return;
+    }
+    else if (argc == 1) {
+        printMem();
+        return;
+    }
+    else {
+        print_response(Error_Codes::ER_INVALID_ARG);
+        return;
+    }
+}
+
+/* Black box function. */
+static void
+command_log(int argc, char** argv)
+{
+    // Check is help is requested for this command or no arguments were included.
+    if (!(strcmp(argv[1], "help")) || (argc == 1)) {
+        Serial.println("Format: log command");
+        Serial.println("dump      - Prints every entry, oldest first.");
+        Serial.println("dump N    - Prints the newest N entries.");
+        return;
+    }
+    else if (!(strcmp(argv[1], "dump"))) {
+        int32_t count = INT32_MAX;
+        if (argc > 2 && (!sanitize_input(argv[2], &count) || count < 0)) {
+            print_response(Error_Codes::ER_INVALID_ARG);
+            return;
+        }
+        control_dump_black_box((uint32_t) count);
+        print_response(Error_Codes::ER_NONE);
+        return;
+    }
+    else {
+        print_response(Error_Codes::ER_INVALID_ARG);
+        return;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef UVENT_FIXED_POINT_H
+#define UVENT_FIXED_POINT_H
+
+#include <Arduino.h>
+
+/* Q16.16 fixed point, for the sensor math that runs in the control handler.
+ *
+ * The Due's Cortex-M3 has no FPU, every float or double operation is a library
+ * call. A Q16 multiply is one 32x32->64 multiply and a shift.
+ * Range is +-32767, with a resolution of 1/65536.
+ *
+ * Constants are made with q16_from_double() in constant expressions, so no
+ * floating point is left in the code that uses them.
+ */
+
+typedef int32_t q16_t;
+
+#define Q16_ONE ((q16_t) 1 << 16)
+
+constexpr q16_t q16_from_double(double value)
+{
+    return q16_t(value * 65536.0 + (value < 0 ? -0.5 : 0.5));
+}
+
+// Scale factors that don't fit Q16, e.g. a slope per ADC count.
+constexpr int64_t q32_from_double(double value)
+{
+    return int64_t(value * 4294967296.0 + (value < 0 ? -0.5 : 0.5));
+}
+
+inline q16_t q16_from_int(int32_t value)
+{
+    return value * Q16_ONE;
+}
+
+inline float q16_to_float(q16_t value)
+{
+    return value * (1.0f / Q16_ONE);
+}
+
+// Product of two Q16 values, rounded.
+inline q16_t q16_mul(q16_t a, q16_t b)
+{
+    return q16_t(((int64_t) a * b + (Q16_ONE >> 1)) >> 16);
+}
+
+#endif
@@ -0,0 +1,361 @@
+#include "i2c_bus.h"
+#include "utilities/perf.h"
+#include <DueTimer.h>
+
+// Queued, per priority, oldest first. A transaction stays at the head of its queue until it is done.
+static i2c_transaction* heads[I2C_BUS_PRIORITIES];
+static i2c_transaction* tails[I2C_BUS_PRIORITIES];
+
+// The transaction with a chunk on the bus.
+static i2c_transaction* volatile current = nullptr;
+
+// Holds on the bus for Wire, see i2c_bus_lock().
+static volatile uint32_t held = 0;
+
+static i2c_bus_stats stats{};
+
+// While the bus is held only control transactions go, from the holder itself.
+static i2c_transaction* most_urgent()
+{
+    for (uint8_t p = 0; p < I2C_BUS_PRIORITIES; p++) {
+        if (heads[p]) {
+            return heads[p];
+        }
+        if (held) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+static void finish(i2c_transaction* t, I2c_Status status)
+{
+    uint8_t p = (uint8_t) t->priority;
+    heads[p] = t->next;
+    if (!heads[p]) {
+        tails[p] = nullptr;
+    }
+    t->next = nullptr;
+
+    uint32_t wait = perf_cycles() - t->queued_at;
+    stats.transactions[p]++;
+    if (status != I2c_Status::DONE) {
+        stats.failed[p]++;
+    }
+    if (wait > stats.max_wait_cycles[p]) {
+        stats.max_wait_cycles[p] = wait;
+    }
+
+    t->status = status;
+    if (t->on_done) {
+        t->on_done(t);
+    }
+}
+
+#if defined(ARDUINO_ARCH_SAM)
+
+#include <Wire.h>
+
+#define I2C_TWI WIRE_INTERFACE
+
+// The chunk on the bus.
+static uint8_t chunk_length = 0;
+static uint8_t chunk_moved = 0;// Read from RHR, or written to THR
+static bool stop_sent = false;
+static uint32_t chunk_started = 0;
+
+static bool polling = false;
+
+static uint32_t irq_save()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static void irq_restore(uint32_t primask)
+{
+    __set_PRIMASK(primask);
+}
+
+static bool in_interrupt()
+{
+    return __get_IPSR() != 0;
+}
+
+static void start_chunk(i2c_transaction* t)
+{
+    uint8_t left = t->length - t->done;
+    chunk_length = (t->priority == I2c_Priority::CONTROL || left < I2C_BUS_CHUNK_BYTES) ? left : I2C_BUS_CHUNK_BYTES;
+    chunk_moved = 0;
+    stop_sent = false;
+    chunk_started = perf_cycles();
+    current = t;
+    t->status = I2c_Status::BUSY;
+    stats.chunks++;
+
+    Twi* twi = I2C_TWI;
+    twi->TWI_MMR = TWI_MMR_DADR(t->address) | TWI_MMR_IADRSZ_1_BYTE | (t->read ? TWI_MMR_MREAD : 0);
+    twi->TWI_IADR = TWI_IADR_IADR((uint8_t) (t->reg + t->done));
+
+    // Clears a NACK or overrun left over.
+    (void) twi->TWI_SR;
+
+    if (t->read) {
+        // A single byte needs STOP with START.
+        stop_sent = chunk_length == 1;
+        twi->TWI_CR = stop_sent ? (TWI_CR_START | TWI_CR_STOP) : TWI_CR_START;
+    }
+    else {
+        // Writing THR starts it.
+        twi->TWI_THR = t->data[t->done];
+        chunk_moved = 1;
+    }
+}
+
+static void chunk_failed(i2c_transaction* t, bool nack)
+{
+    current = nullptr;
+    if (!nack) {
+        // Timed out or overran, start the TWI over. This leaves its interrupts off, as Wire has them.
+        TWI_ConfigureMaster(I2C_TWI, I2C_BUS_CLOCK_HZ, VARIANT_MCK);
+    }
+
+    if (++t->tries >= I2C_BUS_RETRIES) {
+        finish(t, I2c_Status::FAILED);
+        return;
+    }
+
+    // The chunk goes again, from where it started.
+    stats.retries++;
+    t->status = I2c_Status::QUEUED;
+}
+
+static void service_chunk()
+{
+    i2c_transaction* t = current;
+    Twi* twi = I2C_TWI;
+    uint32_t sr = twi->TWI_SR;
+    bool stopping = stop_sent;
+
+    if (sr & TWI_SR_NACK) {
+        chunk_failed(t, true);
+        return;
+    }
+    if (sr & TWI_SR_OVRE) {
+        chunk_failed(t, false);
+        return;
+    }
+
+    if (t->read) {
+        if (sr & TWI_SR_RXRDY) {
+            uint8_t value = twi->TWI_RHR;
+            if (chunk_moved < chunk_length) {
+                t->data[t->done + chunk_moved++] = value;
+            }
+            // STOP goes after the byte being received now, the last.
+            if (!stop_sent && chunk_moved == chunk_length - 1) {
+                twi->TWI_CR = TWI_CR_STOP;
+                stop_sent = true;
+            }
+        }
+    }
+    else if ((sr & TWI_SR_TXRDY) && !stop_sent) {
+        if (chunk_moved < chunk_length) {
+            twi->TWI_THR = t->data[t->done + chunk_moved++];
+        }
+        else {
+            twi->TWI_CR = TWI_CR_STOP;
+            stop_sent = true;
+        }
+    }
+
+    // TXCOMP is only looked at once STOP was sent before this status was read.
+    if (stopping && (sr & TWI_SR_TXCOMP) && chunk_moved == chunk_length) {
+        current = nullptr;
+        t->done += chunk_length;
+        t->tries = 0;
+        if (t->done >= t->length) {
+            finish(t, I2c_Status::DONE);
+        }
+        else {
+            t->status = I2c_Status::QUEUED;
+        }
+        return;
+    }
+
+    if (perf_cycles() - chunk_started > (uint32_t) I2C_BUS_TIMEOUT_US * PERF_CYCLES_PER_US) {
+        chunk_failed(t, false);
+    }
+}
+
+static void step()
+{
+    if (current) {
+        service_chunk();
+    }
+
+    // Straight on to the next chunk, whichever is most urgent.
+    while (!current) {
+        i2c_transaction* t = most_urgent();
+        if (!t) {
+            break;
+        }
+        start_chunk(t);
+    }
+}
+
+static void poll_handler()
+{
+    uint32_t primask = irq_save();
+    step();
+    if (!current && !most_urgent()) {
+        Timer3.stop();
+        polling = false;
+    }
+    irq_restore(primask);
+}
+
+static void start_polling()
+{
+    if (!polling && (current || most_urgent())) {
+        polling = true;
+        Timer3.start(I2C_BUS_POLL_US);
+    }
+}
+
+void i2c_bus_init()
+{
+    Wire.setClock(I2C_BUS_CLOCK_HZ);
+    Timer3.attachInterrupt(poll_handler);
+}
+
+#else
+
+// Host: nothing answers, a transaction fails as soon as it starts.
+static uint32_t irq_save()
+{
+    return 0;
+}
+
+static void irq_restore(uint32_t primask)
+{
+    (void) primask;
+}
+
+static bool in_interrupt()
+{
+    return false;
+}
+
+static void step()
+{
+    while (i2c_transaction* t = most_urgent()) {
+        finish(t, I2c_Status::FAILED);
+    }
+}
+
+static void start_polling()
+{
+}
+
+void i2c_bus_init()
+{
+}
+
+#endif
+
+bool i2c_bus_submit(i2c_transaction& transaction)
+{
+    uint32_t primask = irq_save();
+    if (transaction.status == I2c_Status::QUEUED || transaction.status == I2c_Status::BUSY) {
+        irq_restore(primask);
+        return false;
+    }
+
+    transaction.done = 0;
+    transaction.tries = 0;
+    transaction.next = nullptr;
+    transaction.queued_at = perf_cycles();
+    transaction.status = I2c_Status::QUEUED;
+
+    uint8_t p = (uint8_t) transaction.priority;
+    if (tails[p]) {
+        tails[p]->next = &transaction;
+    }
+    else {
+        heads[p] = &transaction;
+    }
+    tails[p] = &transaction;
+
+    if (!current) {
+        step();
+    }
+    start_polling();
+    irq_restore(primask);
+    return true;
+}
+
+bool i2c_bus_transfer(i2c_transaction& transaction)
+{
+    // Held by loop(), which was interrupted in the middle of using Wire.
+    if (held && in_interrupt()) {
+        stats.held_off++;
+        return false;
+    }
+
+    transaction.priority = I2c_Priority::CONTROL;
+    if (!i2c_bus_submit(transaction)) {
+        return false;
+    }
+
+    while (transaction.status == I2c_Status::QUEUED || transaction.status == I2c_Status::BUSY) {
+        uint32_t primask = irq_save();
+        step();
+        irq_restore(primask);
+    }
+    return transaction.status == I2c_Status::DONE;
+}
+
+void i2c_bus_lock()
+{
+    uint32_t primask = irq_save();
+    held++;
+    irq_restore(primask);
+
+    // Nothing new starts, let the chunk in flight finish.
+    while (current) {
+        primask = irq_save();
+        step();
+        irq_restore(primask);
+    }
+}
+
+void i2c_bus_unlock()
+{
+    uint32_t primask = irq_save();
+    if (held) {
+        held--;
+    }
+    if (!held) {
+        if (!current) {
+            step();
+        }
+        start_polling();
+    }
+    irq_restore(primask);
+}
+
+void i2c_bus_get_stats(i2c_bus_stats& out)
+{
+    uint32_t primask = irq_save();
+    out = stats;
+    irq_restore(primask);
+}
+
+void i2c_bus_reset_stats()
+{
+    uint32_t primask = irq_save();
+    stats = {};
+    irq_restore(primask);
+}
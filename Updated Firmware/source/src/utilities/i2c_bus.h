@@ -0,0 +1,115 @@
+#ifndef UVENT_I2C_BUS_H
+#define UVENT_I2C_BUS_H
+
+#include "../config/uvent_conf.h"
+#include <Arduino.h>
+
+/* Queued transactions on the I2C bus the touch controller, angle sensor and EEPROM share.
+ *
+ * A transaction is a read or write of registers starting at reg, owned by the
+ * caller until it is done. It is queued by priority and moved by the TWI
+ * peripheral one byte at a time, the bus stepped from Timer3 every
+ * I2C_BUS_POLL_US while anything is queued and stopped when nothing is. When a
+ * transaction finishes, its status is set and its on_done called, from the
+ * timer interrupt or whoever stepped the bus.
+ *
+ * Touch and bulk reads are cut into chunks of I2C_BUS_CHUNK_BYTES, each its
+ * own start and stop with the register address moved on. Between chunks the
+ * most urgent transaction queued goes next, so a control read waits for at most
+ * one chunk, never a whole burst of touch registers.
+ *
+ * i2c_bus_transfer() is for the control handler: it queues a control read and
+ * steps the bus itself until it is done. Code that uses Wire, like the EEPROM
+ * library, holds the bus with I2cBusLock, which lets the chunk in flight finish
+ * and keeps the queue off the bus until it is let go. A transfer from an
+ * interrupt while it is held fails at once, the caller uses its last reading.
+ *
+ * The TWI interrupt is Wire's, so the bus is polled rather than interrupt driven.
+ * Host builds have nothing on the bus: transactions fail as soon as they are queued.
+ */
+
+#define I2C_BUS_PRIORITIES 3
+
+enum class I2c_Priority : uint8_t {
+    CONTROL = 0,// From the control handler, never cut into chunks
+    TOUCH = 1,  // Touch controller, for LVGL
+    BULK = 2    // Anything else
+};
+
+enum class I2c_Status : uint8_t {
+    IDLE,  // Not queued
+    QUEUED,// Waiting, or between chunks
+    BUSY,  // A chunk on the bus
+    DONE,
+    FAILED // NACK, or timed out I2C_BUS_RETRIES times
+};
+
+struct i2c_transaction;
+
+typedef void (*i2c_done_cb)(i2c_transaction* transaction);
+
+struct i2c_transaction {
+    uint8_t address;// 7 bit
+    uint8_t reg;    // First register, sent as a one byte internal address
+    uint8_t* data;
+    uint8_t length; // At least 1
+    bool read;
+    I2c_Priority priority;
+    i2c_done_cb on_done;
+    void* user_data;
+
+    volatile I2c_Status status;
+
+    // The queue's.
+    uint8_t done;
+    uint8_t tries;
+    uint32_t queued_at;
+    i2c_transaction* next;
+};
+
+struct i2c_bus_stats {
+    uint32_t transactions[I2C_BUS_PRIORITIES];
+    uint32_t failed[I2C_BUS_PRIORITIES];
+    uint32_t max_wait_cycles[I2C_BUS_PRIORITIES];// From queued to done
+    uint32_t chunks;
+    uint32_t retries;
+    uint32_t held_off;// Control transfers failed as the bus was held
+};
+
+/**
+ * Sets up the TWI for the queue, call from setup() after Wire.begin().
+ */
+void i2c_bus_init();
+
+/**
+ * Queues a transaction, from anywhere.
+ * @return false if it is still queued.
+ */
+bool i2c_bus_submit(i2c_transaction& transaction);
+
+/**
+ * Queues a control transaction and steps the bus until it is done. For the
+ * control handler, loop() may call it too.
+ * @return Whether it was done, false if it failed or the bus was held.
+ */
+bool i2c_bus_transfer(i2c_transaction& transaction);
+
+/**
+ * Holds the bus for Wire, from loop(). Waits for the chunk in flight. Nests.
+ */
+void i2c_bus_lock();
+void i2c_bus_unlock();
+
+void i2c_bus_get_stats(i2c_bus_stats& out);
+
+void i2c_bus_reset_stats();
+
+/* Holds the bus for the rest of the scope it is declared in.
+ */
+class I2cBusLock {
+public:
+    I2cBusLock() { i2c_bus_lock(); }
+    ~I2cBusLock() { i2c_bus_unlock(); }
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "memtest.h"
+#include <malloc.h>
+#include "logging.h"
+
+#ifdef ARDUINO_ARCH_SAM
+extern char _end;
+extern "C" char* sbrk(int i);
+static const char* ramstart = (char*) 0x20070000;
+static const char* ramend = (char*) 0x20088000;
+#endif
+
+// glibc from 2.33 has mallinfo2() in place of mallinfo().
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define MEM_MALLINFO mallinfo2
+#else
+#define MEM_MALLINFO mallinfo
+#endif
+
+static uint32_t setup_heap_size = 0;
+static uint32_t setup_heap_used = 0;
+
+void mem_mark_setup()
+{
+    setup_heap_size = mem_heap_size();
+    setup_heap_used = mem_heap_used();
+}
+
+uint32_t mem_heap_used()
+{
+    return MEM_MALLINFO().uordblks;
+}
+
+uint32_t mem_heap_size()
+{
+#ifdef ARDUINO_ARCH_SAM
+    return sbrk(0) - &_end;
+#else
+    return MEM_MALLINFO().arena;
+#endif
+}
+
+int32_t mem_heap_growth()
+{
+    return (int32_t) (mem_heap_size() - setup_heap_size);
+}
+
+void printMem()
+{
+    serial_printf("------------------------\n");
+    serial_printf("Dynamic ram used: %d bytes, %d after setup\n", (int) mem_heap_used(), (int) setup_heap_used);
+    serial_printf("Heap size: %d bytes, grown %d since setup\n", (int) mem_heap_size(), (int) mem_heap_growth());
+#ifdef ARDUINO_ARCH_SAM
+    char* heapend = sbrk(0);
+    register char* stack_ptr asm ("sp");
+    struct mallinfo mi = mallinfo();
+    serial_printf("Program static ram used %d bytes\n", &_end-ramstart);
+    serial_printf("Stack ram used %d bytes\n", ramend-stack_ptr);
+    serial_printf("My guess at free mem: %d bytes\n", stack_ptr-heapend+mi.fordblks);
+#endif
+    serial_printf("------------------------\n\n");
+}
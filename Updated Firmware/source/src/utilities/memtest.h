@@ -1,26 +1,30 @@
 #ifndef UVENT_MEMTEST_H
 #define UVENT_MEMTEST_H
 
-#include <malloc.h>
-#include "logging.h"
-
-extern char _end;
-extern "C" char* sbrk(int i);
-const char* ramstart = (char*) 0x20070000;
-const char* ramend = (char*) 0x20088000;
-
-inline void printMem()
-{
-    char* heapend = sbrk(0);
-    register char* stack_ptr asm ("sp");
-    struct mallinfo mi = mallinfo();
-    serial_printf("------------------------\n");
-    serial_printf("Dynamic ram used: %d bytes\n", mi.uordblks);
-    serial_printf("Program static ram used %d bytes\n", &_end-ramstart);
-    serial_printf("Stack ram used %d bytes\n", ramend-stack_ptr);
-    serial_printf("My guess at free mem: %d bytes\n", stack_ptr-heapend+mi.fordblks);
-    serial_printf("------------------------\n\n");
-
-}
+#include <Arduino.h>
+
+/* Heap use, and how much the heap has grown since setup().
+ *
+ * Everything that allocates should be done by the end of setup(). The heap only
+ * ever grows, sbrk() doesn't give memory back, so its size is a high water mark:
+ * if it is bigger than it was after setup(), something allocated on the way
+ * and the long run fragmentation that comes with it has started.
+ *
+ * Host builds only have the allocator's view of the heap.
+ */
+
+// Takes the heap as it is now as the baseline. Call at the end of setup().
+void mem_mark_setup();
+
+// Bytes of heap the allocator has handed out and not had back.
+uint32_t mem_heap_used();
+
+// Bytes the heap has grown to.
+uint32_t mem_heap_size();
+
+// Bytes the heap has grown since mem_mark_setup().
+int32_t mem_heap_growth();
+
+void printMem();
 
 #endif //UVENT_MEMTEST_H
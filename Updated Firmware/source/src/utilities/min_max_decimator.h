@@ -0,0 +1,86 @@
+#ifndef UVENT_MIN_MAX_DECIMATOR_H
+#define UVENT_MIN_MAX_DECIMATOR_H
+
+#include <Arduino.h>
+#include "fixed_point.h"
+
+/* Cuts a stream of samples into columns, the lowest and highest sample of each.
+ *
+ * A sweep of samples_per_sweep samples is spread over columns columns as evenly
+ * as whole samples go: column k ends after floor((k + 1) * samples / columns)
+ * samples, so no sample is dropped and none counted twice, and a sweep always
+ * takes the same time whatever the rounding. Drawn as a line from its lowest to
+ * its highest sample, a column shows every peak inside it, however short.
+ *
+ * With fewer samples than columns, a sample finishes more than one column and
+ * they all get it.
+ */
+class MinMaxDecimator {
+public:
+    void configure(uint32_t samples_per_sweep, uint32_t columns)
+    {
+        samples = samples_per_sweep;
+        this->columns = columns;
+        column = 0;
+        in_sweep = 0;
+        in_column = 0;
+        column_end = columns ? column_end_of(0) : 0;
+    }
+
+    uint32_t get_columns() const { return columns; }
+
+    /**
+     * Adds a sample.
+     * @return The number of columns the sample finished, usually 0 or 1, each
+     * with column_min and column_max.
+     */
+    uint32_t add(q16_t sample, q16_t& column_min, q16_t& column_max)
+    {
+        if (columns == 0 || samples == 0) {
+            return 0;
+        }
+
+        if (in_column == 0 || sample < low) {
+            low = sample;
+        }
+        if (in_column == 0 || sample > high) {
+            high = sample;
+        }
+        in_column++;
+        in_sweep++;
+
+        uint32_t finished = 0;
+        while (in_sweep >= column_end) {
+            finished++;
+            if (++column == columns) {
+                column = 0;
+                in_sweep = 0;
+            }
+            column_end = column_end_of(column);
+            if (column == 0) {
+                break;
+            }
+        }
+
+        if (finished) {
+            column_min = low;
+            column_max = high;
+            in_column = 0;
+        }
+        return finished;
+    }
+
+private:
+    uint32_t column_end_of(uint32_t k) const { return (uint64_t) (k + 1) * samples / columns; }
+
+    uint32_t samples = 0;
+    uint32_t columns = 0;
+    uint32_t column = 0;
+    uint32_t column_end = 0;
+    uint32_t in_sweep = 0;
+    uint32_t in_column = 0;
+    q16_t low = 0;
+    q16_t high = 0;
+};
+
+#endif
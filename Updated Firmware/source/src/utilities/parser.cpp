@@ -39,8 +39,8 @@ void Parser::init(command_type* pComArr, uint16_t comArrSize)
  */
 void Parser::service()
 {
-    // Read a single byte from the serial port
-    if (Serial.available() > 0) {
+    // Everything that came in since the last call, a command is run as soon as its line ends.
+    while (Serial.available() > 0) {
         handle_input(Serial.read());
     }
 }
@@ -0,0 +1,130 @@
+// Before Arduino.h, its min/max macros break <chrono>.
+#if !defined(ARDUINO_ARCH_SAM)
+#include <chrono>
+#endif
+
+#include "perf.h"
+
+#define PERF_PROBES static_cast<int>(Perf_Probe::COUNT)
+
+static perf_stats probes[PERF_PROBES] = {
+        {"control", CONTROL_HANDLER_PERIOD_US, CONTROL_HANDLER_PERIOD_US},
+#if USE_HW_STEP_GENERATOR && !ENABLE_WIPER_MOTOR
+        {"actuator", 0, ACTUATOR_HANDLER_PERIOD_US},
+#else
+        {"actuator", ACTUATOR_HANDLER_PERIOD_US, ACTUATOR_HANDLER_PERIOD_US},
+#endif
+        {"lvgl", 0, PERF_LVGL_BUDGET_US},
+        {"readouts", SENSOR_POLL_INTERVAL * 1000UL, PERF_LVGL_BUDGET_US},
+        {"dma", 0, PERF_DMA_ISR_BUDGET_US},
+        {"alarms", CONTROL_HANDLER_PERIOD_US, PERF_ALARM_RULES_BUDGET_US},
+};
+
+static uint32_t histogram_bin(uint32_t cycles)
+{
+    uint32_t us = cycles / PERF_CYCLES_PER_US;
+    uint32_t bin = (us == 0) ? 0 : 32 - __builtin_clz(us);
+    return (bin < PERF_HISTOGRAM_BINS) ? bin : PERF_HISTOGRAM_BINS - 1;
+}
+
+static void clear_stats(perf_stats& stats)
+{
+    stats.calls = 0;
+    stats.overruns = 0;
+    stats.min_cycles = UINT32_MAX;
+    stats.max_cycles = 0;
+    stats.total_cycles = 0;
+    stats.has_last_start = false;
+    stats.min_period_cycles = UINT32_MAX;
+    stats.max_period_cycles = 0;
+    memset(stats.exec_histogram, 0, sizeof(stats.exec_histogram));
+    memset(stats.jitter_histogram, 0, sizeof(stats.jitter_histogram));
+}
+
+#if defined(ARDUINO_ARCH_SAM)
+
+static void start_cycle_counter()
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+#else
+
+static void start_cycle_counter() {}
+
+uint32_t perf_cycles()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    return (uint32_t) (ns * PERF_CYCLES_PER_US / 1000);
+}
+
+#endif
+
+void perf_init()
+{
+    start_cycle_counter();
+    perf_reset();
+}
+
+uint32_t perf_begin(Perf_Probe probe)
+{
+    uint32_t now = perf_cycles();
+    perf_stats& stats = probes[static_cast<int>(probe)];
+
+    if (stats.has_last_start) {
+        uint32_t period = now - stats.last_start;
+        if (period < stats.min_period_cycles) {
+            stats.min_period_cycles = period;
+        }
+        if (period > stats.max_period_cycles) {
+            stats.max_period_cycles = period;
+        }
+
+        if (stats.period_us != 0) {
+            uint32_t nominal = stats.period_us * PERF_CYCLES_PER_US;
+            stats.jitter_histogram[histogram_bin(period > nominal ? period - nominal : nominal - period)]++;
+        }
+    }
+    stats.has_last_start = true;
+    stats.last_start = now;
+
+    return now;
+}
+
+void perf_end(Perf_Probe probe, uint32_t start)
+{
+    uint32_t cycles = perf_cycles() - start;
+    perf_stats& stats = probes[static_cast<int>(probe)];
+
+    stats.calls++;
+    stats.total_cycles += cycles;
+    if (cycles < stats.min_cycles) {
+        stats.min_cycles = cycles;
+    }
+    if (cycles > stats.max_cycles) {
+        stats.max_cycles = cycles;
+    }
+    if (cycles > stats.budget_us * PERF_CYCLES_PER_US) {
+        stats.overruns++;
+    }
+    stats.exec_histogram[histogram_bin(cycles)]++;
+}
+
+void perf_get_stats(Perf_Probe probe, perf_stats& out)
+{
+    noInterrupts();
+    out = probes[static_cast<int>(probe)];
+    interrupts();
+}
+
+void perf_reset()
+{
+    for (int i = 0; i < PERF_PROBES; i++) {
+        noInterrupts();
+        clear_stats(probes[i]);
+        interrupts();
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef UVENT_PERF_H
+#define UVENT_PERF_H
+
+#include "../config/uvent_conf.h"
+#include <Arduino.h>
+
+/* Execution time and period of the handlers that have deadlines.
+ *
+ * Each probe times one handler with the Cortex-M3 DWT cycle counter, which
+ * runs at the core clock and costs a register read. Per probe it keeps the
+ * min/max/mean execution time, the spread of the time between calls, and two
+ * histograms: execution time, and how far each period was off the nominal one.
+ * A call that takes longer than the probe's budget is an overrun.
+ *
+ * The histograms have power of two bins in microsec, bin 0 is under 1 us,
+ * bin n from 2^(n-1) up to 2^n us, and the last bin takes everything above.
+ *
+ * It is always on. A probe is written only by its own handler, the command
+ * reads a copy taken with interrupts off. The counter wraps every 51 s, a
+ * handler that is called less often than that has no period.
+ *
+ * Host builds count with the host's clock, scaled to Due cycles.
+ */
+
+#define PERF_HISTOGRAM_BINS 16
+
+// Due core clock, cycles per microsec.
+#define PERF_CYCLES_PER_US 84
+
+enum class Perf_Probe {
+    CONTROL_HANDLER, // Timer0, the state machine
+    ACTUATOR,        // Timer1, the actuator handler, or the step generator's segment interrupt
+    LV_TASK_HANDLER, // LVGL, from loop()
+    UPDATE_READOUTS, // Readout task, sensor readouts and charts
+    DMA_ISR,         // Display DMA done
+    ALARM_RULES,     // Alarm rules, from the control handler
+    COUNT
+};
+
+struct perf_stats {
+    const char* name;
+    uint32_t period_us;// Nominal period, 0 if it isn't called periodically
+    uint32_t budget_us;// Longer than this is an overrun
+
+    uint32_t calls;
+    uint32_t overruns;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+
+    // Between the starts of two calls.
+    bool has_last_start;
+    uint32_t last_start;
+    uint32_t min_period_cycles;
+    uint32_t max_period_cycles;
+
+    uint32_t exec_histogram[PERF_HISTOGRAM_BINS];
+    uint32_t jitter_histogram[PERF_HISTOGRAM_BINS];
+};
+
+/**
+ * Starts the cycle counter and clears the stats.
+ */
+void perf_init();
+
+#if defined(ARDUINO_ARCH_SAM)
+inline uint32_t perf_cycles()
+{
+    return DWT->CYCCNT;
+}
+#else
+uint32_t perf_cycles();
+#endif
+
+/**
+ * Marks the start of a call, returns the time to pass to perf_end().
+ */
+uint32_t perf_begin(Perf_Probe probe);
+
+void perf_end(Perf_Probe probe, uint32_t start);
+
+/**
+ * Copies the stats of a probe, with interrupts off.
+ */
+void perf_get_stats(Perf_Probe probe, perf_stats& out);
+
+void perf_reset();
+
+/* Times the rest of the scope it is declared in.
+ */
+class PerfScope {
+public:
+    explicit PerfScope(Perf_Probe probe) : probe(probe), start(perf_begin(probe)) {}
+    ~PerfScope() { perf_end(probe, start); }
+
+private:
+    Perf_Probe probe;
+    uint32_t start;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef UVENT_RING_BUFFER_H
+#define UVENT_RING_BUFFER_H
+
+#include <Arduino.h>
+
+/* Single producer ring buffer of samples, without locks.
+ *
+ * One writer, usually an interrupt, pushes samples and overwrites the oldest.
+ * Any number of readers look at it without taking samples out: the latest one,
+ * a window of the newest ones, or a stream that picks up where it left off.
+ *
+ * Samples are published by bumping a running count after the sample is stored.
+ * A reader copies what it wants and then checks the count again. If the writer
+ * lapped the copied samples in the meantime, the copy is redone. While the count
+ * is c the writer may be storing sample c, over sample c - N, so only the newest
+ * N - 1 samples can be read.
+ *
+ * N must be a power of two, 2 or more.
+ */
+template<typename T, uint32_t N>
+class RingBuffer {
+    static_assert(N > 1 && (N & (N - 1)) == 0, "RingBuffer size must be a power of two, 2 or more");
+
+public:
+    // Producer only.
+    void push(T value)
+    {
+        uint32_t n = written;
+        data[n & (N - 1)] = value;
+        __sync_synchronize();
+        written = n + 1;
+    }
+
+    // Total number of samples pushed so far. Wraps, differences stay valid.
+    uint32_t count() const { return written; }
+
+    static constexpr uint32_t capacity() { return N; }
+
+    // The most samples a reader can get at once, one less than the capacity.
+    static constexpr uint32_t readable() { return N - 1; }
+
+    // The newest sample, or T() if nothing was pushed yet.
+    T latest() const
+    {
+        for (;;) {
+            uint32_t n = written;
+            if (n == 0) {
+                return T();
+            }
+            __sync_synchronize();
+            T value = data[(n - 1) & (N - 1)];
+            __sync_synchronize();
+
+            // Safe unless the writer got round to the sample's slot while we read.
+            if (written - n < N - 1) {
+                return value;
+            }
+        }
+    }
+
+    /**
+     * Copies the newest samples, oldest first.
+     * @return The number copied, fewer than n if not that many were pushed yet, at most readable().
+     */
+    uint32_t read_window(T* out, uint32_t n) const
+    {
+        if (n > readable()) {
+            n = readable();
+        }
+
+        for (;;) {
+            uint32_t end = written;
+            uint32_t copied = end < n ? end : n;
+            uint32_t start = end - copied;
+
+            __sync_synchronize();
+            for (uint32_t i = 0; i < copied; i++) {
+                out[i] = data[(start + i) & (N - 1)];
+            }
+            __sync_synchronize();
+
+            // The oldest sample copied must not have been overwritten, nor be being written.
+            if (written - start < N) {
+                return copied;
+            }
+        }
+    }
+
+    /**
+     * Reads the samples pushed since the last call, for a consumer that wants every sample.
+     * Each output is the average of decimation samples, only whole groups are taken.
+     * If the reader fell more than readable() behind, it skips ahead to the oldest sample it can read.
+     * @param next Running count of the next sample to read, start with count() and keep it between calls.
+     * @return The number of outputs written.
+     */
+    uint32_t read_since(uint32_t& next, T* out, uint32_t max_out, uint32_t decimation = 1) const
+    {
+        // Groups are added up in integers, there is no FPU to do it in floats.
+        static_assert(sizeof(T) <= sizeof(uint16_t) && T(-1) > T(0) && N <= 65536, "read_since() sums up to 65536 unsigned samples of up to 16 bits");
+
+        if (decimation == 0) {
+            decimation = 1;
+        }
+
+        for (;;) {
+            uint32_t end = written;
+            uint32_t start = next;
+            if (end - start > readable()) {
+                start = end - readable();
+            }
+
+            uint32_t outputs = (end - start) / decimation;
+            if (outputs > max_out) {
+                outputs = max_out;
+            }
+
+            __sync_synchronize();
+            uint32_t pos = start;
+            for (uint32_t i = 0; i < outputs; i++) {
+                // A group fits in the buffer, so the sum can't overflow.
+                uint32_t sum = 0;
+                for (uint32_t k = 0; k < decimation; k++) {
+                    sum += data[pos++ & (N - 1)];
+                }
+                out[i] = T(sum / decimation);
+            }
+            __sync_synchronize();
+
+            if (written - start < N) {
+                next = pos;
+                return outputs;
+            }
+        }
+    }
+
+private:
+    T data[N];
+    volatile uint32_t written = 0;
+};
+
+#endif
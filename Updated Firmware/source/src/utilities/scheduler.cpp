@@ -0,0 +1,175 @@
+#include "scheduler.h"
+#include "utilities/perf.h"
+#include "utilities/util.h"
+
+struct scheduler_task {
+    scheduler_task_stats stats;
+    scheduler_task_fn run;
+    bool background;
+    bool running;
+    uint32_t release_us;
+};
+
+static scheduler_task tasks[SCHEDULER_MAX_TASKS];
+static int task_count = 0;
+
+static uint64_t idle_cycles = 0;
+static uint32_t stats_start_ms = 0;
+
+// Microsec from now to time, negative once it has gone by. Good across the wrap of now_us().
+static int32_t until(uint32_t time, uint32_t now)
+{
+    return (int32_t) (time - now);
+}
+
+/* The released task with the earliest deadline, -1 if none is released. A
+ * task that is running, waiting on something, isn't run again inside itself.
+ */
+static int earliest_due(uint32_t now, bool background_only)
+{
+    int best = -1;
+    uint32_t best_deadline = 0;
+    for (int i = 0; i < task_count; i++) {
+        const scheduler_task& task = tasks[i];
+        if (!task.stats.enabled || task.running || (background_only && !task.background)) {
+            continue;
+        }
+        if (until(task.release_us, now) > 0) {
+            continue;
+        }
+
+        uint32_t deadline = task.release_us + task.stats.period_us;
+        if (best < 0 || until(deadline, best_deadline) < 0) {
+            best = i;
+            best_deadline = deadline;
+        }
+    }
+    return best;
+}
+
+static void run_task(scheduler_task& task, uint32_t now)
+{
+    scheduler_task_stats& stats = task.stats;
+    uint32_t late = now - task.release_us;
+    uint32_t deadline = task.release_us + stats.period_us;
+
+    task.running = true;
+    uint32_t start = perf_cycles();
+    task.run();
+    uint32_t cycles = perf_cycles() - start;
+    task.running = false;
+
+    uint32_t end = now_us();
+    stats.runs++;
+    stats.total_cycles += cycles;
+    if (cycles > stats.max_cycles) {
+        stats.max_cycles = cycles;
+    }
+    if (cycles > stats.budget_us * PERF_CYCLES_PER_US) {
+        stats.overruns++;
+    }
+    if (until(deadline, end) < 0) {
+        stats.misses++;
+    }
+    if (late > stats.max_late_us) {
+        stats.max_late_us = late;
+    }
+
+    task.release_us += stats.period_us;
+    if (until(task.release_us, end) < 0) {
+        task.release_us = end;
+    }
+}
+
+int scheduler_add(const char* name, scheduler_task_fn run, uint32_t period_us, uint32_t budget_us, bool background)
+{
+    if (task_count == SCHEDULER_MAX_TASKS) {
+        return -1;
+    }
+
+    scheduler_task& task = tasks[task_count];
+    task.stats = {};
+    task.stats.name = name;
+    task.stats.period_us = period_us;
+    task.stats.budget_us = budget_us;
+    task.stats.enabled = true;
+    task.run = run;
+    task.background = background;
+    task.running = false;
+    task.release_us = now_us();
+    return task_count++;
+}
+
+void scheduler_set_enabled(int task, bool enabled)
+{
+    if (task < 0 || task >= task_count) {
+        return;
+    }
+
+    if (enabled && !tasks[task].stats.enabled) {
+        tasks[task].release_us = now_us();
+    }
+    tasks[task].stats.enabled = enabled;
+}
+
+void scheduler_run()
+{
+    uint32_t now = now_us();
+    int task = earliest_due(now, false);
+    if (task >= 0) {
+        run_task(tasks[task], now);
+        return;
+    }
+
+    /* Sleep with interrupts masked: the one that wakes the core is only taken once
+     * the idle time is read, so the time spent in it isn't counted as idle.
+     */
+#if defined(ARDUINO_ARCH_SAM)
+    __disable_irq();
+    uint32_t start = perf_cycles();
+    // The millisecond tick wakes it if nothing else does.
+    __WFI();
+    idle_cycles += perf_cycles() - start;
+    __enable_irq();
+#endif
+}
+
+void scheduler_yield()
+{
+    uint32_t now = now_us();
+    int task = earliest_due(now, true);
+    if (task >= 0) {
+        run_task(tasks[task], now);
+    }
+}
+
+int scheduler_task_count()
+{
+    return task_count;
+}
+
+void scheduler_get_stats(int task, scheduler_task_stats& out)
+{
+    out = tasks[task].stats;
+}
+
+void scheduler_get_idle(uint32_t& elapsed_ms, uint64_t& idle)
+{
+    elapsed_ms = now_ms() - stats_start_ms;
+    idle = idle_cycles;
+}
+
+void scheduler_reset_stats()
+{
+    for (int i = 0; i < task_count; i++) {
+        scheduler_task_stats& stats = tasks[i].stats;
+        stats.runs = 0;
+        stats.overruns = 0;
+        stats.misses = 0;
+        stats.max_cycles = 0;
+        stats.total_cycles = 0;
+        stats.max_late_us = 0;
+    }
+    idle_cycles = 0;
+    stats_start_ms = now_ms();
+}
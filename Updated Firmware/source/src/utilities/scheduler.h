@@ -0,0 +1,73 @@
+#ifndef UVENT_SCHEDULER_H
+#define UVENT_SCHEDULER_H
+
+#include "../config/uvent_conf.h"
+#include <Arduino.h>
+
+/* Runs the work of loop() as periodic tasks, earliest deadline first.
+ *
+ * A task is released every period_us and is due by the next release. Each
+ * call of scheduler_run() runs the released task with the earliest deadline,
+ * start to end, as nothing is preempted. With none released the core sleeps
+ * until the next interrupt, a millisecond at most with the tick, and the time
+ * asleep is counted as idle, the interrupt that wakes it is not.
+ *
+ * A task that took longer than its budget is an overrun, one that ended past
+ * its deadline a miss. Releases a task missed aren't made up: the next one is
+ * a period after the last, or now if that has gone by.
+ *
+ * Background tasks don't touch LVGL, so scheduler_yield() may run them while
+ * a task waits, e.g. on the display DMA.
+ *
+ * Everything here is from loop(). Timing is on the perf cycle counter.
+ */
+
+struct scheduler_task_stats {
+    const char* name;
+    uint32_t period_us;
+    uint32_t budget_us;
+    bool enabled;
+
+    uint32_t runs;
+    uint32_t overruns;
+    uint32_t misses;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+    uint32_t max_late_us;// From release to start
+};
+
+typedef void (*scheduler_task_fn)();
+
+/**
+ * Adds an enabled task, released now.
+ * @return Its number, -1 if there are SCHEDULER_MAX_TASKS already.
+ */
+int scheduler_add(const char* name, scheduler_task_fn run, uint32_t period_us, uint32_t budget_us, bool background);
+
+/**
+ * Stops or starts a task, one started is released now.
+ */
+void scheduler_set_enabled(int task, bool enabled);
+
+/**
+ * Runs the task due first, or sleeps until an interrupt if none is. Call from loop().
+ */
+void scheduler_run();
+
+/**
+ * Runs the background task due first, if one is, from a task that is waiting.
+ */
+void scheduler_yield();
+
+int scheduler_task_count();
+
+void scheduler_get_stats(int task, scheduler_task_stats& out);
+
+/**
+ * Time since the stats were reset, and how much of it the scheduler had nothing to run.
+ */
+void scheduler_get_idle(uint32_t& elapsed_ms, uint64_t& idle_cycles);
+
+void scheduler_reset_stats();
+
+#endif
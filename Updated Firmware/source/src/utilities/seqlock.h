@@ -0,0 +1,74 @@
+#ifndef UVENT_SEQLOCK_H
+#define UVENT_SEQLOCK_H
+
+#include <Arduino.h>
+
+/* A value written by one writer, usually an interrupt, and read whole by others without locks.
+ *
+ * The writer makes the sequence odd, stores the value and makes it even again.
+ * A reader copies the value between two reads of the sequence and takes the
+ * copy only if both were the same even number, otherwise it copies again. So a
+ * reader never sees half of one write and half of another, and the writer
+ * never waits. A reader interrupted by the writer on the Due copies once more.
+ *
+ * T must be copyable with memcpy.
+ */
+template<typename T>
+class SeqLock {
+public:
+    // Writer only.
+    void write(const T& value)
+    {
+        uint32_t s = sequence;
+        sequence = s + 1;
+        __sync_synchronize();
+        copy(&stored, &value);
+        __sync_synchronize();
+        sequence = s + 2;
+    }
+
+    T read() const
+    {
+        T out;
+        read(out);
+        return out;
+    }
+
+    /**
+     * Copies the newest value.
+     * @return Its sequence, even, 0 if nothing was written yet. It changes with every write.
+     */
+    uint32_t read(T& out) const
+    {
+        for (;;) {
+            uint32_t before = sequence;
+            __sync_synchronize();
+            if (before & 1) {
+                continue;
+            }
+            copy(&out, &stored);
+            __sync_synchronize();
+            if (sequence == before) {
+                return before;
+            }
+        }
+    }
+
+    uint32_t get_sequence() const { return sequence; }
+
+private:
+    // Byte by byte through volatile, so the compiler keeps the copy between the barriers.
+    static void copy(volatile void* to, const volatile void* from)
+    {
+        volatile uint8_t* d = static_cast<volatile uint8_t*>(to);
+        const volatile uint8_t* s = static_cast<const volatile uint8_t*>(from);
+        for (uint32_t i = 0; i < sizeof(T); i++) {
+            d[i] = s[i];
+        }
+    }
+
+    volatile uint32_t sequence = 0;
+    T stored = {};
+};
+
+#endif
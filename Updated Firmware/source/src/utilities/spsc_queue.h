@@ -0,0 +1,59 @@
+#ifndef UVENT_SPSC_QUEUE_H
+#define UVENT_SPSC_QUEUE_H
+
+#include <Arduino.h>
+
+/* Queue from one producer to one consumer, without locks.
+ *
+ * The producer, usually an interrupt, only moves head, the consumer only tail,
+ * each after the entries it covers are stored or copied out. Neither waits on
+ * the other. When the queue is full, new entries are dropped and counted, the
+ * queued ones are kept.
+ *
+ * N must be a power of two.
+ */
+template<typename T, uint32_t N>
+class SpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    // Producer only. Returns false if it was full.
+    bool push(const T& value)
+    {
+        uint32_t h = head;
+        if (h - tail >= N) {
+            dropped++;
+            return false;
+        }
+        data[h & (N - 1)] = value;
+        __sync_synchronize();
+        head = h + 1;
+        return true;
+    }
+
+    // Consumer only. Returns false if it was empty.
+    bool pop(T& out)
+    {
+        uint32_t t = tail;
+        if (head == t) {
+            return false;
+        }
+        __sync_synchronize();
+        out = data[t & (N - 1)];
+        __sync_synchronize();
+        tail = t + 1;
+        return true;
+    }
+
+    uint32_t size() const { return head - tail; }
+
+    uint32_t get_dropped() const { return dropped; }
+
+private:
+    T data[N];
+    volatile uint32_t head = 0;
+    volatile uint32_t tail = 0;
+    volatile uint32_t dropped = 0;
+};
+
+#endif
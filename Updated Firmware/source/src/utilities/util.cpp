@@ -1,8 +1,18 @@
 #include "util.h"
 
+// millis() and micros() run off SysTick on the Due.
+clock_source_t clock_source = millis;
+clock_source_t clock_source_us = micros;
+
+void set_clock_source(clock_source_t source, clock_source_t source_us)
+{
+    clock_source = source ? source : millis;
+    clock_source_us = source_us ? source_us : micros;
+}
+
 bool has_time_elapsed(uint32_t* timer_ptr, uint32_t n)
 {
-    uint32_t ms = millis();
+    uint32_t ms = now_ms();
     bool result = ms - *timer_ptr >= n;
 
     if (ms < *timer_ptr || result) {
@@ -26,6 +26,27 @@ inline auto max(const Tpa& a, const Tpb& b) -> decltype(b > a ? b : a)
 
 #define EPSILON 0.0000001
 
+/* Source of the current time, in milliseconds or microsec.
+ * Every time read in the firmware goes through now_ms() or now_us(), so the clock can be
+ * swapped out, e.g. for a stepped virtual clock in host builds.
+ */
+typedef uint32_t (* clock_source_t)();
+
+extern clock_source_t clock_source;
+extern clock_source_t clock_source_us;
+
+/**
+ * @param source The new time source, nullptr restores millis().
+ * @param source_us The same clock in microsec, nullptr restores micros().
+ */
+void set_clock_source(clock_source_t source, clock_source_t source_us = nullptr);
+
+// Returns the current time in milliseconds
+inline uint32_t now_ms() { return clock_source(); }
+
+// Returns the current time in microsec
+inline uint32_t now_us() { return clock_source_us(); }
+
 /**
  * @param ptr The pointer to the field/var keeping the time
  * @param n The amount of millis required to elapse
@@ -34,7 +55,7 @@ inline auto max(const Tpa& a, const Tpb& b) -> decltype(b > a ? b : a)
 bool has_time_elapsed(uint32_t* ptr, uint32_t n);
 
 // Returns the current time in seconds
-inline float now_s() { return millis() * 1e-3; }
+inline float now_s() { return now_ms() * 1e-3; }
 
 bool is_whole(double x, double epsilon = EPSILON);
 
@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+"""Decoder and recorder for the UVent binary telemetry stream.
+
+The firmware side is src/controls/telemetry.h, which describes the frame and the
+records. Turn the stream on with the "telem on" command, or pass --start.
+
+Reads from the serial port (needs pyserial) or from a recording, and can save
+the raw bytes and write each record type to its own CSV file:
+
+    tools/telemetry.py --port /dev/ttyACM0 --start --record run.bin --csv run/
+    tools/telemetry.py --file run.bin --csv run/
+
+A native build records a simulated run with: program 60 20 50 --telemetry run.bin
+"""
+
+import argparse
+import csv
+import os
+import struct
+import sys
+import zlib
+
+TELEMETRY_VERSION = 2
+
+# Same order as States in src/controls/machine.h
+STATES = ['STARTUP', 'INSPR', 'INSPR_HOLD', 'EXPR', 'PEEP_PAUSE', 'EXPR_HOLD', 'ACTUATOR_HOME',
+          'ACTUATOR_JOG', 'FAULT', 'DEBUG', 'OFF']
+
+RECORD_SAMPLES = 1
+RECORD_TICK = 2
+RECORD_STATE = 3
+RECORD_BREATH = 4
+
+HEADER = struct.Struct('<BBH')
+SAMPLES_HEADER = struct.Struct('<IHB')
+SAMPLE = struct.Struct('<hh')
+TICK = struct.Struct('<IBh')
+STATE = struct.Struct('<IBB')
+BREATH = struct.Struct('<IIHfffHHHfffffffffff')
+
+BREATH_FIELDS = ['time_ms', 'cycle', 'bpm', 'volume_ml', 'ie_i', 'ie_e', 'pip', 'peep', 'plateau_time',
+                 'm_pip', 'm_peep', 'm_plateau_press', 'm_rr', 'm_ie_i', 'm_ie_e', 'm_vti', 'm_vte',
+                 'm_minute_volume', 'm_compliance', 'm_resistance']
+
+
+def state_name(state):
+    return STATES[state] if state < len(STATES) else str(state)
+
+
+def cobs_decode(data):
+    """Returns the decoded frame, or None if it isn't valid COBS."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    """Splits the byte stream on 0 and checks each frame. Text on the port fails the check and is counted."""
+
+    def __init__(self, on_record):
+        self.on_record = on_record
+        self.buffer = bytearray()
+        self.frames = 0
+        self.bad_frames = 0
+        self.lost_frames = 0
+        self.last_sequence = None
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            end = self.buffer.find(b'\x00')
+            if end < 0:
+                return
+            chunk = bytes(self.buffer[:end])
+            del self.buffer[:end + 1]
+            if chunk:
+                self.frame(chunk)
+
+    def frame(self, chunk):
+        raw = cobs_decode(chunk)
+        if raw is None or len(raw) < HEADER.size + 4:
+            self.bad_frames += 1
+            return
+
+        body, crc = raw[:-4], struct.unpack('<I', raw[-4:])[0]
+        if zlib.crc32(body) != crc:
+            self.bad_frames += 1
+            return
+
+        version, record_type, sequence = HEADER.unpack_from(body)
+        if version != TELEMETRY_VERSION:
+            self.bad_frames += 1
+            return
+
+        # Dropped on the unit, or lost on the way.
+        if self.last_sequence is not None:
+            self.lost_frames += (sequence - self.last_sequence - 1) & 0xFFFF
+        self.last_sequence = sequence
+        self.frames += 1
+
+        self.on_record(record_type, body[HEADER.size:])
+
+
+class Recorder:
+    """Turns records into CSV rows, and prints each breath."""
+
+    def __init__(self, csv_dir, quiet):
+        self.quiet = quiet
+        self.writers = {}
+        self.files = []
+        self.next_sample = None
+        self.lost_samples = 0
+        if csv_dir:
+            os.makedirs(csv_dir, exist_ok=True)
+            self.writers[RECORD_SAMPLES] = self.open(csv_dir, 'samples.csv', ['sample', 'time_s', 'pressure_cmh2o', 'flow_lpm'])
+            self.writers[RECORD_TICK] = self.open(csv_dir, 'ticks.csv', ['time_ms', 'state', 'position_deg'])
+            self.writers[RECORD_STATE] = self.open(csv_dir, 'states.csv', ['time_ms', 'from', 'to'])
+            self.writers[RECORD_BREATH] = self.open(csv_dir, 'breaths.csv', BREATH_FIELDS)
+
+    def open(self, csv_dir, name, header):
+        f = open(os.path.join(csv_dir, name), 'w', newline='')
+        self.files.append(f)
+        writer = csv.writer(f)
+        writer.writerow(header)
+        return writer
+
+    def close(self):
+        for f in self.files:
+            f.close()
+
+    def write(self, record_type, row):
+        writer = self.writers.get(record_type)
+        if writer:
+            writer.writerow(row)
+
+    def record(self, record_type, payload):
+        if record_type == RECORD_SAMPLES:
+            first, rate_hz, count = SAMPLES_HEADER.unpack_from(payload)
+            if self.next_sample is not None and first != self.next_sample:
+                self.lost_samples += (first - self.next_sample) & 0xFFFFFFFF
+            self.next_sample = (first + count) & 0xFFFFFFFF
+            for i in range(count):
+                pressure, flow = SAMPLE.unpack_from(payload, SAMPLES_HEADER.size + i * SAMPLE.size)
+                sample = first + i
+                self.write(record_type, [sample, '%.4f' % (sample / rate_hz), pressure / 100, flow / 100])
+        elif record_type == RECORD_TICK:
+            time_ms, state, position = TICK.unpack_from(payload)
+            self.write(record_type, [time_ms, state_name(state), position / 100])
+        elif record_type == RECORD_STATE:
+            time_ms, state_from, state_to = STATE.unpack_from(payload)
+            self.write(record_type, [time_ms, state_name(state_from), state_name(state_to)])
+        elif record_type == RECORD_BREATH:
+            breath = dict(zip(BREATH_FIELDS, BREATH.unpack_from(payload)))
+            self.write(record_type, ['%.3f' % v if isinstance(v, float) else v for v in breath.values()])
+            if not self.quiet:
+                print('%8.1f s  breath %5d  pip %5.1f  plat %5.1f  peep %5.1f  vti %6.1f  vte %6.1f  mv %5.2f  rr %4.1f'
+                      '  c %5.1f  r %5.1f'
+                      % (breath['time_ms'] / 1000, breath['cycle'], breath['m_pip'], breath['m_plateau_press'],
+                         breath['m_peep'], breath['m_vti'], breath['m_vte'], breath['m_minute_volume'], breath['m_rr'],
+                         breath['m_compliance'], breath['m_resistance']))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--port', help='serial port of the unit')
+    source.add_argument('--file', help='recording to decode')
+    parser.add_argument('--baud', type=int, default=115200, help='SERIAL_BAUD_RATE of the unit')
+    parser.add_argument('--start', action='store_true', help='send "telem on" first, and "telem off" on exit')
+    parser.add_argument('--record', help='save the raw bytes from the port to this file')
+    parser.add_argument('--csv', help='directory to write samples, ticks, states and breaths CSV files to')
+    parser.add_argument('--quiet', action='store_true', help="don't print each breath")
+    args = parser.parse_args()
+
+    recorder = Recorder(args.csv, args.quiet)
+    decoder = Decoder(recorder.record)
+
+    try:
+        if args.file:
+            with open(args.file, 'rb') as f:
+                decoder.feed(f.read())
+        else:
+            try:
+                import serial
+            except ImportError:
+                sys.exit('Reading the port needs pyserial: pip install pyserial')
+
+            raw = open(args.record, 'wb') if args.record else None
+            port = serial.Serial(args.port, args.baud, timeout=0.1)
+            if args.start:
+                port.write(b'telem on\r')
+            try:
+                while True:
+                    data = port.read(4096)
+                    if raw and data:
+                        raw.write(data)
+                    decoder.feed(data)
+            except KeyboardInterrupt:
+                pass
+            finally:
+                if args.start:
+                    port.write(b'telem off\r')
+                port.close()
+                if raw:
+                    raw.close()
+    finally:
+        recorder.close()
+
+    print('%d records, %d lost, %d samples lost, %d bad frames or text'
+          % (decoder.frames, decoder.lost_frames, recorder.lost_samples, decoder.bad_frames))
+
+
+if __name__ == '__main__':
+    main()